@@ -0,0 +1,358 @@
+#!/usr/bin/env python3
+# Framed batch client for the "Binmode test framework" binmode (dirtyproto)
+# Packs many commands into one BM_FRAME request and reads back one response frame.
+# Several frames can be queued before reading the responses (pipelining).
+# Scripts are uploaded once and run on the device, only the values they emit come back.
+#
+# Usage: dirtyproto_frame.py [port] [--selftest] [--frames N]
+#   select the binmode on the Bus Pirate first: binmode, then "Binmode test framework"
+#   port is the binary CDC port, usually the second /dev/ttyACMx or COMx
+#
+# Requires pyserial
+import argparse
+import struct
+import sys
+import time
+
+BM_BITORDER_MSB = 11
+BM_BITORDER_LSB = 12
+BM_AUX_READ = 14
+BM_DELAY_US = 24
+BM_DELAY_MS = 25
+BM_CHANGE_MODE = 7
+BM_CONFIG = 30
+BM_WRITE = 31
+BM_START = 32
+BM_STOP = 34
+BM_READ = 36
+BM_FRAME = 43
+BM_WRITE_BULK = 44
+BM_READ_BULK = 45
+BM_I2C_TRANSACTION = 46
+BM_SCRIPT_LOAD = 47
+BM_SCRIPT_RUN = 48
+
+# script opcodes, see src/binmode/dirtyproto_script.h
+SCRIPT_OP = {
+    "end": 0x80,
+    "set": 0x81,
+    "mov": 0x82,
+    "add": 0x83,
+    "and": 0x84,
+    "res": 0x85,
+    "emit": 0x86,
+    "echo": 0x87,
+    "callr": 0x88,
+    "jmp": 0x89,
+    "jz": 0x8A,
+    "jnz": 0x8B,
+    "jeq": 0x8C,
+    "jne": 0x8D,
+    "djnz": 0x8E,
+}
+
+FRAME_MAX = 512
+
+STATUS = {
+    0: "ok",
+    1: "invalid command",
+    2: "truncated command",
+    3: "request too long",
+    4: "response full",
+    5: "bad script operand",
+    6: "script step limit",
+}
+
+I2C_STATUS = {
+    0: "ok",
+    1: "nack",
+    2: "timeout",
+    3: "not in I2C mode",
+    4: "transaction too long",
+}
+
+
+def i2c_request(addr, data, rxlen):
+    data = bytes(data)
+    return struct.pack("<BBHH", BM_I2C_TRANSACTION, addr, len(data), rxlen) + data
+
+
+class Frame:
+    """Builder for one request frame, each method appends a command"""
+
+    def __init__(self):
+        self.data = bytearray()
+        self.results = 0  # expected result bytes
+
+    def command(self, cmd, *args):
+        self.data.append(cmd)
+        self.data.extend(args)
+        self.results += 1
+        return self
+
+    def write(self, data):
+        data = bytes(data)
+        for i in range(0, len(data), 255):
+            chunk = data[i:i + 255]
+            self.data.extend((BM_WRITE_BULK, len(chunk)))
+            self.data.extend(chunk)
+            self.results += len(chunk)
+        return self
+
+    def read(self, count):
+        while count:
+            n = min(count, 255)
+            self.data.extend((BM_READ_BULK, n))
+            self.results += n
+            count -= n
+        return self
+
+    def i2c(self, addr, data, rxlen):
+        # one I2C transaction, adds a status byte and rxlen data bytes to the results
+        self.data.extend(i2c_request(addr, data, rxlen))
+        self.results += 1 + rxlen
+        return self
+
+    def start(self):
+        return self.command(BM_START)
+
+    def stop(self):
+        return self.command(BM_STOP)
+
+    def delay_us(self, us):
+        return self.command(BM_DELAY_US, us)
+
+    def delay_ms(self, ms):
+        return self.command(BM_DELAY_MS, ms)
+
+    def change_mode(self, name):
+        self.data.append(BM_CHANGE_MODE)
+        self.data.extend(name.encode() + b"\0")
+        self.results += 1
+        return self
+
+    def encode(self):
+        if len(self.data) > FRAME_MAX:
+            raise ValueError("frame is %d bytes, max %d" % (len(self.data), FRAME_MAX))
+        return struct.pack("<BH", BM_FRAME, len(self.data)) + bytes(self.data)
+
+
+class Script(Frame):
+    """Builder for a script, the Frame methods add commands, the rest add script opcodes
+    Jump targets are label names, r0 holds the last result byte of each command"""
+
+    def __init__(self):
+        super().__init__()
+        self.labels = {}
+        self.fixups = []  # (offset, label) of each jump target
+
+    def label(self, name):
+        self.labels[name] = len(self.data)
+        return self
+
+    def op(self, name, *args):
+        self.data.append(SCRIPT_OP[name])
+        self.data.extend(args)
+        return self
+
+    def imm16(self, value):
+        self.data.extend(struct.pack("<H", value & 0xFFFF))
+
+    def target(self, label):
+        self.fixups.append((len(self.data), label))
+        self.data.extend((0, 0))
+
+    def end(self):
+        return self.op("end")
+
+    def set(self, reg, value):
+        self.op("set", reg)
+        self.imm16(value)
+        return self
+
+    def mov(self, dst, src):
+        return self.op("mov", dst, src)
+
+    def add(self, reg, value):
+        self.op("add", reg)
+        self.imm16(value)
+        return self
+
+    def and_(self, reg, mask):
+        self.op("and", reg)
+        self.imm16(mask)
+        return self
+
+    def res(self, reg, index):
+        return self.op("res", reg, index)
+
+    def emit(self, reg):
+        return self.op("emit", reg)
+
+    def echo(self, on):
+        return self.op("echo", 1 if on else 0)
+
+    def callr(self, cmd, reg):
+        return self.op("callr", cmd, reg)
+
+    def jmp(self, label):
+        self.op("jmp")
+        self.target(label)
+        return self
+
+    def jump_if(self, name, reg, label, value=None):
+        self.op(name, reg)
+        if value is not None:
+            self.imm16(value)
+        self.target(label)
+        return self
+
+    def jz(self, reg, label):
+        return self.jump_if("jz", reg, label)
+
+    def jnz(self, reg, label):
+        return self.jump_if("jnz", reg, label)
+
+    def jeq(self, reg, value, label):
+        return self.jump_if("jeq", reg, label, value)
+
+    def jne(self, reg, value, label):
+        return self.jump_if("jne", reg, label, value)
+
+    def djnz(self, reg, label):
+        return self.jump_if("djnz", reg, label)
+
+    def program(self):
+        data = bytearray(self.data)
+        for offset, label in self.fixups:
+            data[offset:offset + 2] = struct.pack("<H", self.labels[label])
+        if len(data) > FRAME_MAX:
+            raise ValueError("script is %d bytes, max %d" % (len(data), FRAME_MAX))
+        return bytes(data)
+
+    def encode(self):
+        program = self.program()
+        return struct.pack("<BH", BM_SCRIPT_LOAD, len(program)) + program
+
+
+class Client:
+    def __init__(self, port, timeout=2.0):
+        import serial
+
+        self.port = serial.Serial(port, 115200, timeout=timeout)
+        self.port.reset_input_buffer()
+
+    def send(self, frame):
+        self.port.write(frame.encode())
+
+    def receive(self):
+        header = self.port.read(3)
+        if len(header) != 3:
+            raise TimeoutError("no response frame")
+        status, length = struct.unpack("<BH", header)
+        payload = self.port.read(length)
+        if len(payload) != length:
+            raise TimeoutError("short response frame")
+        return status, payload
+
+    def transact(self, frame):
+        self.send(frame)
+        return self.receive()
+
+    def i2c(self, addr, data=b"", rxlen=0):
+        # standalone I2C transaction, returns (status, rxlen bytes)
+        self.port.write(i2c_request(addr, data, rxlen))
+        response = self.port.read(1 + rxlen)
+        if len(response) != 1 + rxlen:
+            raise TimeoutError("short I2C response")
+        return response[0], response[1:]
+
+    def load(self, script):
+        # store a script on the device, returns the status
+        self.port.write(script.encode())
+        status = self.port.read(1)
+        if len(status) != 1:
+            raise TimeoutError("no script load status")
+        return status[0]
+
+    def run(self, steps=0):
+        # run the loaded script, 0 steps for the firmware default, returns (status, emitted bytes)
+        self.port.write(struct.pack("<BI", BM_SCRIPT_RUN, steps))
+        return self.receive()
+
+    def pipeline(self, frames):
+        # queue every request, then collect the responses in order
+        for f in frames:
+            self.send(f)
+        return [self.receive() for _ in frames]
+
+
+def selftest(client, frames):
+    ok = True
+
+    def check(name, got, want):
+        nonlocal ok
+        result = "PASS" if got == want else "FAIL"
+        if got != want:
+            ok = False
+        print("%s %s: got %r, expected %r" % (result, name, got, want))
+
+    # commands without bus activity, valid in any mode
+    f = Frame().delay_us(10).command(BM_BITORDER_MSB).command(BM_BITORDER_LSB).delay_ms(1)
+    check("basic frame", client.transact(f), (0, bytes(4)))
+
+    # empty frame
+    check("empty frame", client.transact(Frame()), (0, b""))
+
+    # nested frames are rejected, earlier results are kept
+    f = Frame().delay_us(1)
+    f.data.extend((BM_FRAME, 0, 0))
+    check("nested frame", client.transact(f), (1, bytes(1)))
+
+    # bulk write with missing data
+    f = Frame().delay_us(1)
+    f.data.extend((BM_WRITE_BULK, 4, 0x00))
+    check("truncated bulk write", client.transact(f), (2, bytes(1)))
+
+    # pipelined frames
+    batch = [Frame().delay_us(1).command(BM_BITORDER_MSB) for _ in range(frames)]
+    start = time.perf_counter()
+    results = client.pipeline(batch)
+    elapsed = time.perf_counter() - start
+    check("pipelined frames", results, [(0, bytes(2))] * frames)
+    print("%d frames, %d commands in %.1f ms" % (frames, frames * 2, elapsed * 1000))
+
+    # script: count down from 5, emitting the counter each pass
+    s = Script().set(1, 5).label("loop").emit(1).djnz(1, "loop").end()
+    check("script load", client.load(s), 0)
+    check("script loop", client.run(), (0, bytes([5, 4, 3, 2, 1])))
+
+    # only emitted values come back, command results stay on the device
+    s = Script().delay_us(1).command(BM_BITORDER_MSB).emit(0)
+    client.load(s)
+    check("script emit", client.run(), (0, bytes(1)))
+
+    # an endless loop is stopped by the step limit
+    client.load(Script().label("top").jmp("top"))
+    check("script step limit", client.run(1000), (6, b""))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="dirtyproto framed batch client")
+    parser.add_argument("port", help="binary CDC port")
+    parser.add_argument("--selftest", action="store_true", help="run protocol checks")
+    parser.add_argument("--frames", type=int, default=32, help="frames in the pipelined test")
+    args = parser.parse_args()
+
+    client = Client(args.port)
+    if args.selftest:
+        sys.exit(0 if selftest(client, args.frames) else 1)
+
+    # example: one SPI style transaction in a single round trip
+    status, payload = client.transact(Frame().start().write([0x9f]).read(3).stop())
+    print("status: %s, results: %s" % (STATUS.get(status, status), payload.hex(" ")))
+
+
+if __name__ == "__main__":
+    main()
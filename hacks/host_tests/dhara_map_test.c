@@ -0,0 +1,356 @@
+// Host test for the dhara map lookup caches (src/dhara/map.c)
+// The map runs on a simulated NAND in RAM. The Makefile builds this test twice, with the
+// default caches and with both caches off (DHARA_MAP_CACHE_SIZE=0, DHARA_MAP_NODE_CACHE_SIZE=0).
+// - every read is checked against a reference model of the sectors, unmapped and trimmed
+//   sectors must read blank and dhara_map_find must report them as not found
+// - the workloads are FAT like: FAT and directory sectors read over and over, data written
+//   and trimmed, syncs, a FAT that stays cached while garbage collection moves it, and a run
+//   on a chip with factory bad blocks where erases fail
+// - after each run the map is synced, resumed from the NAND and every sector read again
+// - the caches may not change what is written: each run logs a hash of the read data, of
+//   every program and erase and of the final flash image, check compares the two logs
+// - the metadata reads per sector read are printed, the NAND cost the caches save
+//
+// Usage: dhara_map_test [log]    log gets the hashes to compare between the two builds
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "dhara/map.h"
+
+#define LOG2_PAGE_SIZE 9
+#define LOG2_PPB 6
+#define BLOCKS 256
+#define PAGE_SIZE (1 << LOG2_PAGE_SIZE)
+#define PAGES (BLOCKS << LOG2_PPB)
+#define SECTORS 6000
+#define FAT_SECTORS 64
+#define DIR_SECTORS 64
+#define GC_RATIO 4
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+static uint8_t flash[PAGES][PAGE_SIZE];
+static bool page_free[PAGES], block_bad[BLOCKS], block_failing[BLOCKS];
+static uint32_t fail_rate; // one in fail_rate erases fails, 0 for none
+static uint32_t page_reads, meta_reads, progs, erases;
+static uint32_t nand_hash, read_hash;
+
+static uint32_t rng;
+static uint32_t rnd(void) {
+    rng = rng * 1103515245 + 12345;
+    return (rng >> 8) & 0xffffff;
+}
+
+// FNV-1a
+static void hash(uint32_t* h, const void* data, size_t len) {
+    const uint8_t* p = data;
+    for (size_t i = 0; i < len; i++) {
+        *h = (*h ^ p[i]) * 16777619;
+    }
+}
+
+static void hash_op(char op, uint32_t n) {
+    hash(&nand_hash, &op, 1);
+    hash(&nand_hash, &n, sizeof(n));
+}
+
+int dhara_nand_is_bad(const struct dhara_nand* n, dhara_block_t b) {
+    (void)n;
+    return block_bad[b];
+}
+
+void dhara_nand_mark_bad(const struct dhara_nand* n, dhara_block_t b) {
+    (void)n;
+    hash_op('B', b);
+    block_bad[b] = true;
+}
+
+int dhara_nand_erase(const struct dhara_nand* n, dhara_block_t b, dhara_error_t* err) {
+    (void)n;
+    hash_op('E', b);
+    erases++;
+    if (fail_rate && rnd() % fail_rate == 0) {
+        block_failing[b] = true;
+    }
+    if (block_failing[b]) {
+        dhara_set_error(err, DHARA_E_BAD_BLOCK);
+        return -1;
+    }
+    memset(flash[b << LOG2_PPB], 0xff, PAGE_SIZE << LOG2_PPB);
+    for (uint32_t p = 0; p < (1u << LOG2_PPB); p++) {
+        page_free[(b << LOG2_PPB) + p] = true;
+    }
+    return 0;
+}
+
+int dhara_nand_prog(const struct dhara_nand* n, dhara_page_t p, const uint8_t* data, dhara_error_t* err) {
+    (void)n;
+    hash_op('P', p);
+    hash(&nand_hash, data, PAGE_SIZE);
+    progs++;
+    if (!page_free[p]) {
+        printf("FAIL page %u programmed twice\n", p);
+        exit(1);
+    }
+    page_free[p] = false;
+    if (block_failing[p >> LOG2_PPB]) {
+        dhara_set_error(err, DHARA_E_BAD_BLOCK);
+        return -1;
+    }
+    memcpy(flash[p], data, PAGE_SIZE);
+    return 0;
+}
+
+int dhara_nand_is_free(const struct dhara_nand* n, dhara_page_t p) {
+    (void)n;
+    return page_free[p];
+}
+
+int dhara_nand_read(const struct dhara_nand* n, dhara_page_t p, size_t offset, size_t length, uint8_t* data,
+                    dhara_error_t* err) {
+    (void)n;
+    (void)err;
+    if (length == PAGE_SIZE) {
+        page_reads++;
+    } else {
+        meta_reads++;
+    }
+    memcpy(data, &flash[p][offset], length);
+    return 0;
+}
+
+int dhara_nand_copy(const struct dhara_nand* n, dhara_page_t src, dhara_page_t dst, dhara_error_t* err) {
+    static uint8_t buf[PAGE_SIZE];
+    page_reads++;
+    memcpy(buf, flash[src], PAGE_SIZE);
+    return dhara_nand_prog(n, dst, buf, err);
+}
+
+static const struct dhara_nand nand = { LOG2_PAGE_SIZE, LOG2_PPB, BLOCKS };
+static uint8_t page_buf[PAGE_SIZE];
+static struct dhara_map map;
+
+static uint32_t model[SECTORS]; // the version written to each sector, 0 for unmapped
+static uint32_t version;
+static uint32_t recent[16]; // the last sectors read or written, a file being worked on
+static uint32_t recent_next;
+static uint32_t sector_reads, sector_meta_reads;
+static bool failed;
+
+static void fill(uint8_t* data, uint32_t s, uint32_t v) {
+    for (uint32_t i = 0; i < PAGE_SIZE; i += 8) {
+        memcpy(&data[i], &s, 4);
+        memcpy(&data[i + 4], &v, 4);
+    }
+}
+
+static void check(bool ok, const char* what, uint32_t s, dhara_error_t err) {
+    if (!ok && !failed) {
+        printf("FAIL %s sector %u: %s\n", what, s, dhara_strerror(err));
+        failed = true;
+    }
+}
+
+static void map_read(uint32_t s) {
+    uint8_t data[PAGE_SIZE], expect[PAGE_SIZE];
+    dhara_error_t err = DHARA_E_NONE;
+    uint32_t meta = meta_reads;
+    if (model[s]) {
+        fill(expect, s, model[s]);
+    } else {
+        memset(expect, 0xff, PAGE_SIZE);
+    }
+    int ret = dhara_map_read(&map, s, data, &err);
+    check(ret == 0, "read", s, err);
+    check(memcmp(data, expect, PAGE_SIZE) == 0, "read data of", s, DHARA_E_NONE);
+    sector_reads++;
+    sector_meta_reads += meta_reads - meta;
+    recent[recent_next++ % count_of(recent)] = s;
+    hash(&read_hash, data, PAGE_SIZE);
+
+    dhara_page_t page;
+    err = DHARA_E_NONE;
+    ret = dhara_map_find(&map, s, &page, &err);
+    check(model[s] ? ret == 0 : (ret < 0 && err == DHARA_E_NOT_FOUND), "find", s, err);
+}
+
+static void map_write(uint32_t s) {
+    uint8_t data[PAGE_SIZE];
+    dhara_error_t err = DHARA_E_NONE;
+    model[s] = ++version;
+    fill(data, s, model[s]);
+    recent[recent_next++ % count_of(recent)] = s;
+    int ret = dhara_map_write(&map, s, data, &err);
+    check(ret == 0, "write", s, err);
+}
+
+static void map_trim(uint32_t s) {
+    dhara_error_t err = DHARA_E_NONE;
+    model[s] = 0;
+    int ret = dhara_map_trim(&map, s, &err);
+    check(ret == 0, "trim", s, err);
+}
+
+static void map_sync(void) {
+    dhara_error_t err = DHARA_E_NONE;
+    int ret = dhara_map_sync(&map, &err);
+    check(ret == 0, "sync", 0, err);
+}
+
+static uint32_t data_sector(void) {
+    return FAT_SECTORS + DIR_SECTORS + rnd() % (SECTORS - FAT_SECTORS - DIR_SECTORS);
+}
+
+// half the time a sector that was just used, so trims and reads find it in the cache
+static uint32_t recent_sector(void) {
+    return (rnd() % 2) ? recent[rnd() % count_of(recent)] : data_sector();
+}
+
+// reads mostly: FAT walks, directory scans and file data, with enough data writes that the
+// journal goes round the chip and the FAT is moved by garbage collection only
+static void workload_read(uint32_t ops) {
+    for (uint32_t i = 0; i < ops && !failed; i++) {
+        uint32_t op = rnd() % 100;
+        if (op < 45) {
+            map_read(rnd() % FAT_SECTORS);
+        } else if (op < 70) {
+            map_read(FAT_SECTORS + rnd() % DIR_SECTORS);
+        } else if (op < 90) {
+            map_read(data_sector());
+        } else {
+            map_write(data_sector());
+        }
+    }
+}
+
+// a log file growing while the FAT is read: FAT and directory fill the 128 sector cache
+// slots, the data goes to the directory's slots only, so the FAT stays cached while garbage
+// collection moves it
+static void workload_fat_hot(uint32_t ops) {
+    const uint32_t stride = FAT_SECTORS + DIR_SECTORS;
+    for (uint32_t i = 0; i < ops && !failed; i++) {
+        uint32_t s = (1 + rnd() % (SECTORS / stride - 1)) * stride + FAT_SECTORS + rnd() % DIR_SECTORS;
+        if (rnd() % 2) {
+            map_read(rnd() % FAT_SECTORS);
+        } else {
+            map_write(s);
+        }
+    }
+}
+
+// metadata and data writes, trims and syncs between the reads, as the FTL does them
+static void workload_mixed(uint32_t ops) {
+    for (uint32_t i = 0; i < ops && !failed; i++) {
+        uint32_t op = rnd() % 100;
+        if (op < 30) {
+            map_read(rnd() % (FAT_SECTORS + DIR_SECTORS));
+        } else if (op < 50) {
+            map_read(recent_sector());
+        } else if (op < 60) {
+            map_write(rnd() % (FAT_SECTORS + DIR_SECTORS));
+        } else if (op < 88) {
+            map_write(data_sector());
+        } else if (op < 97) {
+            map_trim(recent_sector());
+        } else {
+            map_sync();
+        }
+    }
+}
+
+// sync, forget the RAM state, resume from the NAND and read every sector twice
+static void remount(void) {
+    dhara_error_t err = DHARA_E_NONE;
+    map_sync();
+    dhara_map_init(&map, &nand, page_buf, GC_RATIO);
+    int ret = dhara_map_resume(&map, &err);
+    check(ret == 0, "resume at", 0, err);
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t s = 0; s < SECTORS && !failed; s++) {
+            map_read(s);
+        }
+    }
+    uint32_t mapped = 0;
+    for (uint32_t s = 0; s < SECTORS; s++) {
+        mapped += model[s] != 0;
+    }
+    check(dhara_map_size(&map) == mapped, "size after", mapped, DHARA_E_NONE);
+}
+
+typedef struct {
+    const char* what;
+    uint32_t fail_rate;
+    void (*workload)(uint32_t ops);
+    uint32_t ops;
+} run_t;
+
+static const run_t runs[] = {
+    { "read mostly", 0, workload_read, 200000 },
+    { "FAT hot", 0, workload_fat_hot, 100000 },
+    { "mixed", 0, workload_mixed, 200000 },
+    { "mixed, bad blocks", 50, workload_mixed, 100000 },
+};
+
+static bool run(const run_t* r, FILE* log) {
+    dhara_error_t err;
+    memset(flash, 0xff, sizeof(flash));
+    memset(page_free, true, sizeof(page_free));
+    memset(block_failing, false, sizeof(block_failing));
+    memset(model, 0, sizeof(model));
+    memset(recent, 0, sizeof(recent));
+    rng = 1;
+    fail_rate = r->fail_rate;
+    // about one factory bad block in 40 on a chip that fails
+    for (uint32_t b = 0; b < BLOCKS; b++) {
+        block_bad[b] = fail_rate && rnd() % 40 == 0;
+    }
+    version = 0;
+    page_reads = meta_reads = progs = erases = 0;
+    nand_hash = read_hash = 2166136261u;
+    failed = false;
+
+    dhara_map_init(&map, &nand, page_buf, GC_RATIO);
+    dhara_map_resume(&map, &err);
+    // a formatted and partly filled disk
+    for (uint32_t s = 0; s < SECTORS && !failed; s += 1 + rnd() % 3) {
+        map_write(s);
+    }
+    sector_reads = sector_meta_reads = 0;
+    r->workload(r->ops);
+    double meta_per_read = (double)sector_meta_reads / (sector_reads ? sector_reads : 1);
+    uint32_t reads = sector_reads;
+    if (!failed) {
+        remount();
+    }
+
+    uint32_t image_hash = 2166136261u, bad = 0;
+    hash(&image_hash, flash, sizeof(flash));
+    for (uint32_t b = 0; b < BLOCKS; b++) {
+        bad += block_bad[b];
+    }
+    printf("%s %-18s %6u reads, %.3f metadata reads per read, %u bad blocks\n", failed ? "FAIL" : "ok  ", r->what,
+           reads, meta_per_read, bad);
+    if (log) {
+        fprintf(log, "%s: reads %08x, nand %08x, image %08x, %u programs, %u erases, %u bad blocks\n", r->what,
+                read_hash, nand_hash, image_hash, progs, erases, bad);
+    }
+    return !failed;
+}
+
+int main(int argc, char** argv) {
+    FILE* log = NULL;
+    if (argc > 1 && !(log = fopen(argv[1], "w"))) {
+        perror(argv[1]);
+        return 1;
+    }
+    printf("sector cache %u entries, node cache %u entries\n", DHARA_MAP_CACHE_SIZE, DHARA_MAP_NODE_CACHE_SIZE);
+    int fails = 0;
+    for (size_t r = 0; r < count_of(runs); r++) {
+        fails += !run(&runs[r], log);
+    }
+    if (log) {
+        fclose(log);
+    }
+    return fails ? 1 : 0;
+}
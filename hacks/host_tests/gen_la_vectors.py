@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+# Generates the capture vectors for la_decode_test
+# Each vector is a synthetic capture plus the frames that were encoded into it,
+# so the expected frames come from the generator and not from the decoder.
+#
+# Usage: gen_la_vectors.py [output directory]
+#   writes i2c.vec, spi_mode0-3.vec, spi_nocs.vec, uart.vec and 1wire.vec
+#
+# Vector format, one record per line, # starts a comment:
+#   protocol <i2c|spi|uart|1wire>
+#   pins <channel> ...          LA_DECODE_PIN_NONE is written as -
+#   sample_rate <Hz>
+#   bit_rate <baud>             UART only
+#   cpol <0|1> / cpha <0|1>     SPI only
+#   s <hex sample> <count>      samples, in capture order
+#   f <start> <type> <value> <value2>   expected frames, in emit order
+import os
+import random
+import sys
+
+
+class Capture:
+    def __init__(self, protocol, pins, sample_rate, noise_pin=None, seed=1, noise=0.2):
+        self.protocol = protocol
+        self.pins = pins
+        self.sample_rate = sample_rate
+        self.bit_rate = 0
+        self.cpol = 0
+        self.cpha = 0
+        self.level = 0xff
+        self.samples = []
+        self.frames = []
+        self.noise_pin = noise_pin  # a channel the decoder must ignore
+        self.noise = noise  # toggle probability per sample
+        self.rnd = random.Random(seed)
+
+    def set(self, pin, value):
+        if value:
+            self.level |= 1 << pin
+        else:
+            self.level &= ~(1 << pin)
+
+    def hold(self, count):
+        for _ in range(count):
+            if self.noise_pin is not None and self.rnd.random() < self.noise:
+                self.level ^= 1 << self.noise_pin
+            self.samples.append(self.level)
+
+    @property
+    def index(self):
+        return len(self.samples)
+
+    def frame(self, start, ftype, value=0, value2=0):
+        self.frames.append((start, ftype, value, value2))
+
+    def write(self, path, comment):
+        with open(path, "w", newline="\n") as f:
+            f.write("# %s\n" % comment)
+            f.write("# generated by gen_la_vectors.py, do not edit\n")
+            f.write("protocol %s\n" % self.protocol)
+            f.write("pins %s\n" % " ".join("-" if p is None else str(p) for p in self.pins))
+            f.write("sample_rate %d\n" % self.sample_rate)
+            if self.protocol == "uart":
+                f.write("bit_rate %d\n" % self.bit_rate)
+            if self.protocol == "spi":
+                f.write("cpol %d\ncpha %d\n" % (self.cpol, self.cpha))
+            run_value, run = self.samples[0], 0
+            for s in self.samples:
+                if s != run_value:
+                    f.write("s %02x %d\n" % (run_value, run))
+                    run_value, run = s, 0
+                run += 1
+            f.write("s %02x %d\n" % (run_value, run))
+            for fr in self.frames:
+                f.write("f %d %s %02x %02x\n" % fr)
+
+
+# I2C, h samples per half clock, SDA and SCL are never changed in the same sample
+def i2c_vector():
+    sda, scl, h = 2, 3, 5
+    c = Capture("i2c", [sda, scl], 1000000, noise_pin=6, seed=2)
+    c.hold(20)
+
+    def start(restart=False):
+        if restart:  # SCL is low after the last ACK
+            c.set(sda, 1)
+            c.hold(h)
+            c.set(scl, 1)
+            c.hold(h)
+        c.set(sda, 0)
+        c.frame(c.index, "RESTART" if restart else "START")
+        c.hold(h)
+        c.set(scl, 0)
+        c.hold(h)
+
+    def clock(bit):
+        c.set(sda, bit)
+        c.hold(h)
+        c.set(scl, 1)
+        at = c.index
+        c.hold(h)
+        c.set(scl, 0)
+        c.hold(1)
+        return at
+
+    def byte(value, ftype, ack):
+        first = None
+        for i in range(8):
+            at = clock((value >> (7 - i)) & 1)
+            first = at if first is None else first
+        c.frame(first, ftype, value)
+        at = clock(0 if ack else 1)
+        c.frame(at, "ACK" if ack else "NACK")
+
+    def stop():
+        c.set(sda, 0)
+        c.hold(h)
+        c.set(scl, 1)
+        c.hold(h)
+        c.set(sda, 1)
+        c.frame(c.index, "STOP")
+        c.hold(4 * h)
+
+    # write register 0x10 to a device at 0x50, then read back two bytes with a repeated START
+    start()
+    byte(0x50 << 1, "ADDR", True)
+    byte(0x10, "DATA", True)
+    start(restart=True)
+    byte((0x50 << 1) | 1, "ADDR", True)
+    byte(0xA5, "DATA", True)
+    byte(0x3C, "DATA", False)
+    stop()
+    # address NACK
+    start()
+    byte(0x23 << 1, "ADDR", False)
+    stop()
+    # all ones and all zeros data
+    start()
+    byte(0x7F << 1, "ADDR", True)
+    byte(0xFF, "DATA", True)
+    byte(0x00, "DATA", True)
+    stop()
+    # a STOP while idle is not a frame
+    c.set(scl, 0)
+    c.hold(h)
+    c.set(sda, 0)
+    c.hold(h)
+    c.set(scl, 1)
+    c.hold(h)
+    c.set(sda, 1)
+    c.hold(20)
+    return c
+
+
+# SPI with CLK=0, MOSI=1, MISO=2, CS=3, data changes away from the sampling edge
+def spi_vector(cpol, cpha, cs=True):
+    clk, mosi, miso, csn, h = 0, 1, 2, 3, 4
+    c = Capture("spi", [clk, mosi, miso, csn if cs else None], 1000000, noise_pin=None if cs else 5, seed=3)
+    c.cpol, c.cpha = cpol, cpha
+    c.set(clk, cpol)
+    c.hold(10)
+
+    def select():
+        c.set(csn, 0)
+        c.frame(c.index, "START")
+        c.hold(h)
+
+    def release():
+        c.hold(h)
+        c.set(csn, 1)
+        c.frame(c.index, "STOP")
+        c.hold(2 * h)
+
+    def bit(mo, mi):
+        if cpha == 0:  # data before the leading edge, sampled on it
+            c.set(mosi, mo)
+            c.set(miso, mi)
+            c.hold(h)
+            c.set(clk, not cpol)
+            at = c.index
+            c.hold(h)
+            c.set(clk, cpol)
+        else:  # data after the leading edge, sampled on the trailing edge
+            c.set(clk, not cpol)
+            c.hold(1)
+            c.set(mosi, mo)
+            c.set(miso, mi)
+            c.hold(h)
+            c.set(clk, cpol)
+            at = c.index
+            c.hold(h)
+        return at
+
+    def byte(mo, mi):
+        first = None
+        for i in range(8):
+            at = bit((mo >> (7 - i)) & 1, (mi >> (7 - i)) & 1)
+            first = at if first is None else first
+        c.frame(first, "DATA", mo, mi)
+
+    if cs:
+        select()
+        for mo, mi in ((0x9F, 0xFF), (0x00, 0xEF), (0x00, 0x40), (0x00, 0x18)):
+            byte(mo, mi)
+        release()
+        select()
+        byte(0x55, 0xAA)
+        release()
+        # CS released after 3 bits: the partial byte is an error
+        select()
+        first = bit(1, 0)
+        bit(0, 1)
+        bit(1, 1)
+        c.hold(h)
+        c.set(csn, 1)
+        c.frame(first, "ERROR", 0b101, 0b011)
+        c.frame(c.index, "STOP")
+        c.hold(2 * h)
+        # clocks while deselected are ignored
+        for _ in range(8):
+            bit(1, 1)
+        c.hold(h)
+    else:
+        for mo, mi in ((0x01, 0x80), (0xC3, 0x3C), (0xFF, 0x00)):
+            byte(mo, mi)
+        c.hold(h)
+    return c
+
+
+# UART 8N1 at a baud that is not a divisor of the sample rate
+def uart_vector():
+    rx = 4
+    c = Capture("uart", [rx], 1000000, noise_pin=0, seed=4)
+    c.bit_rate = 115200
+    spb = c.sample_rate / c.bit_rate
+    c.hold(30)
+
+    def char(value, stop=1, idle_bits=2):
+        t0 = c.index
+        bits = [0] + [(value >> i) & 1 for i in range(8)] + [stop]
+        for n, b in enumerate(bits):
+            c.set(rx, b)
+            c.hold(round(t0 + (n + 1) * spb) - c.index)
+        c.frame(t0, "DATA" if stop else "ERROR", value)
+        c.set(rx, 1)
+        c.hold(round(idle_bits * spb))
+
+    for ch in b"Bus Pirate\r\n":
+        char(ch, idle_bits=0)  # back to back
+    char(0x00)
+    char(0xFF)
+    char(0x55)
+    char(0xA3, stop=0)  # framing error
+    # a low glitch shorter than half a bit is not a start bit
+    c.set(rx, 0)
+    c.hold(2)
+    c.set(rx, 1)
+    c.hold(30)
+    char(0x5A)
+    return c
+
+
+# 1-Wire at 2 samples per us
+def onewire_vector():
+    dq = 7
+    c = Capture("1wire", [dq], 2000000, noise_pin=1, seed=5, noise=0.002)
+    us = c.sample_rate // 1000000
+    c.hold(50 * us)
+
+    def low(length_us, ftype=None):
+        c.set(dq, 0)
+        if ftype:
+            c.frame(c.index, ftype)
+        c.hold(length_us * us)
+        c.set(dq, 1)
+
+    def reset(presence=True):
+        low(480, "RESET")
+        c.hold(30 * us)
+        if presence:
+            low(120, "PRESENCE")
+        c.hold((450 if presence else 570) * us)
+
+    def byte(value):
+        start = c.index
+        for i in range(8):
+            low(6 if (value >> i) & 1 else 60)
+            c.hold((64 if (value >> i) & 1 else 10) * us)
+        c.frame(start, "DATA", value)
+
+    reset()
+    byte(0xCC)  # skip ROM
+    byte(0x44)  # convert T
+    reset()
+    byte(0xCC)
+    byte(0xBE)  # read scratchpad
+    byte(0x50)
+    byte(0x05)
+    reset(presence=False)  # no device, the next slots are bits again
+    byte(0x33)  # LSB is a 1, a 0 slot right after a reset would read as a presence pulse
+    c.hold(100 * us)
+    return c
+
+
+def main():
+    out = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "vectors")
+    os.makedirs(out, exist_ok=True)
+    vectors = [
+        ("i2c.vec", i2c_vector(), "I2C write, repeated START read, NACK, STOP while idle"),
+        ("spi_nocs.vec", spi_vector(0, 0, cs=False), "SPI mode 0 without a CS channel"),
+        ("uart.vec", uart_vector(), "UART 115200 8N1 at 1MHz, framing error, glitch"),
+        ("1wire.vec", onewire_vector(), "1-Wire reset, presence, commands, reset without presence"),
+    ]
+    for mode in range(4):
+        vectors.append(("spi_mode%d.vec" % mode, spi_vector(mode >> 1, mode & 1),
+                        "SPI mode %d, CS framing, partial byte, clocks while deselected" % mode))
+    for name, cap, comment in vectors:
+        cap.write(os.path.join(out, name), comment)
+
+
+if __name__ == "__main__":
+    main()
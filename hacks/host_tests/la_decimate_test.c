@@ -0,0 +1,205 @@
+// Host test for the logic analyzer decimation filters (src/binmode/la_decimate.c)
+// - vectors for channel 0 with glitches on the first and last sample of a group, across a
+//   group boundary, ties, odd factors and the partial group flushed at the end of a capture
+// - the majority clamp: factors above LA_DECIMATE_MAJORITY_MAX_FACTOR are clamped and a full
+//   group of 255 highs must not carry into the next channel's counter
+// - random captures on all channels against a per channel reference, fed in random spans
+//   into a small ring so groups span calls and the write index wraps
+//
+// Usage: la_decimate_test
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binmode/la_decimate.h"
+
+#define RING_SIZE 64
+
+static uint8_t ring[RING_SIZE];
+
+typedef struct {
+    const char* what;
+    uint8_t mode;
+    uint32_t factor;
+    const char* in;  // channel 0 per sample, spaces mark the groups
+    const char* out; // channel 0 per output, the last one is the flushed partial group if any
+} vector_t;
+
+static const vector_t vectors[] = {
+    // glitch keeps a pulse shorter than a group as a toggle from the previous output
+    { "high glitch on the first sample", LA_DECIMATE_GLITCH, 4, "1000 0000", "10" },
+    { "high glitch on the last sample", LA_DECIMATE_GLITCH, 4, "0001 0000", "10" },
+    { "high glitch across the boundary", LA_DECIMATE_GLITCH, 4, "0001 1000 0000", "100" },
+    { "low glitch on the first sample", LA_DECIMATE_GLITCH, 4, "1111 0111 1111", "101" },
+    { "low glitch on the last sample", LA_DECIMATE_GLITCH, 4, "1111 1110 1111", "101" },
+    { "edge inside a group", LA_DECIMATE_GLITCH, 4, "0011 1111 1100", "110" },
+    { "pulse inside a group", LA_DECIMATE_GLITCH, 4, "0110 0000", "10" },
+    { "two pulses in a row", LA_DECIMATE_GLITCH, 4, "0100 0010 0000", "100" },
+    { "partial group flushed", LA_DECIMATE_GLITCH, 4, "0000 01", "01" },
+    { "factor 1 passes through", LA_DECIMATE_GLITCH, 1, "0110100", "0110100" },
+    { "factor 0 is factor 1", LA_DECIMATE_GLITCH, 0, "0110100", "0110100" },
+    // majority drops a pulse shorter than half a group, ties keep the previous output
+    { "high glitch on the first sample", LA_DECIMATE_MAJORITY, 4, "1000 0000", "00" },
+    { "high glitch on the last sample", LA_DECIMATE_MAJORITY, 4, "0001 0000", "00" },
+    { "high glitch across the boundary", LA_DECIMATE_MAJORITY, 4, "0001 1000 0000", "000" },
+    { "low glitch on the first sample", LA_DECIMATE_MAJORITY, 4, "1111 0111 1111", "111" },
+    { "low glitch on the last sample", LA_DECIMATE_MAJORITY, 4, "1111 1110 1111", "111" },
+    { "tie after low keeps low", LA_DECIMATE_MAJORITY, 4, "1100 0011", "00" },
+    { "tie after high keeps high", LA_DECIMATE_MAJORITY, 4, "1111 1100 0011", "111" },
+    { "three of four", LA_DECIMATE_MAJORITY, 4, "0111 1000 1101", "101" },
+    { "odd factor", LA_DECIMATE_MAJORITY, 3, "110 011 010 100", "1100" },
+    { "partial group flushed", LA_DECIMATE_MAJORITY, 4, "1111 001", "10" },
+    { "partial group tie", LA_DECIMATE_MAJORITY, 4, "1111 10", "11" },
+    { "factor 1 passes through", LA_DECIMATE_MAJORITY, 1, "0110100", "0110100" },
+};
+
+// run a whole capture, one sample per span when split is set, returns the outputs
+static uint32_t decimate(la_decimate_t* d, const uint8_t* in, uint32_t count, bool split, uint8_t* out) {
+    uint32_t write = 0, produced = 0;
+    for (uint32_t i = 0; i < count;) {
+        uint32_t n = split ? 1 : count;
+        produced += la_decimate_run(d, &in[i], n, out, 0xffffffff, &write);
+        i += n;
+    }
+    produced += la_decimate_flush(d, out, 0xffffffff, &write);
+    return (produced == write) ? produced : 0xffffffff;
+}
+
+static int test_vectors(void) {
+    int fails = 0;
+    for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+        const vector_t* vec = &vectors[v];
+        uint8_t in[64], out[64];
+        char got[65];
+        uint32_t count = 0;
+        for (const char* c = vec->in; *c; c++) {
+            if (*c != ' ') {
+                in[count++] = (*c == '1');
+            }
+        }
+        bool ok = true;
+        for (int split = 0; split < 2; split++) {
+            la_decimate_t d;
+            la_decimate_init(&d, vec->mode, vec->factor);
+            uint32_t n = decimate(&d, in, count, split, out);
+            for (uint32_t i = 0; i < n && i < 64; i++) {
+                got[i] = (out[i] & 1) ? '1' : '0';
+                ok = ok && !(out[i] & 0xfe); // the idle channels stay low
+            }
+            got[(n < 64) ? n : 64] = 0;
+            ok = ok && strcmp(got, vec->out) == 0;
+        }
+        printf("%s %-8s %-32s %-15s -> %s\n", ok ? "ok  " : "FAIL", la_decimate_mode_name(vec->mode), vec->what,
+               vec->in, got);
+        fails += !ok;
+    }
+    return fails;
+}
+
+static int test_clamp(void) {
+    static uint8_t in[1024], out[8];
+    la_decimate_t d;
+    bool ok = true;
+
+    la_decimate_init(&d, LA_DECIMATE_MAJORITY, 1000);
+    ok = ok && d.factor == LA_DECIMATE_MAJORITY_MAX_FACTOR;
+    la_decimate_init(&d, LA_DECIMATE_MAJORITY, LA_DECIMATE_MAJORITY_MAX_FACTOR + 1);
+    ok = ok && d.factor == LA_DECIMATE_MAJORITY_MAX_FACTOR;
+    la_decimate_init(&d, LA_DECIMATE_GLITCH, 1000);
+    ok = ok && d.factor == 1000; // the glitch accumulators have no limit
+
+    // full counters: 255 highs on every channel, then 255 lows
+    la_decimate_init(&d, LA_DECIMATE_MAJORITY, LA_DECIMATE_MAJORITY_MAX_FACTOR);
+    memset(in, 0xff, 255);
+    memset(&in[255], 0x00, 255);
+    ok = ok && decimate(&d, in, 510, false, out) == 2 && out[0] == 0xff && out[1] == 0x00;
+
+    // one high short of a tie on odd channels, one over on even channels
+    la_decimate_init(&d, LA_DECIMATE_MAJORITY, LA_DECIMATE_MAJORITY_MAX_FACTOR);
+    for (uint32_t i = 0; i < 255; i++) {
+        in[i] = (i < 127) ? 0xff : (i == 127) ? 0x55 : 0x00;
+    }
+    ok = ok && decimate(&d, in, 255, true, out) == 1 && out[0] == 0x55;
+
+    // a clamped factor of 1000 gives an output every 255 samples
+    la_decimate_init(&d, LA_DECIMATE_MAJORITY, 1000);
+    memset(in, 0xa5, 1020);
+    ok = ok && decimate(&d, in, 1020, false, out) == 4 && out[3] == 0xa5;
+
+    printf("%s majority clamp at %u\n", ok ? "ok  " : "FAIL", LA_DECIMATE_MAJORITY_MAX_FACTOR);
+    return !ok;
+}
+
+// per channel reference of both filters for one group
+static uint8_t ref_group(uint8_t mode, const uint8_t* in, uint32_t n, uint8_t prev) {
+    uint8_t out = 0;
+    for (int ch = 0; ch < 8; ch++) {
+        uint32_t high = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            high += (in[i] >> ch) & 1;
+        }
+        bool p = (prev >> ch) & 1, v;
+        if (mode == LA_DECIMATE_MAJORITY) {
+            v = (high * 2 > n) ? true : (high * 2 < n) ? false : p;
+        } else {
+            v = (high == n) ? true : (high == 0) ? false : !p;
+        }
+        out |= v << ch;
+    }
+    return out;
+}
+
+static int test_random(void) {
+    static const uint32_t factors[] = { 1, 2, 3, 4, 7, 8, 16, 100, 254, 255, 256, 1000 };
+    static uint8_t in[8192], expect[8192];
+    uint32_t cases = 0, fails = 0;
+    for (int c = 0; c < 2000; c++) {
+        uint8_t mode = (rand() % 2) ? LA_DECIMATE_MAJORITY : LA_DECIMATE_GLITCH;
+        uint32_t factor = factors[rand() % (sizeof(factors) / sizeof(factors[0]))];
+        uint32_t count = 1 + rand() % sizeof(in);
+        // channels with different rates of change, channel 7 changes every sample
+        uint8_t level = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            for (int ch = 0; ch < 8; ch++) {
+                if (rand() % (1 << (7 - ch)) == 0) {
+                    level ^= 1 << ch;
+                }
+            }
+            in[i] = level;
+        }
+
+        la_decimate_t d;
+        la_decimate_init(&d, mode, factor);
+        uint32_t f = d.factor, n = 0;
+        uint8_t prev = 0;
+        for (uint32_t i = 0; i < count; i += f) {
+            uint32_t len = (count - i < f) ? count - i : f;
+            prev = ref_group(mode, &in[i], len, prev);
+            expect[n++] = prev;
+        }
+
+        uint32_t write = rand(), start = write, produced = 0;
+        for (uint32_t i = 0; i < count;) {
+            uint32_t span = 1 + rand() % 300;
+            span = (span > count - i) ? count - i : span;
+            produced += la_decimate_run(&d, &in[i], span, ring, RING_SIZE - 1, &write);
+            i += span;
+        }
+        produced += la_decimate_flush(&d, ring, RING_SIZE - 1, &write);
+        bool ok = produced == n && write - start == n;
+        // the ring holds the last RING_SIZE outputs
+        for (uint32_t k = (n > RING_SIZE) ? n - RING_SIZE : 0; ok && k < n; k++) {
+            ok = ring[(start + k) & (RING_SIZE - 1)] == expect[k];
+        }
+        cases++;
+        fails += !ok;
+    }
+    printf("%s %u random captures against the per channel reference, %u differ\n", fails ? "FAIL" : "ok  ", cases,
+           fails);
+    return fails != 0;
+}
+
+int main(void) {
+    srand(1);
+    int fails = test_vectors() + test_clamp() + test_random();
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+// Host test for the logic analyzer protocol decoders (src/decode)
+// Decodes each capture vector and compares the frames with the ones the generator encoded.
+// Every vector is decoded in one span, one sample per span and in random spans,
+// the frames must be the same each time since the decoders keep their state between spans.
+//
+// Usage: la_decode_test vectors/*.vec
+// Vectors are made by gen_la_vectors.py, see there for the format
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode/la_decode.h"
+
+#define MAX_SAMPLES (1024 * 1024)
+#define MAX_FRAMES 1024
+
+typedef struct {
+    la_decoder_t config;
+    uint8_t* samples;
+    uint32_t sample_count;
+    la_decode_frame_t expect[MAX_FRAMES];
+    uint32_t expect_count;
+} vector_t;
+
+static la_decode_frame_t got[MAX_FRAMES];
+static uint32_t got_count;
+
+static void collect(const la_decoder_t* d, const la_decode_frame_t* frame) {
+    (void)d;
+    if (got_count < MAX_FRAMES) {
+        got[got_count] = *frame;
+    }
+    got_count++;
+}
+
+static int frame_type(const char* name) {
+    for (int i = 0; i <= LA_FRAME_ERROR; i++) {
+        if (strcmp(name, la_decode_frame_name(i)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool load_vector(const char* path, vector_t* v) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    memset(&v->config, 0, sizeof(v->config));
+    memset(v->config.pins, LA_DECODE_PIN_NONE, sizeof(v->config.pins));
+    v->sample_count = 0;
+    v->expect_count = 0;
+    int protocol = LA_DECODE_NONE;
+
+    char line[128];
+    unsigned line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char key[16], name[16];
+        unsigned a, b, c, d;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        } else if (sscanf(line, "protocol %15s", name) == 1) {
+            protocol = la_decode_find_protocol(name);
+        } else if (strncmp(line, "pins", 4) == 0) {
+            char* p = line + 4;
+            for (int pin = 0; pin < LA_DECODE_MAX_PINS; pin++) {
+                int n;
+                if (sscanf(p, " %15s%n", name, &n) != 1) {
+                    break;
+                }
+                v->config.pins[pin] = (name[0] == '-') ? LA_DECODE_PIN_NONE : atoi(name);
+                p += n;
+            }
+        } else if (sscanf(line, "sample_rate %u", &a) == 1) {
+            v->config.sample_rate = a;
+        } else if (sscanf(line, "bit_rate %u", &a) == 1) {
+            v->config.bit_rate = a;
+        } else if (sscanf(line, "cpol %u", &a) == 1) {
+            v->config.spi_cpol = a;
+        } else if (sscanf(line, "cpha %u", &a) == 1) {
+            v->config.spi_cpha = a;
+        } else if (sscanf(line, "s %x %u", &a, &b) == 2) {
+            if (v->sample_count + b > MAX_SAMPLES) {
+                fprintf(stderr, "%s:%u: too many samples\n", path, line_no);
+                fclose(f);
+                return false;
+            }
+            memset(&v->samples[v->sample_count], a, b);
+            v->sample_count += b;
+        } else if (sscanf(line, "f %u %15s %x %x", &a, key, &c, &d) == 4 && frame_type(key) >= 0 &&
+                   v->expect_count < MAX_FRAMES) {
+            la_decode_frame_t* fr = &v->expect[v->expect_count++];
+            fr->start = a;
+            fr->type = frame_type(key);
+            fr->value = c;
+            fr->value2 = d;
+        } else {
+            fprintf(stderr, "%s:%u: bad line: %s", path, line_no, line);
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    if (protocol == LA_DECODE_NONE) {
+        fprintf(stderr, "%s: no protocol\n", path);
+        return false;
+    }
+    v->config.protocol = protocol;
+    return true;
+}
+
+// decode the vector in spans of span samples, 0 for random spans
+static void decode(const vector_t* v, uint32_t span) {
+    la_decoder_t d = v->config;
+    la_decode_init(&d, v->config.protocol, &collect, NULL);
+    got_count = 0;
+    for (uint32_t i = 0; i < v->sample_count;) {
+        uint32_t n = span ? span : 1 + (uint32_t)rand() % 97;
+        if (n > v->sample_count - i) {
+            n = v->sample_count - i;
+        }
+        la_decode_feed(&d, &v->samples[i], n);
+        i += n;
+    }
+}
+
+static bool check(const char* path, const char* how, const vector_t* v) {
+    bool ok = got_count == v->expect_count;
+    for (uint32_t i = 0; ok && i < got_count; i++) {
+        const la_decode_frame_t* g = &got[i];
+        const la_decode_frame_t* e = &v->expect[i];
+        if (g->start != e->start || g->type != e->type || g->value != e->value || g->value2 != e->value2) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        return true;
+    }
+    printf("FAIL %s (%s): %u frames, expected %u\n", path, how, got_count, v->expect_count);
+    uint32_t n = (got_count > v->expect_count) ? got_count : v->expect_count;
+    for (uint32_t i = 0; i < n && i < MAX_FRAMES; i++) {
+        char g[40] = "-", e[40] = "-";
+        if (i < got_count) {
+            snprintf(g, sizeof(g), "%u %s %02X %02X", got[i].start, la_decode_frame_name(got[i].type),
+                     got[i].value, got[i].value2);
+        }
+        if (i < v->expect_count) {
+            snprintf(e, sizeof(e), "%u %s %02X %02X", v->expect[i].start,
+                     la_decode_frame_name(v->expect[i].type), v->expect[i].value, v->expect[i].value2);
+        }
+        printf(" %s %-28s expected %s\n", strcmp(g, e) ? "!" : " ", g, e);
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    static vector_t v;
+    v.samples = malloc(MAX_SAMPLES);
+    int fails = 0;
+    srand(1);
+    for (int i = 1; i < argc; i++) {
+        if (!load_vector(argv[i], &v)) {
+            fails++;
+            continue;
+        }
+        bool ok = true;
+        decode(&v, v.sample_count);
+        ok = check(argv[i], "one span", &v) && ok;
+        decode(&v, 1);
+        ok = check(argv[i], "one sample per span", &v) && ok;
+        for (int k = 0; k < 20 && ok; k++) {
+            decode(&v, 0);
+            ok = check(argv[i], "random spans", &v);
+        }
+        printf("%s %s: %u samples, %u frames\n", ok ? "ok  " : "FAIL", argv[i], v.sample_count, v.expect_count);
+        fails += !ok;
+    }
+    free(v.samples);
+    return fails ? 1 : 0;
+}
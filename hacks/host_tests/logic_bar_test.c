@@ -0,0 +1,213 @@
+// Host test for the logic bar graph redraw (graph_logic_lines_cached in src/toolbars/logic_bar.c)
+// The firmware file is compiled as is against the stand-ins in stub/, printf goes to a small
+// VT102 screen model (cursor position, character delete and insert) that counts the bytes.
+// - after every redraw the graph rows must show the window and the labels either side of the
+//   graph must be untouched, also after the delete/insert pans
+// - a redraw of the same window sends nothing
+// - the bytes of each pan and redraw are printed next to graph_logic_lines_2, the full redraw
+//   the cache replaced, and may not be more than it
+// - then every pan from -100 to +100 samples is checked the same way
+//
+// Usage: logic_bar_test
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+static int term_printf(const char* format, ...);
+#define printf term_printf
+#include "toolbars/logic_bar.c"
+#undef printf
+
+#define TERM_ROWS 24
+#define TERM_COLS LOGIC_BAR_WIDTH
+#define GRAPH_ROW 5 // first graph row, 1 based like the terminal
+#define GRAPH_COL (LOGIC_BAR_VERTICAL_LABELS + 1)
+
+static char screen[TERM_ROWS][TERM_COLS];
+static int cur_row, cur_col; // 0 based
+static uint32_t term_bytes;
+static bool term_error;
+
+static uint8_t capture[LA_BUFFER_SIZE];
+
+uint8_t logic_analyzer_read_ptr(uint32_t read_pointer) {
+    return capture[read_pointer];
+}
+
+const char* ui_term_color_error(void) {
+    return "";
+}
+
+// the escapes the graph code sends: CUP (\e[r;cH), DCH (\e[nP) and ICH (\e[n@)
+static void term_write(const char* s, size_t len) {
+    term_bytes += len;
+    for (size_t i = 0; i < len;) {
+        if (s[i] != '\e') {
+            if (cur_row < 0 || cur_row >= TERM_ROWS || cur_col < 0 || cur_col >= TERM_COLS) {
+                term_error = true;
+            } else {
+                screen[cur_row][cur_col++] = s[i];
+            }
+            i++;
+            continue;
+        }
+        int a = 0, b = 0, n = 0;
+        if (sscanf(&s[i], "\e[%d;%dH%n", &a, &b, &n) == 2 && n) {
+            cur_row = a - 1;
+            cur_col = b - 1;
+        } else if (cur_row < 0 || cur_row >= TERM_ROWS || cur_col < 0 || cur_col >= TERM_COLS) {
+            term_error = true;
+            return;
+        } else if (sscanf(&s[i], "\e[%dP%n", &a, &n) == 1 && n && a <= TERM_COLS - cur_col) {
+            char* r = screen[cur_row];
+            memmove(&r[cur_col], &r[cur_col + a], TERM_COLS - cur_col - a);
+            memset(&r[TERM_COLS - a], ' ', a);
+        } else if (sscanf(&s[i], "\e[%d@%n", &a, &n) == 1 && n && a <= TERM_COLS - cur_col) {
+            char* r = screen[cur_row];
+            memmove(&r[cur_col + a], &r[cur_col], TERM_COLS - cur_col - a);
+            memset(&r[cur_col], ' ', a);
+        } else {
+            term_error = true;
+            return;
+        }
+        i += n;
+    }
+}
+
+static int term_printf(const char* format, ...) {
+    char buf[2048];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    term_write(buf, len);
+    return len;
+}
+
+// the frame around the graph: labels left and right of each row
+static void term_reset(void) {
+    memset(screen, ' ', sizeof(screen));
+    for (int row = 0; row < TERM_ROWS; row++) {
+        screen[row][0] = 'A' + row;
+        screen[row][1] = '|';
+        screen[row][TERM_COLS - 2] = '|';
+        screen[row][TERM_COLS - 1] = 'a' + row;
+    }
+    graph_cells_invalidate();
+}
+
+static bool screen_check(uint32_t sample_ptr) {
+    bool ok = !term_error;
+    for (int row = 0; row < TERM_ROWS; row++) {
+        const char* r = screen[row];
+        ok = ok && r[0] == 'A' + row && r[1] == '|';
+        ok = ok && r[TERM_COLS - 2] == '|' && r[TERM_COLS - 1] == 'a' + row;
+    }
+    for (int pin = 0; pin < LOGIC_BAR_CHANNELS; pin++) {
+        const char* r = &screen[GRAPH_ROW - 1 + pin][GRAPH_COL - 1];
+        for (int i = 0; i < (LOGIC_BAR_GRAPH_WIDTH); i++) {
+            uint8_t sample = capture[(sample_ptr + i) & (LA_BUFFER_SIZE - 1)];
+            char expect = (sample & (1u << pin)) ? logic_graph_high_character : logic_graph_low_character;
+            ok = ok && r[i] == expect;
+        }
+    }
+    return ok;
+}
+
+// a serial bus capture: a clock, data that changes on the falling edge, a chip select,
+// a slow signal, a glitchy line and idle channels
+static void capture_fill(void) {
+    srand(7);
+    uint8_t data = 0;
+    for (uint32_t i = 0; i < LA_BUFFER_SIZE; i++) {
+        bool clk = (i >> 2) & 1;
+        if ((i & 7) == 0) {
+            data = rand() & 1;
+        }
+        bool cs = ((i >> 9) & 3) != 0;
+        bool slow = (i >> 7) & 1;
+        bool glitch = (rand() % 40) == 0;
+        capture[i] = clk | (data << 1) | (cs << 2) | (slow << 3) | (glitch << 4) | (1 << 5);
+    }
+}
+
+// one graph update from start_pos, returns false if the screen or the byte count is wrong
+static bool redraw(uint32_t start_pos, bool invalidate, uint32_t* bytes, uint32_t* full) {
+    uint32_t sample_ptr = (1000 + start_pos) & (LA_BUFFER_SIZE - 1);
+
+    // the full redraw as it was before the cache, on a copy of the screen
+    char saved[TERM_ROWS][TERM_COLS];
+    memcpy(saved, screen, sizeof(screen));
+    term_bytes = 0;
+    graph_logic_lines_2(GRAPH_ROW, sample_ptr);
+    *full = term_bytes;
+    bool ok = screen_check(sample_ptr);
+    memcpy(screen, saved, sizeof(screen));
+
+    if (invalidate) {
+        term_reset();
+    }
+    term_bytes = 0;
+    graph_logic_lines_cached(GRAPH_ROW, sample_ptr, start_pos);
+    *bytes = term_bytes;
+    ok = ok && screen_check(sample_ptr);
+    return ok && term_bytes == graph_redraw_bytes && term_bytes <= *full;
+}
+
+typedef struct {
+    const char* what;
+    int32_t move; // samples to pan from the current window
+    bool invalidate;
+} step_t;
+
+static const step_t steps[] = {
+    { "first draw", 0, true },
+    { "same window", 0, false },
+    { "pan right 1", 1, false },
+    { "pan left 1", -1, false },
+    { "pan right 8", 8, false },
+    { "pan right 10", 10, false },
+    { "pan left 20", -20, false },
+    { "pan right 40", 40, false },
+    { "pan right 52", 52, false }, // the largest pan that still shifts the terminal cells
+    { "pan right 53", 53, false },
+    { "pan left 76", -76, false },
+    { "jump 10000", 10000, false },
+    { "same window", 0, false },
+    { "frame redrawn", 0, true },
+};
+
+int main(void) {
+    uint32_t start_pos = 0, bytes, full;
+    int fails = 0;
+    capture_fill();
+    term_reset();
+    printf("bytes per graph update, cached redraw vs full redraw:\n");
+    for (size_t s = 0; s < count_of(steps); s++) {
+        const step_t* step = &steps[s];
+        start_pos += step->move;
+        bool ok = redraw(start_pos, step->invalidate, &bytes, &full);
+        if (step->move == 0 && !step->invalidate) {
+            ok = ok && bytes == 0;
+        }
+        printf("%s %-14s %4u bytes, full redraw %4u\n", ok ? "ok  " : "FAIL", step->what, bytes, full);
+        fails += !ok;
+    }
+
+    uint32_t worst = 0, total = 0, count = 0;
+    bool ok = true;
+    for (int32_t move = -100; move <= 100; move++) {
+        start_pos = 20000;
+        ok = redraw(start_pos, true, &bytes, &full) && ok;
+        start_pos += move;
+        ok = redraw(start_pos, false, &bytes, &full) && ok;
+        worst = (bytes > worst) ? bytes : worst;
+        total += bytes;
+        count++;
+    }
+    printf("%s pans -100..100: %u bytes average, %u worst, full redraw %u\n", ok ? "ok  " : "FAIL", total / count,
+           worst, full);
+    fails += !ok;
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+// Host test and benchmark for the scope spectrum kernel (src/display/scope_fft.c)
+// - every bin of the Q15 transform is compared with a double precision DFT of the same
+//   windowed input, for all sizes and random tones, and must be within FFT_MAX_ERROR LSB
+// - a full range sine must read 0dB and scope_fft_db() must follow 10 * log10(p)
+// - the kernel (radix 4 passes) is timed against a plain radix 2 transform with the
+//   same Q15 twiddles, this is the comparison the kernel choice is based on
+//
+// Usage: scope_fft_test [-b]    -b runs the benchmark only
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "display/scope_fft.h"
+
+#define RING_SIZE 6464    // same size as the scope display buffer
+#define FFT_MAX_ERROR 8.0 // LSB, the output is scaled by 1 / n
+#define DB_MAX_ERROR 0.7  // 0.1dB units, rounding plus the log2 table
+
+static uint16_t ring[RING_SIZE];
+static int16_t re[SCOPE_FFT_MAX], im[SCOPE_FFT_MAX];
+static int16_t r2_cos[SCOPE_FFT_MAX / 2], r2_sin[SCOPE_FFT_MAX / 2];
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void fill_tone(double freq, double amp, double noise) {
+    for (int i = 0; i < RING_SIZE; i++) {
+        double v = 2048 + amp * sin(2 * M_PI * freq * i) + noise * ((rand() % 5) - 2);
+        ring[i] = (v < 0) ? 0 : (v > 4095) ? 4095 : (uint16_t)v;
+    }
+}
+
+// the input as scope_fft_load() prepares it, DFT in double, scaled by 1 / n
+static double dft_error(uint32_t start, uint32_t log2n) {
+    uint32_t n = 1u << log2n;
+    static double x[SCOPE_FFT_MAX];
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += ring[(start + i) % RING_SIZE];
+    }
+    int32_t mean = sum >> log2n;
+    for (uint32_t i = 0; i < n; i++) {
+        double v = (ring[(start + i) % RING_SIZE] - mean) * 8.0;
+        v = (v > 32767) ? 32767 : (v < -32767) ? -32767 : v;
+        x[i] = v * 0.5 * (1 - cos(2 * M_PI * i / n));
+    }
+    double worst = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        double sr = 0, si = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t a = (uint32_t)(((uint64_t)k * i) % n);
+            sr += x[i] * cos(2 * M_PI * a / n);
+            si -= x[i] * sin(2 * M_PI * a / n);
+        }
+        double e = hypot(sr / n - re[k], si / n - im[k]);
+        if (e > worst) {
+            worst = e;
+        }
+    }
+    return worst;
+}
+
+static int test_accuracy(void) {
+    int fails = 0;
+    for (uint32_t log2n = 2; log2n <= SCOPE_FFT_MAX_LOG2; log2n++) {
+        uint32_t n = 1u << log2n;
+        double worst = 0;
+        for (int trial = 0; trial < 40; trial++) {
+            // tones on and between bins, from small to full range
+            double bin = 1 + rand() % (n / 2 - 1) + (rand() % 100) / 100.0;
+            fill_tone(bin / n, rand() % 2048, 1);
+            uint32_t start = rand() % RING_SIZE;
+            scope_fft_load(re, im, ring, RING_SIZE, start, log2n);
+            scope_fft(re, im, log2n);
+            double e = dft_error(start, log2n);
+            if (e > worst) {
+                worst = e;
+            }
+        }
+        bool ok = worst <= FFT_MAX_ERROR;
+        printf("%s n=%4u: worst bin error %.2f LSB\n", ok ? "ok  " : "FAIL", n, worst);
+        fails += !ok;
+    }
+    return fails;
+}
+
+static int test_levels(void) {
+    int fails = 0;
+    // full range sine centered on bin 64 of 1024
+    fill_tone(64.0 / 1024, 2047, 0);
+    scope_fft_load(re, im, ring, RING_SIZE, 0, SCOPE_FFT_MAX_LOG2);
+    scope_fft(re, im, SCOPE_FFT_MAX_LOG2);
+    int peak = SCOPE_FFT_FLOOR;
+    for (int k = 1; k < SCOPE_FFT_MAX / 2; k++) {
+        int db = scope_fft_db(re[k], im[k]);
+        if (db > peak) {
+            peak = db;
+        }
+    }
+    bool ok = abs(peak) <= 2;
+    printf("%s full range sine: %d.%ddB\n", ok ? "ok  " : "FAIL", peak / 10, abs(peak % 10));
+    fails += !ok;
+
+    double worst = 0;
+    for (int32_t r = 1; r <= 32767; r++) {
+        double ref = 100 * log10((double)r * r / (4096.0 * 4096.0));
+        double e = fabs(scope_fft_db(r, 0) - ref);
+        if (e > worst) {
+            worst = e;
+        }
+    }
+    ok = worst <= DB_MAX_ERROR && scope_fft_db(0, 0) == SCOPE_FFT_FLOOR;
+    printf("%s scope_fft_db: worst error %.2f (0.1dB)\n", ok ? "ok  " : "FAIL", worst);
+    fails += !ok;
+    return fails;
+}
+
+// plain radix 2 decimation in time, one pass per stage, same rounding as the kernel
+static void fft_radix2_reference(int16_t* xr, int16_t* xi, uint32_t log2n) {
+    uint32_t n = 1u << log2n;
+    for (uint32_t m = 1; m < n; m *= 2) {
+        uint32_t step = SCOPE_FFT_MAX / (2 * m);
+        for (uint32_t k = 0; k < m; k++) {
+            int32_t c = r2_cos[k * step], s = r2_sin[k * step];
+            for (uint32_t g = k; g < n; g += 2 * m) {
+                int32_t ar = xr[g], ai = xi[g];
+                int32_t br = xr[g + m], bi = xi[g + m];
+                int32_t tr = (br * c + bi * s) >> 15;
+                int32_t ti = (bi * c - br * s) >> 15;
+                xr[g] = (ar + tr) >> 1;
+                xi[g] = (ai + ti) >> 1;
+                xr[g + m] = (ar - tr) >> 1;
+                xi[g + m] = (ai - ti) >> 1;
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static uint64_t cycles(void) {
+    return __rdtsc();
+}
+#else
+#define HAVE_CYCLES 0
+static uint64_t cycles(void) {
+    return 0;
+}
+#endif
+
+typedef void (*transform_t)(int16_t* xr, int16_t* xi, uint32_t log2n);
+
+#define BENCH_ROUNDS 50
+
+// one round, the transform runs over its own output, the time doesn't depend on the data
+// keeps the best time per transform
+static void bench(transform_t f, uint32_t log2n, double* ns, double* cyc) {
+    const int runs = 200;
+    scope_fft_load(re, im, ring, RING_SIZE, 0, log2n);
+    double t0 = now_ns();
+    uint64_t c0 = cycles();
+    for (int i = 0; i < runs; i++) {
+        f(re, im, log2n);
+    }
+    double c = (double)(cycles() - c0) / runs;
+    double t = (now_ns() - t0) / runs;
+    if (t < *ns) {
+        *ns = t;
+        *cyc = c;
+    }
+}
+
+static void benchmark(void) {
+    for (int i = 0; i < SCOPE_FFT_MAX / 2; i++) {
+        r2_cos[i] = (int16_t)lrint(32767 * cos(2 * M_PI * i / SCOPE_FFT_MAX));
+        r2_sin[i] = (int16_t)lrint(32767 * sin(2 * M_PI * i / SCOPE_FFT_MAX));
+    }
+    fill_tone(100.5 / 1024, 1500, 1);
+    printf("benchmark, best of %d rounds, %s per transform:\n", BENCH_ROUNDS,
+           HAVE_CYCLES ? "ns and TSC cycles" : "ns");
+    for (uint32_t log2n = 8; log2n <= SCOPE_FFT_MAX_LOG2; log2n++) {
+        double k_ns = 1e30, k_cyc = 0, r_ns = 1e30, r_cyc = 0;
+        // alternate between the two so both see the same machine load
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            bench(scope_fft, log2n, &k_ns, &k_cyc);
+            bench(fft_radix2_reference, log2n, &r_ns, &r_cyc);
+        }
+        printf(" n=%4u: scope_fft %8.0f ns", 1u << log2n, k_ns);
+        if (HAVE_CYCLES) {
+            printf(" %8.0f cyc", k_cyc);
+        }
+        printf(", plain radix 2 %8.0f ns", r_ns);
+        if (HAVE_CYCLES) {
+            printf(" %8.0f cyc", r_cyc);
+        }
+        printf(", %.2fx\n", r_ns / k_ns);
+    }
+}
+
+int main(int argc, char** argv) {
+    srand(3);
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        benchmark();
+        return 0;
+    }
+    int fails = test_accuracy() + test_levels();
+    benchmark();
+    return fails ? 1 : 0;
+}
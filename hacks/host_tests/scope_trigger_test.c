@@ -0,0 +1,227 @@
+// Host test and benchmark for the scope trigger search (src/display/scope_trigger.c)
+// - without hysteresis scope_trigger_find() must fire on the same sample as the per sample
+//   loops the DMA interrupt used before the search moved out of it
+// - with hysteresis it must match a per sample state machine: arm past level - h (rising) or
+//   level + h (falling), fire on the crossing
+// - blocks are searched one after the other with the state carried over, at every alignment
+//   and with odd lengths, so the byte loops around the word loop run too
+// - the old loop and the kernel are timed over a full capture ring without a trigger, the
+//   case the interrupt paid for on every block
+//
+// Usage: scope_trigger_test [-b]    -b runs the benchmark only
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "display/scope_trigger.h"
+
+#define ADC_MAX 4095
+#define BLOCK 64   // CAPTURE_DEPTH in scope.c
+#define BLOCKS 101 // BUFFERS in scope.c
+#define CASES 200000
+
+static uint16_t samples[BLOCK * BLOCKS + 2];
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// the interrupt loops from before the trigger search, last is the sample before s[0]
+static int32_t old_find(uint8_t edge, uint16_t level, uint16_t* last, const uint16_t* s, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t v = s[i];
+        bool fire;
+        if (edge == SCOPE_TRIGGER_RISING) {
+            fire = *last <= level && v > level;
+        } else if (edge == SCOPE_TRIGGER_FALLING) {
+            fire = *last >= level && v < level;
+        } else {
+            fire = (*last >= level) ? v < level : v > level;
+        }
+        if (fire) {
+            return i;
+        }
+        *last = v;
+    }
+    return -1;
+}
+
+// per sample hysteresis state machine, state 1 armed low, 2 armed high
+static int32_t ref_find(uint8_t edge, int32_t level, int32_t h, int* state, const uint16_t* s, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t v = s[i];
+        if ((*state == 1 && v > level) || (*state == 2 && v < level)) {
+            *state = 0;
+            return i;
+        }
+        if (edge == SCOPE_TRIGGER_RISING) {
+            if (v <= level - h) {
+                *state = 1;
+            } else if (v > level) {
+                *state = 0;
+            }
+        } else if (edge == SCOPE_TRIGGER_FALLING) {
+            if (v >= level + h) {
+                *state = 2;
+            } else if (v < level) {
+                *state = 0;
+            }
+        } else if (v < level - h) {
+            *state = 1;
+        } else if (v >= level + h) {
+            *state = 2;
+        }
+    }
+    return -1;
+}
+
+static uint16_t clamp(int32_t v) {
+    return (v < 0) ? 0 : (v > ADC_MAX) ? ADC_MAX : v;
+}
+
+// noise, a signal hovering at level, one inside the hysteresis band, a square wave across it
+static void fill(int pattern, int32_t level, int32_t h, uint16_t* s, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t v;
+        switch (pattern) {
+            case 0:
+                v = rand() % (ADC_MAX + 1);
+                break;
+            case 1:
+                v = level + rand() % 7 - 3;
+                break;
+            case 2:
+                v = level + rand() % (2 * h + 9) - h - 4;
+                break;
+            default:
+                v = ((i / 20) & 1) ? level + h + 5 : level - h - 5;
+                break;
+        }
+        s[i] = clamp(v);
+    }
+}
+
+static int test_equivalence(void) {
+    static const char* edge_names[] = { "rising", "falling", "either" };
+    uint32_t cases[3][2] = { 0 }, fails[3][2] = { 0 };
+    for (int c = 0; c < CASES; c++) {
+        uint8_t edge = rand() % 3;
+        int32_t level = rand() % (ADC_MAX + 1);
+        if (rand() % 8 == 0) {
+            level = (rand() % 2) ? 0 : ADC_MAX; // no sample can arm or fire one way
+        }
+        int32_t h = (rand() % 3) ? 0 : rand() % 300;
+        uint32_t offset = rand() % 2; // blocks that start between two words
+        uint32_t block = BLOCK - rand() % 4;
+        uint16_t* s = &samples[offset];
+        fill(rand() % 4, level, h, s, block * 4 + 1);
+
+        scope_trigger_t t;
+        scope_trigger_init(&t, edge, level, h);
+        // the first sample only primes the search, as in scope.c
+        scope_trigger_find(&t, s, 1);
+        int state = 0;
+        ref_find(edge, level, h, &state, s, 1);
+        uint16_t last = s[0];
+
+        bool ok = true;
+        for (uint32_t b = 0; b < 4 && ok; b++) {
+            const uint16_t* p = &s[1 + b * block];
+            int32_t got = scope_trigger_find(&t, p, block);
+            ok = got == ref_find(edge, level, h, &state, p, block);
+            if (h == 0) {
+                ok = ok && got == old_find(edge, level, &last, p, block);
+            }
+            if (got >= 0) {
+                break;
+            }
+        }
+        cases[edge][h != 0]++;
+        fails[edge][h != 0] += !ok;
+    }
+    int failed = 0;
+    for (int edge = 0; edge < 3; edge++) {
+        for (int h = 0; h < 2; h++) {
+            bool ok = fails[edge][h] == 0;
+            printf("%s %-7s %-14s %6u cases, %u differ\n", ok ? "ok  " : "FAIL", edge_names[edge],
+                   h ? "hysteresis" : "vs old loops", cases[edge][h], fails[edge][h]);
+            failed += !ok;
+        }
+    }
+    return failed;
+}
+
+#define BENCH_ROUNDS 30
+#define BENCH_RUNS 200
+
+static volatile int32_t bench_sink;
+
+// one pass over the ring without a trigger, each block as the interrupt saw it
+static void bench_old(uint8_t edge, uint16_t level) {
+    uint16_t last = samples[0];
+    for (uint32_t b = 0; b < BLOCKS; b++) {
+        bench_sink = old_find(edge, level, &last, &samples[b * BLOCK], BLOCK);
+    }
+}
+
+static void bench_kernel(uint8_t edge, uint16_t level) {
+    scope_trigger_t t;
+    scope_trigger_init(&t, edge, level, 0);
+    for (uint32_t b = 0; b < BLOCKS; b++) {
+        bench_sink = scope_trigger_find(&t, &samples[b * BLOCK], BLOCK);
+    }
+}
+
+static void bench(void (*f)(uint8_t, uint16_t), uint8_t edge, uint16_t level, double* best) {
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        f(edge, level);
+    }
+    double t = (now_ns() - t0) / (BENCH_RUNS * BLOCKS * BLOCK);
+    if (t < *best) {
+        *best = t;
+    }
+}
+
+static void benchmark(void) {
+    static const struct {
+        const char* what;
+        uint8_t edge;
+        uint16_t level;
+    } runs[] = {
+        { "rising, noise below level", SCOPE_TRIGGER_RISING, 2000 },
+        { "falling, noise below level", SCOPE_TRIGGER_FALLING, 2000 },
+        { "either, noise below level", SCOPE_TRIGGER_EITHER, 2000 },
+        { "rising, noise above level", SCOPE_TRIGGER_RISING, 500 },
+    };
+    // a quiet signal, 1000 to 1049 counts, that never crosses either level
+    for (uint32_t i = 0; i < BLOCK * BLOCKS; i++) {
+        samples[i] = 1000 + rand() % 50;
+    }
+    printf("benchmark, ns per sample over %d blocks of %d without a trigger, best of %d rounds:\n", BLOCKS, BLOCK,
+           BENCH_ROUNDS);
+    for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+        double t_old = 1e30, t_kernel = 1e30;
+        // alternate between the two so both see the same machine load
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            bench(bench_old, runs[r].edge, runs[r].level, &t_old);
+            bench(bench_kernel, runs[r].edge, runs[r].level, &t_kernel);
+        }
+        printf(" %-27s old loop %.3f, scope_trigger_find %.3f, %.2fx\n", runs[r].what, t_old, t_kernel,
+               t_old / t_kernel);
+    }
+}
+
+int main(int argc, char** argv) {
+    srand(1);
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        benchmark();
+        return 0;
+    }
+    int fails = test_equivalence();
+    benchmark();
+    return fails ? 1 : 0;
+}
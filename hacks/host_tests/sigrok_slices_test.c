@@ -0,0 +1,483 @@
+// Host test and benchmark for the sigrok trace encoders (src/lib/sigrok/pico_sdk_sigrok.c)
+// The firmware file is compiled as is against the SDK stand-ins in stub/, with the byte at a
+// time encoders it had before the word at a time change kept here as the reference.
+// - send_slices_D4 and send_slices_1B must produce the same bytes and sample count as the
+//   reference for every data pattern, half size (every residue mod 8, so the byte loops before
+//   the first aligned word and after the last one run), fixed length tails, continuous mode
+//   and 1 or 2 tx bytes per sample
+// - each pattern is timed for both, best of several rounds
+// - sigrok_setup must not panic when other modes hold the DMA channels, it gives back the
+//   channels it got and frees the sample buffer
+//
+// Usage: sigrok_slices_test [-b]    -b runs the benchmark only
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lib/sigrok/pico_sdk_sigrok.c"
+
+// D4: 4 bit samples, 8 per word. Reference: every nibble of a changed word is visited
+static void ref_send_slices_D4(sr_device_t* d, uint8_t* dbuf) {
+    uint8_t nibcurr = 0, niblast;
+    uint32_t cword, lword;
+    txbufidx = 0;
+    cword = *(uint32_t*)&dbuf[0];
+    lword = cword;
+    for (int j = 0; j < 8; j++) {
+        nibcurr = cword & 0xF;
+        txbuf[j] = (nibcurr) | 0x80;
+        cword >>= 4;
+    }
+    niblast = nibcurr;
+    txbufidx = 8;
+    rxbufdidx = 4;
+    rlecnt = 0;
+
+    if (d->samples_per_half <= 8) {
+        sigrok_tx(txbuf, txbufidx);
+        d->scnt += d->samples_per_half;
+        return;
+    }
+    samp_remain = d->samples_per_half - 8;
+    if ((d->cont == false) && ((d->scnt + samp_remain) > (d->num_samples))) {
+        samp_remain = d->num_samples - d->scnt;
+        d->scnt += samp_remain;
+    } else {
+        d->scnt += d->samples_per_half;
+    }
+    for (uint32_t i = 0; i < (samp_remain >> 3); i++) {
+        cword = *(uint32_t*)&dbuf[rxbufdidx];
+        rxbufdidx += 4;
+        while (rlecnt >= 640) {
+            txbuf[txbufidx++] = 127;
+            rlecnt -= 640;
+            if (txbufidx > 3) {
+                sigrok_tx(txbuf, txbufidx);
+                txbufidx = 0;
+            }
+        }
+        if ((cword == lword) && ((cword >> 4) == (cword & 0x0FFFFFFF))) {
+            rlecnt += 8;
+        } else {
+            lword = cword;
+            for (int j = 0; j < 8; j++) {
+                nibcurr = cword & 0xF;
+                if (nibcurr == niblast) {
+                    rlecnt++;
+                } else {
+                    if (rlecnt > 7) {
+                        int rlemid = rlecnt & 0x3F8;
+                        txbuf[txbufidx++] = (rlemid >> 3) + 47;
+                    }
+                    rlecnt &= 0x7;
+                    txbuf[txbufidx++] = 0x80 | nibcurr | rlecnt << 4;
+                    rlecnt = 0;
+                }
+                cword >>= 4;
+                niblast = nibcurr;
+            }
+        }
+        if (txbufidx >= 64) {
+            sigrok_tx(txbuf, txbufidx);
+            txbufidx = 0;
+        }
+    }
+    while (rlecnt >= 640) {
+        txbuf[txbufidx++] = 127;
+        rlecnt -= 640;
+    }
+    if (rlecnt > 7) {
+        int rleend = rlecnt & 0x3F8;
+        txbuf[txbufidx++] = (rleend >> 3) + 47;
+    }
+    if (rlecnt) {
+        rlecnt &= 0x7;
+        rlecnt--;
+        txbuf[txbufidx++] = 0x80 | nibcurr | rlecnt << 4;
+        rlecnt = 0;
+    }
+    if (txbufidx) {
+        sigrok_tx(txbuf, txbufidx);
+        txbufidx = 0;
+    }
+}
+
+// 1B: 5-8 channels, one byte per sample. Reference: one sample per loop
+static void __attribute__((noinline)) ref_send_slices_1B(sr_device_t* d, uint8_t* dbuf) {
+    send_slice_init(d, dbuf);
+    for (uint32_t s = 0; s < samp_remain; s++) {
+        cval = dbuf[rxbufdidx++];
+        if (cval == lval) {
+            rlecnt++;
+        } else {
+            check_rle();
+            tx_d_samp(d, cval);
+            check_tx_buf(TX_BUF_THRESH);
+        }
+        lval = cval;
+    }
+    check_rle();
+    check_tx_buf(1);
+}
+
+// SDK and USB stand-ins used on the encoder path, the CDC port writes into out
+#define HALF_MAX 100000
+static uint8_t* out;
+static uint32_t out_len;
+static uint8_t out_ref[HALF_MAX * 4], out_new[HALF_MAX * 4];
+
+uint32_t tud_cdc_n_write(uint8_t itf, const void* buffer, uint32_t bufsize) {
+    (void)itf;
+    memcpy(out + out_len, buffer, bufsize);
+    out_len += bufsize;
+    return bufsize;
+}
+uint32_t tud_cdc_n_write_flush(uint8_t itf) {
+    (void)itf;
+    return 0;
+}
+bool tud_cdc_n_connected(uint8_t itf) {
+    (void)itf;
+    return true;
+}
+uint64_t time_us_64(void) {
+    return 0;
+}
+
+// capture_buf is word aligned on the device as well
+static uint8_t buf[HALF_MAX] __attribute__((aligned(4)));
+
+static uint32_t rnd(void) {
+    static uint32_t x = 12345;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+enum { PAT_RANDOM, PAT_IDLE, PAT_RUNS, PAT_SQUARE, PAT_BUSY, PAT_SPARSE, PAT_CLOCKS, PAT_COUNT };
+static const char* const pattern_names[PAT_COUNT] = { "random", "idle", "runs", "square", "busy", "sparse", "clocks" };
+
+// d4 packs two 4 bit samples per byte
+static void fill(int pattern, bool d4) {
+    uint32_t v = 0, run = 0;
+    for (int i = 0; i < HALF_MAX; i++) {
+        switch (pattern) {
+            case PAT_RANDOM:
+                buf[i] = rnd();
+                break;
+            case PAT_IDLE:
+                buf[i] = 0;
+                break;
+            case PAT_RUNS: // long runs of one value
+                if (!run) {
+                    v = rnd();
+                    run = rnd() % 2000 + 1;
+                }
+                run--;
+                buf[i] = d4 ? (v & 0xf) * 0x11 : v;
+                break;
+            case PAT_SQUARE:
+                buf[i] = ((i / 700) & 1) ? 0xff : 0x00;
+                break;
+            case PAT_BUSY: // a new value every few samples
+                if (!run) {
+                    v = rnd();
+                    run = rnd() % 5 + 1;
+                }
+                run--;
+                buf[i] = v;
+                break;
+            case PAT_SPARSE:
+                buf[i] = (rnd() % 50) ? (i ? buf[i - 1] : 0) : rnd();
+                break;
+            case PAT_CLOCKS: // three channels clocked at different rates
+                if (d4) {
+                    uint8_t b = 0;
+                    for (int h = 0; h < 2; h++) {
+                        uint32_t t = 2 * i + h;
+                        uint8_t n = ((t / 13) & 1) | (((t / 40) & 1) << 1) | (((t / 300) & 1) << 2);
+                        b |= n << (4 * h);
+                    }
+                    buf[i] = b;
+                } else {
+                    buf[i] = ((i / 7) & 1) | (((i / 20) & 1) << 1) | (((i / 150) & 1) << 2);
+                }
+                break;
+        }
+    }
+}
+
+typedef void (*encoder_t)(sr_device_t* d, uint8_t* dbuf);
+
+static uint32_t run_encoder(encoder_t f, sr_device_t* d, uint8_t* dest) {
+    out = dest;
+    out_len = 0;
+    f(d, buf);
+    return out_len;
+}
+
+static bool compare(encoder_t ref, encoder_t enc, sr_device_t d, const char* name, int pattern) {
+    sr_device_t d_ref = d, d_new = d;
+    uint32_t len_ref = run_encoder(ref, &d_ref, out_ref);
+    uint32_t len_new = run_encoder(enc, &d_new, out_new);
+    if (len_ref == len_new && !memcmp(out_ref, out_new, len_ref) && d_ref.scnt == d_new.scnt) {
+        return true;
+    }
+    printf("FAIL %s %s: half %u scnt %u num %u cont %d bps %d: %u bytes (scnt %u), reference %u (scnt %u)\n",
+           name,
+           pattern_names[pattern],
+           d.samples_per_half,
+           d.scnt,
+           d.num_samples,
+           d.cont,
+           d.d_tx_bps,
+           len_new,
+           d_new.scnt,
+           len_ref,
+           d_ref.scnt);
+    for (uint32_t i = 0; i < len_ref && i < len_new; i++) {
+        if (out_ref[i] != out_new[i]) {
+            printf(" first difference at byte %u: %02x, reference %02x\n", i, out_new[i], out_ref[i]);
+            break;
+        }
+    }
+    return false;
+}
+
+static int test(void) {
+    int fails = 0;
+    uint32_t cases = 0;
+    for (int pattern = 0; pattern < PAT_COUNT; pattern++) {
+        for (int d4 = 0; d4 < 2; d4++) {
+            for (int trial = 0; trial < 4; trial++) {
+                fill(pattern, d4);
+                // every residue of small halves, then large ones around word multiples
+                static uint32_t halves[80];
+                uint32_t n = 0;
+                for (uint32_t h = 1; h <= 40; h++) {
+                    halves[n++] = h;
+                }
+                const uint32_t large[] = { 100, 1000, 4093, 4096, 4099, HALF_MAX - 5, HALF_MAX - 1, HALF_MAX };
+                for (uint32_t i = 0; i < count_of(large); i++) {
+                    halves[n++] = large[i];
+                }
+                for (uint32_t i = 0; i < n; i++) {
+                    // D4 halves are in samples, two per byte
+                    uint32_t half = d4 ? 2 * halves[i] : halves[i];
+                    if (half > (d4 ? 2 * HALF_MAX : HALF_MAX)) {
+                        continue;
+                    }
+                    for (int cont = 0; cont < 2; cont++) {
+                        for (int tail = 0; tail < 3; tail++) {
+                            sr_device_t d = { 0 };
+                            d.samples_per_half = half;
+                            d.cont = cont;
+                            // fixed length captures end inside this half, at a random sample
+                            d.scnt = tail ? rnd() % 1000 : 0;
+                            d.num_samples = tail ? d.scnt + 1 + rnd() % half : 0xffffffff;
+                            for (uint8_t bps = 1; bps <= 2; bps++) {
+                                d.d_tx_bps = bps;
+                                d_dma_bps = 1;
+                                if (d4) {
+                                    if (bps == 1) {
+                                        fails += !compare(ref_send_slices_D4, send_slices_D4, d, "D4", pattern);
+                                        cases++;
+                                    }
+                                } else {
+                                    fails += !compare(ref_send_slices_1B, send_slices_1B, d, "1B", pattern);
+                                    cases++;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("%s %u cases compared with the reference encoders\n", fails ? "FAIL" : "ok  ", cases);
+    return fails;
+}
+
+// SDK stand-ins for sigrok_setup and sigrok_cleanup, DMA_CHANNELS channels to claim from
+#define DMA_CHANNELS 12
+static bool dma_claimed[DMA_CHANNELS];
+static bool dma_error;
+static int mem_blocks;
+struct _system_config system_config;
+static bus_ctrl_hw_t bus_ctrl;
+bus_ctrl_hw_t* bus_ctrl_hw = &bus_ctrl;
+
+int dma_claim_unused_channel(bool required) {
+    for (int i = 0; i < DMA_CHANNELS; i++) {
+        if (!dma_claimed[i]) {
+            dma_claimed[i] = true;
+            return i;
+        }
+    }
+    dma_error |= required; // the SDK panics
+    return -1;
+}
+void dma_channel_unclaim(uint channel) {
+    dma_error |= channel >= DMA_CHANNELS || !dma_claimed[channel];
+    if (channel < DMA_CHANNELS) {
+        dma_claimed[channel] = false;
+    }
+}
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = { channel };
+    return c;
+}
+void channel_config_set_transfer_data_size(dma_channel_config* c, int size) {
+    (void)c, (void)size;
+}
+void channel_config_set_read_increment(dma_channel_config* c, bool incr) {
+    (void)c, (void)incr;
+}
+void channel_config_set_write_increment(dma_channel_config* c, bool incr) {
+    (void)c, (void)incr;
+}
+void channel_config_set_dreq(dma_channel_config* c, uint dreq) {
+    (void)c, (void)dreq;
+}
+uint8_t* mem_alloc(size_t size, uint32_t owner) {
+    (void)owner;
+    mem_blocks++;
+    return malloc(size);
+}
+void mem_free(uint8_t* ptr) {
+    mem_blocks--;
+    free(ptr);
+}
+void bio_input(uint8_t bio) {
+    (void)bio;
+}
+void system_bio_update_purpose_and_label(bool enable, uint8_t bio_pin, int purpose, const char* label) {
+    (void)enable, (void)bio_pin, (void)purpose, (void)label;
+}
+// sigrok_stop, only reached from cleanup after a capture
+pio_hw_t host_pio0;
+adc_hw_t* adc_hw;
+volatile uint8_t scope_running;
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    (void)pio, (void)sm, (void)enabled;
+}
+void pio_sm_clear_fifos(PIO pio, uint sm) {
+    (void)pio, (void)sm;
+}
+void pio_remove_program(PIO pio, const struct pio_program* program, uint offset) {
+    (void)pio, (void)program, (void)offset;
+}
+void dma_channel_abort(uint channel) {
+    (void)channel;
+}
+void adc_run(bool run) {
+    (void)run;
+}
+void adc_fifo_setup(bool en, bool dreq_en, uint dreq_thresh, bool err_in_fifo, bool byte_shift) {
+    (void)en, (void)dreq_en, (void)dreq_thresh, (void)err_in_fifo, (void)byte_shift;
+}
+void adc_fifo_drain(void) {
+}
+void busy_wait_ms(uint32_t delay_ms) {
+    (void)delay_ms;
+}
+
+static int dma_claimed_count(void) {
+    int n = 0;
+    for (int i = 0; i < DMA_CHANNELS; i++) {
+        n += dma_claimed[i];
+    }
+    return n;
+}
+
+// setup with 0 to DMA_CHANNELS channels already taken by other modes: either the mode
+// starts with four channels, or it gives back the ones it got, frees its buffer and stays
+// idle, cleanup must then leave the other modes' channels alone
+static int test_setup(void) {
+    int fails = 0;
+    for (int taken = 0; taken <= DMA_CHANNELS; taken++) {
+        memset(dma_claimed, 0, sizeof(dma_claimed));
+        for (int i = 0; i < taken; i++) {
+            dma_claimed[DMA_CHANNELS - 1 - i] = true;
+        }
+        dma_error = false;
+        bus_ctrl.priority = 0x1234;
+        bool enough = DMA_CHANNELS - taken >= 4;
+
+        sigrok_setup();
+        bool ok = !dma_error && (capture_buf != NULL) == enough && dma_missing == !enough;
+        ok = ok && dma_claimed_count() == taken + (enough ? 4 : 0) && mem_blocks == (enough ? 1 : 0);
+        sigrok_cleanup();
+        ok = ok && !dma_error && dma_claimed_count() == taken && mem_blocks == 0 && bus_ctrl.priority == 0x1234;
+        if (!ok) {
+            printf("FAIL sigrok_setup with %d of %d DMA channels taken\n", taken, DMA_CHANNELS);
+        }
+        fails += !ok;
+    }
+    if (!fails) {
+        printf("ok   sigrok_setup and cleanup with 0 to %d DMA channels taken\n", DMA_CHANNELS);
+    }
+    return fails;
+}
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+#define BENCH_ROUNDS 30
+
+static void bench_one(encoder_t f, sr_device_t d, double* best) {
+    const int runs = 10;
+    double t0 = now_ns();
+    for (int r = 0; r < runs; r++) {
+        sr_device_t dd = d;
+        run_encoder(f, &dd, out_new);
+    }
+    double t = (now_ns() - t0) / runs / 1e3;
+    if (t < *best) {
+        *best = t;
+    }
+}
+
+static void benchmark(void) {
+    printf("benchmark, us per %u sample half, best of %d rounds:\n", HALF_MAX, BENCH_ROUNDS);
+    printf(" %-8s %10s %10s %7s %10s %10s %7s\n", "pattern", "D4 ref", "D4", "", "1B ref", "1B", "");
+    for (int pattern = 0; pattern < PAT_COUNT; pattern++) {
+        double t[4] = { 1e30, 1e30, 1e30, 1e30 };
+        sr_device_t d = { 0 };
+        d.cont = true;
+        d.d_tx_bps = 1;
+        d_dma_bps = 1;
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            fill(pattern, true);
+            d.samples_per_half = HALF_MAX;
+            bench_one(ref_send_slices_D4, d, &t[0]);
+            bench_one(send_slices_D4, d, &t[1]);
+            fill(pattern, false);
+            d.samples_per_half = HALF_MAX;
+            bench_one(ref_send_slices_1B, d, &t[2]);
+            bench_one(send_slices_1B, d, &t[3]);
+        }
+        printf(" %-8s %10.1f %10.1f %6.2fx %10.1f %10.1f %6.2fx\n",
+               pattern_names[pattern],
+               t[0],
+               t[1],
+               t[0] / t[1],
+               t[2],
+               t[3],
+               t[2] / t[3]);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        benchmark();
+        return 0;
+    }
+    int fails = test() + test_setup();
+    benchmark();
+    return fails ? 1 : 0;
+}
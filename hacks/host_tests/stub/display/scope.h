@@ -0,0 +1,3 @@
+// Host stand-in
+#include <stdint.h>
+extern volatile uint8_t scope_running;
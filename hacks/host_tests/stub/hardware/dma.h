@@ -0,0 +1,2 @@
+// Host stand-in, declarations are in pico/stdlib.h
+#include "pico/stdlib.h"
@@ -0,0 +1 @@
+// Host stand-in, the PIO program header is generated by the firmware build
@@ -0,0 +1,4 @@
+// Host stand-in
+#include "pico/stdlib.h"
+uint32_t multicore_fifo_pop_blocking(void);
+void multicore_fifo_push_blocking(uint32_t data);
@@ -0,0 +1,106 @@
+// Host stand-in for the pico-sdk headers, only what the host tests compile against
+// Functions are declared only, a test defines the ones its code path calls
+#ifndef HOST_STUB_PICO_STDLIB_H
+#define HOST_STUB_PICO_STDLIB_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+typedef unsigned int uint;
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+// PIO
+typedef struct {
+    volatile uint32_t fdebug;
+    volatile uint32_t rxf[4];
+} pio_hw_t;
+typedef pio_hw_t* PIO;
+extern pio_hw_t host_pio0;
+#define pio0 (&host_pio0)
+#define PIO_FDEBUG_RXSTALL_LSB 0
+struct pio_program {
+    const uint16_t* instructions;
+    uint8_t length;
+    int8_t origin;
+};
+typedef struct {
+    uint32_t x;
+} pio_sm_config;
+enum { pio_pins };
+enum { PIO_FIFO_JOIN_RX = 2 };
+uint16_t pio_encode_in(int src, uint count);
+uint pio_add_program(PIO pio, const struct pio_program* program);
+void pio_remove_program(PIO pio, const struct pio_program* program, uint offset);
+pio_sm_config pio_get_default_sm_config(void);
+void sm_config_set_in_pins(pio_sm_config* c, uint in_base);
+void sm_config_set_wrap(pio_sm_config* c, uint wrap_target, uint wrap);
+void sm_config_set_clkdiv_int_frac(pio_sm_config* c, uint16_t div_int, uint8_t div_frac);
+void sm_config_set_in_shift(pio_sm_config* c, bool shift_right, bool autopush, uint push_threshold);
+void sm_config_set_fifo_join(pio_sm_config* c, int join);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config* config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_restart(PIO pio, uint sm);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+
+// DMA
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
+typedef struct {
+    struct {
+        volatile uint32_t al1_ctrl;
+    } ch[12];
+} dma_hw_t;
+extern dma_hw_t* dma_hw;
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB 11
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS 0x7800
+enum { DMA_SIZE_8, DMA_SIZE_16, DMA_SIZE_32 };
+bool dma_channel_is_busy(uint channel);
+void dma_channel_set_write_addr(uint channel, volatile void* write_addr, bool trigger);
+void dma_channel_abort(uint channel);
+void channel_config_set_chain_to(dma_channel_config* c, uint chain_to);
+void channel_config_set_dreq(dma_channel_config* c, uint dreq);
+void channel_config_set_transfer_data_size(dma_channel_config* c, int size);
+void channel_config_set_read_increment(dma_channel_config* c, bool incr);
+void channel_config_set_write_increment(dma_channel_config* c, bool incr);
+dma_channel_config dma_channel_get_default_config(uint channel);
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+void dma_channel_configure(uint channel,
+                           const dma_channel_config* config,
+                           volatile void* write_addr,
+                           const volatile void* read_addr,
+                           uint transfer_count,
+                           bool trigger);
+
+// ADC
+typedef struct {
+    volatile uint32_t fcs, fifo, div;
+} adc_hw_t;
+extern adc_hw_t* adc_hw;
+#define ADC_FCS_OVER_BITS 1
+#define ADC_FCS_UNDER_BITS 2
+#define DREQ_ADC 36
+void adc_run(bool run);
+void adc_select_input(uint input);
+void adc_set_round_robin(uint input_mask);
+void adc_fifo_setup(bool en, bool dreq_en, uint dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_fifo_drain(void);
+
+// bus, clocks, time
+typedef struct {
+    volatile uint32_t priority;
+} bus_ctrl_hw_t;
+extern bus_ctrl_hw_t* bus_ctrl_hw;
+#define BUSCTRL_BUS_PRIORITY_DMA_W_BITS 1
+#define BUSCTRL_BUS_PRIORITY_DMA_R_BITS 2
+enum { clk_sys = 5 };
+uint32_t clock_get_hz(int clock);
+void hw_write_masked(volatile uint32_t* addr, uint32_t values, uint32_t write_mask);
+void hw_set_bits(volatile uint32_t* addr, uint32_t mask);
+uint64_t time_us_64(void);
+void busy_wait_ms(uint32_t delay_ms);
+
+#endif
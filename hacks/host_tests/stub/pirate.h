@@ -0,0 +1,15 @@
+// Host stand-in for the Bus Pirate platform header, only what the host tests compile against
+#ifndef HOST_STUB_PIRATE_H
+#define HOST_STUB_PIRATE_H
+#include "pico/stdlib.h"
+
+#define PIO_LOGIC_ANALYZER_PIO pio0
+#define PIO_LOGIC_ANALYZER_SM 0
+#define AMUX_OUT_ADC 2
+#define BP_PIN_MODE 1
+#define UI_CMDBUFFSIZE 512
+enum { BIO0, BIO1, BIO2, BIO3, BIO4, BIO5, BIO6, BIO7 };
+extern const uint8_t bio2bufiopin[8];
+extern const uint32_t hw_pin_label_ordered_color[10][2];
+
+#endif
@@ -0,0 +1,3 @@
+// Host stand-in
+#include "pico/stdlib.h"
+bool amux_select_bio(uint8_t bio);
@@ -0,0 +1,3 @@
+// Host stand-in
+#include "pico/stdlib.h"
+void bio_input(uint8_t bio);
@@ -0,0 +1,5 @@
+// Host stand-in
+#include "pico/stdlib.h"
+enum { BP_BIG_BUFFER_LA = 2 };
+uint8_t* mem_alloc(size_t size, uint32_t owner);
+void mem_free(uint8_t* ptr);
@@ -0,0 +1,17 @@
+// Host stand-in for the system configuration, only what the host tests compile against
+#ifndef HOST_STUB_SYSTEM_CONFIG_H
+#define HOST_STUB_SYSTEM_CONFIG_H
+#include "pico/stdlib.h"
+
+struct _system_config {
+    bool binmode_usb_rx_queue_enable;
+    bool binmode_usb_tx_queue_enable;
+    uint8_t terminal_ansi_rows;
+    uint32_t terminal_ansi_statusbar;
+    bool terminal_hide_cursor;
+    bool terminal_ansi_statusbar_pause;
+};
+extern struct _system_config system_config;
+void system_bio_update_purpose_and_label(bool enable, uint8_t bio_pin, int purpose, const char* label);
+
+#endif
@@ -0,0 +1,5 @@
+// Host stand-in, the binary CDC port
+#include "pico/stdlib.h"
+uint32_t tud_cdc_n_write(uint8_t itf, const void* buffer, uint32_t bufsize);
+uint32_t tud_cdc_n_write_flush(uint8_t itf);
+bool tud_cdc_n_connected(uint8_t itf);
@@ -0,0 +1,8 @@
+// Host stand-in
+#include <stdint.h>
+const char* ui_term_color_error(void);
+const char* ui_term_color_info(void);
+const char* ui_term_color_reset(void);
+uint32_t ui_term_color_text_background(uint32_t rgb_text, uint32_t rgb_background);
+char* ui_term_cursor_show(void);
+char* ui_term_cursor_hide(void);
@@ -0,0 +1,5 @@
+// Host stand-in
+#include <stdbool.h>
+bool bin_rx_fifo_try_get(char* c);
+bool rx_fifo_try_get(char* c);
+void rx_fifo_get_blocking(char* c);
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+# Read throughput benchmark for the legacy binary mode (src/binmode/legacy4third.c)
+# Times SPI write-then-read (opcode 0x04) the way flashrom reads a flash chip: a 4 byte
+# read command (0x03 + 24 bit address) followed by a read of the given length, repeated
+# for a fixed time per size. Prints reads/s and kB/s so firmware builds can be compared.
+#
+# Usage: legacy4third_bench.py port [--sizes 16,256,4096,16384,65535] [--seconds 3] [--speed 7]
+#   select the binmode on the Bus Pirate first: binmode, then "Legacy Binary Mode for Flashrom..."
+#   port is the binary CDC port, usually the second /dev/ttyACMx or COMx
+#   a SPI flash on the IO header gives real data, without one the timing is the same
+#   --speed is the legacy SPI speed code, 0=30kHz 1=125kHz 2=250kHz 3=1MHz 4=2MHz 5=2.6MHz
+#   6=4MHz 7=8MHz
+#
+# Requires pyserial
+import argparse
+import sys
+import time
+
+SPEED_HZ = [30000, 125000, 250000, 1000000, 2000000, 2600000, 4000000, 8000000]
+
+
+class Legacy:
+    def __init__(self, port, timeout=2.0):
+        import serial
+
+        self.port = serial.Serial(port, 115200, timeout=timeout)
+        self.port.reset_input_buffer()
+
+    def expect(self, what, reply):
+        got = self.port.read(len(reply))
+        if got != reply:
+            raise RuntimeError("%s: expected %r, got %r" % (what, reply, got))
+
+    def enter_spi(self, speed):
+        # up to 20 zero bytes until the mode answers BBIO1, as flashrom does
+        # only the first zero after another command answers, then every 16th
+        reply = b""
+        for _ in range(20):
+            self.port.write(b"\x00")
+            time.sleep(0.01)
+            reply += self.port.read(self.port.in_waiting)
+            if reply.endswith(b"BBIO1"):
+                break
+        else:
+            raise RuntimeError("binary mode: no BBIO1, got %r" % reply)
+        self.port.write(b"\x01")
+        self.expect("SPI mode", b"SPI1")
+        self.port.write(bytes([0x60 | speed]))
+        self.expect("SPI speed", b"\x01")
+        self.port.write(b"\x8a")  # 3.3V outputs, CKE active to idle
+        self.expect("SPI config", b"\x01")
+        self.port.write(b"\x49")  # power on, CS high
+        self.expect("peripherals", b"\x01")
+
+    def write_then_read(self, data, count):
+        self.port.write(bytes([0x04, len(data) >> 8, len(data) & 0xFF, count >> 8, count & 0xFF]) + data)
+        reply = self.port.read(1 + count)
+        if len(reply) != 1 + count or reply[0] != 0x01:
+            raise TimeoutError("short reply, %d of %d bytes" % (len(reply), 1 + count))
+        return reply[1:]
+
+    def exit(self):
+        self.port.write(b"\x00\x0f")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="legacy binary mode SPI read benchmark")
+    parser.add_argument("port", help="binary CDC port")
+    parser.add_argument("--sizes", default="16,256,4096,16384,65535", help="read lengths, comma separated")
+    parser.add_argument("--seconds", type=float, default=3.0, help="time per read length")
+    parser.add_argument("--speed", type=int, default=7, choices=range(8), help="legacy SPI speed code")
+    args = parser.parse_args()
+    sizes = [int(s) for s in args.sizes.split(",")]
+    if any(s < 1 or s > 0xFFFF for s in sizes):
+        sys.exit("read lengths are 1 to 65535 bytes")
+
+    bp = Legacy(args.port)
+    bp.enter_spi(args.speed)
+    print("SPI %d Hz, %.1f s per size" % (SPEED_HZ[args.speed], args.seconds))
+    print("%8s %10s %10s %10s" % ("bytes", "reads/s", "kB/s", "SPI kB/s"))
+    for size in sizes:
+        reads = 0
+        start = time.perf_counter()
+        try:
+            while time.perf_counter() - start < args.seconds:
+                bp.write_then_read(b"\x03\x00\x00\x00", size)
+                reads += 1
+        except TimeoutError as e:
+            print("%8d failed after %d reads: %s" % (size, reads, e))
+            bp.port.reset_input_buffer()
+            continue
+        elapsed = time.perf_counter() - start
+        # the bus limit for comparison: 4 command bytes plus the read at the SPI clock
+        spi = SPEED_HZ[args.speed] / 8 / 1000 * size / (size + 4)
+        print("%8d %10.1f %10.1f %10.1f" % (size, reads / elapsed, reads * size / elapsed / 1000, spi))
+    bp.exit()
+
+
+if __name__ == "__main__":
+    main()
@@ -38,6 +38,9 @@
 #include "binmode/sump.h"
 #include "binio_helpers.h"
 #include "tusb.h"
+#ifdef BP_USE_HWI2C
+#include "pirate/hwi2c_pio.h"
+#endif
 #include "commands/global/l_bitorder.h"
 #include "commands/global/p_pullups.h"
 #include "commands/global/cmd_mcu.h"
@@ -167,6 +170,45 @@ uint32_t binmode_read(uint8_t* binmode_args) {
     return result.in_data;
 }
 
+// one complete I2C transaction: START, address, txlen bytes, repeated START, address | 1, rxlen bytes, STOP
+// addr is the 8 bit write address, the read bit is set as needed
+// returns a hwi2c_status_t, or BINMODE_I2C_WRONG_MODE outside of the I2C mode
+uint8_t binmode_i2c_transaction(uint8_t addr, uint8_t* txbuf, uint16_t txlen, uint8_t* rxbuf, uint16_t rxlen) {
+#ifdef BP_USE_HWI2C
+    const uint32_t timeout = 0xfffff;
+    hwi2c_status_t i2c_status;
+
+    if (system_config.mode != HWI2C) {
+        return BINMODE_I2C_WRONG_MODE;
+    }
+    addr &= ~1u;
+    if (rxlen == 0) {
+        i2c_status = pio_i2c_write_array_timeout(addr, txbuf, txlen, timeout);
+    } else if (txlen == 0) {
+        i2c_status = pio_i2c_read_array_timeout(addr | 1u, rxbuf, rxlen, timeout);
+    } else {
+        i2c_status = pio_i2c_write_read_array_timeout(addr, txbuf, txlen, rxbuf, rxlen, timeout);
+    }
+
+    // the array functions bail out with the bus still claimed
+    switch (i2c_status) {
+        case HWI2C_NACK:
+            if (pio_i2c_stop_timeout(timeout) == HWI2C_TIMEOUT) {
+                pio_i2c_resume_after_error();
+            }
+            break;
+        case HWI2C_TIMEOUT:
+            pio_i2c_resume_after_error();
+            break;
+        default:
+            break;
+    }
+    return i2c_status;
+#else
+    return BINMODE_I2C_WRONG_MODE;
+#endif
+}
+
 // might have to compare the function to the
 // address of the dummy functions to see if
 // these apply to the mode
@@ -7,6 +7,7 @@ uint32_t binmode_start_alt(uint8_t* binmode_args);
 uint32_t binmode_stop(uint8_t* binmode_args);
 uint32_t binmode_stop_alt(uint8_t* binmode_args);
 uint32_t binmode_read(uint8_t* binmode_args);
+uint8_t binmode_i2c_transaction(uint8_t addr, uint8_t* txbuf, uint16_t txlen, uint8_t* rxbuf, uint16_t rxlen);
 uint32_t binmode_clkh(uint8_t* binmode_args);
 uint32_t binmode_clkl(uint8_t* binmode_args);
 uint32_t binmode_tick(uint8_t* binmode_args);
@@ -46,4 +47,7 @@ uint32_t binmode_change_binmode(uint8_t* binmode_args);
 
 extern uint8_t binmode_debug;
 
-#define BINMODE_MAX_ARGS 10
\ No newline at end of file
+#define BINMODE_MAX_ARGS 10
+
+// binmode_i2c_transaction() status, after the hwi2c_status_t values
+#define BINMODE_I2C_WRONG_MODE 3
\ No newline at end of file
@@ -12,9 +12,7 @@
 #include "modes.h"
 
 void script_send(const char* c, uint32_t len) {
-    for (uint32_t i = 0; i < len; i++) {
-        bin_tx_fifo_put(c[i]);
-    }
+    bin_tx_fifo_put_buf(c, len);
 }
 
 void script_reset(void) {
@@ -15,6 +15,8 @@
 #include "binmode/falaio.h"
 #include "binmode/irtoy-irman.h"
 #include "binmode/irtoy-air.h"
+#include "binmode/serprog.h"
+#include "lib/sigrok/pico_sdk_sigrok.h"
 #include "lib/arduino-ch32v003-swio/arduino_ch32v003.h"
 #include "pirate/storage.h" // File system related
 #include "usb_rx.h"
@@ -113,11 +115,39 @@ const binmode_t binmodes[] = {
         .pullup_enabled = false,
         .psu_en_voltage = 5.0,
         .psu_en_current = 0,  
-        .button_to_exit = false,      
+        .button_to_exit = true,      
         .binmode_setup = irtoy_air_setup,
         .binmode_cleanup = irtoy_air_cleanup,
         .binmode_service = irtoy_air_service,
     },
+    {
+        .lock_terminal = true,
+        .can_save_config = false,
+        .reset_to_hiz = true,
+        .pullup_enabled = false,
+        .psu_en_voltage = 0,
+        .psu_en_current = 0,
+        .button_to_exit = true,
+        .binmode_name = serprog_name,
+        .binmode_setup = serprog_setup,
+        .binmode_setup_message = serprog_setup_message,
+        .binmode_service = serprog_service,
+        .binmode_cleanup = serprog_cleanup,
+    },
+    {
+        .lock_terminal = true,
+        .can_save_config = false,
+        .reset_to_hiz = true,
+        .pullup_enabled = false,
+        .psu_en_voltage = 0,
+        .psu_en_current = 0,
+        .button_to_exit = true,
+        .binmode_name = sigrok_name,
+        .binmode_setup = sigrok_setup,
+        .binmode_setup_message = sigrok_setup_message,
+        .binmode_service = sigrok_service,
+        .binmode_cleanup = sigrok_cleanup,
+    },
 };
 
 inline void binmode_setup(void) {
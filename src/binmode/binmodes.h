@@ -11,6 +11,8 @@ enum {
     BINMODE_USE_FALA,
     BINMODE_USE_IRTOY_IRMAN,
     BINMODE_USE_IRTOY_AIR,
+    BINMODE_USE_SERPROG,
+    BINMODE_USE_SIGROK,
     BINMODE_MAXPROTO
 };
 
@@ -31,6 +31,7 @@
 #include "binio_helpers.h"
 #include "tusb.h"
 #include "binmode/binio.h"
+#include "binmode/dirtyproto_script.h"
 #include "system_config.h"
 
 struct _binmode_struct {
@@ -89,6 +90,12 @@ enum {
     BM_DATH,
     BM_DATL,
     BM_BITR,
+    BM_FRAME,      // 43 length prefixed batch of commands, one response frame
+    BM_WRITE_BULK, // 44 frame only: write N bytes
+    BM_READ_BULK,  // 45 frame only: read N bytes
+    BM_I2C_TRANSACTION, // 46 I2C mode: addr, txlen, rxlen (16 bit little endian), txlen bytes
+    BM_SCRIPT_LOAD,     // 47 length (16 bit little endian), length bytes of script
+    BM_SCRIPT_RUN,      // 48 step limit (32 bit little endian), one response frame
 };
 
 static const struct _binmode_struct binmode_commands[] = {
@@ -136,6 +143,12 @@ static const struct _binmode_struct binmode_commands[] = {
     [BM_DATH] = { &binmode_dath, 0 },
     [BM_DATL] = { &binmode_datl, 0 },
     [BM_BITR] = { &binmode_bitr, 0 },
+    [BM_FRAME] = { 0, 2 },
+    [BM_WRITE_BULK] = { 0, 1 },
+    [BM_READ_BULK] = { 0, 1 },
+    [BM_I2C_TRANSACTION] = { 0, 5 },
+    [BM_SCRIPT_LOAD] = { 0, 2 },
+    [BM_SCRIPT_RUN] = { 0, 4 },
 };
 
 enum binmode_statemachine {
@@ -144,10 +157,270 @@ enum binmode_statemachine {
     BINMODE_GET_NULL_TERM,
     BIMNODE_DO_COMMAND,
     BINMODE_PRINT_STRING,
+    BINMODE_GET_FRAME,
+    BINMODE_GET_I2C_PAYLOAD,
+    BINMODE_GET_SCRIPT,
+    BINMODE_DISCARD_PAYLOAD,
 };
 
 const char dirtyproto_mode_name[] = "Binmode test framework";
 
+/*
+ * Framed batch protocol
+ * Host: BM_FRAME, length (16 bit little endian), length bytes of commands.
+ * Commands are encoded as in the byte protocol: command byte followed by its arguments.
+ * BM_WRITE_BULK n <n bytes> and BM_READ_BULK n are only valid inside a frame,
+ * outside one their arguments and payload are skipped and they are answered with 1.
+ * The whole frame is executed back to back and answered with one response frame:
+ * status, length (16 bit little endian), then the result byte of each command
+ * (n bytes for the bulk commands, none for BM_PRINT_STRING).
+ * Execution stops at the first error, results up to that point are returned.
+ * The host can send the next frame without waiting, responses come back in order.
+ *
+ * I2C transaction
+ * Host: BM_I2C_TRANSACTION, 8 bit address, txlen, rxlen (16 bit little endian), txlen bytes.
+ * Runs START, address, txlen bytes, repeated START, address | 1, rxlen bytes, STOP in one go,
+ * the bus is not released between the write and the read.
+ * Answered with a status (hwi2c_status_t, BINMODE_I2C_WRONG_MODE, I2C_TOO_LONG)
+ * followed by exactly rxlen bytes, 0xff filled if the transaction failed.
+ * Valid on its own and inside a frame, where it adds 1 + rxlen result bytes.
+ *
+ * Scripts
+ * Host: BM_SCRIPT_LOAD, length (16 bit little endian), length bytes of program.
+ * Answered with one status byte, the program is kept until the next load.
+ * Host: BM_SCRIPT_RUN, step limit (32 bit little endian, 0 for DIRTYPROTO_SCRIPT_STEPS).
+ * Runs the program on the device and answers with one response frame as above.
+ * A program is commands encoded as in a frame mixed with the opcodes in dirtyproto_script.h:
+ * registers, loops and jumps on read values, so polling and retries need no round trips.
+ * Only the bytes sent with SCRIPT_OP_EMIT are returned, or every result while ECHO is on.
+ * BM_FRAME and the script commands are not valid inside a frame or a script.
+ */
+#define DIRTYPROTO_FRAME_MAX 512
+
+enum dirtyproto_frame_status {
+    FRAME_OK = 0,
+    FRAME_INVALID_COMMAND,
+    FRAME_TRUNCATED,     // last command is missing arguments
+    FRAME_TOO_LONG,      // request larger than DIRTYPROTO_FRAME_MAX, not executed
+    FRAME_RESPONSE_FULL, // results would exceed DIRTYPROTO_FRAME_MAX
+};
+
+#define I2C_TOO_LONG 4 // txlen or rxlen larger than DIRTYPROTO_FRAME_MAX, not executed
+
+static uint8_t frame_buf[DIRTYPROTO_FRAME_MAX];
+static uint8_t frame_response[DIRTYPROTO_FRAME_MAX];
+static uint16_t frame_length;
+static uint16_t frame_pos;
+static uint8_t script_buf[DIRTYPROTO_FRAME_MAX];
+static uint16_t script_length;
+
+// commands that start their own request can't be nested in a frame or script
+static bool dirtyproto_frame_valid(uint8_t cmd) {
+    return cmd < count_of(binmode_commands) && cmd != BM_FRAME && cmd != BM_SCRIPT_LOAD && cmd != BM_SCRIPT_RUN;
+}
+
+// argument bytes following cmd, -1 if the frame ends first
+static int dirtyproto_frame_args(uint8_t cmd, const uint8_t* args, uint16_t remaining) {
+    int count;
+    if (cmd == BM_WRITE_BULK || cmd == BM_READ_BULK) {
+        if (!remaining) {
+            return -1;
+        }
+        count = (cmd == BM_WRITE_BULK) ? 1 + args[0] : 1;
+    } else if (cmd == BM_I2C_TRANSACTION) {
+        if (remaining < binmode_commands[cmd].arg_count) {
+            return -1;
+        }
+        count = binmode_commands[cmd].arg_count + (args[1] | (args[2] << 8));
+    } else if (cmd == BM_CONFIG) {
+        count = modes[system_config.mode].binmode_get_config_length();
+    } else if (cmd == BM_PRINT_STRING || binmode_commands[cmd].arg_count < 0) {
+        const uint8_t* end = memchr(args, 0x00, remaining);
+        if (!end || (cmd != BM_PRINT_STRING && (end - args) >= BINMODE_MAX_ARGS)) {
+            return -1;
+        }
+        return (end - args) + 1;
+    } else {
+        count = binmode_commands[cmd].arg_count;
+    }
+    return (count <= remaining) ? count : -1;
+}
+
+static void dirtyproto_frame_reply(uint8_t status, uint16_t length) {
+    bin_tx_fifo_put(status);
+    bin_tx_fifo_put(length & 0xff);
+    bin_tx_fifo_put(length >> 8);
+    for (uint16_t i = 0; i < length; i++) {
+        bin_tx_fifo_put(frame_response[i]);
+    }
+}
+
+// rxbuf always holds rxlen bytes afterwards, 0xff filled on failure
+static uint8_t dirtyproto_i2c_run(uint8_t addr, uint8_t* txbuf, uint16_t txlen, uint8_t* rxbuf, uint16_t rxlen) {
+    uint8_t status = binmode_i2c_transaction(addr, txbuf, txlen, rxbuf, rxlen);
+    if (status != 0) {
+        memset(rxbuf, 0xff, rxlen);
+    }
+    if (binmode_debug) {
+        printf("[I2C] 0x%02X tx %d rx %d, status %d\r\n", addr, txlen, rxlen, status);
+    }
+    return status;
+}
+
+// standalone BM_I2C_TRANSACTION, the payload has been collected in frame_buf
+static void dirtyproto_i2c_reply(uint8_t addr, uint16_t txlen, uint16_t rxlen) {
+    uint8_t status;
+    if (txlen > DIRTYPROTO_FRAME_MAX || rxlen > DIRTYPROTO_FRAME_MAX) {
+        status = I2C_TOO_LONG;
+    } else {
+        status = dirtyproto_i2c_run(addr, frame_buf, txlen, frame_response, rxlen);
+    }
+    bin_tx_fifo_put(status);
+    for (uint16_t i = 0; i < rxlen; i++) {
+        bin_tx_fifo_put(status == I2C_TOO_LONG ? 0xff : frame_response[i]);
+    }
+}
+
+// run one command of a frame or script, returns the number of result bytes
+// written to out, -1 if they would exceed max
+static int dirtyproto_frame_exec(uint8_t cmd, const uint8_t* args, uint8_t* out, uint16_t max) {
+    if (cmd == BM_WRITE_BULK || cmd == BM_READ_BULK) {
+        uint8_t n = args[0];
+        if (n > max) {
+            return -1;
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            if (cmd == BM_WRITE_BULK) {
+                out[i] = binmode_write((uint8_t*)&args[1 + i]);
+            } else {
+                out[i] = binmode_read(NULL);
+            }
+        }
+        return n;
+    }
+
+    if (cmd == BM_I2C_TRANSACTION) {
+        uint16_t txlen = args[1] | (args[2] << 8);
+        uint16_t rxlen = args[3] | (args[4] << 8);
+        if (1 + rxlen > max) {
+            return -1;
+        }
+        out[0] = dirtyproto_i2c_run(args[0], (uint8_t*)&args[binmode_commands[cmd].arg_count], txlen, &out[1], rxlen);
+        return 1 + rxlen;
+    }
+
+    if (cmd == BM_PRINT_STRING) {
+        printf("%s\r\n", (const char*)args);
+        return 0;
+    }
+    if (!max) {
+        return -1;
+    }
+    out[0] = binmode_commands[cmd].func((uint8_t*)args);
+    return 1;
+}
+
+static void dirtyproto_frame_execute(const uint8_t* frame, uint16_t length) {
+    uint16_t pos = 0;
+    uint16_t out = 0;
+    uint8_t status = FRAME_OK;
+
+    while (pos < length) {
+        uint8_t cmd = frame[pos++];
+        if (!dirtyproto_frame_valid(cmd)) {
+            status = FRAME_INVALID_COMMAND;
+            break;
+        }
+        int args = dirtyproto_frame_args(cmd, &frame[pos], length - pos);
+        if (args < 0) {
+            status = FRAME_TRUNCATED;
+            break;
+        }
+        int results = dirtyproto_frame_exec(cmd, &frame[pos], &frame_response[out], DIRTYPROTO_FRAME_MAX - out);
+        if (results < 0) {
+            status = FRAME_RESPONSE_FULL;
+            break;
+        }
+        out += results;
+        pos += args;
+    }
+
+    if (binmode_debug) {
+        printf("[FRAME] %d bytes, %d results, status %d\r\n", length, out, status);
+    }
+    dirtyproto_frame_reply(status, out);
+}
+
+static int dirtyproto_script_args(uint8_t cmd, const uint8_t* args, uint16_t remaining) {
+    if (!dirtyproto_frame_valid(cmd)) {
+        return SCRIPT_ARGS_INVALID;
+    }
+    int count = dirtyproto_frame_args(cmd, args, remaining);
+    return (count < 0) ? SCRIPT_ARGS_TRUNCATED : count;
+}
+
+static const dirtyproto_script_io_t dirtyproto_script_io = {
+    .args = dirtyproto_script_args,
+    .exec = dirtyproto_frame_exec,
+};
+
+// BM_SCRIPT_LOAD, the program has been collected in frame_buf
+static void dirtyproto_script_load(void) {
+    uint8_t status = FRAME_OK;
+    if (frame_length > DIRTYPROTO_FRAME_MAX) {
+        script_length = 0;
+        status = FRAME_TOO_LONG;
+    } else {
+        memcpy(script_buf, frame_buf, frame_length);
+        script_length = frame_length;
+    }
+    if (binmode_debug) {
+        printf("[SCRIPT] loaded %d bytes, status %d\r\n", frame_length, status);
+    }
+    bin_tx_fifo_put(status);
+}
+
+static void dirtyproto_script_execute(uint32_t max_steps) {
+    uint16_t out;
+    uint8_t status = dirtyproto_script_run(&dirtyproto_script_io,
+                                           script_buf,
+                                           script_length,
+                                           frame_response,
+                                           DIRTYPROTO_FRAME_MAX,
+                                           &out,
+                                           max_steps ? max_steps : DIRTYPROTO_SCRIPT_STEPS);
+    if (binmode_debug) {
+        printf("[SCRIPT] %d bytes, %d results, status %d\r\n", script_length, out, status);
+    }
+    dirtyproto_frame_reply(status, out);
+}
+
+// collect frame_length bytes into frame_buf, everything waiting in the FIFO is taken in one pass
+// bytes past DIRTYPROTO_FRAME_MAX are drained and dropped, returns true when all have arrived
+static bool dirtyproto_frame_collect(void) {
+    char c;
+    while (frame_pos < frame_length && bin_rx_fifo_try_get(&c)) {
+        if (frame_pos < DIRTYPROTO_FRAME_MAX) {
+            frame_buf[frame_pos] = c;
+        }
+        frame_pos++;
+    }
+    return frame_pos >= frame_length;
+}
+
+// returns true when the frame is complete and has been answered
+static bool dirtyproto_frame_service(void) {
+    if (!dirtyproto_frame_collect()) {
+        return false;
+    }
+    if (frame_length > DIRTYPROTO_FRAME_MAX) {
+        dirtyproto_frame_reply(FRAME_TOO_LONG, 0);
+    } else {
+        dirtyproto_frame_execute(frame_buf, frame_length);
+    }
+    return true;
+}
+
 // handler needs to be cooperative multitasking until mode is enabled
 void dirtyproto_mode(void) {
     static uint8_t binmode_state = BINMODE_COMMAND;
@@ -161,6 +434,26 @@ void dirtyproto_mode(void) {
 
     char c;
     uint32_t temp;
+    if (binmode_state == BINMODE_GET_FRAME) {
+        if (dirtyproto_frame_service()) {
+            binmode_state = BINMODE_COMMAND;
+        }
+        return;
+    }
+    if (binmode_state == BINMODE_GET_SCRIPT) {
+        if (dirtyproto_frame_collect()) {
+            dirtyproto_script_load();
+            binmode_state = BINMODE_COMMAND;
+        }
+        return;
+    }
+    if (binmode_state == BINMODE_GET_I2C_PAYLOAD) {
+        if (dirtyproto_frame_collect()) {
+            dirtyproto_i2c_reply(binmode_args[0], frame_length, binmode_args[3] | (binmode_args[4] << 8));
+            binmode_state = BINMODE_COMMAND;
+        }
+        return;
+    }
     if (bin_rx_fifo_try_get(&c)) {
         switch (binmode_state) {
             case BINMODE_COMMAND:
@@ -226,12 +519,67 @@ void dirtyproto_mode(void) {
                 break;
             case BIMNODE_DO_COMMAND:
             do_binmode_command:
+                if (binmode_command == BM_FRAME) {
+                    frame_length = binmode_args[0] | (binmode_args[1] << 8);
+                    frame_pos = 0;
+                    binmode_state = BINMODE_GET_FRAME;
+                    break;
+                }
+                if (binmode_command == BM_SCRIPT_LOAD) {
+                    frame_length = binmode_args[0] | (binmode_args[1] << 8);
+                    frame_pos = 0;
+                    binmode_state = BINMODE_GET_SCRIPT;
+                    if (dirtyproto_frame_collect()) {
+                        dirtyproto_script_load();
+                        binmode_state = BINMODE_COMMAND;
+                    }
+                    break;
+                }
+                if (binmode_command == BM_SCRIPT_RUN) {
+                    dirtyproto_script_execute(binmode_args[0] | (binmode_args[1] << 8) | (binmode_args[2] << 16) |
+                                              ((uint32_t)binmode_args[3] << 24));
+                    binmode_state = BINMODE_COMMAND;
+                    break;
+                }
+                if (binmode_command == BM_WRITE_BULK || binmode_command == BM_READ_BULK) {
+                    // only valid in a frame, skip the payload so it isn't run as commands
+                    if (binmode_debug) {
+                        printf("[MAIN] Command %d is only valid in a frame\r\n", binmode_command);
+                    }
+                    if (binmode_command == BM_WRITE_BULK && binmode_args[0]) {
+                        binmode_arg_count = 0;
+                        binmode_arg_total = binmode_args[0];
+                        binmode_state = BINMODE_DISCARD_PAYLOAD;
+                        break;
+                    }
+                    bin_tx_fifo_put(1);
+                    binmode_state = BINMODE_COMMAND;
+                    break;
+                }
+                if (binmode_command == BM_I2C_TRANSACTION) {
+                    frame_length = binmode_args[1] | (binmode_args[2] << 8);
+                    frame_pos = 0;
+                    binmode_state = BINMODE_GET_I2C_PAYLOAD;
+                    if (dirtyproto_frame_collect()) {
+                        dirtyproto_i2c_reply(binmode_args[0], frame_length, binmode_args[3] | (binmode_args[4] << 8));
+                        binmode_state = BINMODE_COMMAND;
+                    }
+                    break;
+                }
                 temp = binmode_commands[binmode_command].func(binmode_args);
                 if (binmode_debug) {
                     printf("[MAIN] Command %d returned %d\r\n", binmode_command, temp);
                 }
                 bin_tx_fifo_put(temp);
                 binmode_state = BINMODE_COMMAND;
+                break;
+            case BINMODE_DISCARD_PAYLOAD:
+                binmode_arg_count++;
+                if (binmode_arg_count == binmode_arg_total) {
+                    bin_tx_fifo_put(1);
+                    binmode_state = BINMODE_COMMAND;
+                }
+                break;
             case BINMODE_PRINT_STRING:
                 if (c == 0x00) {
                     printf("\r\n");
@@ -0,0 +1,228 @@
+// dirtyproto script interpreter
+// Command results normally stay on the device: r0 holds the last result byte of each
+// command, RES picks out the others and EMIT sends only the values the host asked for.
+// With ECHO on the results of every command are returned as in a frame.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "binmode/dirtyproto_script.h"
+
+// operand bytes that follow each script opcode, 0xff if not an opcode
+static uint8_t script_op_length(uint8_t op) {
+    switch (op) {
+        case SCRIPT_OP_END:
+            return 0;
+        case SCRIPT_OP_EMIT:
+        case SCRIPT_OP_ECHO:
+            return 1;
+        case SCRIPT_OP_MOV:
+        case SCRIPT_OP_RES:
+        case SCRIPT_OP_CALLR:
+        case SCRIPT_OP_JMP:
+            return 2;
+        case SCRIPT_OP_SET:
+        case SCRIPT_OP_ADD:
+        case SCRIPT_OP_AND:
+        case SCRIPT_OP_JZ:
+        case SCRIPT_OP_JNZ:
+        case SCRIPT_OP_DJNZ:
+            return 3;
+        case SCRIPT_OP_JEQ:
+        case SCRIPT_OP_JNE:
+            return 5;
+        default:
+            return 0xff;
+    }
+}
+
+typedef struct {
+    const dirtyproto_script_io_t* io;
+    uint16_t reg[DIRTYPROTO_SCRIPT_REGS];
+    uint8_t* out;
+    uint16_t out_max;
+    uint16_t count;      // result bytes kept
+    uint16_t last;       // results of the last command start here
+    uint16_t last_count; // and are this long, past count when echo is off
+    bool echo;
+} script_t;
+
+static uint16_t script_le16(const uint8_t* b) {
+    return b[0] | (b[1] << 8);
+}
+
+static uint8_t script_command(script_t* s, uint8_t cmd, const uint8_t* args) {
+    int n = s->io->exec(cmd, args, &s->out[s->count], s->out_max - s->count);
+    if (n < 0) {
+        return SCRIPT_RESPONSE_FULL;
+    }
+    s->last = s->count;
+    s->last_count = n;
+    if (n) {
+        s->reg[0] = s->out[s->count + n - 1];
+    }
+    if (s->echo) {
+        s->count += n;
+    }
+    return SCRIPT_OK;
+}
+
+static uint8_t script_emit(script_t* s, uint8_t value) {
+    // with echo off the last results sit where the byte goes, move them up one
+    uint16_t scratch = s->echo ? 0 : s->last_count;
+    if (s->count + 1 + scratch > s->out_max) {
+        return SCRIPT_RESPONSE_FULL;
+    }
+    if (scratch) {
+        memmove(&s->out[s->last + 1], &s->out[s->last], scratch);
+        s->last++;
+    }
+    s->out[s->count++] = value;
+    return SCRIPT_OK;
+}
+
+// run a program, the result bytes are written to out and their number to out_count
+uint8_t dirtyproto_script_run(const dirtyproto_script_io_t* io,
+                              const uint8_t* prog,
+                              uint16_t length,
+                              uint8_t* out,
+                              uint16_t out_max,
+                              uint16_t* out_count,
+                              uint32_t max_steps) {
+    script_t s = { .io = io, .out = out, .out_max = out_max };
+    uint16_t pc = 0;
+    uint8_t status = SCRIPT_OK;
+
+    while (pc < length && status == SCRIPT_OK) {
+        if (!max_steps--) {
+            status = SCRIPT_STEP_LIMIT;
+            break;
+        }
+        uint8_t op = prog[pc++];
+        const uint8_t* a = &prog[pc];
+        uint16_t remaining = length - pc;
+
+        if (op < SCRIPT_OP_END) {
+            int n = io->args(op, a, remaining);
+            if (n == SCRIPT_ARGS_INVALID) {
+                status = SCRIPT_INVALID_COMMAND;
+            } else if (n < 0) {
+                status = SCRIPT_TRUNCATED;
+            } else {
+                status = script_command(&s, op, a);
+                pc += n;
+            }
+            continue;
+        }
+
+        uint8_t n = script_op_length(op);
+        if (n == 0xff) {
+            status = SCRIPT_INVALID_COMMAND;
+            break;
+        }
+        if (n > remaining) {
+            status = SCRIPT_TRUNCATED;
+            break;
+        }
+        pc += n;
+
+        // the first operand is a register except for END, ECHO, CALLR and JMP
+        uint16_t* r = &s.reg[0];
+        if (op != SCRIPT_OP_END && op != SCRIPT_OP_ECHO && op != SCRIPT_OP_CALLR && op != SCRIPT_OP_JMP) {
+            if (a[0] >= DIRTYPROTO_SCRIPT_REGS) {
+                status = SCRIPT_BAD_OPERAND;
+                break;
+            }
+            r = &s.reg[a[0]];
+        }
+
+        uint32_t target = 0xffffffff; // no jump
+        switch (op) {
+            case SCRIPT_OP_END:
+                pc = length;
+                break;
+            case SCRIPT_OP_SET:
+                *r = script_le16(&a[1]);
+                break;
+            case SCRIPT_OP_MOV:
+                if (a[1] >= DIRTYPROTO_SCRIPT_REGS) {
+                    status = SCRIPT_BAD_OPERAND;
+                    break;
+                }
+                *r = s.reg[a[1]];
+                break;
+            case SCRIPT_OP_ADD:
+                *r += script_le16(&a[1]);
+                break;
+            case SCRIPT_OP_AND:
+                *r &= script_le16(&a[1]);
+                break;
+            case SCRIPT_OP_RES:
+                if (a[1] >= s.last_count) {
+                    status = SCRIPT_BAD_OPERAND;
+                    break;
+                }
+                *r = s.out[s.last + a[1]];
+                break;
+            case SCRIPT_OP_EMIT:
+                status = script_emit(&s, *r & 0xff);
+                break;
+            case SCRIPT_OP_ECHO:
+                s.echo = (a[0] != 0);
+                s.last_count = 0;
+                break;
+            case SCRIPT_OP_CALLR: {
+                if (a[0] >= SCRIPT_OP_END || a[1] >= DIRTYPROTO_SCRIPT_REGS) {
+                    status = SCRIPT_BAD_OPERAND;
+                    break;
+                }
+                uint8_t arg = s.reg[a[1]] & 0xff;
+                if (io->args(a[0], &arg, 1) != 1) {
+                    status = SCRIPT_INVALID_COMMAND;
+                    break;
+                }
+                status = script_command(&s, a[0], &arg);
+                break;
+            }
+            case SCRIPT_OP_JMP:
+                target = script_le16(&a[0]);
+                break;
+            case SCRIPT_OP_JZ:
+                if (!*r) {
+                    target = script_le16(&a[1]);
+                }
+                break;
+            case SCRIPT_OP_JNZ:
+                if (*r) {
+                    target = script_le16(&a[1]);
+                }
+                break;
+            case SCRIPT_OP_JEQ:
+                if (*r == script_le16(&a[1])) {
+                    target = script_le16(&a[3]);
+                }
+                break;
+            case SCRIPT_OP_JNE:
+                if (*r != script_le16(&a[1])) {
+                    target = script_le16(&a[3]);
+                }
+                break;
+            case SCRIPT_OP_DJNZ:
+                if (--*r) {
+                    target = script_le16(&a[1]);
+                }
+                break;
+        }
+
+        if (target != 0xffffffff) {
+            // jumping to the end is a way out of the program
+            if (target > length) {
+                status = SCRIPT_BAD_OPERAND;
+                break;
+            }
+            pc = target;
+        }
+    }
+
+    *out_count = s.count;
+    return status;
+}
@@ -0,0 +1,65 @@
+#ifndef DIRTYPROTO_SCRIPT_H
+#define DIRTYPROTO_SCRIPT_H
+
+// dirtyproto script interpreter
+// Runs a short program uploaded over the binary CDC port: dirtyproto commands encoded as
+// in a frame, mixed with script opcodes for registers, loops and conditional jumps.
+// Pure C, no hardware dependencies: commands are run through the hooks in
+// dirtyproto_script_io_t so the interpreter can be driven by a test harness on a host.
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DIRTYPROTO_SCRIPT_REGS 8
+#define DIRTYPROTO_SCRIPT_STEPS 100000 // default instruction budget
+
+// script opcodes, dirtyproto commands are below 0x80
+// reg is a register number, imm16 and addr16 are little endian, addr16 is a program offset
+enum dirtyproto_script_op {
+    SCRIPT_OP_END = 0x80, // stop
+    SCRIPT_OP_SET,        // reg imm16: reg = imm16
+    SCRIPT_OP_MOV,        // dst src: dst = src
+    SCRIPT_OP_ADD,        // reg imm16: reg += imm16, wraps, 0xffff subtracts 1
+    SCRIPT_OP_AND,        // reg imm16: reg &= imm16
+    SCRIPT_OP_RES,        // reg index: reg = result byte index of the last command
+    SCRIPT_OP_EMIT,       // reg: append the low byte of reg to the results
+    SCRIPT_OP_ECHO,       // 0/1: append the result bytes of every command that follows
+    SCRIPT_OP_CALLR,      // cmd reg: run a one argument command with the low byte of reg
+    SCRIPT_OP_JMP,        // addr16
+    SCRIPT_OP_JZ,         // reg addr16: jump if reg == 0
+    SCRIPT_OP_JNZ,        // reg addr16: jump if reg != 0
+    SCRIPT_OP_JEQ,        // reg imm16 addr16: jump if reg == imm16
+    SCRIPT_OP_JNE,        // reg imm16 addr16: jump if reg != imm16
+    SCRIPT_OP_DJNZ,       // reg addr16: reg -= 1, jump if reg != 0
+};
+
+// same values as the dirtyproto frame status
+enum dirtyproto_script_status {
+    SCRIPT_OK = 0,
+    SCRIPT_INVALID_COMMAND,
+    SCRIPT_TRUNCATED,     // last instruction is missing arguments
+    SCRIPT_TOO_LONG,      // program larger than the script buffer, not stored
+    SCRIPT_RESPONSE_FULL, // results would exceed the response buffer
+    SCRIPT_BAD_OPERAND,   // register, result index or jump target out of range
+    SCRIPT_STEP_LIMIT,    // instruction budget used up, probably an endless loop
+};
+
+#define SCRIPT_ARGS_TRUNCATED -1
+#define SCRIPT_ARGS_INVALID -2
+
+typedef struct {
+    // argument bytes following cmd, SCRIPT_ARGS_TRUNCATED if the program ends first,
+    // SCRIPT_ARGS_INVALID if cmd is unknown or not allowed in a script
+    int (*args)(uint8_t cmd, const uint8_t* args, uint16_t remaining);
+    // run cmd, returns the number of result bytes written to out, -1 if they would exceed max
+    int (*exec)(uint8_t cmd, const uint8_t* args, uint8_t* out, uint16_t max);
+} dirtyproto_script_io_t;
+
+uint8_t dirtyproto_script_run(const dirtyproto_script_io_t* io,
+                              const uint8_t* prog,
+                              uint16_t length,
+                              uint8_t* out,
+                              uint16_t out_max,
+                              uint16_t* out_count,
+                              uint32_t max_steps);
+
+#endif // DIRTYPROTO_SCRIPT_H
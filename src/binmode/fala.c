@@ -12,6 +12,7 @@
 // #include "modes.h"
 #include "binmode/binmodes.h"
 #include "binmode/logicanalyzer.h"
+#include "binmode/la_decimate.h"
 #include "binmode/binio.h"
 #include "binmode/fala.h"
 #include "tusb.h"
@@ -19,6 +20,7 @@
 #include "command_struct.h"
 #include "bytecode.h"
 #include "modes.h"
+#include "ui/ui_cmdln.h"
 
 FalaConfig fala_config = { .base_frequency = 1000000, .oversample = 8 };
 
@@ -39,11 +41,26 @@ void fala_set_triggers(uint8_t trigger_pin, uint8_t trigger_level) {
     // set the trigger pin and level
 }
 
+// input samples per stored sample, the oversampled capture is only reduced when a filter is selected
+uint32_t fala_decimation_factor(void) {
+    return (fala_config.decimate != LA_DECIMATE_OFF) ? fala_config.oversample : 1;
+}
+
+// rate of the samples stored in the buffer
+uint32_t fala_compute_sample_frequency(void) {
+    return logic_analyzer_compute_actual_sample_frequency(fala_config.base_frequency * fala_config.oversample, NULL) /
+           fala_decimation_factor();
+}
+
 // start the logic analyzer
 void fala_start(void) {
     // configure and arm the logic analyzer
+    // with decimation the PIO runs factor times longer, so the buffer still fills with filtered samples
+    uint32_t factor = fala_decimation_factor();
+    logic_analyzer_set_decimation(fala_config.decimate, factor);
     fala_config.actual_sample_frequency = logic_analyzer_configure(
-        fala_config.base_frequency * fala_config.oversample, LA_BUFFER_SIZE, 0x00, 0x00, false, false);
+        fala_config.base_frequency * fala_config.oversample, LA_BUFFER_SIZE * factor, 0x00, 0x00, false, false) / factor;
+    fala_config.start_time_us = time_us_64();
     logic_analyzer_arm(false);
 }
 
@@ -67,6 +84,12 @@ void fala_print_result(void) {
         printf(
         "\r\n%sLogic analyzer:%s %d samples captured\r\n", ui_term_color_info(), ui_term_color_reset(), fala_samples);
     }
+    if (logic_analyzer_decimation_overrun()) {
+        printf("%sLogic analyzer:%s %s filter could not keep up, samples were lost. Lower the oversample rate\r\n",
+               ui_term_color_warning(),
+               ui_term_color_reset(),
+               la_decimate_mode_name(fala_config.decimate));
+    }
 
     // DEBUG: print an 8 line logic analyzer graph of the last 80 samples
     if (fala_config.debug_level > 1) {
@@ -91,12 +114,14 @@ void fala_print_result(void) {
 
 /****************************************************/
 // Hooks for notifying applications of new captures
+// logic_bar, falaio and falafile can all be registered at once
+#define FALA_HOOKS_MAX 3
 
-void (*fala_notify_hooks[2])();
+void (*fala_notify_hooks[FALA_HOOKS_MAX])();
 
 // test if anything is registered
 bool fala_has_hook(void) {
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < FALA_HOOKS_MAX; i++) {
         if (fala_notify_hooks[i] != NULL) {
             return true;
         }
@@ -113,7 +138,7 @@ bool fala_notify_register(void (*hook)()) {
         }
     }
 
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < FALA_HOOKS_MAX; i++) {
         if (fala_notify_hooks[i] == NULL) {
             fala_notify_hooks[i] = hook;
             return true;
@@ -125,7 +150,7 @@ bool fala_notify_register(void (*hook)()) {
 // remove a hook from the list
 // if no hooks are left, clean up the logic analyzer
 void fala_notify_unregister(void (*hook)()) {
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < FALA_HOOKS_MAX; i++) {
         if (fala_notify_hooks[i] == hook) {
             fala_notify_hooks[i] = NULL;
         }
@@ -142,16 +167,24 @@ void fala_notify_hook(void) {
         fala_print_result();
     }
 
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < FALA_HOOKS_MAX; i++) {
         if (fala_notify_hooks[i] != NULL) {
             fala_notify_hooks[i]();
         }
     }
 }
 
+// save the command that is about to run, it is stored with the capture
+void fala_command_hook(void) {
+    if (!fala_has_hook()) {
+        return;
+    }
+    cmdln_get_current_command(sizeof(fala_config.command), fala_config.command);
+}
+
 // start the logic analyzer if a hook is registered
 void fala_start_hook(void) {
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < FALA_HOOKS_MAX; i++) {
         if (fala_notify_hooks[i] != NULL) {
             fala_start();
             return;
@@ -161,7 +194,7 @@ void fala_start_hook(void) {
 
 // stop the logic analyzer if a hook is registered
 void fala_stop_hook(void) {
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < FALA_HOOKS_MAX; i++) {
         if (fala_notify_hooks[i] != NULL) {
             fala_stop();
             return;
@@ -173,7 +206,7 @@ void fala_stop_hook(void) {
 void fala_mode_change_hook(void) {
     fala_set_freq(modes[system_config.mode].protocol_get_speed());
     fala_set_oversample(8);
-    fala_config.actual_sample_frequency = logic_analyzer_compute_actual_sample_frequency(fala_config.base_frequency * fala_config.oversample, NULL);
+    fala_config.actual_sample_frequency = fala_compute_sample_frequency();
     if (fala_has_hook()) {
         printf("\r\n%sLogic analyzer speed:%s %dHz (%dx oversampling)\r\n",
                ui_term_color_info(),
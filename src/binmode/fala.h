@@ -1,11 +1,16 @@
 #ifndef FALA_H
 #define FALA_H
 
+#define FALA_COMMAND_MAX 64
+
 typedef struct {
     uint32_t base_frequency;
     uint32_t oversample;
     uint32_t actual_sample_frequency;
     uint8_t debug_level;
+    uint8_t decimate;                // enum la_decimate_mode, filters the oversampled capture down to base_frequency
+    uint64_t start_time_us;          // time_us_64() when the last capture was armed
+    char command[FALA_COMMAND_MAX];  // command line that triggered the last capture
 } FalaConfig;
 
 extern FalaConfig fala_config;
@@ -14,10 +19,14 @@ extern FalaConfig fala_config;
 void fala_set_freq(uint32_t freq);
 void fala_set_oversample(uint32_t oversample_rate);
 void fala_set_triggers(uint8_t trigger_pin, uint8_t trigger_level);
+uint32_t fala_decimation_factor(void);
+uint32_t fala_compute_sample_frequency(void);
 void fala_start(void);
 void fala_stop(void);
 void fala_print_result(void);
 
+void fala_command_hook(void);
+bool fala_has_hook(void);
 void fala_start_hook(void);
 void fala_stop_hook(void);
 void fala_notify_hook(void);
@@ -0,0 +1,387 @@
+// Follow along logic analyzer capture to file
+// Each capture is saved to the storage as a .vcd (value change dump) or .sr (sigrok session)
+// Samples are streamed straight from the logic analyzer ring buffer, no second copy is made
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pirate.h"
+#include "system_config.h"
+#include "fatfs/ff.h"
+#include "pirate/storage.h"
+#include "binmode/logicanalyzer.h"
+#include "binmode/fala.h"
+#include "binmode/falafile.h"
+#include "ui/ui_term.h"
+
+#define FALAFILE_CHANNELS 8
+#define FALAFILE_MAX_FILES 10000
+#define FALAFILE_LINE_MAX 128 // longest single line written with falafile_printf
+
+static enum falafile_format falafile_format = FALAFILE_OFF;
+static uint32_t falafile_number = 0;
+
+// file state for the capture being written
+static FIL falafile_fil;
+static FRESULT falafile_fr;
+static uint32_t falafile_offset; // bytes written to the file so far
+
+// text and headers are collected here and flushed to the file in chunks
+static char falafile_buf[512];
+static uint32_t falafile_buf_len;
+
+static const char* const falafile_extension[] = {
+    [FALAFILE_OFF] = "off",
+    [FALAFILE_VCD] = "vcd",
+    [FALAFILE_SR] = "sr",
+};
+
+const char* falafile_format_name(enum falafile_format format) {
+    return falafile_extension[format];
+}
+
+enum falafile_format falafile_get_format(void) {
+    return falafile_format;
+}
+
+static void falafile_flush(void) {
+    UINT bw;
+    if (falafile_buf_len && falafile_fr == FR_OK) {
+        falafile_fr = f_write(&falafile_fil, falafile_buf, falafile_buf_len, &bw);
+        if (falafile_fr == FR_OK && bw != falafile_buf_len) {
+            falafile_fr = FR_DENIED; // volume full
+        }
+    }
+    falafile_buf_len = 0;
+}
+
+// small writes are buffered, large writes go straight from the source memory to the file
+static void falafile_write(const void* data, uint32_t len) {
+    UINT bw;
+    falafile_offset += len;
+    if (falafile_buf_len + len <= sizeof(falafile_buf)) {
+        memcpy(&falafile_buf[falafile_buf_len], data, len);
+        falafile_buf_len += len;
+        return;
+    }
+    falafile_flush();
+    if (falafile_fr == FR_OK) {
+        falafile_fr = f_write(&falafile_fil, data, len, &bw);
+        if (falafile_fr == FR_OK && bw != len) {
+            falafile_fr = FR_DENIED;
+        }
+    }
+}
+
+static void falafile_printf(const char* format, ...) {
+    if (sizeof(falafile_buf) - falafile_buf_len < FALAFILE_LINE_MAX) {
+        falafile_flush();
+    }
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(&falafile_buf[falafile_buf_len], FALAFILE_LINE_MAX, format, args);
+    va_end(args);
+    // a line that didn't fit was cut short, an encoding error wrote nothing
+    if (len < 0) {
+        len = 0;
+    } else if (len > FALAFILE_LINE_MAX - 1) {
+        len = FALAFILE_LINE_MAX - 1;
+    }
+    falafile_buf_len += len;
+    falafile_offset += len;
+}
+
+// nibble table CRC32 (zip polynomial), only used for the .sr container
+static uint32_t falafile_crc32(uint32_t crc, const uint8_t* data, uint32_t len) {
+    static const uint32_t table[16] = { 0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+                                        0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+                                        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+// nanoseconds from the first sample
+static uint64_t falafile_sample_time(uint32_t sample) {
+    return ((uint64_t)sample * 1000000000ull) / fala_config.actual_sample_frequency;
+}
+
+/****************************************************/
+// VCD: text header, then only the channels that change
+
+static void falafile_write_vcd(uint32_t start, uint32_t count) {
+    falafile_printf("$date\n  uptime %llu ms\n$end\n", fala_config.start_time_us / 1000);
+    falafile_printf("$version\n  Bus Pirate %s %s\n$end\n", BP_FIRMWARE_VERSION, BP_FIRMWARE_HASH);
+    falafile_printf("$comment\n  command: %s\n", fala_config.command);
+    falafile_printf("  sample rate: %d Hz\n  samples: %d\n$end\n", fala_config.actual_sample_frequency, count);
+    falafile_printf("$timescale 1 ns $end\n$scope module fala $end\n");
+    for (uint8_t i = 0; i < FALAFILE_CHANNELS; i++) {
+        falafile_printf("$var wire 1 %c IO%d $end\n", '!' + i, i);
+    }
+    falafile_printf("$upscope $end\n$enddefinitions $end\n");
+
+    // initial state of all channels
+    uint8_t last = logic_analyzer_read_ptr(start & (LA_BUFFER_SIZE - 1));
+    falafile_printf("#0\n$dumpvars\n");
+    for (uint8_t i = 0; i < FALAFILE_CHANNELS; i++) {
+        falafile_printf("%c%c\n", (last & (1u << i)) ? '1' : '0', '!' + i);
+    }
+    falafile_printf("$end\n");
+
+    // walk the ring in contiguous spans
+    uint32_t sample = 1;
+    uint32_t ptr = start + 1;
+    uint32_t remaining = count - 1;
+    while (remaining && falafile_fr == FR_OK) {
+        const uint8_t* span;
+        uint32_t len = logic_analyzer_get_span(ptr, remaining, &span);
+        for (uint32_t i = 0; i < len; i++, sample++) {
+            uint8_t changed = span[i] ^ last;
+            if (!changed) {
+                continue;
+            }
+            falafile_printf("#%llu\n", falafile_sample_time(sample));
+            for (uint8_t bit = 0; bit < FALAFILE_CHANNELS; bit++) {
+                if (changed & (1u << bit)) {
+                    falafile_printf("%c%c\n", (span[i] & (1u << bit)) ? '1' : '0', '!' + bit);
+                }
+            }
+            last = span[i];
+        }
+        ptr += len;
+        remaining -= len;
+    }
+    falafile_printf("#%llu\n", falafile_sample_time(count));
+}
+
+/****************************************************/
+// sigrok session: an uncompressed zip with version, metadata and logic-1-1 entries
+// sizes and CRC are known before each entry is written, so no seeking back is needed
+
+#define FALAFILE_ZIP_ENTRIES 3
+#define FALAFILE_ZIP_DOS_TIME 0x0000
+#define FALAFILE_ZIP_DOS_DATE (((FF_NORTC_YEAR - 1980) << 9) | (FF_NORTC_MON << 5) | FF_NORTC_MDAY)
+
+typedef struct {
+    const char* name;
+    uint32_t crc;
+    uint32_t size;
+    uint32_t offset;
+} falafile_zip_entry_t;
+
+static void falafile_put16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void falafile_put32(uint8_t* p, uint32_t v) {
+    falafile_put16(p, v);
+    falafile_put16(p + 2, v >> 16);
+}
+
+static void falafile_zip_header(falafile_zip_entry_t* entry) {
+    uint8_t h[30] = { 0 };
+    uint16_t name_len = strlen(entry->name);
+    entry->offset = falafile_offset;
+    falafile_put32(&h[0], 0x04034b50); // local file header
+    falafile_put16(&h[4], 10);         // version 1.0, stored
+    falafile_put16(&h[10], FALAFILE_ZIP_DOS_TIME);
+    falafile_put16(&h[12], FALAFILE_ZIP_DOS_DATE);
+    falafile_put32(&h[14], entry->crc);
+    falafile_put32(&h[18], entry->size); // compressed size
+    falafile_put32(&h[22], entry->size); // uncompressed size
+    falafile_put16(&h[26], name_len);
+    falafile_write(h, sizeof(h));
+    falafile_write(entry->name, name_len);
+}
+
+static void falafile_zip_directory(falafile_zip_entry_t* entries, uint8_t count) {
+    uint32_t directory_offset = falafile_offset;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t h[46] = { 0 };
+        uint16_t name_len = strlen(entries[i].name);
+        falafile_put32(&h[0], 0x02014b50); // central directory header
+        falafile_put16(&h[4], 20);         // made by
+        falafile_put16(&h[6], 10);         // version needed
+        falafile_put16(&h[12], FALAFILE_ZIP_DOS_TIME);
+        falafile_put16(&h[14], FALAFILE_ZIP_DOS_DATE);
+        falafile_put32(&h[16], entries[i].crc);
+        falafile_put32(&h[20], entries[i].size);
+        falafile_put32(&h[24], entries[i].size);
+        falafile_put16(&h[28], name_len);
+        falafile_put32(&h[42], entries[i].offset);
+        falafile_write(h, sizeof(h));
+        falafile_write(entries[i].name, name_len);
+    }
+    uint8_t e[22] = { 0 };
+    falafile_put32(&e[0], 0x06054b50); // end of central directory
+    falafile_put16(&e[8], count);
+    falafile_put16(&e[10], count);
+    falafile_put32(&e[12], falafile_offset - directory_offset);
+    falafile_put32(&e[16], directory_offset);
+    falafile_write(e, sizeof(e));
+}
+
+static void falafile_write_sr(uint32_t start, uint32_t count) {
+    static const char version[] = "2";
+    char metadata[384];
+    int len = snprintf(metadata,
+                       sizeof(metadata),
+                       "# Bus Pirate %s %s\n"
+                       "# command: %s\n"
+                       "# uptime: %llu ms\n"
+                       "[global]\n"
+                       "sigrok version=0.5.2\n"
+                       "\n"
+                       "[device 1]\n"
+                       "capturefile=logic-1\n"
+                       "total probes=%d\n"
+                       "samplerate=%d\n"
+                       "total analog=0\n",
+                       BP_FIRMWARE_VERSION,
+                       BP_FIRMWARE_HASH,
+                       fala_config.command,
+                       fala_config.start_time_us / 1000,
+                       FALAFILE_CHANNELS,
+                       fala_config.actual_sample_frequency);
+    for (uint8_t i = 0; i < FALAFILE_CHANNELS; i++) {
+        len += snprintf(&metadata[len], sizeof(metadata) - len, "probe%d=IO%d\n", i + 1, i);
+    }
+    len += snprintf(&metadata[len], sizeof(metadata) - len, "unitsize=1\n");
+
+    falafile_zip_entry_t entries[FALAFILE_ZIP_ENTRIES] = {
+        { .name = "version", .size = sizeof(version) - 1 },
+        { .name = "metadata", .size = len },
+        { .name = "logic-1-1", .size = count },
+    };
+    entries[0].crc = falafile_crc32(0, (const uint8_t*)version, entries[0].size);
+    entries[1].crc = falafile_crc32(0, (const uint8_t*)metadata, entries[1].size);
+
+    // first pass over the ring computes the sample CRC, the second pass writes the samples
+    uint32_t ptr = start;
+    uint32_t remaining = count;
+    while (remaining) {
+        const uint8_t* span;
+        uint32_t span_len = logic_analyzer_get_span(ptr, remaining, &span);
+        entries[2].crc = falafile_crc32(entries[2].crc, span, span_len);
+        ptr += span_len;
+        remaining -= span_len;
+    }
+
+    falafile_zip_header(&entries[0]);
+    falafile_write(version, entries[0].size);
+    falafile_zip_header(&entries[1]);
+    falafile_write(metadata, entries[1].size);
+    falafile_zip_header(&entries[2]);
+    ptr = start;
+    remaining = count;
+    while (remaining && falafile_fr == FR_OK) {
+        const uint8_t* span;
+        uint32_t span_len = logic_analyzer_get_span(ptr, remaining, &span);
+        falafile_write(span, span_len);
+        ptr += span_len;
+        remaining -= span_len;
+    }
+    falafile_zip_directory(entries, FALAFILE_ZIP_ENTRIES);
+}
+
+/****************************************************/
+
+// find the next unused fala####.ext file name
+static bool falafile_next_name(char* name, uint32_t len) {
+    for (uint32_t i = 0; i < FALAFILE_MAX_FILES; i++) {
+        snprintf(name, len, "fala%04d.%s", falafile_number, falafile_extension[falafile_format]);
+        falafile_number = (falafile_number + 1) % FALAFILE_MAX_FILES;
+        if (!storage_file_exists(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// fala notify hook, save the capture that just finished
+void falafile_notify(void) {
+    if (falafile_format == FALAFILE_OFF) {
+        return;
+    }
+
+    if (!system_config.storage_available) {
+        printf("%sLogic analyzer:%s no storage available, capture not saved\r\n",
+               ui_term_color_error(),
+               ui_term_color_reset());
+        return;
+    }
+
+    uint32_t count = logic_analyzer_get_samples_from_zero();
+    if (count == 0 || count > LA_BUFFER_SIZE) {
+        return;
+    }
+    // end pointer is the last sample written
+    uint32_t start = (logic_analyzer_get_end_ptr() - count + 1) & (LA_BUFFER_SIZE - 1);
+
+    char name[13];
+    if (!falafile_next_name(name, sizeof(name))) {
+        printf("%sLogic analyzer:%s no free file names, capture not saved\r\n",
+               ui_term_color_error(),
+               ui_term_color_reset());
+        return;
+    }
+
+    falafile_fr = f_open(&falafile_fil, name, FA_WRITE | FA_CREATE_ALWAYS);
+    if (falafile_fr != FR_OK) {
+        storage_file_error(falafile_fr);
+        printf("\r\n");
+        return;
+    }
+    falafile_buf_len = 0;
+    falafile_offset = 0;
+
+    if (falafile_format == FALAFILE_VCD) {
+        falafile_write_vcd(start, count);
+    } else {
+        falafile_write_sr(start, count);
+    }
+    falafile_flush();
+
+    FRESULT fr = f_close(&falafile_fil);
+    if (falafile_fr == FR_OK) {
+        falafile_fr = fr;
+    }
+    if (falafile_fr != FR_OK) {
+        storage_file_error(falafile_fr);
+        printf("\r\n");
+        return;
+    }
+    printf("%sLogic analyzer:%s saved to %s (%d bytes)\r\n",
+           ui_term_color_info(),
+           ui_term_color_reset(),
+           name,
+           falafile_offset);
+}
+
+// start saving every capture, registers with fala
+bool falafile_enable(enum falafile_format format) {
+    if (format == FALAFILE_OFF) {
+        falafile_disable();
+        return true;
+    }
+    if (falafile_format == FALAFILE_OFF) {
+        if (!fala_notify_register(&falafile_notify)) {
+            return false;
+        }
+    }
+    falafile_format = format;
+    return true;
+}
+
+void falafile_disable(void) {
+    if (falafile_format == FALAFILE_OFF) {
+        return;
+    }
+    falafile_format = FALAFILE_OFF;
+    fala_notify_unregister(&falafile_notify);
+}
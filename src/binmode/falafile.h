@@ -0,0 +1,17 @@
+#ifndef FALAFILE_H
+#define FALAFILE_H
+
+enum falafile_format {
+    FALAFILE_OFF = 0,
+    FALAFILE_VCD, // value change dump, text
+    FALAFILE_SR,  // sigrok session (zip), opens in PulseView
+};
+
+// Function declarations
+bool falafile_enable(enum falafile_format format);
+void falafile_disable(void);
+enum falafile_format falafile_get_format(void);
+const char* falafile_format_name(enum falafile_format format);
+void falafile_notify(void);
+
+#endif // FALAFILE_H
@@ -18,11 +18,19 @@
 #include "pirate/irio_pio.h"
 #include "pirate/bio.h"
 #include "pirate/psu.h"
+#include "pirate/mem.h"
 
 
 #define MAX_UART_PKT 64
 #define CDC_INTF 1
 
+// big buffer layout: the two capture rings first, they must be aligned to their size
+#define AIR_RING_OFFSET 0
+#define AIR_TEXT_OFFSET (2 * IRIO_RX_RING_BYTES)
+#define AIR_TEXT_SIZE 2048 // AIR packet from the host
+#define AIR_PAIRS_OFFSET (AIR_TEXT_OFFSET + AIR_TEXT_SIZE)
+#define AIR_PAIRS_SIZE 256 // MARK/SPACE pairs to transmit
+
 // binmode name to display
 const char irtoy_air_name[] = "AIR capture (AnalysIR, etc)";
 //TODO: binmode reset to Hiz option, power supply, etc?
@@ -33,6 +41,28 @@ static const char pin_labels[][5]={
     "38k",
 };
 
+static uint8_t *air_mem;
+static char *air_buffer;
+static uint32_t *air_pairs;
+static uint16_t air_cnt;
+static bool frame_found;
+static bool send_id;
+static uint8_t entry_count;
+
+static bool air_rx_start(void){
+    irio_pio_rx_init(bio2bufiopin[BIO5]);
+    if(!irio_pio_rx_ring_start((uint32_t*)&air_mem[AIR_RING_OFFSET])){
+        irio_pio_rx_deinit(bio2bufiopin[BIO5]);
+        return false;
+    }
+    return true;
+}
+
+static void air_rx_stop(void){
+    irio_pio_rx_ring_stop();
+    irio_pio_rx_deinit(bio2bufiopin[BIO5]);
+}
+
 // binmode setup on mode start
 void irtoy_air_setup(void) {
     system_bio_update_purpose_and_label(true, BIO1, BP_PIN_IO, pin_labels[0]);
@@ -45,7 +75,22 @@ void irtoy_air_setup(void) {
     bio_buf_output(BIO4);
     //psu_enable(5, 0, true);
     irio_pio_tx_init(bio2bufiopin[BIO4], 38000);
-    irio_pio_rx_init(bio2bufiopin[BIO5]);
+    air_mem = mem_alloc(AIR_PAIRS_OFFSET + AIR_PAIRS_SIZE * sizeof(uint32_t), BP_BIG_BUFFER_IRTOY_AIR);
+    if(!air_mem){
+        return;
+    }
+    air_buffer = (char*)&air_mem[AIR_TEXT_OFFSET];
+    air_pairs = (uint32_t*)&air_mem[AIR_PAIRS_OFFSET];
+    air_cnt = 0;
+    frame_found = false;
+    send_id = true;
+    entry_count = 0;
+    // no DMA channels for the capture rings, stay idle like a failed allocation
+    if(!air_rx_start()){
+        printf("Error: no DMA channels for the AIR capture\r\n");
+        mem_free(air_mem);
+        air_mem = NULL;
+    }
 }
 
 // binmode cleanup on exit
@@ -53,7 +98,11 @@ void irtoy_air_cleanup(void) {
     system_bio_update_purpose_and_label(false, BIO1, BP_PIN_IO, pin_labels[0]);
     system_bio_update_purpose_and_label(false, BIO4, BP_PIN_IO, pin_labels[1]);
     system_bio_update_purpose_and_label(false, BIO5, BP_PIN_IO, pin_labels[2]);
-    irio_pio_rx_deinit(bio2bufiopin[BIO5]);
+    if(air_mem){
+        air_rx_stop();
+        mem_free(air_mem);
+        air_mem = NULL;
+    }
     irio_pio_tx_deinit(bio2bufiopin[BIO4]);
     //psu_disable();
     bio_init();
@@ -80,7 +129,7 @@ printf("Unable to find modulation frequency (:) in AIR packet\r\n");
 static bool air_decode_transmit(char* air_buffer, uint32_t air_len, uint32_t *data, uint32_t data_len){
 	//parse the csv formatted values into 16 bit value pairs
 	uint16_t data_cnt=0;
-	uint8_t mod_freq;
+	uint8_t mod_freq=0;
 	uint16_t air_cnt=0;
 
     //search start of frame
@@ -161,9 +210,9 @@ static bool air_decode_transmit(char* air_buffer, uint32_t air_len, uint32_t *da
 	printf(";\r\n\r\n");		
 	printf("Parsed AIR packet: modulation frequency %dkHz, %d MARK/SPACE pairs\r\nTransmitting...", mod_freq, data_cnt);
     */
-    irio_pio_rx_deinit(bio2bufiopin[BIO5]);
+    air_rx_stop();
 	irio_pio_tx_frame_write((float)(mod_freq*1000), data_cnt, data);
-    irio_pio_rx_init(bio2bufiopin[BIO5]);
+    air_rx_start();
 	//printf("done\r\n");
 	return AIR_OK;
 }
@@ -176,20 +225,22 @@ typedef struct _IR_PULSE {
     uint8_t always_LF; // always '\n'
 } IR_PULSE;
 
-static void ir_rx_pulse_packet(IR_PULSE *pulse_buffer, bool is_mark, uint16_t pulse_length){
+// packet into buf, returns the length
+static uint32_t ir_rx_pulse_packet(char *buf, bool is_mark, uint16_t pulse_length){
+    IR_PULSE pulse_buffer;
     if(is_mark){
-        pulse_buffer->identifier_mark_or_space = '+'; //mark
+        pulse_buffer.identifier_mark_or_space = '+'; //mark
         //pulse_length = pulse_length |= 0x0001; //always set low bit for mark
     }else{
-        pulse_buffer->identifier_mark_or_space = '-'; //space
+        pulse_buffer.identifier_mark_or_space = '-'; //space
         //pulse_length = pulse_length &= 0xfffe; //always clear low bit for space
     }
-    pulse_buffer->pulse_length_msb = (uint8_t)(pulse_length >> 8);
-    pulse_buffer->pulse_length_lsb = (uint8_t)(pulse_length);
-    for(uint8_t j=0; j<sizeof(IR_PULSE); j++){
-        bin_tx_fifo_put(((uint8_t*)pulse_buffer)[j]);
-    }
-    pulse_buffer->entry_count++;
+    pulse_buffer.entry_count = entry_count++;
+    pulse_buffer.pulse_length_msb = (uint8_t)(pulse_length >> 8);
+    pulse_buffer.pulse_length_lsb = (uint8_t)(pulse_length);
+    pulse_buffer.always_LF = '\n';
+    memcpy(buf, &pulse_buffer, sizeof(IR_PULSE));
+    return sizeof(IR_PULSE);
 }
 
 typedef struct _IR_MODULATION {
@@ -200,12 +251,15 @@ typedef struct _IR_MODULATION {
     uint8_t always_LF; // always '\n'
 } IR_MODULATION;
 
-static void ir_rx_modulation_packet(IR_MODULATION *modulation_buffer, uint16_t period_sum_useconds){
-    modulation_buffer->period_sum_useconds_msb = (uint8_t)(period_sum_useconds >> 8);
-    modulation_buffer->period_sum_useconds_lsb = (uint8_t)(period_sum_useconds);
-    for(uint8_t j=0; j<sizeof(IR_MODULATION); j++){
-        bin_tx_fifo_put(((uint8_t*)modulation_buffer)[j]);
-    }
+static uint32_t ir_rx_modulation_packet(char *buf, uint16_t period_sum_useconds){
+    IR_MODULATION modulation_buffer;
+    modulation_buffer.identifier_modulation = 'M';
+    modulation_buffer.measured_sample_count = 1;
+    modulation_buffer.period_sum_useconds_msb = (uint8_t)(period_sum_useconds >> 8);
+    modulation_buffer.period_sum_useconds_lsb = (uint8_t)(period_sum_useconds);
+    modulation_buffer.always_LF = '\n';
+    memcpy(buf, &modulation_buffer, sizeof(IR_MODULATION));
+    return sizeof(IR_MODULATION);
 }
 
 /*
@@ -228,119 +282,81 @@ ASCII decimals representing the lengths of pulse and no-pulse in uS CSV formatte
     ; - Terminated with a semicolon
 
 */
-// Use PIO to count 1uS ticks for each pulse and no-pulse, with timeout?
-void irtoy_air_service(void){
-    float mod_freq;
-    uint16_t us;
-    uint16_t pairs;
-    uint32_t buffer[128];
-    uint8_t air_buffer[512];
-    bool frame_found=false;
-    uint16_t air_cnt;
-    bool send_id;
-
-    IR_PULSE pulse;
-    pulse.always_LF = '\n';
+// Use PIO to count 1uS ticks for each pulse and no-pulse, with timeout
+// The counts are DMA'd to the capture rings, each MARK/SPACE is encoded as soon as it arrives
+// and a batch of packets goes to the TX FIFO in one call, so the frame length is not limited
+// by a frame buffer and a busy loop doesn't lose edges
+static void air_rx_encode(void){
+    char out[MAX_UART_PKT];
+    uint32_t n = 0;
+    uint16_t len;
+    uint8_t event;
 
-    IR_MODULATION modulation;
-    modulation.identifier_modulation = 'M';
-    modulation.measured_sample_count = 1;
-    modulation.always_LF = '\n';
-
-    //let's talk about this loop
-    //ideally we'd be co-op multitasking, but we're not
-    //to multitask we'd need to make the buffer and air_buffer static
-    //which would eat a lot of memory
-    //instead we just do a never ending loop here
-    while(true){
-        //need to be careful about PIO fifo overflow here
-        if (!tud_cdc_n_connected(CDC_INTF)) {
-            irio_pio_rxtx_drain_fifo();
-            send_id=true;
-            continue;
-        }else if(send_id){
-            send_id=false;
-            const char version[] = {'\n','!','B','P',' ','V', HARDWARE_VERSION, FIRMWARE_VERSION_H, FIRMWARE_VERSION_L,'!','\n', 0x00};
-            for (uint32_t i = 0; i < strlen(version); i++) {
-                bin_tx_fifo_put(version[i]);
-            }
+    // leave room for a pulse and a modulation packet
+    while(n <= sizeof(out) - (sizeof(IR_PULSE) + sizeof(IR_MODULATION))){
+        event = irio_pio_rx_ring_read(&len);
+        if(event == IRIO_RX_NONE){
+            break;
         }
-
-        if(irio_pio_rx_frame_buf(&mod_freq, &us, &pairs, buffer) ){
-            #if 0
-            //create the AIR packet
-            uint8_t mod_freq_int = (uint8_t)roundf(mod_freq / 1000.0f);
-            uint16_t sn_cnt = snprintf(air_buffer, sizeof(air_buffer), "$%u:", mod_freq_int);
-            for (uint16_t i = 0; i < (pairs-1); i++) {
-                sn_cnt += snprintf(&air_buffer[sn_cnt], sizeof(air_buffer) - sn_cnt, "%u,%u,", (uint16_t)(buffer[i] >> 16), (uint16_t)(buffer[i] & 0xffff));
-            }
-            sn_cnt += snprintf(&air_buffer[sn_cnt], sizeof(air_buffer) - sn_cnt, "%u,;", (uint16_t)(buffer[pairs-1] >> 16));
-            //sn_cnt += snprintf(&air_buffer[sn_cnt], sizeof(air_buffer) - sn_cnt, ";");
-            if (sn_cnt >= count_of(air_buffer)) {
-                continue;
-            }
-            
-            //send the AIR packet
-            for (uint32_t i = 0; i < sn_cnt; i++) {
-                bin_tx_fifo_put(air_buffer[i]);
-            }
-            #endif
-
-            //uint8_t mod_freq_int = (uint8_t)roundf(mod_freq / 1000.0f);
-            pulse.entry_count=0;
-            for (uint16_t i = 0; i < (pairs); i++) {
-                ir_rx_pulse_packet(&pulse, true, (uint16_t)(buffer[i] >> 16));
-                ir_rx_pulse_packet(&pulse, false, (uint16_t)(buffer[i] & 0xffff));
-            }
-            //ir_rx_pulse_packet(&pulse, true, (uint16_t)(buffer[pairs-1] >> 16)); 
+        n += ir_rx_pulse_packet(&out[n], event == IRIO_RX_MARK, len);
+        if(len == IRIO_RX_TIMEOUT){ //end of frame
+            float mod_freq;
+            uint16_t us = 0;
+            irio_pio_get_freq_mod(&mod_freq, &us);
+            irio_pio_rx_reset_mod_freq();
             //have us, want nano seconds
             us = (us *1000) / 5; //convert to 1ns ticks
-            ir_rx_modulation_packet(&modulation, us);         
+            n += ir_rx_modulation_packet(&out[n], us);
+            entry_count = 0;
         }
-        
-        char c;
-        while(bin_rx_fifo_try_get(&c)){
-            if(c=='$'){ //beginning of frame
-                frame_found=true;
+    }
+    if(n){
+        bin_tx_fifo_put_buf(out, n);
+    }
+}
+
+// AIR packets from the host are collected between '$' and ';' and transmitted
+static void air_tx_collect(void){
+    char c;
+    while(bin_rx_fifo_try_get(&c)){
+        if(c=='$'){ //beginning of frame
+            frame_found=true;
+            air_cnt=0;
+        }
+        if(frame_found){
+            air_buffer[air_cnt]=c;
+            air_cnt++;
+            if(c==';'){ //end of frame
+                air_buffer[air_cnt]=0; //null terminate
+                air_decode_transmit(air_buffer, AIR_TEXT_SIZE, air_pairs, AIR_PAIRS_SIZE);
+                frame_found=false;
+                air_cnt=0;
+            }else if(air_cnt>=AIR_TEXT_SIZE-1){ //overflow buffer, keep room for the terminator
+                frame_found=false;
                 air_cnt=0;
             }
-            if(frame_found){ 
-                air_buffer[air_cnt]=c;
-                air_cnt++;
-                if(air_cnt>=count_of(air_buffer)){ //overflow buffer
-                    frame_found=false;
-                    air_cnt=0;
-                }
-                if(c==';'){ //end of frame
-                    //send the AIR packet
-                    air_cnt++;
-                    if(air_cnt>=count_of(air_buffer)){ //overflow buffer
-                        frame_found=false;
-                        air_cnt=0;
-                    }      
-                    air_buffer[air_cnt]=0; //null terminate              
-                    air_decode_transmit(air_buffer, count_of(air_buffer), buffer, count_of(buffer));
-                    frame_found=false;
-                    air_cnt=0;
-                }
-            }
-        }
-
-        /*char c;
-        if (!bin_rx_fifo_try_get(&c)){
-            return;
         }
-        const char version[4] = {'V', (HARDWARE_VERSION + 0x30), FIRMWARE_VERSION_H, FIRMWARE_VERSION_L};
+    }
+}
 
-        switch (c) {
-            case 'V':
-            case 'v':// Acquire Version
-                script_send(version, 4);
-                break;           
-            default:
-                break;
+void irtoy_air_service(void){
+    if(!air_mem){
+        return;
+    }
 
-        }*/
+    if (!tud_cdc_n_connected(CDC_INTF)) {
+        //keep the rings moving, nobody is listening
+        uint16_t len;
+        while(irio_pio_rx_ring_read(&len) != IRIO_RX_NONE);
+        entry_count = 0;
+        send_id=true;
+        return;
+    }else if(send_id){
+        send_id=false;
+        static const char version[] = {'\n','!','B','P',' ','V', HARDWARE_VERSION, FIRMWARE_VERSION_H, FIRMWARE_VERSION_L,'!','\n'};
+        bin_tx_fifo_put_buf(version, sizeof(version));
     }
 
+    air_rx_encode();
+    air_tx_collect();
 }
@@ -0,0 +1,123 @@
+// Logic analyzer decimation kernels
+// All 8 channels are filtered together with bitwise operations
+#include <stdint.h>
+#include <stdbool.h>
+#include "binmode/la_decimate.h"
+
+// spread a nibble so each bit lands in its own byte lane
+static const uint32_t la_decimate_lanes[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101,
+};
+
+static const char* const la_decimate_names[] = {
+    [LA_DECIMATE_OFF] = "off",
+    [LA_DECIMATE_GLITCH] = "glitch",
+    [LA_DECIMATE_MAJORITY] = "majority",
+};
+
+const char* la_decimate_mode_name(uint8_t mode) {
+    if (mode > LA_DECIMATE_MAJORITY) {
+        return "?";
+    }
+    return la_decimate_names[mode];
+}
+
+static void la_decimate_clear(la_decimate_t* d) {
+    d->n = 0;
+    d->acc_and = 0xff;
+    d->acc_or = 0x00;
+    d->count_lo = 0;
+    d->count_hi = 0;
+}
+
+void la_decimate_init(la_decimate_t* d, uint8_t mode, uint32_t factor) {
+    if (factor == 0) {
+        factor = 1;
+    }
+    if (mode == LA_DECIMATE_MAJORITY && factor > LA_DECIMATE_MAJORITY_MAX_FACTOR) {
+        factor = LA_DECIMATE_MAJORITY_MAX_FACTOR;
+    }
+    d->mode = mode;
+    d->factor = factor;
+    d->prev = 0;
+    la_decimate_clear(d);
+}
+
+// close the current group and return the output sample
+static uint8_t la_decimate_output(la_decimate_t* d) {
+    uint8_t out;
+    if (d->mode == LA_DECIMATE_MAJORITY) {
+        // ties keep the previous value
+        out = d->prev;
+        for (uint8_t i = 0; i < 4; i++) {
+            uint32_t lo = ((d->count_lo >> (i * 8)) & 0xff) * 2;
+            uint32_t hi = ((d->count_hi >> (i * 8)) & 0xff) * 2;
+            if (lo > d->n) {
+                out |= 1u << i;
+            } else if (lo < d->n) {
+                out &= ~(1u << i);
+            }
+            if (hi > d->n) {
+                out |= 1u << (i + 4);
+            } else if (hi < d->n) {
+                out &= ~(1u << (i + 4));
+            }
+        }
+    } else {
+        // stable channels pass through, channels that moved inside the group toggle
+        // from the previous output so the edge is never lost
+        uint8_t moved = d->acc_or ^ d->acc_and;
+        out = d->acc_and | (moved & ~d->prev);
+    }
+    d->prev = out;
+    la_decimate_clear(d);
+    return out;
+}
+
+// filter count input samples, outputs are written to ring[*write & ring_mask]
+// groups can span calls, returns the number of samples written
+uint32_t la_decimate_run(
+    la_decimate_t* d, const uint8_t* in, uint32_t count, uint8_t* ring, uint32_t ring_mask, uint32_t* write) {
+    uint32_t produced = 0;
+    while (count) {
+        uint32_t take = d->factor - d->n;
+        if (take > count) {
+            take = count;
+        }
+        count -= take;
+        d->n += take;
+        if (d->mode == LA_DECIMATE_MAJORITY) {
+            while (take--) {
+                uint8_t x = *in++;
+                d->count_lo += la_decimate_lanes[x & 0x0f];
+                d->count_hi += la_decimate_lanes[x >> 4];
+            }
+        } else {
+            uint8_t acc_and = d->acc_and, acc_or = d->acc_or;
+            while (take--) {
+                uint8_t x = *in++;
+                acc_and &= x;
+                acc_or |= x;
+            }
+            d->acc_and = acc_and;
+            d->acc_or = acc_or;
+        }
+        if (d->n == d->factor) {
+            ring[*write & ring_mask] = la_decimate_output(d);
+            (*write)++;
+            produced++;
+        }
+    }
+    return produced;
+}
+
+// emit a partial group at the end of a capture
+uint32_t la_decimate_flush(la_decimate_t* d, uint8_t* ring, uint32_t ring_mask, uint32_t* write) {
+    if (!d->n) {
+        return 0;
+    }
+    ring[*write & ring_mask] = la_decimate_output(d);
+    (*write)++;
+    return 1;
+}
@@ -0,0 +1,35 @@
+#ifndef LA_DECIMATE_H
+#define LA_DECIMATE_H
+
+// Logic analyzer decimation filter
+// Reduces oversampled captures to a lower stored rate, one output sample per factor inputs.
+// Pure C, the kernels work on any byte stream and write into a power of two ring buffer.
+#include <stdint.h>
+#include <stdbool.h>
+
+enum la_decimate_mode {
+    LA_DECIMATE_OFF = 0,
+    LA_DECIMATE_GLITCH,   // min/max: a channel that moved inside the group toggles, short glitches are kept
+    LA_DECIMATE_MAJORITY, // each channel takes the value seen in most of the group, rejects glitches
+};
+
+#define LA_DECIMATE_MAJORITY_MAX_FACTOR 255 // majority counters are 8 bits per channel
+
+typedef struct {
+    uint8_t mode;
+    uint32_t factor;
+    uint32_t n;          // samples in the current group
+    uint8_t acc_and;     // glitch: channels low at any point are cleared
+    uint8_t acc_or;      // glitch: channels high at any point are set
+    uint32_t count_lo;   // majority: high sample count for channels 0-3, one byte lane each
+    uint32_t count_hi;   // majority: channels 4-7
+    uint8_t prev;        // last output sample
+} la_decimate_t;
+
+void la_decimate_init(la_decimate_t* d, uint8_t mode, uint32_t factor);
+uint32_t la_decimate_run(
+    la_decimate_t* d, const uint8_t* in, uint32_t count, uint8_t* ring, uint32_t ring_mask, uint32_t* write);
+uint32_t la_decimate_flush(la_decimate_t* d, uint8_t* ring, uint32_t ring_mask, uint32_t* write);
+const char* la_decimate_mode_name(uint8_t mode);
+
+#endif // LA_DECIMATE_H
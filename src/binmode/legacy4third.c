@@ -65,7 +65,9 @@ static uint16_t current_integer;
 static uint8_t current_decimal;
 static uint8_t* tmpbuf;
 static uint8_t* cdc_buff;
-static uint32_t remain_bytes;
+static uint32_t remain_bytes; // bytes waiting in the cdc_buff ring
+static uint32_t cdc_head;     // ring read index, free running
+static uint32_t cdc_tail;     // ring write index, free running
 static bool set_aux_pins = true;
 static bool hold_value = true;
 static bool wp_value = true;
@@ -133,41 +135,57 @@ void enable_debug_legacy(void) {
     binmode_debug_level(&binmode_args);
 }
 
-uint32_t read_buff(uint8_t* buf, uint32_t len, uint32_t max_tries) {
-    uint32_t pending_data = 0;
-    uint32_t bytes_readed = 0;
-    uint32_t total_bytes_readed = 0;
-
-    if (remain_bytes > 0) {
-        bytes_readed = remain_bytes >= len ? len : remain_bytes;
-        memcpy(buf, cdc_buff, bytes_readed);
-        remain_bytes -= bytes_readed;
-
-        if (remain_bytes > 0) {
-            memmove(cdc_buff, cdc_buff + bytes_readed, remain_bytes);
-        }
+static void cdc_ring_reset(void) {
+    cdc_head = 0;
+    cdc_tail = 0;
+    remain_bytes = 0;
+}
 
-        total_bytes_readed = bytes_readed;
+// copy up to len bytes out of the ring, at most two memcpy, nothing is moved
+static uint32_t cdc_ring_take(uint8_t* buf, uint32_t len) {
+    if (len > remain_bytes) {
+        len = remain_bytes;
+    }
+    uint32_t pos = cdc_head & (CDCBUFF_SIZE - 1);
+    uint32_t first = CDCBUFF_SIZE - pos;
+    if (first > len) {
+        first = len;
     }
+    memcpy(buf, cdc_buff + pos, first);
+    memcpy(buf + first, cdc_buff, len - first);
+    cdc_head += len;
+    remain_bytes -= len;
+    return len;
+}
 
-    while (total_bytes_readed < len && max_tries--) {
-        pending_data = tud_cdc_n_available(1);
-        if (pending_data > 0) {
-            bytes_readed = tud_cdc_n_read(1, cdc_buff + remain_bytes, pending_data);
-            tud_task();
-            remain_bytes += bytes_readed;
-            uint32_t bytes_to_copy = len - total_bytes_readed;
-            if (remain_bytes < bytes_to_copy) {
-                bytes_to_copy = remain_bytes;
-            }
+// read from USB into the contiguous free space of the ring
+static void cdc_ring_fill(void) {
+    uint32_t pos = cdc_tail & (CDCBUFF_SIZE - 1);
+    uint32_t space = CDCBUFF_SIZE - remain_bytes;
+    if (space > CDCBUFF_SIZE - pos) {
+        space = CDCBUFF_SIZE - pos;
+    }
+    if (!space) {
+        return;
+    }
+    uint32_t bytes_readed = tud_cdc_n_read(1, cdc_buff + pos, space);
+    cdc_tail += bytes_readed;
+    remain_bytes += bytes_readed;
+}
 
-            memcpy(buf + total_bytes_readed, cdc_buff, bytes_to_copy);
-            total_bytes_readed += bytes_to_copy;
-            remain_bytes -= bytes_to_copy;
+uint32_t read_buff(uint8_t* buf, uint32_t len, uint32_t max_tries) {
+    uint32_t total_bytes_readed = cdc_ring_take(buf, len);
 
-            if (remain_bytes > 0) {
-                memmove(cdc_buff, cdc_buff + bytes_to_copy, remain_bytes);
+    while (total_bytes_readed < len && max_tries--) {
+        if (tud_cdc_n_available(1) > 0) {
+            if (!remain_bytes) {
+                // ring is empty, read straight into the caller's buffer
+                total_bytes_readed += tud_cdc_n_read(1, buf + total_bytes_readed, len - total_bytes_readed);
+            } else {
+                cdc_ring_fill();
+                total_bytes_readed += cdc_ring_take(buf + total_bytes_readed, len - total_bytes_readed);
             }
+            tud_task();
         }
     }
 
@@ -177,7 +195,67 @@ uint32_t read_buff(uint8_t* buf, uint32_t len, uint32_t max_tries) {
 void cdc_full_flush(uint32_t cdc_id) {
     tud_cdc_n_read_flush(cdc_id);
     tud_cdc_n_write_flush(cdc_id);
-    remain_bytes = 0;
+    cdc_ring_reset();
+}
+
+// queue len bytes on the binary CDC port, servicing USB while the FIFO is full
+static void cdc_write_all(const uint8_t* buf, uint32_t len) {
+    while (len) {
+        uint32_t n = tud_cdc_n_write(1, buf, len);
+        buf += n;
+        len -= n;
+        if (len) {
+            tud_task();
+            tud_cdc_n_write_flush(1);
+        }
+    }
+    tud_cdc_n_write_flush(1);
+}
+
+static void legacy_debug_dump(const uint8_t* buf, uint32_t len) {
+    if (!binmode_debug) {
+        return;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        printf("0x%02X ", buf[i]);
+    }
+}
+
+// clock in count bytes (sending 0x00) and stream them to the binary CDC port
+// the two halves of tmpbuf ping-pong: DMA fills one while the other is queued to USB
+// hacks/legacy4third_bench.py measures the reads/s of 0x04 for each read length
+static void legacy_spi_read_stream(uint32_t count) {
+    const uint32_t half = TMPBUFF_SIZE / 2;
+    uint8_t* bufs[2] = { tmpbuf, tmpbuf + half };
+    uint8_t cur = 0;
+    uint32_t n = (count < half) ? count : half;
+
+    if (!hwspi_dma_available()) {
+        while (count) {
+            n = (count < TMPBUFF_SIZE) ? count : TMPBUFF_SIZE;
+            hwspi_write_read_dma(NULL, tmpbuf, n);
+            legacy_debug_dump(tmpbuf, n);
+            cdc_write_all(tmpbuf, n);
+            count -= n;
+        }
+        return;
+    }
+
+    if (n) {
+        hwspi_dma_start(NULL, bufs[cur], n);
+    }
+    while (n) {
+        hwspi_dma_wait();
+        count -= n;
+        uint32_t next = (count < half) ? count : half;
+        if (next) {
+            hwspi_dma_start(NULL, bufs[cur ^ 1], next);
+        }
+        legacy_debug_dump(bufs[cur], n);
+        cdc_write_all(bufs[cur], n);
+        cur ^= 1;
+        n = next;
+    }
 }
 
 void set_pins_ui(void) {
@@ -542,7 +620,10 @@ void legacy_protocol(void) {
                     break;
                 }
 
-                if (bytes_to_write) {
+                uint64_t start_us = time_us_64();
+
+                // writes that fit are buffered whole before CS goes low, longer ones stream from USB
+                if (bytes_to_write && bytes_to_write <= TMPBUFF_SIZE) {
                     while (!read_buff(tmpbuf, bytes_to_write, DEFAULT_MAX_TRIES))
                         ;
                 }
@@ -553,48 +634,36 @@ void legacy_protocol(void) {
                 if (binmode_debug) {
                     printf("\r\n>> ");
                 }
-                int j = 0;
-                uint32_t total_bytes_spi = bytes_to_write + bytes_to_read;
-                while (j < total_bytes_spi) {
-                    if (binmode_debug) {
-                        printf("\r\n[%d] 0x%02X -> | ", j, tmpbuf[j]);
-                    }
-                    tmpbuf[j] = hwspi_write_read(j >= bytes_to_write ? 0x00 : tmpbuf[j]);
-                    if (binmode_debug) {
-                        printf("<- 0x%02X", tmpbuf[j]);
-                    }
-                    j++;
-                }
-                if (0x04 == op_byte) {
-                    hwspi_deselect();
-                }
 
-                int bytes_sent = 0;
-                int chunk_size = 32;
-                int total_bytes = bytes_to_read + 1;
-                int total_cdc_bytes_sended = 0;
-                uint32_t delta = bytes_to_write ? bytes_to_write - 1 : 0;
-                if (bytes_to_write) {
-                    tmpbuf[delta] = '\x01';
+                if (bytes_to_write <= TMPBUFF_SIZE) {
+                    legacy_debug_dump(tmpbuf, bytes_to_write);
+                    hwspi_write_read_dma(tmpbuf, NULL, bytes_to_write);
                 } else {
-                    CDC_SEND_STR(1, "\x01");
-                    total_bytes--;
+                    uint32_t left = bytes_to_write;
+                    while (left) {
+                        uint32_t n = (left < TMPBUFF_SIZE) ? left : TMPBUFF_SIZE;
+                        while (!read_buff(tmpbuf, n, DEFAULT_MAX_TRIES))
+                            ;
+                        legacy_debug_dump(tmpbuf, n);
+                        hwspi_write_read_dma(tmpbuf, NULL, n);
+                        left -= n;
+                    }
                 }
+
                 tud_cdc_n_read_flush(1);
-                remain_bytes = 0;
-                while (bytes_sent < total_bytes) {
-                    int bytes_left = total_bytes - bytes_sent;
-                    int current_chunk_size = (bytes_left < chunk_size) ? bytes_left : chunk_size;
-                    while (tud_cdc_n_write_available(1) < current_chunk_size) {
-                        tud_task();
-                        tud_cdc_n_write_flush(1);
-                    }
-                    total_cdc_bytes_sended += tud_cdc_n_write(1, tmpbuf + delta + bytes_sent, current_chunk_size);
-                    tud_cdc_n_write_flush(1);
-                    bytes_sent += current_chunk_size;
+                cdc_ring_reset();
+                CDC_SEND_STR(1, "\x01");
+                if (binmode_debug) {
+                    printf("\r\n<< ");
+                }
+                legacy_spi_read_stream(bytes_to_read);
+
+                if (0x04 == op_byte) {
+                    hwspi_deselect();
                 }
                 if (binmode_debug) {
-                    printf("\r\ntotal_cdc_bytes_sended: %d", total_cdc_bytes_sended);
+                    uint32_t elapsed = (uint32_t)(time_us_64() - start_us);
+                    printf("\r\n%d bytes written, %d read in %dus", bytes_to_write, bytes_to_read, elapsed);
                 }
                 tud_task();
             } break;
@@ -747,9 +816,12 @@ void legacy4third_mode(void) {
         tmpbuf = cdc_buff + CDCBUFF_SIZE;
         memset(cdc_buff, 0, CDCBUFF_SIZE);
         memset(tmpbuf, 0, TMPBUFF_SIZE);
-        remain_bytes = 0;
+        cdc_ring_reset();
         cdc_full_flush(1);
+        // bulk SPI falls back to polled transfers if no DMA channels are free
+        hwspi_dma_claim();
         legacy_protocol();
+        hwspi_dma_unclaim();
         system_config.binmode_usb_rx_queue_enable = true;
         system_config.binmode_usb_tx_queue_enable = true;
         mem_free(cdc_buff);
@@ -22,6 +22,7 @@
 #include "ui/ui_cmdln.h"
 #include "pirate/intercore_helpers.h"
 #include "pio_config.h"
+#include "binmode/la_decimate.h"
 
 static struct _pio_config pio_config;
 
@@ -47,6 +48,28 @@ bool status_leds_enabled = false;
 // for triggers, it is the number of samples after 0 
 uint32_t samples_from_zero = 0;
 
+// optional decimation stage between the PIO and the ring buffer
+// the two DMA channels ping-pong into a small staging buffer, the DMA_IRQ_1 handler
+// filters each finished half into la_buf. Groups may span halves.
+#define LA_DECIMATE_STAGE_BITS 9
+#define LA_DECIMATE_STAGE_SIZE (1u << LA_DECIMATE_STAGE_BITS)
+static uint8_t la_stage[2][LA_DECIMATE_STAGE_SIZE] __attribute__((aligned(LA_DECIMATE_STAGE_SIZE)));
+static la_decimate_t la_decimate;
+static uint8_t la_decimate_next_mode = LA_DECIMATE_OFF; // applies to the next logic_analyzer_configure()
+static uint32_t la_decimate_next_factor = 1;
+static uint8_t la_stage_next = 0;      // half the next completed transfer will be in
+static uint32_t la_decimate_write = 0; // samples written to la_buf
+static volatile bool la_decimate_overrun = false;
+
+// sample width in bytes, the ring holds LA_BUFFER_SIZE / la_width samples
+// wider captures read consecutive pins from la_wide_base_pin
+static uint8_t la_width = 1;
+static uint8_t la_next_width = 1; // applies to the next logic_analyzer_configure()
+static uint8_t la_wide_base_pin = 0;
+// copy of the active PIO program with the `in pins` bit count widened
+static uint16_t la_wide_instructions[32];
+static struct pio_program la_wide_program;
+
 // PIO pio = pio0;
 // uint sm = 0;
 // static uint offset = 0;
@@ -92,10 +115,130 @@ void logic_analyzer_dump(uint8_t* txbuf) {
     la_ptr &= 0x1ffff;
 }
 
+// dump one sample of la_width bytes (little endian, pin order), newest first
+void logic_analyzer_dump_sample(uint8_t* txbuf) {
+    memcpy(txbuf, (const uint8_t*)&la_buf[la_ptr * la_width], la_width);
+    la_ptr--;
+    la_ptr &= (LA_BUFFER_SIZE / la_width) - 1;
+}
+
+// capture width for the next logic_analyzer_configure(), in bytes: 1, 2 or 4
+// wide samples read 8*width consecutive pins starting at base_pin, the ring depth shrinks to match
+// one shot like the decimation filter, other LA users keep 8 channel captures
+void logic_analyzer_set_width(uint8_t width, uint8_t base_pin) {
+    la_next_width = (width == 2 || width == 4) ? width : 1;
+    la_wide_base_pin = base_pin;
+}
+
+uint8_t logic_analyzer_get_width(void) {
+    return la_width;
+}
+
+// return program with every `in pins, 8` changed to the current sample width
+static const struct pio_program* logic_analyzer_program_width(const struct pio_program* program) {
+    if (la_width == 1) {
+        return program;
+    }
+    la_wide_program = *program;
+    la_wide_program.instructions = la_wide_instructions;
+    for (uint8_t i = 0; i < program->length; i++) {
+        uint16_t instr = program->instructions[i];
+        if ((instr & 0xe0e0) == 0x4000) { // IN, source PINS
+            instr = (instr & ~0x1f) | ((la_width * 8) & 0x1f); // 32 bits is encoded as 0
+        }
+        la_wide_instructions[i] = instr;
+    }
+    return &la_wide_program;
+}
+
 uint8_t logic_analyzer_read_ptr(uint32_t read_pointer) {
     return la_buf[read_pointer];
 }
 
+// get a pointer to a contiguous run of samples in the ring, starting at read_pointer
+// returns the length of the run, which stops at the end of the ring buffer.
+// the caller continues from (read_pointer + length) & (LA_BUFFER_SIZE - 1)
+uint32_t logic_analyzer_get_span(uint32_t read_pointer, uint32_t count, const uint8_t** span) {
+    read_pointer &= (LA_BUFFER_SIZE - 1);
+    *span = (const uint8_t*)&la_buf[read_pointer];
+    if (read_pointer + count > LA_BUFFER_SIZE) {
+        return LA_BUFFER_SIZE - read_pointer;
+    }
+    return count;
+}
+
+// select the decimation filter for the next capture, factor input samples per stored sample
+// one shot: logic_analyzer_configure() clears it so other LA users get raw captures
+void logic_analyzer_set_decimation(uint8_t mode, uint32_t factor) {
+    la_decimate_next_mode = (factor > 1) ? mode : LA_DECIMATE_OFF;
+    la_decimate_next_factor = factor;
+}
+
+// true if the filter fell behind the PIO during the last capture and samples were lost
+bool logic_analyzer_decimation_overrun(void) {
+    return la_decimate_overrun;
+}
+
+static inline uint la_stage_channel(uint8_t half) {
+    return half ? la_dma_control_channel : la_dma_data_channel;
+}
+
+static void la_decimate_drain(void) {
+    uint32_t mask = (1u << la_dma_data_channel) | (1u << la_dma_control_channel);
+    uint32_t ints = dma_hw->ints1 & mask;
+    if (!ints) {
+        return;
+    }
+    dma_hw->ints1 = ints;
+    if (ints == mask) {
+        // both halves finished before we got here, one was overwritten
+        la_decimate_overrun = true;
+    }
+    while (ints) {
+        la_decimate_run(&la_decimate,
+                        la_stage[la_stage_next],
+                        LA_DECIMATE_STAGE_SIZE,
+                        (uint8_t*)la_buf,
+                        LA_BUFFER_SIZE - 1,
+                        &la_decimate_write);
+        ints &= ~(1u << la_stage_channel(la_stage_next));
+        la_stage_next ^= 1;
+    }
+}
+
+static void la_decimate_irq_handler(void) {
+    la_decimate_drain();
+}
+
+static void la_decimate_stop_irq(void) {
+    irq_set_enabled(DMA_IRQ_1, false);
+    irq_remove_handler(DMA_IRQ_1, la_decimate_irq_handler);
+}
+
+static void la_decimate_done(void) {
+    la_decimate_stop_irq();
+    la_decimate_drain();
+    // the active half is partly filled
+    uint ch = la_stage_channel(la_stage_next);
+    uint32_t partial = LA_DECIMATE_STAGE_SIZE - dma_channel_hw_addr(ch)->transfer_count;
+    dma_channel_set_irq1_enabled(la_dma_data_channel, false);
+    dma_channel_set_irq1_enabled(la_dma_control_channel, false);
+    dma_channel_abort(la_dma_data_channel);
+    dma_channel_abort(la_dma_control_channel);
+    la_decimate_run(
+        &la_decimate, la_stage[la_stage_next], partial, (uint8_t*)la_buf, LA_BUFFER_SIZE - 1, &la_decimate_write);
+    la_decimate_flush(&la_decimate, (uint8_t*)la_buf, LA_BUFFER_SIZE - 1, &la_decimate_write);
+    la_decimate.mode = LA_DECIMATE_OFF;
+
+    // same convention as the raw path: pointer to the last sample written
+    la_ptr_reset = la_ptr = (la_decimate_write - 1) & (LA_BUFFER_SIZE - 1);
+    if (la_decimate_write >= LA_BUFFER_SIZE) {
+        samples_from_zero = LA_BUFFER_SIZE;
+    } else {
+        samples_from_zero = la_decimate_write ? la_decimate_write - 1 : 0;
+    }
+}
+
 // this will probably need a mutex
 void logic_analyser_done(void) {
     // turn off stuff!
@@ -115,16 +258,24 @@ void logic_analyser_done(void) {
 
     busy_wait_ms(1);
 
+    if (la_decimate.mode != LA_DECIMATE_OFF) {
+        la_decimate_done();
+        if (status_leds_enabled) {
+            rgb_set_all(0x00, 0xff, 0);
+        }
+        la_sm_done = true;
+        return;
+    }
  
     // transfer count is the words remaining in the stalled transfer, dma deincrements on start (-1)
-    int32_t tail = LA_BUFFER_SIZE - dma_channel_hw_addr(la_dma_data_channel)->transfer_count - 1;
+    int32_t tail = (LA_BUFFER_SIZE / la_width) - dma_channel_hw_addr(la_dma_data_channel)->transfer_count - 1;
 
     // add the preceding chunks of DMA to find the location in the array
     // ready to dump
     samples_from_zero = la_ptr_reset = la_ptr = tail;
 
     if(tail==-1){
-        samples_from_zero = LA_BUFFER_SIZE;
+        samples_from_zero = LA_BUFFER_SIZE / la_width;
     }
     if(status_leds_enabled){
         rgb_set_all(0x00, 0xff, 0); //,0x00FF00 green for dump
@@ -155,11 +306,40 @@ bool logic_analyzer_is_done(void) {
     return (la_status == LA_IDLE);
 }
 
+// decimation: both channels read the PIO, each fills one half of la_stage and chains to the other.
+// write address wrapping keeps each channel inside its half if the filter falls behind.
+static void restart_dma_decimate(void) {
+    for (uint8_t half = 0; half < 2; half++) {
+        uint ch = la_stage_channel(half);
+        dma_channel_config c = dma_channel_get_default_config(ch);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, true);
+        channel_config_set_ring(&c, true, LA_DECIMATE_STAGE_BITS);
+        channel_config_set_dreq(&c, pio_get_dreq(pio_config.pio, pio_config.sm, false));
+        channel_config_set_chain_to(&c, la_stage_channel(half ^ 1));
+        dma_channel_configure(
+            ch, &c, la_stage[half], &pio_config.pio->rxf[pio_config.sm], LA_DECIMATE_STAGE_SIZE, false);
+        dma_channel_set_irq1_enabled(ch, true);
+    }
+    la_stage_next = 0;
+    la_decimate_write = 0;
+    la_decimate_overrun = false;
+    dma_hw->ints1 = (1u << la_dma_data_channel) | (1u << la_dma_control_channel);
+    irq_set_exclusive_handler(DMA_IRQ_1, la_decimate_irq_handler);
+    irq_set_enabled(DMA_IRQ_1, true);
+    dma_channel_start(la_dma_data_channel);
+}
+
 void restart_dma() {
     dma_channel_config la_dma_data_config;
     dma_channel_config la_dma_control_config;
     dma_channel_abort(la_dma_control_channel);
     dma_channel_abort(la_dma_data_channel);
+    if (la_decimate.mode != LA_DECIMATE_OFF) {
+        restart_dma_decimate();
+        return;
+    }
     la_dma_data_config = dma_channel_get_default_config(la_dma_data_channel);
     la_dma_control_config = dma_channel_get_default_config(la_dma_control_channel);
 
@@ -173,7 +353,8 @@ void restart_dma() {
                           1,                                         // Halt after each control block
                           false                                      // Don't start yet
     );
-    channel_config_set_transfer_data_size(&la_dma_data_config, DMA_SIZE_8);
+    channel_config_set_transfer_data_size(&la_dma_data_config,
+                                          (la_width == 4) ? DMA_SIZE_32 : ((la_width == 2) ? DMA_SIZE_16 : DMA_SIZE_8));
     channel_config_set_read_increment(&la_dma_data_config, false);
     channel_config_set_write_increment(&la_dma_data_config, true);
     channel_config_set_dreq(
@@ -186,7 +367,7 @@ void restart_dma() {
                           &la_dma_data_config,
                           0,                                   // write address, filled by the control channel
                           &pio_config.pio->rxf[pio_config.sm], // read address
-                          LA_BUFFER_SIZE,                      // size of transfer
+                          LA_BUFFER_SIZE / la_width,           // size of transfer
                           false                                // Don't start yet
     );
 
@@ -202,6 +383,15 @@ uint32_t logic_analyzer_configure(
 
     irq_handler_installed=interrupt;
 
+    la_width = la_next_width;
+    la_next_width = 1;
+    uint8_t base_pin = (la_width > 1) ? la_wide_base_pin : la_base_pin;
+
+    // the decimation filter works on 8 channel samples
+    la_decimate_init(&la_decimate, (la_width == 1) ? la_decimate_next_mode : LA_DECIMATE_OFF, la_decimate_next_factor);
+    la_decimate_next_mode = LA_DECIMATE_OFF;
+    la_decimate_next_factor = 1;
+
     // This can be useful for debugging. The position of sampling always start at the beginning of the buffer
     // restart_dma(); //this moved to below because the PIO isn't yet assigned
 
@@ -214,7 +404,7 @@ uint32_t logic_analyzer_configure(
     uint8_t trigger_pin = 0;
     bool trigger_ok = false;
     if (trigger_mask) {
-        for (uint8_t i = 0; i < 8; i++) {
+        for (uint8_t i = 0; i < la_width * 8; i++) {
             if (trigger_mask & 1u << i) {
                 trigger_pin = i;
                 trigger_ok = true;
@@ -231,26 +421,26 @@ uint32_t logic_analyzer_configure(
         {
             // bool success = pio_claim_free_sm_and_add_program_for_gpio_range(&logicanalyzer_high_trigger_program,
             // &pio_config.pio, &pio_config.sm, &pio_config.offset, LA_BASE_PIN, 8, true); hard_assert(success);
-            pio_config.program = &logicanalyzer_high_trigger_program;
+            pio_config.program = logic_analyzer_program_width(&logicanalyzer_high_trigger_program);
             pio_config.offset = pio_add_program(pio_config.pio, pio_config.program);
             actual_frequency = logicanalyzer_high_trigger_program_init(
-                pio_config.pio, pio_config.sm, pio_config.offset, la_base_pin, la_base_pin + trigger_pin, freq, edge);
+                pio_config.pio, pio_config.sm, pio_config.offset, base_pin, base_pin + trigger_pin, freq, edge, la_width * 8);
         } else // low level trigger program
         {
             // bool success = pio_claim_free_sm_and_add_program_for_gpio_range(&logicanalyzer_low_trigger_program,
             // &pio_config.pio, &pio_config.sm, &pio_config.offset, LA_BASE_PIN, 8, true); hard_assert(success);
-            pio_config.program = &logicanalyzer_low_trigger_program;
+            pio_config.program = logic_analyzer_program_width(&logicanalyzer_low_trigger_program);
             pio_config.offset = pio_add_program(pio_config.pio, pio_config.program);
             actual_frequency = logicanalyzer_low_trigger_program_init(
-                pio_config.pio, pio_config.sm, pio_config.offset, la_base_pin, la_base_pin + trigger_pin, freq, edge);
+                pio_config.pio, pio_config.sm, pio_config.offset, base_pin, base_pin + trigger_pin, freq, edge, la_width * 8);
         }
     } else { // else no trigger program
         // bool success = pio_claim_free_sm_and_add_program_for_gpio_range(&logicanalyzer_no_trigger_program,
         // &pio_config.pio, &pio_config.sm, &pio_config.offset, LA_BASE_PIN, 8, true); hard_assert(success);
-        pio_config.program = &logicanalyzer_no_trigger_program; // move this before to simplify add program
+        pio_config.program = logic_analyzer_program_width(&logicanalyzer_no_trigger_program); // move this before to simplify add program
         pio_config.offset = pio_add_program(pio_config.pio, pio_config.program);
         actual_frequency =
-            logicanalyzer_no_trigger_program_init(pio_config.pio, pio_config.sm, pio_config.offset, la_base_pin, freq);
+            logicanalyzer_no_trigger_program_init(pio_config.pio, pio_config.sm, pio_config.offset, base_pin, freq, la_width * 8);
     }
 #ifdef BP_PIO_SHOW_ASSIGNMENT
     printf("pio %d, sm %d, offset %d\n", PIO_NUM(pio_config.pio), pio_config.sm, pio_config.offset);
@@ -283,6 +473,10 @@ void logic_analyzer_arm(bool led_indicator_enable) {
 }
 
 bool logic_analyzer_cleanup(void) {
+    if (la_decimate.mode != LA_DECIMATE_OFF) {
+        la_decimate_stop_irq();
+        la_decimate.mode = LA_DECIMATE_OFF;
+    }
     dma_channel_cleanup(la_dma_control_channel);
     dma_channel_cleanup(la_dma_data_channel);
     dma_channel_unclaim(la_dma_data_channel);
@@ -302,7 +496,7 @@ bool logic_analyzer_cleanup(void) {
 }
 
 bool logicanalyzer_setup(void) {
-    //note that there isn't any alignment constraint for this buffer
+    //8 bit captures have no alignment constraint, 16/32 bit DMA needs the word alignment mem_alloc provides
     la_buf = mem_alloc(LA_BUFFER_SIZE, 0);
 
 
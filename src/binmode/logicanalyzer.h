@@ -2,6 +2,9 @@
 bool logicanalyzer_setup(void);
 int logicanalyzer_status(void);
 void logic_analyzer_dump(uint8_t* txbuf);
+void logic_analyzer_dump_sample(uint8_t* txbuf);
+void logic_analyzer_set_width(uint8_t width, uint8_t base_pin);
+uint8_t logic_analyzer_get_width(void);
 bool logic_analyzer_is_done(void);
 void logic_analyser_done(void);
 uint32_t logic_analyzer_configure(
@@ -15,6 +18,9 @@ uint32_t logic_analyzer_get_current_ptr(void);
 uint32_t logic_analyzer_get_end_ptr(void);
 void logic_analyzer_reset_ptr(void);
 uint8_t logic_analyzer_read_ptr(uint32_t read_pointer);
+uint32_t logic_analyzer_get_span(uint32_t read_pointer, uint32_t count, const uint8_t** span);
 void logic_analyzer_set_base_pin(uint8_t base_pin);
 uint32_t logic_analyzer_get_samples_from_zero(void);
-uint32_t logic_analyzer_compute_actual_sample_frequency(float desired_frequency, float* div_out);
\ No newline at end of file
+uint32_t logic_analyzer_compute_actual_sample_frequency(float desired_frequency, float* div_out);
+void logic_analyzer_set_decimation(uint8_t mode, uint32_t factor);
+bool logic_analyzer_decimation_overrun(void);
\ No newline at end of file
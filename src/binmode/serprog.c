@@ -0,0 +1,213 @@
+// flashrom serprog binmode
+// SPI flash programming over the binary CDC port with the native serprog protocol.
+// The protocol is parsed in serprog_parser.c, this file connects it to the SPI peripheral
+// and USB. O_SPIOP write data is sent to the bus by DMA straight out of the USB receive
+// buffer while the next packet is received into the other half, read data ping-pongs
+// between two DMA buffers so one is clocked in while the other is queued to USB.
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "pirate.h"
+#include "system_config.h"
+#include "tusb.h"
+#include "pirate/bio.h"
+#include "pirate/hwspi.h"
+#include "pirate/mem.h"
+#include "ui/ui_term.h"
+#include "binmode/serprog_parser.h"
+#include "binmode/serprog.h"
+
+#define CDC_INTF 1
+
+#define SERPROG_RX_SIZE 1024   // each of two USB receive buffers
+#define SERPROG_READ_SIZE 4096 // each of two SPI read buffers
+#define SERPROG_BUFFER_SIZE (2 * SERPROG_RX_SIZE + 2 * SERPROG_READ_SIZE)
+#define SERPROG_DEFAULT_SPEED 1000000
+
+const char serprog_name[] = "Serprog SPI flash programmer (flashrom)";
+
+static const char pin_labels[][5] = { "CLK", "MOSI", "MISO", "CS" };
+
+static uint8_t* serprog_buf;
+static uint8_t* serprog_rx[2];
+static uint8_t* serprog_read[2];
+static uint8_t serprog_rx_cur;
+static bool serprog_dma_busy;
+static serprog_t serprog;
+
+// finish any write still running from the USB receive buffer
+static void serprog_spi_wait(void) {
+    if (serprog_dma_busy) {
+        hwspi_dma_wait();
+        serprog_dma_busy = false;
+    }
+}
+
+static void serprog_cdc_write(const uint8_t* data, uint32_t count) {
+    while (count) {
+        uint32_t n = tud_cdc_n_write(CDC_INTF, data, count);
+        data += n;
+        count -= n;
+        if (count) {
+            tud_task();
+            tud_cdc_n_write_flush(CDC_INTF);
+        }
+    }
+}
+
+static void serprog_cdc_flush(void) {
+    tud_cdc_n_write_flush(CDC_INTF);
+}
+
+static void serprog_spi_select(bool select) {
+    serprog_spi_wait();
+    if (select) {
+        hwspi_select();
+    } else {
+        hwspi_deselect();
+    }
+}
+
+// returns with the transfer running, the parser is done with the span
+// and the service loop receives into the other buffer meanwhile
+static void serprog_spi_write(const uint8_t* data, uint32_t count) {
+    serprog_spi_wait();
+    if (!hwspi_dma_available()) {
+        hwspi_write_read_dma(data, NULL, count);
+        return;
+    }
+    hwspi_dma_start(data, NULL, count);
+    serprog_dma_busy = true;
+}
+
+static void serprog_spi_read(uint32_t count) {
+    uint8_t cur = 0;
+    uint32_t n = (count < SERPROG_READ_SIZE) ? count : SERPROG_READ_SIZE;
+
+    serprog_spi_wait();
+    if (!hwspi_dma_available()) {
+        while (count) {
+            n = (count < SERPROG_READ_SIZE) ? count : SERPROG_READ_SIZE;
+            hwspi_write_read_dma(NULL, serprog_read[0], n);
+            serprog_cdc_write(serprog_read[0], n);
+            count -= n;
+        }
+        return;
+    }
+
+    hwspi_dma_start(NULL, serprog_read[cur], n);
+    while (n) {
+        hwspi_dma_wait();
+        count -= n;
+        uint32_t next = (count < SERPROG_READ_SIZE) ? count : SERPROG_READ_SIZE;
+        if (next) {
+            hwspi_dma_start(NULL, serprog_read[cur ^ 1], next);
+        }
+        serprog_cdc_write(serprog_read[cur], n);
+        cur ^= 1;
+        n = next;
+    }
+}
+
+static uint32_t serprog_spi_freq(uint32_t hz) {
+    serprog_spi_wait();
+    return spi_set_baudrate(M_SPI_PORT, hz);
+}
+
+static void serprog_pins(bool enable) {
+    serprog_spi_wait();
+    if (enable) {
+        hwspi_init(8, 0, 0);
+        return;
+    }
+    // release the bus so another programmer or the target can drive it
+    bio_set_function(M_SPI_CLK, GPIO_FUNC_SIO);
+    bio_set_function(M_SPI_CDO, GPIO_FUNC_SIO);
+    bio_input(M_SPI_CLK);
+    bio_input(M_SPI_CDO);
+    bio_input(M_SPI_CS);
+}
+
+static const serprog_io_t serprog_io = {
+    .write = serprog_cdc_write,
+    .flush = serprog_cdc_flush,
+    .spi_select = serprog_spi_select,
+    .spi_write = serprog_spi_write,
+    .spi_read = serprog_spi_read,
+    .spi_freq = serprog_spi_freq,
+    .pin_state = serprog_pins,
+    .serbuf = 0xffff,
+};
+
+void serprog_setup(void) {
+    system_config.binmode_usb_rx_queue_enable = false;
+    system_config.binmode_usb_tx_queue_enable = false;
+
+    spi_init(M_SPI_PORT, SERPROG_DEFAULT_SPEED);
+    hwspi_init(8, 0, 0);
+    system_bio_update_purpose_and_label(true, M_SPI_CLK, BP_PIN_MODE, pin_labels[0]);
+    system_bio_update_purpose_and_label(true, M_SPI_CDO, BP_PIN_MODE, pin_labels[1]);
+    system_bio_update_purpose_and_label(true, M_SPI_CDI, BP_PIN_MODE, pin_labels[2]);
+    system_bio_update_purpose_and_label(true, M_SPI_CS, BP_PIN_MODE, pin_labels[3]);
+    hwspi_dma_claim(); // without DMA channels transfers fall back to polled IO
+
+    serprog_buf = mem_alloc(SERPROG_BUFFER_SIZE, 0);
+    if (serprog_buf) {
+        serprog_rx[0] = serprog_buf;
+        serprog_rx[1] = serprog_buf + SERPROG_RX_SIZE;
+        serprog_read[0] = serprog_buf + 2 * SERPROG_RX_SIZE;
+        serprog_read[1] = serprog_read[0] + SERPROG_READ_SIZE;
+    }
+    serprog_rx_cur = 0;
+    serprog_dma_busy = false;
+    serprog_init(&serprog, &serprog_io);
+}
+
+void serprog_setup_message(void) {
+    if (!serprog_buf) {
+        printf("%sSerprog: buffer in use, exit the logic analyzer and try again%s\r\n",
+               ui_term_color_error(),
+               ui_term_color_reset());
+        return;
+    }
+    printf("%sSPI flash programmer on the binary COM port, use flashrom -p serprog:dev=<port>%s\r\n",
+           ui_term_color_info(),
+           ui_term_color_reset());
+    printf("%sEnable the power supply (W) before entering binmode if the chip is powered from the Bus Pirate%s\r\n",
+           ui_term_color_info(),
+           ui_term_color_reset());
+}
+
+void serprog_cleanup(void) {
+    serprog_spi_wait();
+    hwspi_dma_unclaim();
+    hwspi_deinit();
+    system_bio_update_purpose_and_label(false, M_SPI_CLK, BP_PIN_MODE, 0);
+    system_bio_update_purpose_and_label(false, M_SPI_CDO, BP_PIN_MODE, 0);
+    system_bio_update_purpose_and_label(false, M_SPI_CDI, BP_PIN_MODE, 0);
+    system_bio_update_purpose_and_label(false, M_SPI_CS, BP_PIN_MODE, 0);
+    if (serprog_buf) {
+        mem_free(serprog_buf);
+        serprog_buf = NULL;
+    }
+    system_config.binmode_usb_rx_queue_enable = true;
+    system_config.binmode_usb_tx_queue_enable = true;
+}
+
+void serprog_service(void) {
+    if (!serprog_buf) {
+        return;
+    }
+    // keep the bus busy while an O_SPIOP streams in, return to the main loop between commands
+    while (tud_cdc_n_available(CDC_INTF)) {
+        uint8_t* buf = serprog_rx[serprog_rx_cur];
+        serprog_rx_cur ^= 1;
+        uint32_t n = tud_cdc_n_read(CDC_INTF, buf, SERPROG_RX_SIZE);
+        serprog_feed(&serprog, buf, n);
+        if (serprog_idle(&serprog)) {
+            break;
+        }
+        tud_task();
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef SERPROG_H
+#define SERPROG_H
+
+// Global variables
+extern const char serprog_name[];
+
+// Function declarations
+void serprog_setup(void);
+void serprog_setup_message(void);
+void serprog_cleanup(void);
+void serprog_service(void);
+
+#endif // SERPROG_H
@@ -0,0 +1,242 @@
+// flashrom serprog protocol parser
+// O_SPIOP write data is handed to the SPI hook straight from the caller's buffer
+// as it arrives, and read data is streamed by the SPI hook, so transfers of any
+// length (flashrom sends whole pages and reads whole chips) never need to fit in RAM.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "binmode/serprog_parser.h"
+
+static const char serprog_pgmname[16] = "BusPirate";
+
+// parameter bytes that follow each supported command, 0xff if not supported
+static uint8_t serprog_arg_length(uint8_t cmd) {
+    switch (cmd) {
+        case S_CMD_NOP:
+        case S_CMD_Q_IFACE:
+        case S_CMD_Q_CMDMAP:
+        case S_CMD_Q_PGMNAME:
+        case S_CMD_Q_SERBUF:
+        case S_CMD_Q_BUSTYPE:
+        case S_CMD_Q_CHIPSIZE:
+        case S_CMD_Q_OPBUF:
+        case S_CMD_Q_WRNMAXLEN:
+        case S_CMD_SYNCNOP:
+        case S_CMD_Q_RDNMAXLEN:
+            return 0;
+        case S_CMD_S_BUSTYPE:
+        case S_CMD_S_PIN_STATE:
+        case S_CMD_S_SPI_CS:
+            return 1;
+        case S_CMD_S_SPI_FREQ:
+            return 4;
+        case S_CMD_O_SPIOP:
+            return 6;
+        default:
+            return 0xff;
+    }
+}
+
+static void serprog_reply(serprog_t* s, const uint8_t* data, uint32_t count) {
+    s->io->write(data, count);
+    s->io->flush();
+}
+
+static void serprog_ack_u16(serprog_t* s, uint16_t value) {
+    uint8_t r[3] = { SERPROG_ACK, value & 0xff, value >> 8 };
+    serprog_reply(s, r, sizeof(r));
+}
+
+static void serprog_ack_u24(serprog_t* s, uint32_t value) {
+    uint8_t r[4] = { SERPROG_ACK, value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff };
+    serprog_reply(s, r, sizeof(r));
+}
+
+static void serprog_ack_u8(serprog_t* s, uint8_t value) {
+    uint8_t r[2] = { SERPROG_ACK, value };
+    serprog_reply(s, r, sizeof(r));
+}
+
+static void serprog_ack(serprog_t* s) {
+    uint8_t r = SERPROG_ACK;
+    serprog_reply(s, &r, 1);
+}
+
+static void serprog_nak(serprog_t* s) {
+    uint8_t r = SERPROG_NAK;
+    serprog_reply(s, &r, 1);
+}
+
+static uint32_t serprog_le24(const uint8_t* b) {
+    return b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16);
+}
+
+static void serprog_cmdmap(serprog_t* s) {
+    uint8_t r[33];
+    memset(r, 0, sizeof(r));
+    r[0] = SERPROG_ACK;
+    for (uint32_t cmd = 0; cmd < 256; cmd++) {
+        if (serprog_arg_length(cmd) != 0xff) {
+            r[1 + (cmd >> 3)] |= 1u << (cmd & 7);
+        }
+    }
+    serprog_reply(s, r, sizeof(r));
+}
+
+// write phase done: ACK, then the read data follows directly
+static void serprog_spiop_finish(serprog_t* s) {
+    uint8_t r = SERPROG_ACK;
+    s->io->write(&r, 1);
+    if (s->read_len) {
+        s->io->spi_read(s->read_len);
+    }
+    s->io->spi_select(false);
+    s->io->flush();
+    s->state = SERPROG_STATE_CMD;
+}
+
+static void serprog_spiop_start(serprog_t* s) {
+    s->write_remain = serprog_le24(&s->args[0]);
+    s->read_len = serprog_le24(&s->args[3]);
+    s->io->spi_select(true);
+    if (s->write_remain) {
+        s->state = SERPROG_STATE_SPI_WRITE;
+    } else {
+        serprog_spiop_finish(s);
+    }
+}
+
+static void serprog_execute(serprog_t* s) {
+    s->state = SERPROG_STATE_CMD;
+    switch (s->cmd) {
+        case S_CMD_NOP:
+            serprog_ack(s);
+            break;
+        case S_CMD_Q_IFACE:
+            serprog_ack_u16(s, SERPROG_IFACE_VERSION);
+            break;
+        case S_CMD_Q_CMDMAP:
+            serprog_cmdmap(s);
+            break;
+        case S_CMD_Q_PGMNAME: {
+            uint8_t r[17];
+            r[0] = SERPROG_ACK;
+            memcpy(&r[1], serprog_pgmname, sizeof(serprog_pgmname));
+            serprog_reply(s, r, sizeof(r));
+            break;
+        }
+        case S_CMD_Q_SERBUF:
+            // USB has flow control, the host can't overrun us
+            serprog_ack_u16(s, s->io->serbuf > 0xffff ? 0xffff : s->io->serbuf);
+            break;
+        case S_CMD_Q_BUSTYPE:
+            serprog_ack_u8(s, SERPROG_BUS_SPI);
+            break;
+        case S_CMD_Q_CHIPSIZE:
+            // 2^24 bytes, the most a 24 bit address can reach
+            serprog_ack_u8(s, 24);
+            break;
+        case S_CMD_Q_OPBUF:
+            // parallel/LPC/FWH op buffering is not supported, SPI ops execute immediately
+            serprog_ack_u16(s, 0);
+            break;
+        case S_CMD_Q_WRNMAXLEN:
+        case S_CMD_Q_RDNMAXLEN:
+            // 0 means 2^24, O_SPIOP data is streamed so there is no practical limit
+            serprog_ack_u24(s, 0);
+            break;
+        case S_CMD_SYNCNOP: {
+            uint8_t r[2] = { SERPROG_NAK, SERPROG_ACK };
+            serprog_reply(s, r, sizeof(r));
+            break;
+        }
+        case S_CMD_S_BUSTYPE:
+            // SPI is the only bus, it is always selected
+            if (s->args[0] & SERPROG_BUS_SPI) {
+                serprog_ack(s);
+            } else {
+                serprog_nak(s);
+            }
+            break;
+        case S_CMD_O_SPIOP:
+            serprog_spiop_start(s);
+            break;
+        case S_CMD_S_SPI_FREQ: {
+            uint32_t hz = s->args[0] | ((uint32_t)s->args[1] << 8) | ((uint32_t)s->args[2] << 16) |
+                          ((uint32_t)s->args[3] << 24);
+            if (!hz) {
+                serprog_nak(s);
+                break;
+            }
+            hz = s->io->spi_freq(hz);
+            uint8_t r[5] = { SERPROG_ACK, hz & 0xff, (hz >> 8) & 0xff, (hz >> 16) & 0xff, hz >> 24 };
+            serprog_reply(s, r, sizeof(r));
+            break;
+        }
+        case S_CMD_S_PIN_STATE:
+            s->io->pin_state(s->args[0] != 0);
+            serprog_ack(s);
+            break;
+        case S_CMD_S_SPI_CS:
+            // a single chip select
+            if (s->args[0] == 0) {
+                serprog_ack(s);
+            } else {
+                serprog_nak(s);
+            }
+            break;
+        default:
+            serprog_nak(s);
+            break;
+    }
+}
+
+void serprog_init(serprog_t* s, const serprog_io_t* io) {
+    memset(s, 0, sizeof(*s));
+    s->io = io;
+    s->state = SERPROG_STATE_CMD;
+}
+
+// true between commands, no O_SPIOP is half way through
+bool serprog_idle(const serprog_t* s) {
+    return s->state == SERPROG_STATE_CMD;
+}
+
+void serprog_feed(serprog_t* s, const uint8_t* data, uint32_t count) {
+    while (count) {
+        if (s->state == SERPROG_STATE_SPI_WRITE) {
+            // pass the whole span through, no per byte work
+            uint32_t n = (count < s->write_remain) ? count : s->write_remain;
+            s->io->spi_write(data, n);
+            data += n;
+            count -= n;
+            s->write_remain -= n;
+            if (!s->write_remain) {
+                serprog_spiop_finish(s);
+            }
+            continue;
+        }
+
+        uint8_t c = *data++;
+        count--;
+
+        if (s->state == SERPROG_STATE_CMD) {
+            s->cmd = c;
+            s->arg_count = 0;
+            s->arg_total = serprog_arg_length(c);
+            if (s->arg_total == 0xff) {
+                serprog_nak(s);
+            } else if (s->arg_total == 0) {
+                serprog_execute(s);
+            } else {
+                s->state = SERPROG_STATE_ARGS;
+            }
+            continue;
+        }
+
+        s->args[s->arg_count++] = c;
+        if (s->arg_count == s->arg_total) {
+            serprog_execute(s);
+        }
+    }
+}
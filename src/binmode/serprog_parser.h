@@ -0,0 +1,70 @@
+#ifndef SERPROG_PARSER_H
+#define SERPROG_PARSER_H
+
+// flashrom serprog protocol parser
+// Pure C, no hardware dependencies: bytes from the host are fed in spans of any size,
+// SPI and USB access goes through the hooks in serprog_io_t so the parser
+// can be driven by a test harness on a host.
+// Protocol reference: flashrom Documentation/serprog-protocol.txt
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SERPROG_ACK 0x06
+#define SERPROG_NAK 0x15
+
+#define SERPROG_IFACE_VERSION 0x0001
+#define SERPROG_BUS_SPI 0x08
+
+enum serprog_cmd {
+    S_CMD_NOP = 0x00,        // no operation
+    S_CMD_Q_IFACE = 0x01,    // query interface version
+    S_CMD_Q_CMDMAP = 0x02,   // query supported commands bitmap
+    S_CMD_Q_PGMNAME = 0x03,  // query programmer name
+    S_CMD_Q_SERBUF = 0x04,   // query serial buffer size
+    S_CMD_Q_BUSTYPE = 0x05,  // query supported bustypes
+    S_CMD_Q_CHIPSIZE = 0x06, // query supported chipsize (2^n format)
+    S_CMD_Q_OPBUF = 0x07,    // query operation buffer size
+    S_CMD_Q_WRNMAXLEN = 0x08, // query maximum write-n length
+    S_CMD_SYNCNOP = 0x10,    // special no-operation that returns NAK+ACK
+    S_CMD_Q_RDNMAXLEN = 0x11, // query maximum read-n length
+    S_CMD_S_BUSTYPE = 0x12,  // set used bustype(s)
+    S_CMD_O_SPIOP = 0x13,    // perform SPI operation
+    S_CMD_S_SPI_FREQ = 0x14, // set SPI clock frequency
+    S_CMD_S_PIN_STATE = 0x15, // enable/disable output drivers
+    S_CMD_S_SPI_CS = 0x16,   // select chip select line
+};
+
+// hardware hooks, all are called from serprog_feed()
+typedef struct {
+    void (*write)(const uint8_t* data, uint32_t count); // queue response bytes to the host
+    void (*flush)(void);                                  // response complete, push it out
+    void (*spi_select)(bool select);                      // assert/release the chip select
+    void (*spi_write)(const uint8_t* data, uint32_t count); // clock out, read data discarded
+    void (*spi_read)(uint32_t count);                     // clock in count bytes and write() them
+    uint32_t (*spi_freq)(uint32_t hz);                    // set the clock, returns the actual frequency
+    void (*pin_state)(bool enable);                       // enable/disable the output drivers
+    uint32_t serbuf;                                      // reported serial buffer size
+} serprog_io_t;
+
+enum serprog_state {
+    SERPROG_STATE_CMD = 0, // waiting for a command byte
+    SERPROG_STATE_ARGS,    // collecting fixed length parameters
+    SERPROG_STATE_SPI_WRITE, // streaming O_SPIOP write data to the SPI bus
+};
+
+typedef struct {
+    const serprog_io_t* io;
+    uint8_t state;       // enum serprog_state
+    uint8_t cmd;         // command being parsed
+    uint8_t args[6];     // fixed length parameters
+    uint8_t arg_count;   // parameter bytes received
+    uint8_t arg_total;   // parameter bytes expected
+    uint32_t write_remain; // O_SPIOP bytes still to arrive from the host
+    uint32_t read_len;   // O_SPIOP bytes to clock in after the write phase
+} serprog_t;
+
+void serprog_init(serprog_t* s, const serprog_io_t* io);
+void serprog_feed(serprog_t* s, const uint8_t* data, uint32_t count);
+bool serprog_idle(const serprog_t* s);
+
+#endif // SERPROG_PARSER_H
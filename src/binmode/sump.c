@@ -57,7 +57,7 @@
 #define CDC_INTF 1
 
 #define SAMPLING_DIVIDER 2 // minimal sysclk sampling divider. For Bus Pirate with PIO max speed is /2
-#define SAMPLING_BITS 8
+#define SAMPLING_BITS 16
 #define SAMPLING_BYTES ((SAMPLING_BITS + 7) / 8)
 #define SUMP_MEMORY_SIZE 32768 * 4 // 100kB
 
@@ -70,6 +70,16 @@
 
 #define ONE_MHZ 1000000u
 
+/*
+ * Channel groups
+ * 8 bit captures read the IO pins from the logic analyzer base pin.
+ * Wider captures read consecutive GPIOs from BUFDIR0: byte 0 is the buffer
+ * direction (1 = output), byte 1 the IO pins, bytes 2-3 raw GPIO 16-31.
+ * Group 0 is always the IO pins, so enabling more groups doesn't move channels.
+ */
+#define SUMP_WIDE_BASE_PIN BUFDIR0
+static const uint8_t sump_group_byte[4] = { 1, 0, 2, 3 };
+
 struct _trigger {
     uint32_t mask;
     uint32_t value;
@@ -88,6 +98,8 @@ static struct _sump {
     uint8_t cmd_pos;        // command buffer position
     volatile uint8_t state; // SUMP_STATE_*
     uint8_t width;          // in bytes, 1 = 8 bits, 2 = 16 bits
+    uint8_t groups;         // enabled channel groups, bit 0 = group 0
+    uint8_t capture_width;  // bytes per captured sample: 1, 2 or 4
     uint8_t trigger_index;
     uint32_t pio_prog_offset;
     uint32_t read_start;
@@ -200,6 +212,21 @@ static uint32_t sump_calc_sysclk_divider()
     return v;
 }*/
 
+// move trigger bits from SUMP channel order to the captured pin order
+static uint32_t sump_capture_bits(uint32_t val) {
+    uint32_t out = 0;
+    if (sump.capture_width == 1) {
+        return val & 0xff;
+    }
+    for (uint8_t g = 0; g < 4; g++) {
+        uint8_t byte = sump_group_byte[g];
+        if (byte < sump.capture_width) {
+            out |= ((val >> (g * 8)) & 0xff) << (byte * 8);
+        }
+    }
+    return out;
+}
+
 static void sump_do_run(void) {
     uint8_t state;
     uint32_t i, tmask = 0;
@@ -212,6 +239,15 @@ static void sump_do_run(void) {
         return;
     }
 
+    // wider samples leave fewer of them in the buffer
+    uint32_t depth = (SUMP_MEMORY_SIZE) / sump.capture_width;
+    if (sump.read_count > depth) {
+        sump.read_count = depth;
+    }
+    if (sump.delay_count > depth) {
+        sump.delay_count = depth;
+    }
+
     for (i = 0; i < count_of(sump.trigger); i++) {
         tstart |= sump.trigger[i].start; // is one group of trigger channels enabled
         tmask |= sump.trigger[i].mask;   // is a value actually masked?
@@ -233,7 +269,13 @@ static void sump_do_run(void) {
         sump.state = SUMP_STATE_SAMPLING;
     }
 
-    logic_analyzer_configure(freq, sump.delay_count, sump.trigger[0].mask, trigger_value, edge, true);
+    logic_analyzer_set_width(sump.capture_width, SUMP_WIDE_BASE_PIN);
+    logic_analyzer_configure(freq,
+                             sump.delay_count,
+                             sump_capture_bits(sump.trigger[0].mask),
+                             sump_capture_bits(trigger_value),
+                             edge,
+                             true);
     logic_analyzer_arm(true);
     return;
 }
@@ -265,22 +307,25 @@ static void sump_do_reset(void) {
 }
 
 static void sump_set_flags(uint32_t flags) {
-    uint8_t width;
+    uint8_t width = 0;
+    uint8_t highest = 0;
 
     sump.flags = flags;
-    width = 2;
-    if (flags & SUMP_FLAG1_GR0_DISABLE) {
-        width--;
-    }
-    if (flags & SUMP_FLAG1_GR1_DISABLE) {
-        width--;
-    }
-    // we don't support 24-bit or 32-bit capture - sorry
-    if ((flags & SUMP_FLAG1_GR2_DISABLE) == 0) {
-        width = 0;
+    sump.groups = (~flags & SUMP_FLAG1_GR_MASK) >> SUMP_FLAG1_GR_SHIFT;
+    for (uint8_t g = 0; g < 4; g++) {
+        if (sump.groups & (1u << g)) {
+            width++;
+            highest = g;
+        }
     }
-    if ((flags & SUMP_FLAG1_GR3_DISABLE) == 0) {
-        width = 0;
+    // only enabled groups are sent, the capture covers the highest one
+    // and trades buffer depth for width
+    if (sump.groups == 0x01) {
+        sump.capture_width = 1;
+    } else if (highest <= 1) {
+        sump.capture_width = 2;
+    } else {
+        sump.capture_width = 4;
     }
     // printf("%s(): sample %u bytes\n", __func__, width);
     sump.width = width;
@@ -432,15 +477,16 @@ static uint sump_tx_empty(uint8_t* buf, uint len) {
     count = sump.read_count;
     // printf("%s: count=%u\n", __func__, count);
     a = 0x55;
-    if (sump.width == 1) {
-        for (i = 0; i < len && count > 0; count--, i++) {
+    if (sump.width == 0) {
+        return 0;
+    }
+    for (i = 0; i + sump.width <= len && count > 0; count--) {
+        for (uint8_t b = 0; b < sump.width; b++, i++) {
             *buf++ = a;
-            a ^= 0xff;
         }
-        sump.read_count -= i;
-    } else {
-        return 0;
+        a ^= 0xff;
     }
+    sump.read_count = count;
     ////printf("%s: ret=%u\n", __func__, i);
     return i;
 }
@@ -463,6 +509,24 @@ static uint sump_tx8(uint8_t* buf, uint len) {
     return i;
 }
 
+// wide samples: send the bytes of the enabled groups, lowest group first
+static uint sump_tx_wide(uint8_t* buf, uint len) {
+    uint32_t i, count;
+    uint8_t sample[4];
+
+    count = sump.read_count;
+    for (i = 0; i + sump.width <= len && count > 0; count--) {
+        logic_analyzer_dump_sample(sample);
+        for (uint8_t g = 0; g < 4; g++) {
+            if (sump.groups & (1u << g)) {
+                buf[i++] = sample[sump_group_byte[g]];
+            }
+        }
+    }
+    sump.read_count = count;
+    return i;
+}
+
 static uint sump_fill_tx(uint8_t* buf, uint len) {
     uint ret;
 
@@ -474,8 +538,10 @@ static uint sump_fill_tx(uint8_t* buf, uint len) {
         return 0;
     }
     if (sump.state == SUMP_STATE_DUMP) {
-        if (sump.width == 1) {
+        if (sump.capture_width == 1) {
             ret = sump_tx8(buf, len);
+        } else if (sump.width) {
+            ret = sump_tx_wide(buf, len);
         } else {
             // invalid
             ret = sump_tx_empty(buf, len);
@@ -499,6 +565,8 @@ static void cdc_sump_init_connect(void) {
     memset(&sump, 0, sizeof(sump));
     sump.pio_prog_offset = pio_off;
     sump.width = 1;
+    sump.groups = 0x01;
+    sump.capture_width = 1;
     sump.divider = 1000; // a safe value
     sump.read_count = 256;
     sump.delay_count = 256;
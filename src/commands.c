@@ -43,6 +43,10 @@
 #include "commands/global/otpdump.h"
 #endif
 #include "commands/global/ovrclk.h"
+#include "commands/global/perf.h"
+#ifdef BP_HW_STORAGE_NAND
+#include "commands/global/cmd_nand.h"
+#endif
 
 // command configuration
 const struct _global_command_struct commands[] = {
@@ -100,6 +104,10 @@ const struct _global_command_struct commands[] = {
 { .command="otpdump",   .allow_hiz=true,  .func=&otpdump_handler,                    .help_text=0x00 },
 #endif
 { .command="ovrclk",    .allow_hiz=true,  .func=&ovrclk_handler,                     .help_text=0x00 },
+{ .command="perf",      .allow_hiz=true,  .func=&perf_handler,                       .help_text=0x00 },
+#ifdef BP_HW_STORAGE_NAND
+{ .command="nand",      .allow_hiz=true,  .func=&cmd_nand_handler,                   .help_text=0x00 },
+#endif
     // clang-format on
 };
 
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pirate.h"
+#include "system_config.h"
+#include "command_struct.h"
+#include "msc_disk.h"
+#include "pirate/mem.h"
+#include "nand/spi_nand.h"
+#include "ui/ui_cmdln.h"
+#include "ui/ui_help.h"
+#include "commands/global/cmd_nand.h"
+
+#define NAND_BENCH_PAGES 64 // default, one erase block
+
+static const char* const usage[] = {
+    "nand bench [-p <pages>]",
+    "Page read and program load speed: nand bench",
+    "Time 256 pages: nand bench -p 256",
+    "Program load fills the NAND cache but does not program it, the flash contents are not changed",
+};
+
+static const struct ui_help_options options[] = {
+    { 0, "-h", T_HELP_FLAG },
+};
+
+// bytes in us as MB/s with two decimals
+static void nand_bench_print(const char* name, uint32_t pages, uint64_t us) {
+    uint32_t kbps = us ? (uint32_t)((uint64_t)pages * SPI_NAND_PAGE_SIZE * 1000 / us) : 0;
+    printf("%s: %d pages in %dus, %d.%02d MB/s, %dus per page\r\n",
+           name,
+           pages,
+           (uint32_t)us,
+           kbps / 1000,
+           (kbps % 1000) / 10,
+           (uint32_t)(us / pages));
+}
+
+static void nand_bench(uint32_t pages) {
+    uint8_t* buf = mem_alloc(SPI_NAND_PAGE_SIZE, BP_BIG_BUFFER_NANDBENCH);
+    if (!buf) {
+        printf("\r\n");
+        return;
+    }
+
+    // keep the host off the flash while the cache is in use, leave it out if it already was
+    bool reinsert = !usbmsdrive_is_ejected();
+    if (reinsert) {
+        eject_usbmsdrive();
+    }
+
+    int ret = SPI_NAND_RET_OK;
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < pages; i++) {
+        row_address_t row = { .whole = i };
+        ret = spi_nand_page_read(row, 0, buf, SPI_NAND_PAGE_SIZE);
+        // ECC results are fine for timing, bus errors are not
+        if (ret == SPI_NAND_RET_BAD_SPI || ret == SPI_NAND_RET_TIMEOUT) {
+            break;
+        }
+    }
+    uint64_t read_us = time_us_64() - start;
+
+    if (ret != SPI_NAND_RET_BAD_SPI && ret != SPI_NAND_RET_TIMEOUT) {
+        start = time_us_64();
+        for (uint32_t i = 0; i < pages; i++) {
+            row_address_t row = { .whole = i };
+            ret = spi_nand_page_load(row, 0, buf, SPI_NAND_PAGE_SIZE);
+            if (ret != SPI_NAND_RET_OK) {
+                break;
+            }
+        }
+    }
+    uint64_t load_us = time_us_64() - start;
+
+    if (reinsert) {
+        insert_usbmsdrive();
+    }
+    mem_free(buf);
+
+    if (ret == SPI_NAND_RET_BAD_SPI || ret == SPI_NAND_RET_TIMEOUT) {
+        printf("NAND bench failed, error %d\r\n", ret);
+        return;
+    }
+    nand_bench_print("Page read (array to cache and bus)", pages, read_us);
+    nand_bench_print("Program load (bus only)", pages, load_us);
+}
+
+void cmd_nand_handler(struct command_result* res) {
+    if (ui_help_show(res->help_flag, usage, count_of(usage), &options[0], count_of(options))) {
+        return;
+    }
+
+    char action[6];
+    if (!cmdln_args_string_by_position(1, sizeof(action), action) || strcmp(action, "bench") != 0) {
+        ui_help_show(true, usage, count_of(usage), &options[0], count_of(options));
+        res->error = true;
+        return;
+    }
+
+    if (!spi_nand_ready()) {
+        printf("NAND flash not found\r\n");
+        res->error = true;
+        return;
+    }
+
+    command_var_t arg;
+    uint32_t pages;
+    if (!cmdln_args_find_flag_uint32('p', &arg, &pages)) {
+        pages = NAND_BENCH_PAGES;
+    }
+    if (pages == 0 || pages > 1024) {
+        printf("Pages must be 1 to 1024\r\n");
+        res->error = true;
+        return;
+    }
+    nand_bench(pages);
+}
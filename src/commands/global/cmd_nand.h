@@ -0,0 +1 @@
+void cmd_nand_handler(struct command_result* res);
@@ -10,19 +10,33 @@
 #include "ui/ui_cmdln.h"
 #include "pirate/button.h"
 #include "binmode/fala.h"
+#include "binmode/falafile.h"
+#include "decode/la_decode.h"
+#include "fatfs/ff.h"
+#include "pirate/storage.h"
 #include "toolbars/logic_bar.h"
 #include "binmode/logicanalyzer.h"
+#include "binmode/la_decimate.h"
+#include "bytecode.h"
+#include "modes.h"
 
 static const char* const usage[] = {
     "logic analyzer usage",
-    "logic\t[start|stop|hide|show|nav]",
-    "\t[-i] [-g] [-o oversample] [-f frequency] [-d debug]",
+    "logic\t[start|stop|hide|show|nav|decode]",
+    "\t[-i] [-g] [-o oversample] [-f frequency] [-d debug] [-w vcd|sr|off]",
+    "\t[-m glitch|majority|off]",
     "start logic analyzer: logic start",
     "stop logic analyzer: logic stop",
     "hide logic analyzer: logic hide",
     "show logic analyzer: logic show",
     "navigate logic analyzer: logic nav",
+    "decode last capture: logic decode [i2c|spi|uart|1wire|off] [-p pins] [-s file] [-r baud] [-c cpol] [-e cpha]",
+    "decode I2C with SDA=IO2, SCL=IO3, save to file: logic decode i2c -p 2,3 -s i2c.txt",
+    "decode UART at 9600 baud: logic decode uart -r 9600",
+    "decode SPI mode 3 (CPOL=1, CPHA=1): logic decode spi -c 1 -e 1",
     "configure logic analyzer: logic -i -o 8 -f 1000000 -d 0",
+    "save every capture to storage (VCD or sigrok): logic -w vcd",
+    "sample at 8x, store 1x keeping glitches: logic -o 8 -m glitch",
     #if (BP_VER == 5 || BP_VER == XL5)
         "undocumented: set base pin (0=bufdir, 8=bufio) -b: logic -b 8",
     #elif (BP_VER == 6 || BP_VER == 7)
@@ -40,6 +54,7 @@ static const struct ui_help_options options[] = {
     { 0, "hide", T_HELP_LOGIC_HIDE },   // hide
     { 0, "show", T_HELP_LOGIC_SHOW },   // show
     { 0, "nav", T_HELP_LOGIC_NAV },     // navigate
+    { 0, "decode", T_HELP_LOGIC_DECODE }, // decode
     // config options
     { 0, "-i", T_HELP_LOGIC_INFO },       // info
     { 0, "-o", T_HELP_LOGIC_OVERSAMPLE }, // oversample
@@ -47,9 +62,157 @@ static const struct ui_help_options options[] = {
     { 0, "-0", T_HELP_LOGIC_LOW_CHAR },   // low char
     { 0, "-1", T_HELP_LOGIC_HIGH_CHAR },  // high char
     { 0, "-d", T_HELP_LOGIC_DEBUG },      // debug
+    { 0, "-w", T_HELP_LOGIC_WRITE },      // write captures to file
+    { 0, "-m", T_HELP_LOGIC_FILTER },     // decimation filter
     { 0, "-h", T_HELP_FLAG },
 };
 
+// UART baud when not in UART mode and -r is not given
+#define LOGIC_DECODE_DEFAULT_BAUD 115200
+
+// decoder shared with the logic bar, which labels frames on the graph
+static la_decoder_t logic_decoder;
+
+// default channels follow the pin assignment of the matching mode
+static const uint8_t logic_decode_default_pins[LA_DECODE_COUNT][LA_DECODE_MAX_PINS] = {
+    [LA_DECODE_I2C] = { M_I2C_SDA, M_I2C_SCL, LA_DECODE_PIN_NONE, LA_DECODE_PIN_NONE },
+    [LA_DECODE_SPI] = { M_SPI_CLK, M_SPI_CDO, M_SPI_CDI, M_SPI_CS },
+    [LA_DECODE_UART] = { M_UART_RX, LA_DECODE_PIN_NONE, LA_DECODE_PIN_NONE, LA_DECODE_PIN_NONE },
+    [LA_DECODE_1WIRE] = { M_OW_OWD, LA_DECODE_PIN_NONE, LA_DECODE_PIN_NONE, LA_DECODE_PIN_NONE },
+};
+
+static void logic_decode_print(const la_decoder_t* d, const la_decode_frame_t* frame) {
+    char line[48];
+    uint32_t len = snprintf(line, sizeof(line), "%8d %-8s", frame->start, la_decode_frame_name(frame->type));
+    switch (frame->type) {
+        case LA_FRAME_ADDR:
+            len += snprintf(&line[len], sizeof(line) - len, " 0x%02X %c", frame->value >> 1, (frame->value & 1) ? 'R' : 'W');
+            break;
+        case LA_FRAME_DATA:
+        case LA_FRAME_ERROR:
+            len += snprintf(&line[len], sizeof(line) - len, " 0x%02X", frame->value);
+            if (d->protocol == LA_DECODE_SPI) {
+                len += snprintf(&line[len], sizeof(line) - len, " (0x%02X)", frame->value2);
+            }
+            break;
+    }
+    len += snprintf(&line[len], sizeof(line) - len, "\r\n");
+
+    if (d->ctx) {
+        UINT bw;
+        f_write((FIL*)d->ctx, line, len, &bw);
+    } else {
+        printf("%s", line);
+    }
+}
+
+static void logic_decode(struct command_result* res) {
+    char protocol_str[7];
+    if (!cmdln_args_string_by_position(2, sizeof(protocol_str), protocol_str)) {
+        printf("Specify a protocol: i2c, spi, uart, 1wire, off\r\n");
+        res->error = true;
+        return;
+    }
+
+    if (strcmp(protocol_str, "off") == 0) {
+        logic_bar_set_decoder(NULL);
+        printf("Decoder disabled\r\n");
+        return;
+    }
+
+    int protocol = la_decode_find_protocol(protocol_str);
+    if (protocol == LA_DECODE_NONE) {
+        printf("Error: unknown protocol '%s'\r\n", protocol_str);
+        res->error = true;
+        return;
+    }
+
+    memcpy(logic_decoder.pins, logic_decode_default_pins[protocol], sizeof(logic_decoder.pins));
+    command_var_t arg;
+    char pins_str[12];
+    if (cmdln_args_find_flag_string('p', &arg, sizeof(pins_str), pins_str)) {
+        // comma separated channel list, order is protocol specific
+        uint8_t pin = 0;
+        for (char* c = pins_str; *c && pin < la_decode_protocols[protocol]->pin_count; c++) {
+            if (*c >= '0' && *c <= '7') {
+                logic_decoder.pins[pin++] = *c - '0';
+            }
+        }
+    }
+
+    // SPI clock polarity and phase, mode 0 unless given
+    uint32_t cpol = 0, cpha = 0;
+    if (cmdln_args_find_flag_uint32('c', &arg, &cpol) && cpol > 1) {
+        printf("Error: CPOL must be 0 or 1, '%d' is invalid\r\n", cpol);
+        res->error = true;
+        return;
+    }
+    if (cmdln_args_find_flag_uint32('e', &arg, &cpha) && cpha > 1) {
+        printf("Error: CPHA must be 0 or 1, '%d' is invalid\r\n", cpha);
+        res->error = true;
+        return;
+    }
+
+    // UART baud, kept apart from the sample frequency which logic -f changes
+    uint32_t baud = LOGIC_DECODE_DEFAULT_BAUD;
+#ifdef BP_USE_HWUART
+    if (system_config.mode == HWUART) {
+        baud = modes[system_config.mode].protocol_get_speed();
+    }
+#endif
+    if (cmdln_args_find_flag_uint32('r', &arg, &baud) && baud == 0) {
+        printf("Error: baud rate must be greater than 0\r\n");
+        res->error = true;
+        return;
+    }
+
+    logic_decoder.spi_cpol = cpol;
+    logic_decoder.spi_cpha = cpha;
+    logic_decoder.sample_rate = fala_config.actual_sample_frequency;
+    logic_decoder.bit_rate = baud;
+    la_decode_init(&logic_decoder, protocol, &logic_decode_print, NULL);
+    logic_bar_set_decoder(&logic_decoder);
+
+    if (!fala_has_hook()) {
+        printf("Decoder set, start the logic analyzer to capture data\r\n");
+        return;
+    }
+
+    uint32_t count = logic_analyzer_get_samples_from_zero();
+    if (count == 0 || count > LA_BUFFER_SIZE) {
+        printf("No samples to decode\r\n");
+        return;
+    }
+    uint32_t start = (logic_analyzer_get_end_ptr() - count + 1) & (LA_BUFFER_SIZE - 1);
+
+    char file[13];
+    FIL fil;
+    if (cmdln_args_find_flag_string('s', &arg, sizeof(file), file)) {
+        FRESULT fr = f_open(&fil, file, FA_WRITE | FA_CREATE_ALWAYS);
+        if (fr != FR_OK) {
+            storage_file_error(fr);
+            printf("\r\n");
+            res->error = true;
+            return;
+        }
+        logic_decoder.ctx = &fil;
+    }
+
+    la_decode_run(&logic_decoder, &logic_analyzer_get_span, start, count);
+
+    if (logic_decoder.ctx) {
+        logic_decoder.ctx = NULL;
+        FRESULT fr = f_close(&fil);
+        if (fr != FR_OK) {
+            storage_file_error(fr);
+            printf("\r\n");
+            res->error = true;
+            return;
+        }
+        printf("Decoded %d samples to %s\r\n", count, file);
+    }
+}
+
 void logic_handler(struct command_result* res) {
     static bool logic_active = false;
     static bool logic_visible = false;
@@ -59,7 +222,8 @@ void logic_handler(struct command_result* res) {
     }
 
     char action_str[9];
-    bool verb_start = false, verb_stop = false, verb_hide = false, verb_show = false, verb_nav = false;
+    bool verb_start = false, verb_stop = false, verb_hide = false, verb_show = false, verb_nav = false,
+         verb_decode = false;
     if (cmdln_args_string_by_position(1, sizeof(action_str), action_str)) {
         if (strcmp(action_str, "start") == 0) {
             verb_start = true;
@@ -76,6 +240,14 @@ void logic_handler(struct command_result* res) {
         if (strcmp(action_str, "nav") == 0) {
             verb_nav = true;
         }
+        if (strcmp(action_str, "decode") == 0) {
+            verb_decode = true;
+        }
+    }
+
+    if (verb_decode) {
+        logic_decode(res);
+        return;
     }
 
     if (verb_nav) {
@@ -157,6 +329,10 @@ void logic_handler(struct command_result* res) {
     bool has_high_char = cmdln_args_find_flag_string('1', &arg, sizeof(high_char), high_char); // high: set high char
     uint32_t base_channel;
     bool has_base_channel = cmdln_args_find_flag_uint32('b', &arg, &base_channel); // base channel: set base channel
+    char write_format[4];
+    bool has_write = cmdln_args_find_flag_string('w', &arg, sizeof(write_format), write_format); // write: save captures
+    char filter[9];
+    bool has_filter = cmdln_args_find_flag_string('m', &arg, sizeof(filter), filter); // filter: decimation mode
 
     bool has_ok=false;
 
@@ -190,6 +366,28 @@ void logic_handler(struct command_result* res) {
         has_ok = true;
     }
 
+    if (has_write) {
+        enum falafile_format format;
+        if (strcmp(write_format, "vcd") == 0) {
+            format = FALAFILE_VCD;
+        } else if (strcmp(write_format, "sr") == 0) {
+            format = FALAFILE_SR;
+        } else if (strcmp(write_format, "off") == 0) {
+            format = FALAFILE_OFF;
+        } else {
+            printf("Error: file format must be vcd, sr, or off, '%s' is invalid\r\n", write_format);
+            res->error = true;
+            return;
+        }
+        if (!falafile_enable(format)) {
+            printf("Error: unable to attach to the logic analyzer\r\n");
+            res->error = true;
+            return;
+        }
+        printf("Save captures to storage: %s\r\n", falafile_format_name(format));
+        has_ok = true;
+    }
+
     if (has_oversample) {
         if (oversample < 1) {
             printf("Error: oversample rate must be greater than 0, '%d' is invalid\r\n", oversample);
@@ -202,6 +400,31 @@ void logic_handler(struct command_result* res) {
         has_ok = true;
     }
 
+    if (has_filter) {
+        uint8_t mode;
+        if (strcmp(filter, "glitch") == 0) {
+            mode = LA_DECIMATE_GLITCH;
+        } else if (strcmp(filter, "majority") == 0) {
+            mode = LA_DECIMATE_MAJORITY;
+        } else if (strcmp(filter, "off") == 0) {
+            mode = LA_DECIMATE_OFF;
+        } else {
+            printf("Error: filter must be glitch, majority, or off, '%s' is invalid\r\n", filter);
+            res->error = true;
+            return;
+        }
+        fala_config.decimate = mode;
+        printf("Decimation filter set to: %s\r\n", la_decimate_mode_name(mode));
+        has_ok = true;
+    }
+
+    if (fala_config.decimate == LA_DECIMATE_MAJORITY && fala_config.oversample > LA_DECIMATE_MAJORITY_MAX_FACTOR) {
+        printf("Error: majority filter supports an oversample rate up to %d\r\n", LA_DECIMATE_MAJORITY_MAX_FACTOR);
+        fala_config.decimate = LA_DECIMATE_OFF;
+        res->error = true;
+        return;
+    }
+
     if (has_frequency) {
         printf("Sample frequency set to: %dHz\r\n", frequency);
         // update fala config struct
@@ -215,19 +438,29 @@ void logic_handler(struct command_result* res) {
         return;
     }
 
-    if (has_info || has_oversample || has_frequency) {
-        fala_config.actual_sample_frequency =
+    if (has_info || has_oversample || has_frequency || has_filter) {
+        uint32_t capture_frequency =
             logic_analyzer_compute_actual_sample_frequency(fala_config.base_frequency * fala_config.oversample, NULL);
+        fala_config.actual_sample_frequency = fala_compute_sample_frequency();
         printf("\r\nLogic Analyzer settings\r\n");
-        float foversample = (float)fala_config.actual_sample_frequency / fala_config.base_frequency;
+        float foversample = (float)capture_frequency / fala_config.base_frequency;
         printf(" Oversample rate: %d\r\n", fala_config.oversample);
         printf(" Sample frequency: %dHz\r\n", fala_config.base_frequency);
+        printf(" Decimation filter: %s", la_decimate_mode_name(fala_config.decimate));
+        if (fala_config.decimate != LA_DECIMATE_OFF) {
+            printf(" (stored at %dHz)", fala_config.actual_sample_frequency);
+        }
+        printf("\r\n");
+        printf(" Save captures to storage: %s\r\n", falafile_format_name(falafile_get_format()));
+        if (fala_config.debug_level) {
+            printf(" Logic bar last graph update: %d bytes\r\n", logic_bar_get_redraw_bytes());
+        }
         if (foversample != 1.0) {
             printf("\r\nNote: actual oversample rate is not 1\r\n");
         }
-        if (fala_config.actual_sample_frequency != fala_config.base_frequency) {
+        if (capture_frequency != fala_config.base_frequency) {
             printf("Actual sample frequency: %dHz (%f * %dHz)\r\n",
-                   fala_config.actual_sample_frequency,
+                   capture_frequency,
                    foversample,
                    fala_config.base_frequency);
         }
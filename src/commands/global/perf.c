@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pirate.h"
+#include "command_struct.h"
+#include "ui/ui_cmdln.h"
+#include "ui/ui_help.h"
+#include "system_perf.h"
+#include "commands/global/perf.h"
+
+static const char* const usage[] = {
+    "perf [lcd|clear]",
+    "LCD refresh and SPI bus timing: perf lcd",
+    "Reset the counters: perf clear",
+};
+
+static const struct ui_help_options options[] = {
+    { 0, "-h", T_HELP_FLAG },
+};
+
+static const char* const spi_user_names[PERF_SPI_USERS] = {
+    [PERF_SPI_LCD] = "LCD",
+    [PERF_SPI_STORAGE] = "Storage",
+    [PERF_SPI_OTHER] = "Other",
+};
+
+static uint32_t perf_average(const perf_counter_t* c) {
+    return c->count ? (uint32_t)(c->total_us / c->count) : 0;
+}
+
+static void perf_lcd_show(void) {
+    uint32_t elapsed_ms = (time_us_64() - perf_lcd.start_us) / 1000;
+    if (!elapsed_ms) {
+        elapsed_ms = 1;
+    }
+
+    printf("Counting for %d.%03ds\r\n", elapsed_ms / 1000, elapsed_ms % 1000);
+    printf("LCD update: %d calls, average %dus, max %dus\r\n",
+           perf_lcd.lcd_update.count,
+           perf_average(&perf_lcd.lcd_update),
+           perf_lcd.lcd_update.max_us);
+    printf("Refresh timer (%dms): fired %d, completed %d, skipped %d while busy\r\n",
+           (BP_LCD_REFRESH_RATE_MS < 0) ? -BP_LCD_REFRESH_RATE_MS : BP_LCD_REFRESH_RATE_MS,
+           perf_lcd.lcd_timer_fired,
+           perf_lcd.lcd_requests_done,
+           perf_lcd.lcd_timer_skipped);
+
+    printf("SPI bus\t  held ms  busy  count   max us  wait ms  max wait us\r\n");
+    for (uint8_t i = 0; i < PERF_SPI_USERS; i++) {
+        const perf_counter_t* hold = &perf_lcd.spi_hold[i];
+        const perf_counter_t* wait = &perf_lcd.spi_wait[i];
+        uint32_t hold_ms = hold->total_us / 1000;
+        printf("%s\t%9d  %3d%%  %5d  %7d  %7d  %11d\r\n",
+               spi_user_names[i],
+               hold_ms,
+               (uint32_t)((uint64_t)hold_ms * 100 / elapsed_ms),
+               hold->count,
+               hold->max_us,
+               (uint32_t)(wait->total_us / 1000),
+               wait->max_us);
+    }
+}
+
+void perf_handler(struct command_result* res) {
+    if (ui_help_show(res->help_flag, usage, count_of(usage), &options[0], count_of(options))) {
+        return;
+    }
+
+    char action[6];
+    if (!cmdln_args_string_by_position(1, sizeof(action), action)) {
+        ui_help_show(true, usage, count_of(usage), &options[0], count_of(options));
+        return;
+    }
+
+    if (strcmp(action, "lcd") == 0) {
+        perf_lcd_show();
+    } else if (strcmp(action, "clear") == 0) {
+        perf_lcd_clear();
+        printf("Counters cleared\r\n");
+    } else {
+        printf("Invalid action. Try perf -h for help\r\n");
+        res->error = true;
+    }
+}
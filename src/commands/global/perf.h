@@ -0,0 +1 @@
+void perf_handler(struct command_result* res);
@@ -0,0 +1,171 @@
+// Logic analyzer protocol decoder core
+// Walks samples and wakes the protocol decoder only when a watched channel changes
+// or a timed decoder (UART) reaches its deadline.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "decode/la_decode.h"
+
+const la_decode_protocol_t* const la_decode_protocols[LA_DECODE_COUNT] = {
+    [LA_DECODE_NONE] = 0,
+    [LA_DECODE_I2C] = &la_decode_i2c,
+    [LA_DECODE_SPI] = &la_decode_spi,
+    [LA_DECODE_UART] = &la_decode_uart,
+    [LA_DECODE_1WIRE] = &la_decode_1wire,
+};
+
+static const char* const la_decode_frame_names[] = {
+    [LA_FRAME_START] = "START",
+    [LA_FRAME_RESTART] = "RESTART",
+    [LA_FRAME_ADDR] = "ADDR",
+    [LA_FRAME_DATA] = "DATA",
+    [LA_FRAME_ACK] = "ACK",
+    [LA_FRAME_NACK] = "NACK",
+    [LA_FRAME_STOP] = "STOP",
+    [LA_FRAME_RESET] = "RESET",
+    [LA_FRAME_PRESENCE] = "PRESENCE",
+    [LA_FRAME_ERROR] = "ERROR",
+};
+
+bool la_decode_init(la_decoder_t* d, uint8_t protocol, la_decode_emit_t emit, void* ctx) {
+    if (protocol >= LA_DECODE_COUNT || !la_decode_protocols[protocol]) {
+        return false;
+    }
+    d->protocol = protocol;
+    d->emit = emit;
+    d->ctx = ctx;
+    la_decode_reset(d);
+    return true;
+}
+
+// clear running state, keeps the configuration
+void la_decode_reset(la_decoder_t* d) {
+    d->index = 0;
+    d->deadline = LA_DECODE_NO_DEADLINE;
+    d->mark = 0;
+    d->frame = 0;
+    d->bit_fp = 0;
+    d->watch = 0;
+    d->last = 0;
+    d->primed = false;
+    d->state = 0;
+    d->bits = 0;
+    d->shift = 0;
+    d->shift2 = 0;
+    if (d->protocol < LA_DECODE_COUNT && la_decode_protocols[d->protocol]) {
+        la_decode_protocols[d->protocol]->reset(d);
+    }
+}
+
+// feed the next span of samples, can be called repeatedly as a capture streams in
+void la_decode_feed(la_decoder_t* d, const uint8_t* samples, uint32_t count) {
+    const la_decode_protocol_t* p = la_decode_protocols[d->protocol];
+    if (!p || !count) {
+        return;
+    }
+    if (!d->primed) {
+        d->last = samples[0];
+        d->primed = true;
+    }
+    for (uint32_t i = 0; i < count; i++, d->index++) {
+        uint8_t changed = (samples[i] ^ d->last) & d->watch;
+        if (changed || d->index == d->deadline) {
+            p->sample(d, samples[i], changed);
+        }
+        d->last = samples[i];
+    }
+}
+
+// decode count samples from an iterator, starting at read_pointer start
+void la_decode_run(la_decoder_t* d, la_decode_span_t get_span, uint32_t start, uint32_t count) {
+    while (count) {
+        const uint8_t* span;
+        uint32_t len = get_span(start, count, &span);
+        if (!len) {
+            return;
+        }
+        la_decode_feed(d, span, len);
+        start += len;
+        count -= len;
+    }
+}
+
+void la_decode_emit(la_decoder_t* d, uint8_t type, uint32_t start, uint8_t value, uint8_t value2) {
+    if (!d->emit) {
+        return;
+    }
+    la_decode_frame_t frame = { .start = start, .end = d->index, .type = type, .value = value, .value2 = value2 };
+    d->emit(d, &frame);
+}
+
+int la_decode_find_protocol(const char* name) {
+    for (int i = 0; i < LA_DECODE_COUNT; i++) {
+        if (la_decode_protocols[i] && strcmp(name, la_decode_protocols[i]->name) == 0) {
+            return i;
+        }
+    }
+    return LA_DECODE_NONE;
+}
+
+const char* la_decode_frame_name(uint8_t type) {
+    if (type >= sizeof(la_decode_frame_names) / sizeof(la_decode_frame_names[0])) {
+        return "?";
+    }
+    return la_decode_frame_names[type];
+}
+
+static uint32_t la_decode_hex(uint8_t value, char* str) {
+    static const char hex[] = "0123456789ABCDEF";
+    str[0] = hex[value >> 4];
+    str[1] = hex[value & 0x0f];
+    return 2;
+}
+
+// short label for the logic bar, at most 4 characters
+// snprintf is avoided so the core stays free of printf dependencies
+uint32_t la_decode_frame_label(const la_decode_frame_t* frame, char* str, uint32_t max_len) {
+    char label[5];
+    uint32_t len = 0;
+    switch (frame->type) {
+        case LA_FRAME_START:
+            label[len++] = 'S';
+            break;
+        case LA_FRAME_RESTART:
+            label[len++] = 'S';
+            label[len++] = 'r';
+            break;
+        case LA_FRAME_ADDR:
+            len += la_decode_hex(frame->value >> 1, &label[len]);
+            label[len++] = (frame->value & 1) ? 'R' : 'W';
+            break;
+        case LA_FRAME_DATA:
+            len += la_decode_hex(frame->value, &label[len]);
+            break;
+        case LA_FRAME_ACK:
+            label[len++] = 'A';
+            break;
+        case LA_FRAME_NACK:
+            label[len++] = 'N';
+            break;
+        case LA_FRAME_STOP:
+            label[len++] = 'P';
+            break;
+        case LA_FRAME_RESET:
+            label[len++] = 'R';
+            label[len++] = 'S';
+            label[len++] = 'T';
+            break;
+        case LA_FRAME_PRESENCE:
+            label[len++] = 'P';
+            label[len++] = 'D';
+            break;
+        default:
+            label[len++] = '!';
+            break;
+    }
+    if (len > max_len) {
+        len = max_len;
+    }
+    memcpy(str, label, len);
+    return len;
+}
@@ -0,0 +1,125 @@
+#ifndef LA_DECODE_H
+#define LA_DECODE_H
+
+// Protocol decoders for logic analyzer captures
+// Pure C, no hardware dependencies: samples are fed in spans from any source
+// (the LA ring buffer, a streaming capture, or a stored capture vector on a host).
+// Decoders are incremental, state is kept between calls to la_decode_feed()
+#include <stdint.h>
+#include <stdbool.h>
+
+enum la_decode_protocol {
+    LA_DECODE_NONE = 0,
+    LA_DECODE_I2C,
+    LA_DECODE_SPI,
+    LA_DECODE_UART,
+    LA_DECODE_1WIRE,
+    LA_DECODE_COUNT
+};
+
+enum la_decode_frame_type {
+    LA_FRAME_START = 0,
+    LA_FRAME_RESTART,
+    LA_FRAME_ADDR,
+    LA_FRAME_DATA,
+    LA_FRAME_ACK,
+    LA_FRAME_NACK,
+    LA_FRAME_STOP,
+    LA_FRAME_RESET,
+    LA_FRAME_PRESENCE,
+    LA_FRAME_ERROR,
+};
+
+typedef struct {
+    uint32_t start;  // sample index of the first sample in the frame
+    uint32_t end;    // sample index of the last sample in the frame
+    uint8_t type;    // enum la_decode_frame_type
+    uint8_t value;   // address (with R/W bit), data byte, MOSI for SPI
+    uint8_t value2;  // MISO for SPI
+} la_decode_frame_t;
+
+struct la_decoder;
+typedef void (*la_decode_emit_t)(const struct la_decoder* d, const la_decode_frame_t* frame);
+
+// iterator over a sample source, same shape as logic_analyzer_get_span()
+// returns a pointer to up to count contiguous samples starting at read_pointer
+typedef uint32_t (*la_decode_span_t)(uint32_t read_pointer, uint32_t count, const uint8_t** span);
+
+// channel assignment, order depends on the protocol
+enum {
+    LA_DECODE_I2C_SDA = 0,
+    LA_DECODE_I2C_SCL,
+    LA_DECODE_SPI_CLK = 0,
+    LA_DECODE_SPI_MOSI,
+    LA_DECODE_SPI_MISO,
+    LA_DECODE_SPI_CS,
+    LA_DECODE_UART_RX = 0,
+    LA_DECODE_1WIRE_DQ = 0,
+    LA_DECODE_MAX_PINS = 4
+};
+
+#define LA_DECODE_PIN_NONE 0xff
+
+typedef struct la_decoder {
+    // configuration
+    uint8_t protocol;                   // enum la_decode_protocol
+    uint8_t pins[LA_DECODE_MAX_PINS];   // channel numbers (0-7), LA_DECODE_PIN_NONE if unused
+    uint8_t spi_cpol;
+    uint8_t spi_cpha;
+    uint32_t sample_rate;               // samples per second
+    uint32_t bit_rate;                  // UART baud
+    la_decode_emit_t emit;              // called for every decoded frame
+    void* ctx;                          // user data for emit
+
+    // running state, cleared by la_decode_reset()
+    uint32_t index;                     // absolute index of the next sample
+    uint32_t deadline;                  // sample index where a timed decoder wants a callback
+    uint32_t mark;                      // sample index of the last edge of interest (start bit, pulse)
+    uint32_t frame;                     // sample index where the current byte began
+    uint32_t bit_fp;                    // UART samples per bit, 1-Wire samples per us (16.16 fixed point)
+    uint8_t watch;                      // channel mask that wakes the decoder on change
+    uint8_t last;                       // previous sample
+    bool primed;                        // last holds a real sample
+    uint8_t state;
+    uint8_t bits;
+    uint8_t shift;
+    uint8_t shift2;
+} la_decoder_t;
+
+#define LA_DECODE_NO_DEADLINE 0xffffffffu
+
+// protocol implementation
+typedef struct {
+    const char* name;
+    uint8_t pin_count;
+    void (*reset)(la_decoder_t* d);
+    // called when a watched channel changes or the deadline is reached
+    void (*sample)(la_decoder_t* d, uint8_t sample, uint8_t changed);
+} la_decode_protocol_t;
+
+extern const la_decode_protocol_t* const la_decode_protocols[LA_DECODE_COUNT];
+
+// decoder API
+bool la_decode_init(la_decoder_t* d, uint8_t protocol, la_decode_emit_t emit, void* ctx);
+void la_decode_reset(la_decoder_t* d);
+void la_decode_feed(la_decoder_t* d, const uint8_t* samples, uint32_t count);
+void la_decode_run(la_decoder_t* d, la_decode_span_t get_span, uint32_t start, uint32_t count);
+int la_decode_find_protocol(const char* name);
+const char* la_decode_frame_name(uint8_t type);
+uint32_t la_decode_frame_label(const la_decode_frame_t* frame, char* str, uint32_t max_len);
+
+// shared helpers for the protocol implementations
+void la_decode_emit(la_decoder_t* d, uint8_t type, uint32_t start, uint8_t value, uint8_t value2);
+static inline bool la_decode_pin(const la_decoder_t* d, uint8_t sample, uint8_t pin) {
+    return (sample >> d->pins[pin]) & 1;
+}
+static inline uint8_t la_decode_pin_mask(const la_decoder_t* d, uint8_t pin) {
+    return (d->pins[pin] == LA_DECODE_PIN_NONE) ? 0 : (1u << d->pins[pin]);
+}
+
+extern const la_decode_protocol_t la_decode_i2c;
+extern const la_decode_protocol_t la_decode_spi;
+extern const la_decode_protocol_t la_decode_uart;
+extern const la_decode_protocol_t la_decode_1wire;
+
+#endif // LA_DECODE_H
@@ -0,0 +1,70 @@
+// 1-Wire decoder: reset, presence, and bytes LSB first
+// every low pulse is timed, long pulses are resets, short pulses are 1 bits
+#include <stdint.h>
+#include <stdbool.h>
+#include "decode/la_decode.h"
+
+#define OW_RESET_MIN_US 400    // reset is nominally 480us
+#define OW_PRESENCE_MIN_US 50  // presence is 60-240us
+#define OW_ZERO_MIN_US 15      // write/read 1 releases the bus within 15us
+
+enum {
+    OW_IDLE = 0,
+    OW_RESET
+};
+
+static void ow_reset(la_decoder_t* d) {
+    d->watch = la_decode_pin_mask(d, LA_DECODE_1WIRE_DQ);
+    d->bit_fp = (uint32_t)(((uint64_t)d->sample_rate << 16) / 1000000);
+    if (d->bit_fp == 0) {
+        d->bit_fp = 1;
+    }
+}
+
+static void ow_sample(la_decoder_t* d, uint8_t sample, uint8_t changed) {
+    if (!changed) {
+        return; // no deadline is set, only DQ edges are of interest
+    }
+    if (!la_decode_pin(d, sample, LA_DECODE_1WIRE_DQ)) {
+        d->mark = d->index; // falling edge, pulse starts
+        return;
+    }
+
+    // rising edge, measure the low pulse
+    uint32_t us = (uint32_t)(((uint64_t)(d->index - d->mark) << 16) / d->bit_fp);
+
+    if (us >= OW_RESET_MIN_US) {
+        la_decode_emit(d, LA_FRAME_RESET, d->mark, 0, 0);
+        d->state = OW_RESET;
+        d->bits = 0;
+        d->shift = 0;
+        return;
+    }
+
+    if (d->state == OW_RESET) {
+        d->state = OW_IDLE;
+        if (us >= OW_PRESENCE_MIN_US) {
+            la_decode_emit(d, LA_FRAME_PRESENCE, d->mark, 0, 0);
+            return;
+        }
+    }
+
+    if (d->bits == 0) {
+        d->frame = d->mark;
+    }
+    if (us < OW_ZERO_MIN_US) {
+        d->shift |= 1u << d->bits;
+    }
+    if (++d->bits == 8) {
+        la_decode_emit(d, LA_FRAME_DATA, d->frame, d->shift, 0);
+        d->bits = 0;
+        d->shift = 0;
+    }
+}
+
+const la_decode_protocol_t la_decode_1wire = {
+    .name = "1wire",
+    .pin_count = 1,
+    .reset = ow_reset,
+    .sample = ow_sample,
+};
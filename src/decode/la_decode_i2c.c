@@ -0,0 +1,60 @@
+// I2C decoder: START/RESTART, address + R/W, data, ACK/NACK, STOP
+// SDA changes while SCL is high are conditions, SDA is sampled on SCL rising edges
+#include <stdint.h>
+#include <stdbool.h>
+#include "decode/la_decode.h"
+
+enum {
+    I2C_IDLE = 0,
+    I2C_ADDR,
+    I2C_DATA
+};
+
+static void i2c_reset(la_decoder_t* d) {
+    d->watch = la_decode_pin_mask(d, LA_DECODE_I2C_SDA) | la_decode_pin_mask(d, LA_DECODE_I2C_SCL);
+}
+
+static void i2c_sample(la_decoder_t* d, uint8_t sample, uint8_t changed) {
+    bool sda = la_decode_pin(d, sample, LA_DECODE_I2C_SDA);
+    bool scl = la_decode_pin(d, sample, LA_DECODE_I2C_SCL);
+    bool scl_was = la_decode_pin(d, d->last, LA_DECODE_I2C_SCL);
+
+    // START, RESTART and STOP conditions
+    if ((changed & la_decode_pin_mask(d, LA_DECODE_I2C_SDA)) && scl && scl_was) {
+        if (!sda) {
+            la_decode_emit(d, (d->state == I2C_IDLE) ? LA_FRAME_START : LA_FRAME_RESTART, d->index, 0, 0);
+            d->state = I2C_ADDR;
+            d->bits = 0;
+            d->shift = 0;
+        } else if (d->state != I2C_IDLE) {
+            la_decode_emit(d, LA_FRAME_STOP, d->index, 0, 0);
+            d->state = I2C_IDLE;
+        }
+        return;
+    }
+
+    if (d->state == I2C_IDLE || !(changed & la_decode_pin_mask(d, LA_DECODE_I2C_SCL)) || !scl) {
+        return;
+    }
+
+    // SCL rising edge, 8 data bits MSB first then ACK
+    if (d->bits < 8) {
+        if (d->bits == 0) {
+            d->frame = d->index;
+        }
+        d->shift = (d->shift << 1) | sda;
+        d->bits++;
+        return;
+    }
+    la_decode_emit(d, (d->state == I2C_ADDR) ? LA_FRAME_ADDR : LA_FRAME_DATA, d->frame, d->shift, 0);
+    la_decode_emit(d, sda ? LA_FRAME_NACK : LA_FRAME_ACK, d->index, 0, 0);
+    d->state = I2C_DATA;
+    d->bits = 0;
+}
+
+const la_decode_protocol_t la_decode_i2c = {
+    .name = "i2c",
+    .pin_count = 2,
+    .reset = i2c_reset,
+    .sample = i2c_sample,
+};
@@ -0,0 +1,65 @@
+// SPI decoder: CS framing (optional), 8 bit MOSI/MISO words MSB first
+// supports all four CPOL/CPHA modes
+#include <stdint.h>
+#include <stdbool.h>
+#include "decode/la_decode.h"
+
+enum {
+    SPI_IDLE = 0,
+    SPI_SELECTED
+};
+
+static void spi_reset(la_decoder_t* d) {
+    d->watch = la_decode_pin_mask(d, LA_DECODE_SPI_CLK) | la_decode_pin_mask(d, LA_DECODE_SPI_CS);
+    // without a CS pin every clock is part of a transfer
+    d->state = la_decode_pin_mask(d, LA_DECODE_SPI_CS) ? SPI_IDLE : SPI_SELECTED;
+}
+
+static void spi_sample(la_decoder_t* d, uint8_t sample, uint8_t changed) {
+    if (changed & la_decode_pin_mask(d, LA_DECODE_SPI_CS)) {
+        if (!la_decode_pin(d, sample, LA_DECODE_SPI_CS)) {
+            la_decode_emit(d, LA_FRAME_START, d->index, 0, 0);
+            d->state = SPI_SELECTED;
+        } else if (d->state == SPI_SELECTED) {
+            if (d->bits) { // CS released mid byte
+                la_decode_emit(d, LA_FRAME_ERROR, d->frame, d->shift, d->shift2);
+            }
+            la_decode_emit(d, LA_FRAME_STOP, d->index, 0, 0);
+            d->state = SPI_IDLE;
+        }
+        d->bits = 0;
+        return;
+    }
+
+    if (d->state != SPI_SELECTED || !(changed & la_decode_pin_mask(d, LA_DECODE_SPI_CLK))) {
+        return;
+    }
+
+    // leading edge moves the clock away from CPOL, CPHA=0 samples on the leading edge
+    bool leading = la_decode_pin(d, sample, LA_DECODE_SPI_CLK) != d->spi_cpol;
+    if (leading == (bool)d->spi_cpha) {
+        return;
+    }
+
+    if (d->bits == 0) {
+        d->frame = d->index;
+        d->shift = 0; // a partial byte reports only its own bits
+        d->shift2 = 0;
+    }
+    d->shift = (d->shift << 1) | la_decode_pin(d, sample, LA_DECODE_SPI_MOSI);
+    d->shift2 <<= 1;
+    if (la_decode_pin_mask(d, LA_DECODE_SPI_MISO)) {
+        d->shift2 |= la_decode_pin(d, sample, LA_DECODE_SPI_MISO);
+    }
+    if (++d->bits == 8) {
+        la_decode_emit(d, LA_FRAME_DATA, d->frame, d->shift, d->shift2);
+        d->bits = 0;
+    }
+}
+
+const la_decode_protocol_t la_decode_spi = {
+    .name = "spi",
+    .pin_count = 4,
+    .reset = spi_reset,
+    .sample = spi_sample,
+};
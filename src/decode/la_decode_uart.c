@@ -0,0 +1,79 @@
+// UART decoder: 8N1, idle high, LSB first
+// the start bit edge arms a deadline at the center of each bit, so only
+// edges and bit centers wake the decoder
+#include <stdint.h>
+#include <stdbool.h>
+#include "decode/la_decode.h"
+
+enum {
+    UART_IDLE = 0,
+    UART_START,
+    UART_DATA,
+    UART_STOP
+};
+
+static void uart_reset(la_decoder_t* d) {
+    d->watch = la_decode_pin_mask(d, LA_DECODE_UART_RX);
+    d->bit_fp = d->bit_rate ? (uint32_t)(((uint64_t)d->sample_rate << 16) / d->bit_rate) : 0;
+    if (d->bit_fp < (1u << 16)) { // need at least one sample per bit
+        d->bit_fp = 1u << 16;
+    }
+}
+
+// center of bit n after the start edge, bit 0 is the start bit
+static void uart_next_deadline(la_decoder_t* d, uint8_t n) {
+    uint32_t deadline = d->mark + (uint32_t)(((uint64_t)(2 * n + 1) * d->bit_fp) >> 17);
+    d->deadline = (deadline > d->index) ? deadline : d->index + 1;
+}
+
+static void uart_sample(la_decoder_t* d, uint8_t sample, uint8_t changed) {
+    bool rx = la_decode_pin(d, sample, LA_DECODE_UART_RX);
+
+    if (d->state == UART_IDLE) {
+        if (changed && !rx) {
+            d->mark = d->index;
+            d->state = UART_START;
+            uart_next_deadline(d, 0);
+        }
+        return;
+    }
+
+    if (d->index != d->deadline) {
+        return;
+    }
+
+    switch (d->state) {
+        case UART_START:
+            if (rx) { // glitch, not a start bit
+                d->state = UART_IDLE;
+                d->deadline = LA_DECODE_NO_DEADLINE;
+                return;
+            }
+            d->state = UART_DATA;
+            d->bits = 0;
+            d->shift = 0;
+            uart_next_deadline(d, 1);
+            break;
+        case UART_DATA:
+            d->shift |= rx << d->bits;
+            d->bits++;
+            if (d->bits == 8) {
+                d->state = UART_STOP;
+            }
+            uart_next_deadline(d, d->bits + 1);
+            break;
+        case UART_STOP:
+            // missing stop bit is a framing error
+            la_decode_emit(d, rx ? LA_FRAME_DATA : LA_FRAME_ERROR, d->mark, d->shift, 0);
+            d->state = UART_IDLE;
+            d->deadline = LA_DECODE_NO_DEADLINE;
+            break;
+    }
+}
+
+const la_decode_protocol_t la_decode_uart = {
+    .name = "uart",
+    .pin_count = 1,
+    .reset = uart_reset,
+    .sample = uart_sample,
+};
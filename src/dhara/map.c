@@ -64,6 +64,128 @@ static inline void meta_set_alt(uint8_t *meta, int level, dhara_page_t alt)
 	dhara_w32(meta + 4 + (level << 2), alt);
 }
 
+/************************************************************************
+ * Lookup caches
+ */
+
+static inline dhara_block_t head_block(const struct dhara_map *m)
+{
+	return m->journal.head >> m->journal.nand->log2_ppb;
+}
+
+static void cache_flush(struct dhara_map *m)
+{
+	int i;
+
+	for (i = 0; i < DHARA_MAP_CACHE_SLOTS; i++)
+		m->cache[i].sector = DHARA_SECTOR_NONE;
+
+	for (i = 0; i < DHARA_MAP_NODE_CACHE_SIZE; i++)
+		m->nodes[i].page = DHARA_PAGE_NONE;
+
+	m->node_block = head_block(m);
+}
+
+static inline struct dhara_map_cache_entry *
+cache_slot(struct dhara_map *m, dhara_sector_t s)
+{
+	return &m->cache[s & (DHARA_MAP_CACHE_SLOTS - 1)];
+}
+
+static void cache_set(struct dhara_map *m, dhara_sector_t s,
+		      dhara_page_t p)
+{
+	struct dhara_map_cache_entry *e = cache_slot(m, s);
+
+	if (!DHARA_MAP_CACHE_SIZE || s == DHARA_SECTOR_NONE)
+		return;
+
+	e->sector = s;
+	e->page = p;
+}
+
+/* Forget every node if the head has moved into another block, which
+ * may have been erased on the way.
+ */
+static void nodes_check(struct dhara_map *m)
+{
+	const dhara_block_t b = head_block(m);
+	int i;
+
+	if (b == m->node_block)
+		return;
+
+	for (i = 0; i < DHARA_MAP_NODE_CACHE_SIZE; i++)
+		m->nodes[i].page = DHARA_PAGE_NONE;
+
+	m->node_block = b;
+}
+
+static void node_put(struct dhara_map *m, dhara_page_t p,
+		     const uint8_t *meta)
+{
+	struct dhara_map_node *victim = &m->nodes[0];
+	int i;
+
+	if (!DHARA_MAP_NODE_CACHE_SIZE)
+		return;
+
+	nodes_check(m);
+
+	for (i = 0; i < DHARA_MAP_NODE_CACHE_SIZE; i++) {
+		struct dhara_map_node *n = &m->nodes[i];
+
+		if (n->page == p || n->page == DHARA_PAGE_NONE) {
+			victim = n;
+			break;
+		}
+
+		if (n->used < victim->used)
+			victim = n;
+	}
+
+	victim->page = p;
+	victim->used = ++m->node_clock;
+	memcpy(victim->meta, meta, DHARA_META_SIZE);
+}
+
+/* Read the metadata of a page which is part of the tree */
+static int read_node(struct dhara_map *m, dhara_page_t p, uint8_t *meta,
+		     dhara_error_t *err)
+{
+	int i;
+
+	nodes_check(m);
+
+	for (i = 0; i < DHARA_MAP_NODE_CACHE_SIZE; i++) {
+		struct dhara_map_node *n = &m->nodes[i];
+
+		if (n->page == p) {
+			n->used = ++m->node_clock;
+			memcpy(meta, n->meta, DHARA_META_SIZE);
+			return 0;
+		}
+	}
+
+	if (dhara_journal_read_meta(&m->journal, p, meta, err) < 0)
+		return -1;
+
+	node_put(m, p, meta);
+	return 0;
+}
+
+/* A page holding sector s with the given metadata has just been
+ * written or copied to the front of the journal, and is now the root.
+ */
+static void cache_written(struct dhara_map *m, dhara_sector_t s,
+			  const uint8_t *meta)
+{
+	const dhara_page_t p = dhara_journal_root(&m->journal);
+
+	cache_set(m, s, p);
+	node_put(m, p, meta);
+}
+
 /************************************************************************
  * Public interface
  */
@@ -76,11 +198,19 @@ void dhara_map_init(struct dhara_map *m, const struct dhara_nand *n,
 
 	dhara_journal_init(&m->journal, n, page_buf);
 	m->gc_ratio = gc_ratio;
+	m->node_clock = 0;
+	m->cache_hits = 0;
+	m->cache_misses = 0;
+	cache_flush(m);
 }
 
 int dhara_map_resume(struct dhara_map *m, dhara_error_t *err)
 {
-	if (dhara_journal_resume(&m->journal, err) < 0) {
+	const int ret = dhara_journal_resume(&m->journal, err);
+
+	cache_flush(m);
+
+	if (ret < 0) {
 		m->count = 0;
 		return -1;
 	}
@@ -95,6 +225,8 @@ void dhara_map_clear(struct dhara_map *m)
 		m->count = 0;
 		dhara_journal_clear(&m->journal);
 	}
+
+	cache_flush(m);
 }
 
 dhara_sector_t dhara_map_capacity(const struct dhara_map *m)
@@ -133,7 +265,7 @@ static int trace_path(struct dhara_map *m, dhara_sector_t target,
 	if (p == DHARA_PAGE_NONE)
 		goto not_found;
 
-	if (dhara_journal_read_meta(&m->journal, p, meta, err) < 0)
+	if (read_node(m, p, meta, err) < 0)
 		return -1;
 
 	while (depth < DHARA_RADIX_DEPTH) {
@@ -152,8 +284,7 @@ static int trace_path(struct dhara_map *m, dhara_sector_t target,
 				goto not_found;
 			}
 
-			if (dhara_journal_read_meta(&m->journal, p,
-						    meta, err) < 0)
+			if (read_node(m, p, meta, err) < 0)
 				return -1;
 		} else {
 			if (new_meta)
@@ -182,7 +313,37 @@ not_found:
 int dhara_map_find(struct dhara_map *m, dhara_sector_t target,
 		   dhara_page_t *loc, dhara_error_t *err)
 {
-	return trace_path(m, target, loc, NULL, err);
+	const struct dhara_map_cache_entry *e = cache_slot(m, target);
+	dhara_error_t my_err;
+	dhara_page_t p;
+
+	if (target != DHARA_SECTOR_NONE && e->sector == target) {
+		m->cache_hits++;
+		p = e->page;
+	} else {
+		m->cache_misses++;
+
+		if (trace_path(m, target, &p, NULL, &my_err) < 0) {
+			if (my_err != DHARA_E_NOT_FOUND) {
+				dhara_set_error(err, my_err);
+				return -1;
+			}
+
+			p = DHARA_PAGE_NONE;
+		}
+
+		cache_set(m, target, p);
+	}
+
+	if (p == DHARA_PAGE_NONE) {
+		dhara_set_error(err, DHARA_E_NOT_FOUND);
+		return -1;
+	}
+
+	if (loc)
+		*loc = p;
+
+	return 0;
 }
 
 int dhara_map_read(struct dhara_map *m, dhara_sector_t s,
@@ -247,6 +408,7 @@ static int raw_gc(struct dhara_map *m, dhara_page_t src,
 	if (dhara_journal_copy(&m->journal, src, meta, err) < 0)
 		return -1;
 
+	cache_written(m, target, meta);
 	return 0;
 }
 
@@ -260,23 +422,24 @@ static int pad_queue(struct dhara_map *m, dhara_error_t *err)
 	if (p == DHARA_PAGE_NONE)
 		return dhara_journal_enqueue(&m->journal, NULL, NULL, err);
 
-	if (dhara_journal_read_meta(&m->journal, p, root_meta, err) < 0)
+	if (read_node(m, p, root_meta, err) < 0)
+		return -1;
+
+	if (dhara_journal_copy(&m->journal, p, root_meta, err) < 0)
 		return -1;
 
-	return dhara_journal_copy(&m->journal, p, root_meta, err);
+	cache_written(m, meta_get_id(root_meta), root_meta);
+	return 0;
 }
 
-/* Attempt to recover the journal */
-static int try_recover(struct dhara_map *m, dhara_error_t cause,
-		       dhara_error_t *err)
+/* Attempt to recover the journal. A failure during recovery can roll
+ * the journal back to where recovery began, so the caches are dropped
+ * however it ends.
+ */
+static int recover(struct dhara_map *m, dhara_error_t *err)
 {
 	int restart_count = 0;
 
-	if (cause != DHARA_E_RECOVER) {
-		dhara_set_error(err, cause);
-		return -1;
-	}
-
 	while (dhara_journal_in_recovery(&m->journal)) {
 		dhara_page_t p = dhara_journal_next_recoverable(&m->journal);
 		dhara_error_t my_err;
@@ -305,6 +468,21 @@ static int try_recover(struct dhara_map *m, dhara_error_t cause,
 	return 0;
 }
 
+static int try_recover(struct dhara_map *m, dhara_error_t cause,
+		       dhara_error_t *err)
+{
+	int ret;
+
+	if (cause != DHARA_E_RECOVER) {
+		dhara_set_error(err, cause);
+		return -1;
+	}
+
+	ret = recover(m, err);
+	cache_flush(m);
+	return ret;
+}
+
 static int auto_gc(struct dhara_map *m, dhara_error_t *err)
 {
 	int i;
@@ -356,8 +534,10 @@ int dhara_map_write(struct dhara_map *m, dhara_sector_t dst,
 		if (prepare_write(m, dst, meta, err) < 0)
 			return -1;
 
-		if (!dhara_journal_enqueue(&m->journal, data, meta, &my_err))
+		if (!dhara_journal_enqueue(&m->journal, data, meta, &my_err)) {
+			cache_written(m, dst, meta);
 			break;
+		}
 
 		m->count = old_count;
 
@@ -379,8 +559,10 @@ int dhara_map_copy_page(struct dhara_map *m, dhara_page_t src,
 		if (prepare_write(m, dst, meta, err) < 0)
 			return -1;
 
-		if (!dhara_journal_copy(&m->journal, src, meta, &my_err))
+		if (!dhara_journal_copy(&m->journal, src, meta, &my_err)) {
+			cache_written(m, dst, meta);
 			break;
+		}
 
 		m->count = old_count;
 
@@ -419,8 +601,10 @@ static int try_delete(struct dhara_map *m, dhara_sector_t s,
 	int i;
 
 	if (trace_path(m, s, NULL, meta, &my_err) < 0) {
-		if (my_err == DHARA_E_NOT_FOUND)
+		if (my_err == DHARA_E_NOT_FOUND) {
+			cache_set(m, s, DHARA_PAGE_NONE);
 			return 0;
+		}
 
 		dhara_set_error(err, my_err);
 		return -1;
@@ -440,13 +624,14 @@ static int try_delete(struct dhara_map *m, dhara_sector_t s,
 	if (level < 0) {
 		m->count = 0;
 		dhara_journal_clear(&m->journal);
+		cache_flush(m);
 		return 0;
 	}
 
 	/* Rewrite the cousin with an up-to-date path which doesn't
 	 * point to the original node.
 	 */
-	if (dhara_journal_read_meta(&m->journal, alt_page, alt_meta, err) < 0)
+	if (read_node(m, alt_page, alt_meta, err) < 0)
 		return -1;
 
 	meta_set_id(meta, meta_get_id(alt_meta));
@@ -461,6 +646,8 @@ static int try_delete(struct dhara_map *m, dhara_sector_t s,
 	if (dhara_journal_copy(&m->journal, alt_page, meta, err) < 0)
 		return -1;
 
+	cache_set(m, s, DHARA_PAGE_NONE);
+	cache_written(m, meta_get_id(meta), meta);
 	m->count--;
 	return 0;
 }
@@ -27,11 +27,61 @@ typedef uint32_t dhara_sector_t;
 /* This sector value is reserved */
 #define DHARA_SECTOR_NONE	0xffffffff
 
+/* Lookup caches. Finding a sector means walking the radix tree from the
+ * journal root, reading the metadata of one page per level where the
+ * path branches. The map keeps a direct-mapped cache of recent
+ * sector->page resolutions (a power of two number of entries), and a
+ * small LRU cache of tree node metadata used on a miss. Either can be
+ * set to 0 to turn it off.
+ */
+#ifndef DHARA_MAP_CACHE_SIZE
+#define DHARA_MAP_CACHE_SIZE		128
+#endif
+
+#ifndef DHARA_MAP_NODE_CACHE_SIZE
+#define DHARA_MAP_NODE_CACHE_SIZE	8
+#endif
+
+/* A cache that is off keeps one entry which is never used */
+#define DHARA_MAP_CACHE_SLOTS \
+	(DHARA_MAP_CACHE_SIZE ? DHARA_MAP_CACHE_SIZE : 1)
+#define DHARA_MAP_NODE_SLOTS \
+	(DHARA_MAP_NODE_CACHE_SIZE ? DHARA_MAP_NODE_CACHE_SIZE : 1)
+
+struct dhara_map_cache_entry {
+	dhara_sector_t		sector;
+	dhara_page_t		page;
+};
+
+struct dhara_map_node {
+	dhara_page_t		page;
+	uint32_t		used;
+	uint8_t			meta[DHARA_META_SIZE];
+};
+
 struct dhara_map {
 	struct dhara_journal	journal;
 
 	uint8_t			gc_ratio;
 	dhara_sector_t		count;
+
+	/* Sector cache. A page of DHARA_PAGE_NONE records a sector
+	 * known to be unmapped.
+	 */
+	struct dhara_map_cache_entry	cache[DHARA_MAP_CACHE_SLOTS];
+
+	/* Node cache. Metadata of a written page doesn't change until
+	 * its block is erased, which only happens to the block at the
+	 * journal head, so this is dropped whenever the head moves to
+	 * another block.
+	 */
+	struct dhara_map_node	nodes[DHARA_MAP_NODE_SLOTS];
+	dhara_block_t		node_block;
+	uint32_t		node_clock;
+
+	/* Sector cache statistics */
+	uint32_t		cache_hits;
+	uint32_t		cache_misses;
 };
 
 /* Initialize a map. You need to supply a buffer for page metadata, and
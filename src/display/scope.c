@@ -36,6 +36,10 @@
 #include "hardware/irq.h"
 #include "hardware/spi.h"
 #include "font/font.h"
+#include "display/scope_trigger.h"
+#include "display/scope_fft.h"
+#include "display/scope_measure.h"
+#include "display/scope_file.h"
 // #include "font/hunter-23pt-24h24w.h"
 // #include "font/hunter-20pt-21h21w.h"
 // #include "font/hunter-14pt-19h15w.h"
@@ -43,6 +47,7 @@
 // #include "font/background.h"
 // #include "font/background_image_v4.h"
 extern const FONT_INFO hunter_12ptFontInfo;
+#include "pirate/intercore_helpers.h"
 #include "ui/ui_flags.h"
 #include "ui/ui_lcd.h"
 #include "ui/ui_prompt.h"
@@ -60,20 +65,48 @@ const uint32_t V5 = 0x0c05; // 5V
 #define CAPTURE_DEPTH 64
 #define BUFFERS (5 * 10 * 2 + 1) // 320x10 = standard samples rate (10 samples/pixel) 4x screen width
 
-#define MALLOC_SIZE (2 * 2 * BUFFERS * CAPTURE_DEPTH) + (VS * HS / 2)
+#define LINE_BYTES (HS * 2) // one display line of RGB565 pixels
+#define PAIRS_SIZE (256 * 4) // fb byte to two pixels lookup
+
+#define DIRTY_WIDTH 8 // pixels per dirty column, one word of fb
+#define DIRTY_COLS (HS / DIRTY_WIDTH)
+
+// min/max envelope of the display buffer, level n holds blocks of ENV_BLOCK << n samples
+// 64 sample blocks are the largest that still divide the ring
+#define ENV_BLOCK 8
+#define ENV_LEVELS 4
+#define ENV_ENTRIES (BUFFERS * CAPTURE_DEPTH / ENV_BLOCK) // first level, each level above has half
+#define ENV_SIZE ((4 * (ENV_ENTRIES + ENV_ENTRIES / 2 + ENV_ENTRIES / 4 + ENV_ENTRIES / 8)) + (2 * 2 * HS))
+
+#define FFT_SIZE (2 * 2 * SCOPE_FFT_MAX) // real and imaginary parts for the spectrum view
+#define MEASURE_SIZE (BUFFERS * sizeof(scope_measure_block_t))
+#define MEASURE_HYSTERESIS_MV 20 // least hysteresis for frequency and duty
+
+#define MALLOC_SIZE                                                                                                    \
+    (2 * 2 * BUFFERS * CAPTURE_DEPTH) + 2 * (VS * HS / 2) + PAIRS_SIZE + (2 * LINE_BYTES) + ENV_SIZE + FFT_SIZE +      \
+        MEASURE_SIZE
 static volatile uint32_t sample_first = 0, sample_last = BUFFERS * CAPTURE_DEPTH - 1;
 static uint32_t display_sample_first = 0, display_sample_last = BUFFERS * CAPTURE_DEPTH - 1;
 static volatile uint16_t* capture_buffer = 0;
 static uint16_t* display_buffer = 0;
-static int offset = 0;
+static volatile int offset = 0;
 static uint dma_chan;
 static volatile unsigned short stop_capture;
-static uint16_t last_value, trigger_level = 24 * V5 / 50 + 1;
+static uint16_t trigger_level = 24 * V5 / 50 + 1;
+// steps of the h trigger command in mV, the signal has to move this far
+// back past the level before the next crossing counts, which stops noise retriggering
+static const uint16_t hysteresis_mv[] = { 0, 20, 50, 100, 200 };
+static uint8_t trigger_hysteresis = 0; // index into hysteresis_mv
 static int32_t display_trigger_offset = 50;         // offset from start of buffer in samples
 static int32_t display_trigger_position = 100 * 10; // trigger_offset in 1uS units
 static int32_t trigger_position, trigger_offset;
 static uint32_t trigger_point; // index of trigger point - saved actual pointer to trigger
-static unsigned char search_rising = 1, search_falling = 0, search_either = 0, first_sample, in_trigger_mode = 0;
+static unsigned char search_enabled = 1, first_sample, in_trigger_mode = 0;
+// the trigger search runs in a low priority interrupt pended by the DMA interrupt,
+// it walks every completed block from search_offset up to the one being captured
+static scope_trigger_t trigger;
+static int block_irq = -1;
+static volatile int search_offset;
 ;
 static uint32_t h_res = 100; // 100uS
 static uint8_t scope_pin = 0;
@@ -81,11 +114,30 @@ static uint8_t display = 0;
 static uint8_t caught = 0;
 static uint8_t no_switch = 0;
 static uint8_t triggered = 0;
+static int32_t display_trigger_sample = -1; // trigger point of the capture on screen, -1 if none
 static uint8_t scope_stopped = 1;
 static uint8_t scope_subsystem_stopped = 1;
 volatile uint8_t scope_running = 0;
 static volatile uint8_t scope_stop_waiting = 0;
 static unsigned char* fb = 0;
+static uint32_t* pixel_pairs = 0; // both pixels of an fb byte through clr[], in LCD byte order
+static uint32_t* line_buf[2];     // ping-pong lines for the DMA push
+static unsigned char* fb_sent = 0; // copy of what the LCD shows, only changed columns are sent
+static bool fb_sent_valid = false;
+static uint16_t* env_level[ENV_LEVELS]; // min, max pairs
+static uint16_t* env_column;            // min, max pairs of each trace column, raw ADC values
+static bool env_valid = false;          // env_level matches the display buffer
+static uint32_t env_start, env_samples, env_width, env_columns; // what env_column holds, nothing if env_columns is 0
+static int16_t* fft_re;
+static int16_t* fft_im;
+static uint8_t spectrum_log2 = 0; // FFT size of the spectrum view, 0 shows the trace
+static scope_measure_block_t* measure_block; // summary of each capture block
+static scope_measure_t measure;
+static volatile int measure_offset; // next block to summarise
+static scope_measure_frame_t measured; // the capture on screen
+static bool measured_valid = false;
+// redraw statistics for the si command
+static uint32_t stat_frames, stat_bytes, stat_last_bytes, stat_last_spans, stat_start_us, stat_fft_us;
 typedef enum {
     SMODE_ONCE,
     SMODE_NORMAL,
@@ -146,6 +198,9 @@ static void scope_start(int pin);
 static void scope_stop(void);
 static void scope_shutdown(int now);
 static void switch_buffers(void);
+static uint32_t scope_sample_rate(void);
+static uint32_t measure_mv(uint32_t counts);
+static void measure_frequency(char* b, uint32_t size);
 
 const char* scope_error(void) {
     return GET_T(T_MODE_ERROR_NO_EFFECT_HIZ);
@@ -172,6 +227,7 @@ void scope_help(void) {
     // printf("	0-7 which digital pin is the trigger pin\r\n");
     // printf("	v [0-9].[0-9] voltage level\r\n");
     printf("	+-*b  trigger on pos neg none both\r\n");
+    printf("	h hysteresis off/20/50/100/200mV, restarts the capture\r\n");
     printf("	BME move trigger point to beginning/middle/end\r\n");
     printf("\r\n");
     printf("x - timebase\r\n");
@@ -190,6 +246,14 @@ void scope_help(void) {
     printf("	a - auto\r\n");
     printf("\r\n");
     printf("ss - stop - button if running\r\n");
+    printf("si - redraw statistics\r\n");
+    printf("sf - spectrum view on/off\r\n");
+    printf("	256/512/1024 - FFT size\r\n");
+    printf("	0 - back to the trace\r\n");
+    printf("sm - measurements, frequency and duty use the trigger level\r\n");
+    printf("sw - save the capture on screen to storage\r\n");
+    printf("	csv - time and voltage text (default)\r\n");
+    printf("	wav - 16 bit PCM, trigger as a cue point\r\n");
 }
 
 void scope_cleanup(void) {
@@ -202,6 +266,12 @@ void scope_cleanup(void) {
     fb = 0;
     capture_buffer = 0;
     display_buffer = 0;
+    pixel_pairs = 0;
+    fb_sent = 0;
+    env_column = 0;
+    fft_re = 0;
+    fft_im = 0;
+    measure_block = 0;
     display = 0;
     amux_sweep();
 }
@@ -252,6 +322,29 @@ uint32_t scope_setup_exc(void) {
     fb = x;
     display_buffer = (uint16_t*)&x[VS * HS / 2];                                        // 2 byte aligned
     capture_buffer = (volatile uint16_t*)&x[VS * HS / 2 + 2 * BUFFERS * CAPTURE_DEPTH]; // 2 byte aligned
+    pixel_pairs = (uint32_t*)&x[VS * HS / 2 + 4 * BUFFERS * CAPTURE_DEPTH];              // 4 byte aligned
+    line_buf[0] = (uint32_t*)&x[VS * HS / 2 + 4 * BUFFERS * CAPTURE_DEPTH + PAIRS_SIZE];
+    line_buf[1] = line_buf[0] + LINE_BYTES / 4;
+    fb_sent = &x[VS * HS / 2 + 4 * BUFFERS * CAPTURE_DEPTH + PAIRS_SIZE + 2 * LINE_BYTES];
+    fb_sent_valid = false;
+    env_level[0] = (uint16_t*)&fb_sent[VS * HS / 2];
+    for (int i = 1; i < ENV_LEVELS; i++) {
+        env_level[i] = env_level[i - 1] + 2 * (ENV_ENTRIES >> (i - 1));
+    }
+    env_column = env_level[ENV_LEVELS - 1] + 2 * (ENV_ENTRIES >> (ENV_LEVELS - 1));
+    env_valid = false;
+    env_columns = 0;
+    fft_re = (int16_t*)&env_column[2 * HS];
+    fft_im = fft_re + SCOPE_FFT_MAX;
+    measure_block = (scope_measure_block_t*)&fft_im[SCOPE_FFT_MAX];
+    measured_valid = false;
+    stat_frames = 0;
+    stat_bytes = 0;
+    stat_start_us = time_us_32();
+    // low nibble is the left pixel, clr[] is already in the byte order the LCD wants
+    for (uint32_t i = 0; i < 256; i++) {
+        pixel_pairs[i] = clr[i & 0xf] | ((uint32_t)clr[i >> 4] << 16);
+    }
     display_sample_first = 0;
     display_sample_last = 0;
     scope_subsystem_stopped = 0;
@@ -295,53 +388,56 @@ static void dma_handler(void) {
         }
     }
     first_sample = 0;
+    // completed blocks are summarised and searched at a lower priority
+    irq_set_pending(block_irq);
     if (!stop_capture) {
         if (trigger_skip) { // let capture buffer fill to at least trigger point
             if (trigger_skip == 1) {
                 trigger_skip = 0;
-                last_value = capture_buffer[last_offset + CAPTURE_DEPTH - 1];
+                // searching starts with the block now being captured, arm from the last sample of this one
+                trigger.level = trigger_level;
+                scope_trigger_find(&trigger, (const uint16_t*)&capture_buffer[last_offset + CAPTURE_DEPTH - 1], 1);
+                search_offset = offset;
             } else {
                 trigger_skip--;
             }
             return;
         }
-        if (search_rising) {
-            unsigned short v, *tp = (unsigned short*)&capture_buffer[last_offset];
-            for (int i = 0; i < CAPTURE_DEPTH; i++) {
-                v = *tp++;
-                if (last_value <= trigger_level && v > trigger_level) {
-                    triggered = 1;
-                    trigger_point = i + last_offset;
-                    stop_capture = BUFFERS - 1 - (trigger_offset + CAPTURE_DEPTH - 1) / CAPTURE_DEPTH;
-                    break;
-                }
-                last_value = v;
-            }
-        } else if (search_falling) {
-            unsigned short v, *tp = (unsigned short*)&capture_buffer[last_offset];
-            for (int i = 0; i < CAPTURE_DEPTH; i++) {
-                v = *tp++;
-                if (last_value >= trigger_level && v < trigger_level) {
-                    triggered = 1;
-                    trigger_point = i + last_offset;
-                    stop_capture = BUFFERS - 1 - (trigger_offset + CAPTURE_DEPTH - 1) / CAPTURE_DEPTH;
-                    break;
-                }
-                last_value = v;
-            }
-        } else if (search_either) {
-            unsigned short v, *tp = (unsigned short*)&capture_buffer[last_offset];
-            for (int i = 0; i < CAPTURE_DEPTH; i++) {
-                v = *tp++;
-                if (last_value >= trigger_level ? v < trigger_level : v > trigger_level) {
-                    triggered = 1;
-                    trigger_point = i + last_offset;
-                    stop_capture = BUFFERS - 1 - (trigger_offset + CAPTURE_DEPTH - 1) / CAPTURE_DEPTH;
-                    break;
-                }
-                last_value = v;
-            }
+    }
+}
+
+// summarise and search every completed block, a trigger found late shortens the remaining capture
+// by the blocks that went by, one found too late to keep the pre-trigger samples is passed over
+static void block_handler(void) {
+    while (measure_offset != offset) {
+        int block = measure_offset;
+        scope_measure_block(&measure,
+                            &measure_block[block / CAPTURE_DEPTH],
+                            (const uint16_t*)&capture_buffer[block],
+                            CAPTURE_DEPTH);
+        measure_offset = (block + CAPTURE_DEPTH >= CAPTURE_DEPTH * BUFFERS) ? 0 : block + CAPTURE_DEPTH;
+    }
+    while (scope_running && search_enabled && !trigger_skip && !stop_capture && search_offset != offset) {
+        int block = search_offset;
+        trigger.level = trigger_level; // may be moved while running
+        int32_t i = scope_trigger_find(&trigger, (const uint16_t*)&capture_buffer[block], CAPTURE_DEPTH);
+        search_offset = (block + CAPTURE_DEPTH >= CAPTURE_DEPTH * BUFFERS) ? 0 : block + CAPTURE_DEPTH;
+        if (i < 0) {
+            continue;
+        }
+        uint32_t irq_state = save_and_disable_interrupts();
+        int lag = offset - search_offset;
+        if (lag < 0) {
+            lag += CAPTURE_DEPTH * BUFFERS;
+        }
+        lag /= CAPTURE_DEPTH;
+        int remaining = BUFFERS - 1 - (trigger_offset + CAPTURE_DEPTH - 1) / CAPTURE_DEPTH - lag;
+        if (!lag || remaining > 0) {
+            triggered = 1;
+            trigger_point = i + block;
+            stop_capture = remaining;
         }
+        restore_interrupts(irq_state);
     }
 }
 
@@ -350,6 +446,9 @@ static void scope_stop(void) {
         return;
     }
     irq_set_enabled(DMA_IRQ_0, false);
+    if (block_irq >= 0) {
+        irq_set_enabled(block_irq, false);
+    }
     dma_channel_set_irq0_enabled(dma_chan, false);
     adc_run(false);
     dma_channel_abort(dma_chan);
@@ -401,9 +500,19 @@ static void scope_start(int pin) {
     triggered = 0;
     sample_first = 0;
     sample_last = 0;
-    search_falling = trigger_type == TRIGGER_NEG;
-    search_either = trigger_type == TRIGGER_BOTH;
-    search_rising = trigger_type == TRIGGER_POS;
+    search_enabled = trigger_type != TRIGGER_NONE;
+    scope_trigger_init(&trigger,
+                       trigger_type == TRIGGER_NEG    ? SCOPE_TRIGGER_FALLING
+                       : trigger_type == TRIGGER_BOTH ? SCOPE_TRIGGER_EITHER
+                                                      : SCOPE_TRIGGER_RISING,
+                       trigger_level,
+                       hysteresis_mv[trigger_hysteresis] * V5 / 5000);
+    uint16_t mv = hysteresis_mv[trigger_hysteresis];
+    if (mv < MEASURE_HYSTERESIS_MV) {
+        mv = MEASURE_HYSTERESIS_MV;
+    }
+    scope_measure_init(&measure, trigger_level, mv * V5 / 5000);
+    measure_offset = 0;
     scope_stop_waiting = 0;
     first_sample = 1;
     // adc_init();
@@ -478,6 +587,12 @@ static void scope_start(int pin) {
     dma_channel_set_irq0_enabled(dma_chan, true);
     irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
     irq_set_enabled(DMA_IRQ_0, true);
+    if (block_irq < 0) {
+        block_irq = user_irq_claim_unused(true);
+        irq_set_exclusive_handler(block_irq, block_handler);
+        irq_set_priority(block_irq, PICO_LOWEST_IRQ_PRIORITY);
+    }
+    irq_set_enabled(block_irq, true);
     dma_hw->ints0 = 1u << dma_chan;
     offset = 0;
     stop_capture = 0;
@@ -551,6 +666,14 @@ static void trigger_up(void) {
     display = 1;
 }
 
+static void trigger_next_hysteresis(void) {
+    trigger_hysteresis = (trigger_hysteresis + 1) % count_of(hysteresis_mv);
+    if (scope_running) {
+        scope_restart(scope_pin);
+    }
+    display = 1;
+}
+
 static void trigger_down(void) {
     int d = trigger_level - (dy * 5 * 8 * 100 / V5 - 1);
     if (d < 0) {
@@ -660,13 +783,16 @@ uint32_t scope_commands(struct command_result* result) {
     //  t - scope trigger +-nb up down left right ports- num
     //  sr - run [pin]
     //  ss - stop
+    //  si - redraw statistics
     //
     //
     // hack to discard the command
     char args[5];
     cmdln_args_string_by_position(0, sizeof(args), args);
     if (!(args[0] == 'x' || args[0] == 'y' || args[0] == 't' || (args[0] == 's' && args[1] == 'r') ||
-          (args[0] == 's' && args[1] == 's'))) {
+          (args[0] == 's' && args[1] == 's') || (args[0] == 's' && args[1] == 'i') ||
+          (args[0] == 's' && args[1] == 'f') || (args[0] == 's' && args[1] == 'm') ||
+          (args[0] == 's' && args[1] == 'w'))) {
         return 0;
     }
 
@@ -703,7 +829,7 @@ uint32_t scope_commands(struct command_result* result) {
     do_t:
         in_trigger_mode = 1;
         display = 1;
-        printf("Trigger: +-*b ^v<>T BME xy rsona> ");
+        printf("Trigger: +-*b h ^v<>T BME xy rsona> ");
         // printf("Trigger: a 0-7 +-*b ^v<>T BME xy rsona> ");
         while ((c = next_char()) != 0) {
             switch (c) {
@@ -782,6 +908,9 @@ uint32_t scope_commands(struct command_result* result) {
                     trigger_type = TRIGGER_BOTH;
                     display = 1;
                     break;
+                case 'h':
+                    trigger_next_hysteresis();
+                    break;
                 case 'v':
                 case 'V':
                     trigger_down();
@@ -1287,6 +1416,153 @@ uint32_t scope_commands(struct command_result* result) {
         scope_shutdown(1);
         no_switch = 1;
         system_config.info_bar_changed = 1;
+    } else if (strcmp(args, "si") == 0) {
+        // frames and LCD traffic since the last si
+        uint32_t us = time_us_32() - stat_start_us;
+        uint32_t fps10 = us ? (uint32_t)((uint64_t)stat_frames * 10000000 / us) : 0;
+        printf("Frames: %d, %d.%d fps, %d bytes/frame average\r\n",
+               stat_frames,
+               fps10 / 10,
+               fps10 % 10,
+               stat_frames ? stat_bytes / stat_frames : 0);
+        printf("Last frame: %d bytes in %d spans, full frame %d bytes\r\n",
+               stat_last_bytes,
+               stat_last_spans,
+               HS * VS * 2);
+        if (spectrum_log2) {
+            printf("Last FFT: %d points in %dus\r\n", 1 << spectrum_log2, stat_fft_us);
+        }
+        stat_frames = 0;
+        stat_bytes = 0;
+        stat_start_us = time_us_32();
+    } else if (strcmp(args, "sf") == 0) {
+        // spectrum view
+        // '' - toggle, 1024 points
+        // 256/512/1024 - FFT size
+        // 0 - trace
+        uint32_t points = 0;
+        bool number = false;
+        for (;;) {
+            char c;
+            if (!cmdln_try_peek(0, &c)) {
+                break;
+            }
+            cmdln_try_discard(1);
+            if (c == 0) {
+                break;
+            }
+            if (c == ' ') {
+                continue;
+            }
+            if (c < '0' || c > '9') {
+                printf("invalid spectrum size '%c'\r\n", c);
+                return 0;
+            }
+            points = points * 10 + c - '0';
+            number = true;
+        }
+        if (!number) {
+            spectrum_log2 = spectrum_log2 ? 0 : SCOPE_FFT_MAX_LOG2;
+        } else if (points == 0) {
+            spectrum_log2 = 0;
+        } else if (points == 256) {
+            spectrum_log2 = 8;
+        } else if (points == 512) {
+            spectrum_log2 = 9;
+        } else if (points == SCOPE_FFT_MAX) {
+            spectrum_log2 = SCOPE_FFT_MAX_LOG2;
+        } else {
+            printf("spectrum size is 256, 512 or 1024\r\n");
+            return 0;
+        }
+        display = 1;
+    } else if (strcmp(args, "sm") == 0) {
+        // measurements of the capture on screen
+        if (!measured_valid) {
+            printf("No capture to measure\r\n");
+            return 0;
+        }
+        char f[16];
+        uint32_t min = measure_mv(measured.min);
+        uint32_t max = measure_mv(measured.max);
+        uint32_t rms = measure_mv(scope_measure_rms(&measured));
+        uint32_t mean = measure_mv(scope_measure_mean(&measured));
+        uint32_t level = measure_mv(measure.threshold);
+        uint32_t duty = measured.high * 1000 / measured.samples;
+        measure_frequency(f, sizeof(f));
+        printf("Vpp: %d.%03dV (min %d.%03dV, max %d.%03dV)\r\n",
+               (max - min) / 1000,
+               (max - min) % 1000,
+               min / 1000,
+               min % 1000,
+               max / 1000,
+               max % 1000);
+        printf("Vrms: %d.%03dV, mean: %d.%03dV\r\n", rms / 1000, rms % 1000, mean / 1000, mean % 1000);
+        printf("Frequency: %s, duty: %d.%d%% (%d rising edges through %d.%03dV)\r\n",
+               f,
+               duty / 10,
+               duty % 10,
+               measured.edges,
+               level / 1000,
+               level % 1000);
+        printf("Samples: %d\r\n", measured.samples);
+    } else if (strcmp(args, "sw") == 0) {
+        // save the capture on screen
+        // '' or csv - text
+        // wav - 16 bit PCM
+        char word[4];
+        uint32_t len = 0;
+        for (;;) {
+            char c;
+            if (!cmdln_try_peek(0, &c)) {
+                break;
+            }
+            cmdln_try_discard(1);
+            if (c == 0) {
+                break;
+            }
+            if (c == ' ') {
+                continue;
+            }
+            if (len == sizeof(word) - 1) {
+                len++; // too long for either format
+                break;
+            }
+            word[len++] = c;
+        }
+        word[(len < sizeof(word)) ? len : sizeof(word) - 1] = 0;
+        enum scope_file_format format;
+        if (len == 0 || strcmp(word, "csv") == 0) {
+            format = SCOPE_FILE_CSV;
+        } else if (len < sizeof(word) && strcmp(word, "wav") == 0) {
+            format = SCOPE_FILE_WAV;
+        } else {
+            printf("save as csv or wav\r\n");
+            return 0;
+        }
+        if (!caught) {
+            printf("No capture to save\r\n");
+            return 0;
+        }
+        uint32_t ring = BUFFERS * CAPTURE_DEPTH;
+        // stop core1 drawing frames, it would switch buffers and draw the spectrum under the file writes
+        icm_core0_send_message_synchronous(BP_ICM_DISABLE_LCD_UPDATES);
+        scope_file_capture_t capture = {
+            .ring = display_buffer,
+            .ring_size = ring,
+            .first = display_sample_first,
+            .count = (display_sample_last + ring - display_sample_first) % ring + 1,
+            .trigger = display_trigger_sample,
+            .sample_rate = scope_sample_rate(),
+            .us_per_div = 50000000 / display_timebase,
+            .full_scale = V5,
+            .pin = scope_pin,
+            .work = (uint8_t*)fft_re, // free while LCD updates are off
+            .work_size = FFT_SIZE,
+        };
+        scope_file_save(format, &capture);
+        icm_core0_send_message_synchronous(BP_ICM_ENABLE_LCD_UPDATES);
+        display = 1;
     } else {
         return 0;
     }
@@ -1403,9 +1679,111 @@ static void draw_text(int x, int y, const FONT_INFO* font, CLR c, char* cp) // s
     }
 }
 
+// min/max of each aligned block of the display buffer, once per capture
+static void scope_env_build(void) {
+    const uint16_t* b = display_buffer; // only called when not volatile
+    uint16_t* e = env_level[0];
+    for (uint32_t i = 0; i < ENV_ENTRIES; i++) {
+        uint16_t lo = *b;
+        uint16_t hi = *b;
+        for (uint32_t j = 1; j < ENV_BLOCK; j++) {
+            uint16_t y = b[j];
+            if (y < lo) {
+                lo = y;
+            }
+            if (y > hi) {
+                hi = y;
+            }
+        }
+        b += ENV_BLOCK;
+        *e++ = lo;
+        *e++ = hi;
+    }
+    for (int l = 1; l < ENV_LEVELS; l++) {
+        const uint16_t* s = env_level[l - 1];
+        e = env_level[l];
+        for (uint32_t i = 0; i < (ENV_ENTRIES >> l); i++) {
+            *e++ = (s[0] < s[2]) ? s[0] : s[2];
+            *e++ = (s[1] > s[3]) ? s[1] : s[3];
+            s += 4;
+        }
+    }
+    env_valid = true;
+}
+
+// widen lo/hi by count samples from start, which must not cross the end of the ring
+static void scope_env_range(uint32_t start, uint32_t count, uint16_t* lo, uint16_t* hi) {
+    const uint16_t* b = display_buffer;
+    while (count) {
+        uint16_t l, h;
+        if (!(start & (ENV_BLOCK - 1)) && count >= ENV_BLOCK) {
+            // largest aligned block that fits
+            int level = 0;
+            while (level < ENV_LEVELS - 1 && !(start & (ENV_BLOCK << level)) &&
+                   count >= (uint32_t)(ENV_BLOCK << (level + 1))) {
+                level++;
+            }
+            const uint16_t* e = &env_level[level][2 * (start / (ENV_BLOCK << level))];
+            l = e[0];
+            h = e[1];
+            start += ENV_BLOCK << level;
+            count -= ENV_BLOCK << level;
+        } else {
+            l = h = b[start++];
+            count--;
+        }
+        if (l < *lo) {
+            *lo = l;
+        }
+        if (h > *hi) {
+            *hi = h;
+        }
+    }
+}
+
+// envelope of each trace column starting at sample start, returns the number of columns
+// columns stay cached until the capture or the pan and zoom change
+static uint32_t scope_env_columns(uint32_t start, uint32_t columns) {
+    if (env_columns && env_start == start && env_samples == display_samples && env_width == columns) {
+        return env_columns;
+    }
+    if (!env_valid) {
+        scope_env_build();
+    }
+    env_start = start;
+    env_samples = display_samples;
+    env_width = columns;
+    // samples from start up to and including the last one captured
+    uint32_t avail = display_sample_last + BUFFERS * CAPTURE_DEPTH - start + 1;
+    if (avail > BUFFERS * CAPTURE_DEPTH) {
+        avail -= BUFFERS * CAPTURE_DEPTH;
+    }
+    uint32_t i;
+    for (i = 0; i < columns && avail; i++) {
+        uint32_t n = (avail < display_samples) ? avail : display_samples;
+        uint16_t lo = 0xffff;
+        uint16_t hi = 0;
+        avail -= n;
+        if (start + n > BUFFERS * CAPTURE_DEPTH) {
+            uint32_t first = BUFFERS * CAPTURE_DEPTH - start;
+            scope_env_range(start, first, &lo, &hi);
+            start = 0;
+            n -= first;
+        }
+        scope_env_range(start, n, &lo, &hi);
+        start += n;
+        if (start >= BUFFERS * CAPTURE_DEPTH) {
+            start = 0;
+        }
+        env_column[2 * i] = lo;
+        env_column[2 * i + 1] = hi;
+    }
+    env_columns = i;
+    return i;
+}
+
 static void draw_trace(CLR c) {
     unsigned char* p = &fb[0];
-    uint16_t* b = (uint16_t*)&display_buffer[0]; // only called when not volatile
     int16_t v1[HS];
     int16_t v2[HS];
     int x;
@@ -1418,7 +1796,6 @@ static void draw_trace(CLR c) {
     if (offset >= (BUFFERS * CAPTURE_DEPTH)) {
         offset -= BUFFERS * CAPTURE_DEPTH;
     }
-    b += offset;
     int xlast = HS;
     if (display_sample_first <= display_sample_last) {
         if (offset > display_sample_last || offset < display_sample_first) {
@@ -1429,9 +1806,12 @@ static void draw_trace(CLR c) {
             return;
         }
     }
-    for (x = 0; x < HS;) {
-        for (int i = 0; i < display_samples; i++) {
-            uint32_t y = *b++;
+    // every sample of a column lands between its min and max, so narrow glitches stay visible
+    uint32_t columns = scope_env_columns(offset, (HS + display_zoom - 1) / display_zoom);
+    x = 0;
+    for (uint32_t i = 0; i < columns; i++) {
+        for (int j = 0; j < 2; j++) {
+            uint32_t y = env_column[2 * i + j];
 
             int d = (y * VS * 100 / V5 / dy) - df;
             if (d < 0) {
@@ -1441,30 +1821,14 @@ static void draw_trace(CLR c) {
                     d = VS;
                 }
             }
-            if (i == 0) {
+            if (j == 0) {
                 v1[x] = d;
-                v2[x] = d;
             } else {
-                if (d < v1[x]) {
-                    v1[x] = d;
-                }
-                if (d > v2[x]) {
-                    v2[x] = d;
-                }
-            }
-            if (offset == display_sample_last) {
-                x += display_zoom;
-                goto xdone;
-            }
-            offset++;
-            if (offset >= (BUFFERS * CAPTURE_DEPTH)) {
-                offset = 0;
-                b = (uint16_t*)&display_buffer[0];
+                v2[x] = d;
             }
         }
         x += display_zoom;
     }
-xdone:
     xlast = x;
     y1 = v1[0];
     y2 = v2[0];
@@ -1834,6 +2198,13 @@ static void draw_triggers(int minimal) {
         }
         *cp++ = 'V';
         *cp++ = ' ';
+        if (trigger_hysteresis) {
+            *cp++ = '~';
+            cp += xnum(cp, hysteresis_mv[trigger_hysteresis], 1);
+            *cp++ = 'm';
+            *cp++ = 'V';
+            *cp++ = ' ';
+        }
         int t = display_trigger_position / 10;
         if (t < 1000) {
             cp += xnum(cp, t, 1);
@@ -1865,11 +2236,111 @@ static void draw_triggers(int minimal) {
     }
 }
 
+// samples per second of the capture on screen
+static uint32_t scope_sample_rate(void) {
+    return display_timebase * display_samples / display_zoom;
+}
+
+static uint32_t measure_mv(uint32_t counts) {
+    return counts * 5000 / V5;
+}
+
+// from the rising crossings of the trigger level
+static void measure_frequency(char* b, uint32_t size) {
+    if (measured.edges < 2) {
+        snprintf(b, size, "--Hz");
+        return;
+    }
+    uint32_t span = measured.last_edge - measured.first_edge;
+    uint64_t mhz = (uint64_t)(measured.edges - 1) * scope_sample_rate() * 1000 / span;
+    if (mhz >= 1000000) {
+        snprintf(b, size, "%d.%03dkHz", (uint32_t)(mhz / 1000000), (uint32_t)(mhz / 1000 % 1000));
+    } else {
+        snprintf(b, size, "%d.%03dHz", (uint32_t)(mhz / 1000), (uint32_t)(mhz % 1000));
+    }
+}
+
+// under the pin label
+static void draw_measurements(void) {
+    char b[40];
+    uint32_t vpp = measure_mv(measured.max - measured.min);
+    uint32_t rms = measure_mv(scope_measure_rms(&measured));
+    uint32_t mean = measure_mv(scope_measure_mean(&measured));
+    uint32_t duty = measured.high * 1000 / measured.samples;
+
+    snprintf(b, sizeof(b), "%d.%02dVpp %d.%02dVrms", vpp / 1000, vpp % 1000 / 10, rms / 1000, rms % 1000 / 10);
+    draw_text(308 - (strlen(b) * 12), 33, &hunter_12ptFontInfo, GY, &b[0]);
+    int n = snprintf(b, sizeof(b), "%d.%02dV ", mean / 1000, mean % 1000 / 10);
+    measure_frequency(&b[n], sizeof(b) - n);
+    n = strlen(b);
+    snprintf(&b[n], sizeof(b) - n, " %d%%", (duty + 5) / 10);
+    draw_text(308 - (strlen(b) * 12), 51, &hunter_12ptFontInfo, GY, &b[0]);
+}
+
+// spectrum of the capture from the left edge of the view, 0dB at the top is a full range sine
+static void draw_spectrum(CLR c) {
+    char b[40];
+    char* cp = &b[0];
+    uint32_t n = 1u << spectrum_log2;
+    uint32_t f = scope_sample_rate() / 2; // highest frequency shown
+
+    cp += xnum(cp, n, 1);
+    strcpy(cp, "pt 20dB/");
+    draw_text(HS - 12 - (strlen(b) * 12), VS - 5, &hunter_12ptFontInfo, GY, &b[0]);
+    cp = &b[0];
+    *cp++ = '0';
+    *cp++ = '-';
+    cp += xnum(cp, (f >= 1000) ? f / 1000 : f, 1);
+    strcpy(cp, (f >= 1000) ? "kHz" : "Hz");
+    draw_text(5, VS - 5, &hunter_12ptFontInfo, GY, &b[0]);
+
+    uint32_t ring = BUFFERS * CAPTURE_DEPTH;
+    uint32_t total = (display_sample_last + ring - display_sample_first) % ring + 1;
+    if (!caught || total < n) {
+        return;
+    }
+    // the last n samples if the view is closer than that to the end
+    uint32_t skip = xoffset * 50 * display_samples / display_zoom;
+    if (skip > total - n) {
+        skip = total - n;
+    }
+    uint32_t t = time_us_32();
+    scope_fft_load(fft_re, fft_im, display_buffer, ring, (display_sample_first + skip) % ring, spectrum_log2);
+    scope_fft(fft_re, fft_im, spectrum_log2);
+    stat_fft_us = time_us_32() - t;
+
+    // peak of the bins under each column, DC is left out
+    uint32_t bins = n / 2;
+    for (int x = 0; x < HS; x++) {
+        uint32_t k = 1 + x * (bins - 1) / HS;
+        uint32_t k_end = 1 + (x + 1) * (bins - 1) / HS;
+        int db = SCOPE_FFT_FLOOR;
+        do {
+            int d = scope_fft_db(fft_re[k], fft_im[k]);
+            if (d > db) {
+                db = d;
+            }
+        } while (++k < k_end);
+        int y = -db * (VS / 5) / 200; // 0.1dB units
+        if (y < VS) {
+            draw_v_line(x, (y < 0) ? 0 : y, VS - 1, c);
+        }
+    }
+}
+
 static void draw_scope() {
     char b[40];
     char *s1, *s2;
     int unit;
     draw_grid(PY);
+    if (spectrum_log2) {
+        strcpy(b, "Pin");
+        b[3] = '0' + scope_pin;
+        b[4] = 0;
+        draw_text(308 - (strlen(b) * 12), 15, &hunter_12ptFontInfo, GY, &b[0]);
+        draw_spectrum(B);
+        return;
+    }
 
     switch (dy) {
         case 100:
@@ -2039,6 +2510,9 @@ static void draw_scope() {
     b[3] = '0' + scope_pin;
     b[4] = 0;
     draw_text(308 - (strlen(b) * 12), 15, &hunter_12ptFontInfo, GY, &b[0]);
+    if (caught && measured_valid) {
+        draw_measurements();
+    }
     if (in_trigger_mode) {
         draw_triggers(0);
     } else {
@@ -2049,30 +2523,153 @@ static void draw_scope() {
     }
 }
 
-static void scope_write() {
-    uint16_t x, y;
+static void scope_expand_line(int y, int x, int width, uint32_t* line) {
+    const unsigned char* p = &fb[y * (HS / 2) + x / 2];
+    for (int i = 0; i < width / 2; i++) {
+        line[i] = pixel_pairs[p[i]];
+    }
+    memcpy(&fb_sent[y * (HS / 2) + x / 2], p, width / 2);
+}
+
+// flag every DIRTY_WIDTH pixel column where fb differs from what the LCD shows
+static void scope_dirty_columns(bool* dirty) {
+    const uint32_t* a = (const uint32_t*)fb;
+    const uint32_t* b = (const uint32_t*)fb_sent;
+    memset(dirty, 0, DIRTY_COLS);
+    for (int y = 0; y < VS; y++) {
+        for (int i = 0; i < DIRTY_COLS; i++) {
+            if (a[i] != b[i]) {
+                dirty[i] = true;
+            }
+        }
+        a += DIRTY_COLS;
+        b += DIRTY_COLS;
+    }
+}
 
-    lcd_set_bounding_box(0, VS, 0, HS);
+// send columns x to x+width-1 of every line, line y+1 is expanded while DMA sends line y
+static void scope_write_span(int chan, int x, int width) {
+    lcd_set_bounding_box(0, VS - 1, x, x + width - 1);
 
     spi_busy_wait(true);
     gpio_put(DISPLAY_DP, 1);
     gpio_put(DISPLAY_CS, 0);
 
-    for (uint32_t b = 0; b < (HS * VS / 2); b += 1) {
-        unsigned char x = fb[b];
-        spi_write_blocking(BP_SPI_PORT, (unsigned char*)&clr[x & 0xf], 2);
-        spi_write_blocking(BP_SPI_PORT, (unsigned char*)&clr[(x >> 4) & 0xf], 2);
+    if (chan < 0) {
+        for (int y = 0; y < VS; y++) {
+            scope_expand_line(y, x, width, line_buf[0]);
+            spi_write_blocking(BP_SPI_PORT, (uint8_t*)line_buf[0], width * 2);
+        }
+    } else {
+        dma_channel_set_trans_count(chan, width * 2, false);
+        scope_expand_line(0, x, width, line_buf[0]);
+        for (int y = 0; y < VS; y++) {
+            dma_channel_set_read_addr(chan, line_buf[y & 1], true);
+            if (y + 1 < VS) {
+                scope_expand_line(y + 1, x, width, line_buf[(y + 1) & 1]);
+            }
+            dma_channel_wait_for_finish_blocking(chan);
+        }
+        spi_dma_finish();
     }
 
     gpio_put(DISPLAY_CS, 1);
     spi_busy_wait(false);
 }
 
+// send only the column spans that changed since the last frame, everything after a full invalidate
+static void scope_write() {
+    bool dirty[DIRTY_COLS];
+    if (fb_sent_valid) {
+        scope_dirty_columns(dirty);
+    } else {
+        memset(dirty, true, sizeof(dirty));
+        fb_sent_valid = true;
+    }
+
+    int chan = dma_claim_unused_channel(false);
+    if (chan >= 0) {
+        dma_channel_config c = dma_channel_get_default_config(chan);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_dreq(&c, spi_get_dreq(BP_SPI_PORT, true));
+        dma_channel_configure(chan, &c, &spi_get_hw(BP_SPI_PORT)->dr, NULL, LINE_BYTES, false);
+    }
+
+    stat_last_bytes = 0;
+    stat_last_spans = 0;
+    for (int i = 0; i < DIRTY_COLS;) {
+        if (!dirty[i]) {
+            i++;
+            continue;
+        }
+        int start = i;
+        while (i < DIRTY_COLS && dirty[i]) {
+            i++;
+        }
+        scope_write_span(chan, start * DIRTY_WIDTH, (i - start) * DIRTY_WIDTH);
+        stat_last_bytes += (i - start) * DIRTY_WIDTH * VS * 2;
+        stat_last_spans++;
+    }
+
+    if (chan >= 0) {
+        dma_channel_unclaim(chan);
+    }
+    stat_frames++;
+    stat_bytes += stat_last_bytes;
+}
+
 static int64_t auto_wakeup(alarm_id_t id, void* user_data) {
     auto_wakeup_triggered = 1;
     return 0;
 }
 
+// finish the block summaries the interrupt didn't get to and add up the capture on screen
+static void scope_measure_capture(void) {
+    uint32_t ring = BUFFERS * CAPTURE_DEPTH;
+    uint32_t p = display_sample_first;
+    uint32_t end = display_sample_last + 1;
+
+    measured_valid = false;
+    if (end % CAPTURE_DEPTH) {
+        return; // didn't stop at the end of a block
+    }
+    if (end >= ring) {
+        end = 0;
+    }
+    while (measure_offset != end) {
+        int block = measure_offset;
+        scope_measure_block(&measure, &measure_block[block / CAPTURE_DEPTH], &display_buffer[block], CAPTURE_DEPTH);
+        measure_offset = (block + CAPTURE_DEPTH >= ring) ? 0 : block + CAPTURE_DEPTH;
+    }
+
+    scope_measure_frame_init(&measured);
+    uint32_t head = p % CAPTURE_DEPTH;
+    if (head) {
+        // a triggered capture starts part way into a block, summarise just that part
+        scope_measure_t m;
+        scope_measure_block_t b;
+        scope_measure_init(&m, measure.threshold, measure.hysteresis);
+        scope_measure_block(&m, &b, &display_buffer[p], CAPTURE_DEPTH - head);
+        scope_measure_frame_add(&measured, &b, CAPTURE_DEPTH - head);
+        p += CAPTURE_DEPTH - head;
+        if (p >= ring) {
+            p = 0;
+        }
+    }
+    if (!head || p != end) {
+        do {
+            scope_measure_frame_add(&measured, &measure_block[p / CAPTURE_DEPTH], CAPTURE_DEPTH);
+            p += CAPTURE_DEPTH;
+            if (p >= ring) {
+                p = 0;
+            }
+        } while (p != end);
+    }
+    measured_valid = true;
+}
+
 static void switch_buffers(void) {
     uint16_t* x;
     if (no_switch) {
@@ -2083,6 +2680,9 @@ static void switch_buffers(void) {
         capture_buffer = x;
         display_sample_first = sample_first;
         display_sample_last = sample_last;
+        display_trigger_sample = triggered ? trigger_offset : -1;
+        env_valid = false;
+        env_columns = 0;
         display_zoom = zoom;
         display_samples = samples;
         int t = timebase;
@@ -2278,6 +2878,7 @@ static void switch_buffers(void) {
         }
         // display_timebase = timebase;
         display_base_timebase = base_timebase;
+        scope_measure_capture();
         if (!in_trigger_mode) {
             display_trigger_offset = trigger_offset;
             display_trigger_position = trigger_position;
@@ -2304,6 +2905,11 @@ void scope_lcd_update(uint32_t flags) {
             display = 1;
         }
     }
+    if (flags & UI_UPDATE_FORCE) {
+        // something else drew on the LCD, repaint all of it
+        fb_sent_valid = false;
+        display = 1;
+    }
     if (!display) {
         return;
     }
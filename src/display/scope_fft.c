@@ -0,0 +1,185 @@
+// Scope spectrum
+// Decimation in time FFT: the samples are loaded in bit reversed order, then pairs
+// of radix 2 stages are done together as one radix 4 pass so every value is loaded
+// and stored once per two stages. An odd number of stages starts with a plain radix 2
+// pass, which needs no multiplies.
+#include <stdint.h>
+#include "display/scope_fft.h"
+
+// sin(2 * pi * i / SCOPE_FFT_MAX) in Q15, a quarter wave
+static const int16_t fft_sin[SCOPE_FFT_MAX / 4 + 1] = {
+    0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+    2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+    4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6786, 6983,
+    7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+    9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+    11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+    14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269, 15446, 15623, 15800, 15976,
+    16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+    18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000,
+    20159, 20317, 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+    22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311, 23452, 23592,
+    23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+    25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674,
+    26790, 26905, 27019, 27133, 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+    28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+    29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+    30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050,
+    31113, 31176, 31237, 31297, 31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+    31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250,
+    32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+    32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752,
+    32757, 32761, 32765, 32766, 32767,
+};
+
+// log2(1 + i / 32) in Q8
+static const uint8_t fft_log2[32] = {
+    0, 11, 22, 33, 44, 54, 63, 73, 82, 92, 100, 109, 118, 126, 134, 142, 150,
+    157, 165, 172, 179, 186, 193, 200, 207, 213, 220, 226, 232, 238, 244, 250,
+};
+
+static const uint8_t fft_rev4[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+// angle 2 * pi * i / SCOPE_FFT_MAX, 0 <= i < SCOPE_FFT_MAX / 2
+static inline void fft_twiddle(uint32_t i, int32_t* c, int32_t* s) {
+    if (i <= SCOPE_FFT_MAX / 4) {
+        *c = fft_sin[SCOPE_FFT_MAX / 4 - i];
+        *s = fft_sin[i];
+    } else {
+        *c = -fft_sin[i - SCOPE_FFT_MAX / 4];
+        *s = fft_sin[SCOPE_FFT_MAX / 2 - i];
+    }
+}
+
+static inline int32_t fft_cos(uint32_t i) {
+    int32_t c, s;
+    if (i > SCOPE_FFT_MAX / 2) {
+        i = SCOPE_FFT_MAX - i;
+    }
+    if (i == SCOPE_FFT_MAX / 2) {
+        return -fft_sin[SCOPE_FFT_MAX / 4];
+    }
+    fft_twiddle(i, &c, &s);
+    return c;
+}
+
+void scope_fft_load(int16_t* re,
+                    int16_t* im,
+                    const uint16_t* ring,
+                    uint32_t ring_size,
+                    uint32_t start,
+                    uint32_t log2n) {
+    uint32_t n = 1u << log2n;
+    uint32_t sum = 0;
+    uint32_t p = start;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += ring[p];
+        if (++p >= ring_size) {
+            p = 0;
+        }
+    }
+    int32_t mean = sum >> log2n;
+
+    p = start;
+    for (uint32_t i = 0; i < n; i++) {
+        // 12 bit counts to Q15
+        int32_t v = (ring[p] - mean) * 8;
+        if (v > 32767) {
+            v = 32767;
+        } else if (v < -32767) {
+            v = -32767;
+        }
+        if (++p >= ring_size) {
+            p = 0;
+        }
+        // Hann window, (1 - cos) / 2
+        int32_t w = (32767 - fft_cos(i << (SCOPE_FFT_MAX_LOG2 - log2n))) >> 1;
+        uint32_t r = (fft_rev4[i & 15] << 8) | (fft_rev4[(i >> 4) & 15] << 4) | fft_rev4[i >> 8];
+        r >>= 12 - log2n;
+        re[r] = (v * w) >> 15;
+        im[r] = 0;
+    }
+}
+
+// first stage, twiddle factors are all 1
+static void fft_radix2(int16_t* re, int16_t* im, uint32_t n) {
+    for (uint32_t i = 0; i < n; i += 2) {
+        int32_t ar = re[i], ai = im[i];
+        int32_t br = re[i + 1], bi = im[i + 1];
+        re[i] = (ar + br) >> 1;
+        im[i] = (ai + bi) >> 1;
+        re[i + 1] = (ar - br) >> 1;
+        im[i + 1] = (ai - bi) >> 1;
+    }
+}
+
+// stages with butterfly spans m and 2 * m
+static void fft_radix4(int16_t* re, int16_t* im, uint32_t n, uint32_t m) {
+    uint32_t step = SCOPE_FFT_MAX / (4 * m);
+    for (uint32_t k = 0; k < m; k++) {
+        int32_t c1, s1, c2, s2;
+        fft_twiddle(2 * k * step, &c1, &s1);
+        fft_twiddle(k * step, &c2, &s2);
+        for (uint32_t g = k; g < n; g += 4 * m) {
+            int16_t* r = &re[g];
+            int16_t* i = &im[g];
+            int32_t x0r = r[0], x0i = i[0];
+            int32_t x1r = r[m], x1i = i[m];
+            int32_t x2r = r[2 * m], x2i = i[2 * m];
+            int32_t x3r = r[3 * m], x3i = i[3 * m];
+            int32_t tr, ti;
+
+            // span m: x1 and x3 times exp(-j * 2 * pi * k / 2m)
+            tr = (x1r * c1 + x1i * s1) >> 15;
+            ti = (x1i * c1 - x1r * s1) >> 15;
+            int32_t a0r = (x0r + tr) >> 1, a0i = (x0i + ti) >> 1;
+            int32_t a1r = (x0r - tr) >> 1, a1i = (x0i - ti) >> 1;
+            tr = (x3r * c1 + x3i * s1) >> 15;
+            ti = (x3i * c1 - x3r * s1) >> 15;
+            int32_t a2r = (x2r + tr) >> 1, a2i = (x2i + ti) >> 1;
+            int32_t a3r = (x2r - tr) >> 1, a3i = (x2i - ti) >> 1;
+
+            // span 2m: a2 times exp(-j * 2 * pi * k / 4m), a3 times the same and -j
+            tr = (a2r * c2 + a2i * s2) >> 15;
+            ti = (a2i * c2 - a2r * s2) >> 15;
+            r[0] = (a0r + tr) >> 1;
+            i[0] = (a0i + ti) >> 1;
+            r[2 * m] = (a0r - tr) >> 1;
+            i[2 * m] = (a0i - ti) >> 1;
+            tr = (a3i * c2 - a3r * s2) >> 15;
+            ti = -((a3r * c2 + a3i * s2) >> 15);
+            r[m] = (a1r + tr) >> 1;
+            i[m] = (a1i + ti) >> 1;
+            r[3 * m] = (a1r - tr) >> 1;
+            i[3 * m] = (a1i - ti) >> 1;
+        }
+    }
+}
+
+void scope_fft(int16_t* re, int16_t* im, uint32_t log2n) {
+    uint32_t n = 1u << log2n;
+    uint32_t m = 1;
+    if (log2n & 1) {
+        fft_radix2(re, im, n);
+        m = 2;
+    }
+    for (; m < n; m *= 4) {
+        fft_radix4(re, im, n, m);
+    }
+}
+
+int16_t scope_fft_db(int16_t re, int16_t im) {
+    uint32_t p = (int32_t)re * re + (int32_t)im * im;
+    if (!p) {
+        return SCOPE_FFT_FLOOR;
+    }
+    // log2(p) in Q8
+    int32_t e = 31 - __builtin_clz(p);
+    uint32_t f = p << (31 - e);
+    uint32_t i = (f >> 26) & 31;
+    int32_t l = fft_log2[i] + ((i == 31 ? 256 : fft_log2[i + 1]) - fft_log2[i]) * ((f >> 18) & 255) / 256;
+    // a full range sine leaves 4096 in its bin after the window and the 1 / n scaling
+    // 10 * log10(2) = 0.30103, rounded to the nearest 0.1dB
+    int32_t db = ((e << 8) + l - (24 << 8)) * 30103;
+    return (db + ((db < 0) ? -128000 : 128000)) / 256000;
+}
@@ -0,0 +1,26 @@
+#ifndef _SCOPE_FFT_H_
+#define _SCOPE_FFT_H_
+// Scope spectrum
+// Q15 fixed point FFT of ADC samples. Pure C, no hardware dependencies so the
+// kernel can be tested and timed on a host.
+#include <stdint.h>
+
+#define SCOPE_FFT_MAX_LOG2 10
+#define SCOPE_FFT_MAX (1 << SCOPE_FFT_MAX_LOG2)
+#define SCOPE_FFT_FLOOR -1000 // level of an empty bin, 0.1dB units
+
+// take 1 << log2n samples from start in a ring of ring_size ADC counts,
+// remove the DC level, apply a Hann window and store them in bit reversed order
+void scope_fft_load(int16_t* re,
+                    int16_t* im,
+                    const uint16_t* ring,
+                    uint32_t ring_size,
+                    uint32_t start,
+                    uint32_t log2n);
+// in place forward transform of loaded data, 2 <= log2n <= SCOPE_FFT_MAX_LOG2
+// every stage halves the values so the output is scaled by 1 / n and can't overflow
+void scope_fft(int16_t* re, int16_t* im, uint32_t log2n);
+// level of an output bin in 0.1dB relative to a full range sine, SCOPE_FFT_FLOOR if empty
+int16_t scope_fft_db(int16_t re, int16_t im);
+
+#endif
@@ -0,0 +1,272 @@
+// Scope capture to file
+// The capture is streamed from the ring in chunks through a small work buffer,
+// the scope big buffer has no room for a second copy.
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pirate.h"
+#include "system_config.h"
+#include "fatfs/ff.h"
+#include "pirate/storage.h"
+#include "display/scope_file.h"
+#include "ui/ui_term.h"
+
+#define SCOPE_FILE_MAX_FILES 10000
+#define SCOPE_FILE_LINE_MAX 128 // longest single line written with scope_file_printf
+#define SCOPE_FILE_MIDSCALE 2048 // 12 bit ADC counts to signed PCM
+
+static const char* const scope_file_extension[] = {
+    [SCOPE_FILE_CSV] = "csv",
+    [SCOPE_FILE_WAV] = "wav",
+};
+
+static uint32_t scope_file_number = 0;
+
+// file state for the capture being written
+static FIL* scope_file_fil;
+static FRESULT scope_file_fr;
+static uint32_t scope_file_offset; // bytes written to the file so far
+static char* scope_file_buf;
+static uint32_t scope_file_size;
+static uint32_t scope_file_len;
+
+static void scope_file_flush(void) {
+    UINT bw;
+    if (scope_file_len && scope_file_fr == FR_OK) {
+        scope_file_fr = f_write(scope_file_fil, scope_file_buf, scope_file_len, &bw);
+        if (scope_file_fr == FR_OK && bw != scope_file_len) {
+            scope_file_fr = FR_DENIED; // volume full
+        }
+    }
+    scope_file_len = 0;
+}
+
+// small writes only, they must fit the work buffer
+static void scope_file_write(const void* data, uint32_t len) {
+    if (scope_file_size - scope_file_len < len) {
+        scope_file_flush();
+    }
+    memcpy(&scope_file_buf[scope_file_len], data, len);
+    scope_file_len += len;
+    scope_file_offset += len;
+}
+
+static void scope_file_printf(const char* format, ...) {
+    if (scope_file_size - scope_file_len < SCOPE_FILE_LINE_MAX) {
+        scope_file_flush();
+    }
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(&scope_file_buf[scope_file_len], SCOPE_FILE_LINE_MAX, format, args);
+    va_end(args);
+    // a line that didn't fit was cut short, an encoding error wrote nothing
+    if (len < 0) {
+        len = 0;
+    } else if (len > SCOPE_FILE_LINE_MAX - 1) {
+        len = SCOPE_FILE_LINE_MAX - 1;
+    }
+    scope_file_len += len;
+    scope_file_offset += len;
+}
+
+static void scope_file_put16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void scope_file_put32(uint8_t* p, uint32_t v) {
+    scope_file_put16(p, v);
+    scope_file_put16(p + 2, v >> 16);
+}
+
+static uint32_t scope_file_mv(const scope_file_capture_t* c, uint32_t counts) {
+    return counts * 5000 / c->full_scale;
+}
+
+// capture details, one per line starting with prefix
+static int scope_file_comment(const scope_file_capture_t* c, const char* prefix, char* b, uint32_t size) {
+    int len = snprintf(b,
+                       size,
+                       "%sBus Pirate %s %s scope capture\n"
+                       "%spin: IO%d\n"
+                       "%ssample rate: %d Hz\n"
+                       "%ssamples: %d\n"
+                       "%stimebase: %d us/div\n"
+                       "%sscale: %d counts = 5V\n",
+                       prefix,
+                       BP_FIRMWARE_VERSION,
+                       BP_FIRMWARE_HASH,
+                       prefix,
+                       c->pin,
+                       prefix,
+                       c->sample_rate,
+                       prefix,
+                       c->count,
+                       prefix,
+                       c->us_per_div,
+                       prefix,
+                       c->full_scale);
+    if (c->trigger >= 0) {
+        len += snprintf(&b[len], size - len, "%strigger: sample %d\n", prefix, c->trigger);
+    } else {
+        len += snprintf(&b[len], size - len, "%strigger: none\n", prefix);
+    }
+    return len;
+}
+
+/****************************************************/
+// CSV: comment lines, then time from the trigger point and voltage
+
+static void scope_file_write_csv(const scope_file_capture_t* c) {
+    char comment[256];
+    uint32_t len = scope_file_comment(c, "# ", comment, sizeof(comment));
+    scope_file_write(comment, len);
+    scope_file_printf("time_us,volts\n");
+
+    int32_t t0 = (c->trigger >= 0) ? c->trigger : 0;
+    uint32_t p = c->first;
+    for (uint32_t i = 0; i < c->count && scope_file_fr == FR_OK; i++) {
+        int64_t us = (int64_t)((int32_t)i - t0) * 1000000 / c->sample_rate;
+        uint32_t mv = scope_file_mv(c, c->ring[p]);
+        scope_file_printf("%lld,%d.%03d\n", us, mv / 1000, mv % 1000);
+        if (++p >= c->ring_size) {
+            p = 0;
+        }
+    }
+}
+
+/****************************************************/
+// WAV: sizes are known up front so the file is written front to back
+
+static void scope_file_write_wav(const scope_file_capture_t* c) {
+    char comment[256];
+    uint32_t comment_len = scope_file_comment(c, "", comment, sizeof(comment) - 1) + 1; // with the terminator
+    uint32_t comment_pad = comment_len & 1;
+    comment[comment_len] = 0;
+    uint32_t list_size = 4 + 8 + comment_len + comment_pad;
+    uint32_t cue_size = (c->trigger >= 0) ? 4 + 24 : 0;
+    uint32_t data_size = c->count * 2;
+    uint8_t h[44];
+
+    memcpy(&h[0], "RIFF", 4);
+    scope_file_put32(&h[4], 4 + (8 + 16) + (8 + list_size) + (cue_size ? 8 + cue_size : 0) + (8 + data_size));
+    memcpy(&h[8], "WAVEfmt ", 8);
+    scope_file_put32(&h[16], 16);
+    scope_file_put16(&h[20], 1); // PCM
+    scope_file_put16(&h[22], 1); // mono
+    scope_file_put32(&h[24], c->sample_rate);
+    scope_file_put32(&h[28], c->sample_rate * 2);
+    scope_file_put16(&h[32], 2);
+    scope_file_put16(&h[34], 16);
+    memcpy(&h[36], "LIST", 4);
+    scope_file_put32(&h[40], list_size);
+    scope_file_write(h, 44);
+    memcpy(&h[0], "INFOICMT", 8);
+    scope_file_put32(&h[8], comment_len);
+    scope_file_write(h, 12);
+    scope_file_write(comment, comment_len + comment_pad);
+
+    if (cue_size) {
+        memset(h, 0, 36);
+        memcpy(&h[0], "cue ", 4);
+        scope_file_put32(&h[4], cue_size);
+        scope_file_put32(&h[8], 1);  // cue points
+        scope_file_put32(&h[12], 1); // id
+        scope_file_put32(&h[16], c->trigger);
+        memcpy(&h[20], "data", 4);
+        scope_file_put32(&h[32], c->trigger);
+        scope_file_write(h, 36);
+    }
+
+    memcpy(&h[0], "data", 4);
+    scope_file_put32(&h[4], data_size);
+    scope_file_write(h, 8);
+
+    // samples go through the work buffer a chunk at a time
+    uint32_t p = c->first;
+    uint32_t remaining = c->count;
+    while (remaining && scope_file_fr == FR_OK) {
+        if (scope_file_size - scope_file_len < 2) {
+            scope_file_flush();
+        }
+        uint32_t n = (scope_file_size - scope_file_len) / 2;
+        if (n > remaining) {
+            n = remaining;
+        }
+        uint8_t* out = (uint8_t*)&scope_file_buf[scope_file_len];
+        for (uint32_t i = 0; i < n; i++) {
+            scope_file_put16(&out[2 * i], (int16_t)((c->ring[p] - SCOPE_FILE_MIDSCALE) * 16));
+            if (++p >= c->ring_size) {
+                p = 0;
+            }
+        }
+        scope_file_len += 2 * n;
+        scope_file_offset += 2 * n;
+        remaining -= n;
+    }
+}
+
+/****************************************************/
+
+// find the next unused scop####.ext file name
+static bool scope_file_next_name(enum scope_file_format format, char* name, uint32_t len) {
+    for (uint32_t i = 0; i < SCOPE_FILE_MAX_FILES; i++) {
+        snprintf(name, len, "scop%04d.%s", scope_file_number, scope_file_extension[format]);
+        scope_file_number = (scope_file_number + 1) % SCOPE_FILE_MAX_FILES;
+        if (!storage_file_exists(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool scope_file_save(enum scope_file_format format, const scope_file_capture_t* c) {
+    if (!system_config.storage_available) {
+        printf("%sScope:%s no storage available\r\n", ui_term_color_error(), ui_term_color_reset());
+        return false;
+    }
+
+    char name[13];
+    if (!scope_file_next_name(format, name, sizeof(name))) {
+        printf("%sScope:%s no free file names\r\n", ui_term_color_error(), ui_term_color_reset());
+        return false;
+    }
+
+    FIL fil;
+    scope_file_fr = f_open(&fil, name, FA_WRITE | FA_CREATE_ALWAYS);
+    if (scope_file_fr != FR_OK) {
+        storage_file_error(scope_file_fr);
+        printf("\r\n");
+        return false;
+    }
+    scope_file_fil = &fil;
+    scope_file_buf = (char*)c->work;
+    scope_file_size = c->work_size;
+    scope_file_len = 0;
+    scope_file_offset = 0;
+
+    if (format == SCOPE_FILE_WAV) {
+        scope_file_write_wav(c);
+    } else {
+        scope_file_write_csv(c);
+    }
+    scope_file_flush();
+
+    FRESULT fr = f_close(&fil);
+    if (scope_file_fr == FR_OK) {
+        scope_file_fr = fr;
+    }
+    if (scope_file_fr != FR_OK) {
+        storage_file_error(scope_file_fr);
+        printf("\r\n");
+        return false;
+    }
+    printf("%sScope:%s saved %d samples to %s (%d bytes)\r\n",
+           ui_term_color_info(),
+           ui_term_color_reset(),
+           c->count,
+           name,
+           scope_file_offset);
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef _SCOPE_FILE_H_
+#define _SCOPE_FILE_H_
+// Scope capture to file
+#include <stdint.h>
+#include <stdbool.h>
+
+enum scope_file_format {
+    SCOPE_FILE_CSV = 0, // time and voltage, text
+    SCOPE_FILE_WAV,     // 16 bit mono PCM, details in a comment chunk and the trigger as a cue point
+};
+
+typedef struct {
+    const uint16_t* ring; // capture ring of ADC counts
+    uint32_t ring_size;
+    uint32_t first; // first sample of the capture in the ring
+    uint32_t count;
+    int32_t trigger; // trigger point in samples from first, -1 if not triggered
+    uint32_t sample_rate;
+    uint32_t us_per_div; // timebase on screen
+    uint32_t full_scale; // ADC counts at 5V
+    uint8_t pin;
+    uint8_t* work; // scratch memory for writes, samples are never copied as a whole
+    uint32_t work_size;
+} scope_file_capture_t;
+
+bool scope_file_save(enum scope_file_format format, const scope_file_capture_t* c);
+
+#endif
@@ -0,0 +1,122 @@
+// Scope measurements
+// Min, max, sum and sum of squares add up across blocks. Crossings use a Schmitt
+// trigger around the threshold whose state carries over from block to block, so a
+// frame's edge count and duty cycle don't depend on where the blocks start.
+#include <stdint.h>
+#include "display/scope_measure.h"
+
+enum {
+    MEASURE_STATE_UNKNOWN = 0,
+    MEASURE_STATE_LOW,
+    MEASURE_STATE_HIGH,
+};
+
+void scope_measure_init(scope_measure_t* m, uint16_t threshold, uint16_t hysteresis) {
+    m->threshold = threshold;
+    m->hysteresis = hysteresis;
+    m->state = MEASURE_STATE_UNKNOWN;
+}
+
+void scope_measure_block(scope_measure_t* m, scope_measure_block_t* b, const uint16_t* samples, uint32_t count) {
+    int32_t lo = m->threshold - m->hysteresis / 2;
+    int32_t hi = m->threshold + (m->hysteresis - m->hysteresis / 2);
+    uint16_t min = 0xffff;
+    uint16_t max = 0;
+    uint32_t sum = 0;
+    uint32_t sum_sq = 0;
+    uint32_t high = 0;
+    uint32_t edges = 0;
+    int32_t first = -1;
+    int32_t last = -1;
+    uint8_t state = m->state;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t v = samples[i];
+        if (v < min) {
+            min = v;
+        }
+        if (v > max) {
+            max = v;
+        }
+        sum += v;
+        sum_sq += v * v;
+        if ((int32_t)v > hi) {
+            if (state == MEASURE_STATE_LOW) {
+                if (first < 0) {
+                    first = i;
+                }
+                last = i;
+                edges++;
+            }
+            state = MEASURE_STATE_HIGH;
+        } else if ((int32_t)v < lo) {
+            state = MEASURE_STATE_LOW;
+        }
+        high += (state == MEASURE_STATE_HIGH);
+    }
+
+    m->state = state;
+    b->min = min;
+    b->max = max;
+    b->sum = sum;
+    b->sum_sq = sum_sq;
+    b->high = high;
+    b->edges = edges;
+    b->first_edge = first;
+    b->last_edge = last;
+}
+
+void scope_measure_frame_init(scope_measure_frame_t* f) {
+    f->min = 0xffff;
+    f->max = 0;
+    f->sum = 0;
+    f->sum_sq = 0;
+    f->samples = 0;
+    f->high = 0;
+    f->edges = 0;
+    f->first_edge = 0;
+    f->last_edge = 0;
+}
+
+// blocks must be added in capture order
+void scope_measure_frame_add(scope_measure_frame_t* f, const scope_measure_block_t* b, uint32_t count) {
+    if (b->min < f->min) {
+        f->min = b->min;
+    }
+    if (b->max > f->max) {
+        f->max = b->max;
+    }
+    f->sum += b->sum;
+    f->sum_sq += b->sum_sq;
+    f->high += b->high;
+    if (b->edges) {
+        if (!f->edges) {
+            f->first_edge = f->samples + b->first_edge;
+        }
+        f->last_edge = f->samples + b->last_edge;
+        f->edges += b->edges;
+    }
+    f->samples += count;
+}
+
+uint16_t scope_measure_mean(const scope_measure_frame_t* f) {
+    return f->samples ? f->sum / f->samples : 0;
+}
+
+uint16_t scope_measure_rms(const scope_measure_frame_t* f) {
+    if (!f->samples) {
+        return 0;
+    }
+    // square root of the mean square, bit by bit
+    uint32_t ms = f->sum_sq / f->samples;
+    uint32_t root = 0;
+    for (uint32_t bit = 1u << 30; bit; bit >>= 2) {
+        if (ms >= root + bit) {
+            ms -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
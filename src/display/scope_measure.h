@@ -0,0 +1,46 @@
+#ifndef _SCOPE_MEASURE_H_
+#define _SCOPE_MEASURE_H_
+// Scope measurements
+// Each capture block is summarised once as it completes, a frame is measured by
+// adding up the block summaries. Pure C, no hardware dependencies.
+#include <stdint.h>
+
+// a block of at most 256 samples
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint32_t sum_sq;
+    uint16_t high;      // samples on the high side of the threshold
+    uint16_t edges;     // rising crossings of the threshold
+    int16_t first_edge; // sample of the first and last crossing, -1 if none
+    int16_t last_edge;
+} scope_measure_block_t;
+
+typedef struct {
+    uint16_t threshold;
+    uint16_t hysteresis; // the signal must go this far past threshold to change sides
+    uint8_t state;       // side of the threshold, carried from one block to the next
+} scope_measure_t;
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint64_t sum;
+    uint64_t sum_sq;
+    uint32_t samples;
+    uint32_t high;
+    uint32_t edges;
+    uint32_t first_edge; // from the start of the frame, in samples
+    uint32_t last_edge;
+} scope_measure_frame_t;
+
+void scope_measure_init(scope_measure_t* m, uint16_t threshold, uint16_t hysteresis);
+void scope_measure_block(scope_measure_t* m, scope_measure_block_t* b, const uint16_t* samples, uint32_t count);
+
+void scope_measure_frame_init(scope_measure_frame_t* f);
+void scope_measure_frame_add(scope_measure_frame_t* f, const scope_measure_block_t* b, uint32_t count);
+uint16_t scope_measure_mean(const scope_measure_frame_t* f);
+uint16_t scope_measure_rms(const scope_measure_frame_t* f);
+
+#endif
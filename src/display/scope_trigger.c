@@ -0,0 +1,137 @@
+// Scope trigger search
+// A trigger is a sequence of two events: arm (the signal is far enough on the
+// starting side of level) then fire (it crosses level). Each phase is a search for
+// the first sample outside a band, so whole words of samples that can't change the
+// state are skipped with two SWAR compares and no per sample branches.
+// Without hysteresis the result matches the old per sample comparisons exactly:
+// rising fires on last <= level && v > level, falling on last >= level && v < level.
+#include <stdint.h>
+#include <stdbool.h>
+#include "display/scope_trigger.h"
+
+#define SAMPLE_MAX 0x7fff
+#define LANES_HIGH 0x80008000u
+#define LANES_ONE 0x00010001u
+
+enum {
+    TRIGGER_STATE_IDLE = 0,
+    TRIGGER_STATE_LOW,  // armed below level, waiting for a rising crossing
+    TRIGGER_STATE_HIGH, // armed above level, waiting for a falling crossing
+};
+
+void scope_trigger_init(scope_trigger_t* t, uint8_t edge, uint16_t level, uint16_t hysteresis) {
+    t->edge = edge;
+    t->level = level;
+    t->hysteresis = hysteresis;
+    t->state = TRIGGER_STATE_IDLE;
+}
+
+// lane high bits set where a sample of w is outside lo..hi
+static inline uint32_t outside_mask(uint32_t w, uint32_t below, uint32_t above) {
+    return ((w + above) | ~((w | LANES_HIGH) - below)) & LANES_HIGH;
+}
+
+// index of the first sample outside lo..hi (lo > hi matches every sample), count if none
+static uint32_t find_outside(const uint16_t* s, uint32_t count, int32_t lo, int32_t hi) {
+    uint32_t i = 0;
+    if (lo < 0) {
+        lo = 0;
+    } else if (lo > SAMPLE_MAX + 1) {
+        lo = SAMPLE_MAX + 1;
+    }
+    if (hi < -1) {
+        hi = -1;
+    } else if (hi > SAMPLE_MAX) {
+        hi = SAMPLE_MAX;
+    }
+    // align to a word, the DMA blocks are aligned already
+    for (; i < count && ((uintptr_t)&s[i] & 3); i++) {
+        if (s[i] < lo || s[i] > hi) {
+            return i;
+        }
+    }
+
+    uint32_t below = lo * LANES_ONE;                 // clears the high bit of lanes < lo
+    uint32_t above = (SAMPLE_MAX - hi) * LANES_ONE; // sets the high bit of lanes > hi
+    const uint32_t* w = (const uint32_t*)&s[i];
+    for (; i + 4 <= count; i += 4, w += 2) {
+        uint32_t m0 = outside_mask(w[0], below, above);
+        uint32_t m1 = outside_mask(w[1], below, above);
+        if (m0 | m1) {
+            if (m0) {
+                return i + ((m0 & 0x8000) ? 0 : 1);
+            }
+            return i + ((m1 & 0x8000) ? 2 : 3);
+        }
+    }
+
+    for (; i < count; i++) {
+        if (s[i] < lo || s[i] > hi) {
+            return i;
+        }
+    }
+    return count;
+}
+
+// first sample that fires the trigger, -1 if none, the armed state carries over to the next call
+int32_t scope_trigger_find(scope_trigger_t* t, const uint16_t* samples, uint32_t count) {
+    int32_t level = t->level;
+    int32_t h = t->hysteresis;
+    uint32_t i = 0;
+
+    while (i < count) {
+        uint32_t n;
+        switch (t->state) {
+            case TRIGGER_STATE_IDLE:
+                if (t->edge == SCOPE_TRIGGER_RISING) {
+                    // arm at or below level - h
+                    n = find_outside(&samples[i], count - i, level - h + 1, SAMPLE_MAX);
+                } else if (t->edge == SCOPE_TRIGGER_FALLING) {
+                    // arm at or above level + h
+                    n = find_outside(&samples[i], count - i, 0, level + h - 1);
+                } else {
+                    // arm below level - h or at or above level + h
+                    n = find_outside(&samples[i], count - i, level - h, level + h - 1);
+                }
+                i += n;
+                if (i >= count) {
+                    return -1;
+                }
+                if (t->edge == SCOPE_TRIGGER_RISING ||
+                    (t->edge == SCOPE_TRIGGER_EITHER && samples[i] < level - h)) {
+                    t->state = TRIGGER_STATE_LOW;
+                } else {
+                    t->state = TRIGGER_STATE_HIGH;
+                }
+                i++; // the arming sample can't also fire
+                break;
+            case TRIGGER_STATE_LOW:
+                if (t->edge == SCOPE_TRIGGER_EITHER && h == 0) {
+                    // a sample at level arms the falling edge instead
+                    n = find_outside(&samples[i], count - i, 0, level - 1);
+                } else {
+                    n = find_outside(&samples[i], count - i, 0, level);
+                }
+                i += n;
+                if (i >= count) {
+                    return -1;
+                }
+                if (samples[i] > level) {
+                    t->state = TRIGGER_STATE_IDLE;
+                    return i;
+                }
+                t->state = TRIGGER_STATE_HIGH;
+                i++;
+                break;
+            case TRIGGER_STATE_HIGH:
+                n = find_outside(&samples[i], count - i, level, SAMPLE_MAX);
+                i += n;
+                if (i >= count) {
+                    return -1;
+                }
+                t->state = TRIGGER_STATE_IDLE;
+                return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,24 @@
+#ifndef _SCOPE_TRIGGER_H_
+#define _SCOPE_TRIGGER_H_
+// Scope trigger search
+// Pure C, no hardware dependencies so the kernel can be benchmarked on a host.
+// Samples are ADC counts below 0x8000, two are compared per 32 bit operation.
+#include <stdint.h>
+
+enum scope_trigger_edge {
+    SCOPE_TRIGGER_RISING = 0,
+    SCOPE_TRIGGER_FALLING,
+    SCOPE_TRIGGER_EITHER,
+};
+
+typedef struct {
+    uint16_t level;
+    uint16_t hysteresis; // the signal must first move this far past level the other way, 0 for none
+    uint8_t edge;        // enum scope_trigger_edge
+    uint8_t state;       // armed state, carried from one block to the next
+} scope_trigger_t;
+
+void scope_trigger_init(scope_trigger_t* t, uint8_t edge, uint16_t level, uint16_t hysteresis);
+int32_t scope_trigger_find(scope_trigger_t* t, const uint16_t* samples, uint32_t count);
+
+#endif
@@ -5,112 +5,139 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
-//#include <stdio.h>
-#include "pico/stdlib.h" //uart definitions
-#include <stdlib.h>		 //atoi,atol
+// Bus Pirate binmode for the libsigrok "raspberrypi-pico" driver (PulseView, sigrok-cli)
+// Digital channels D0-D7 are the buffered IO pins BIO0-BIO7 (bio2bufiopin), the analog
+// channel A0 is SIGROK_ANALOG_BIO read through the AMUX. Commands arrive through the binmode
+// RX queue, trace data is written straight to the binary CDC port with tud_cdc_n_write
+// so full 64 byte USB packets go out without the per byte binmode TX queue.
+//
+// Sustained streaming is limited by the USB full speed CDC link, so the rate that keeps up
+// depends on how often the signals change:
+//   D0-D3 only:   RLE, 1 byte per value change
+//   D0-D7:        RLE, 2 bytes per value change (7 bit packing)
+//   A0 (+ D0-D7): no RLE, 1 byte per analog sample plus the digital bytes
+// When the host falls behind a half buffer the capture aborts ("!!!") rather than sending gaps.
+// Fixed length captures that fit in DMA_BUF_SIZE are never limited by USB.
+
+#include <stdio.h>
+#include <stdlib.h> //atoi,atol
+#include <string.h>
+#include "pico/stdlib.h"
 #include "pirate.h"
+#include "system_config.h"
 #include "queue.h"
 #include "pirate/bio.h"
+#include "pirate/amux.h"
+#include "pirate/mem.h"
 #include "hardware/gpio.h"
-// Note: Hardware libraries must be added to CMakelists.txt
 #include "hardware/pio.h"
 #include "hardware/adc.h"
 #include "hardware/dma.h"
-#include "hardware/structs/bus_ctrl.h"
-#include "hardware/structs/pwm.h"
-#include "hardware/sync.h" //wev
-#include "pico/binary_info.h"
-#include "stdarg.h"
-#include "pico/multicore.h"
-#include <string.h>
-#include "sr_device.h"
 #include "hardware/clocks.h"
-#include "tusb.h" //.tud_cdc_write...
+#include "hardware/structs/bus_ctrl.h"
+#include "hardware/sync.h"
+#include "display/scope.h" // scope_running guards the analog subsystem
+#include "ui/ui_term.h"
+#include "tusb.h"
 #include "usb_rx.h"
 #include "usb_tx.h"
+#include "sr_device.h"
+#include "lib/sigrok/pico_sdk_sigrok.h"
 
-// NODMA is a debug mode that disables the DMA engine and prints raw PIO FIFO outputs
-// it is limited to testing a small number of samples equal to the PIO FIFO depths
-// #define NODMA 1
 // These two enable debug print outs of D4 generation, D4_DBG2 are consider higher verbosity
 // #define D4_DBG 1
 // #define D4_DBG2 2
 
-uint8_t *capture_buf;
-volatile uint32_t c1cnt = 0;
-volatile uint32_t c0cnt = 0;
-sr_device_t dev;
-volatile uint32_t tstart;
-volatile bool send_resp = false;
-uint8_t txbuf[TX_BUF_SIZE];
-uint16_t txbufidx;
-uint32_t rxbufdidx;
-uint32_t rlecnt;
-uint32_t ccnt = 0; // count of characters sent serially
+#define SIGROK_CDC 1
+#define SIGROK_ANALOG_BIO BIO0			   // pin measured by analog channel A0
+#define SIGROK_TX_TIMEOUT_US 500000		   // give up on a full CDC FIFO after this long
+#define SIGROK_ABORT_INTERVAL_US 200000 // repeat the abort marker until the host answers
+
+const char sigrok_name[] = "sigrok mixed signal streaming (PulseView raspberrypi-pico)";
+
+static const char pin_labels[][5] = { "D0", "D1", "D2", "D3", "D4", "D5", "D6", "D7" };
+
+static uint8_t *capture_buf;
+static sr_device_t dev;
+static uint8_t txbuf[TX_BUF_SIZE];
+static uint16_t txbufidx;
+static uint32_t rxbufdidx;
+static uint32_t rlecnt;
+static uint32_t ccnt = 0; // count of characters sent serially
 // Number of bytes stored as DMA per slice, must be 1,2 or 4 to support aligned access
 // This will be be zero for 1-4 digital channels.
-uint8_t d_dma_bps;
-uint32_t samp_remain;
-uint32_t lval, cval; // last and current digital sample values
-uint32_t num_halves; // track the number of halves we have processed
-
-volatile uint32_t *tstsa0, *tstsa1, *tstsd0, *tstsd1;
-volatile uint32_t *taddra0, *taddra1, *taddrd0, *taddrd1;
-volatile int lowerhalf; // are we processing the upper or lower half of the data buffers
-volatile bool mask_xfer_err;
-
-// The function stdio_usb_out_chars is part of the PICO sdk usb library.
-// However the function is not externally visible from the library and rather than
-// figure out the build dependencies to do that it is just copied here.
-// This is much faster than a printf of the string, and even faster than the puts_raw
-// supported by the PICO SDK stdio library, which doesn't allow the known length of the buffer
-// to be specified. (The C standard write function doesn't seem to work at all).
-// This function also avoids the inserting of CR/LF in certain modes.
-// The tud_cdc_write_available function returns 256, and thus we have a 256B buffer to feed into
-// but the CDC serial issues in groups of 64B.
-// Since there is another memory fifo inside the TUD code this might possibly be optimized
-// to directly write to it, rather than writing txbuf.  That might allow faster rle processing
-// but is a bit too complicated.
-void my_stdio_usb_out_chars(const char *buf, int length)
+static uint8_t d_dma_bps;
+static uint32_t samp_remain;
+static uint32_t lval, cval; // last and current digital sample values
+static uint32_t num_halves; // track the number of halves we have processed
+
+static uint admachan0, admachan1, pdmachan0, pdmachan1;
+static dma_channel_config acfg0, acfg1, pcfg0, pcfg1;
+static int lowerhalf; // are we processing the upper or lower half of the data buffers
+static bool mask_xfer_err;
+static bool init_done;
+static uint32_t bus_priority; // restored on exit
+static bool dma_missing;      // setup found too few free DMA channels
+static uint64_t abort_time;
+
+// one `in pins, n` instruction, rebuilt for each capture
+static uint16_t capture_prog_instr;
+static struct pio_program capture_prog = { .instructions = &capture_prog_instr, .length = 1, .origin = -1 };
+static uint capture_prog_offset;
+static bool capture_prog_loaded;
+
+// Write to the binary CDC port, tud_cdc_n_write pushes out every full packet by itself.
+// Spins while the FIFO is full, gives up if the host stops reading.
+static void sigrok_cdc_write(const void *buf, uint32_t length)
 {
-	static uint64_t last_avail_time;
-	uint32_t owner;
-	if (tud_cdc_n_connected(1))
+	const uint8_t *p = buf;
+	uint64_t last_avail_time = time_us_64();
+	if (!tud_cdc_n_connected(SIGROK_CDC))
 	{
-		for (int i = 0; i < length;)
-		{
-			int n = length - i;
-			int avail = (int)tud_cdc_n_write_available(1);
-			if (n > avail)
-				n = avail;
-			if (n)
-			{
-				int n2 = (int)tud_cdc_n_write(1, buf + i, (uint32_t)n);
-				tud_task();
-				tud_cdc_n_write_flush(1);
-				i += n2;
-				last_avail_time = time_us_64();
-			}
-			else
-			{
-				tud_task();
-				tud_cdc_n_write_flush(1);
-				#define PICO_STDIO_USB_STDOUT_TIMEOUT_US 500000
-				if (!tud_cdc_n_connected(1) ||
-					(!tud_cdc_n_write_available(1) && time_us_64() > last_avail_time + PICO_STDIO_USB_STDOUT_TIMEOUT_US))
-				{
-					break;
-				}
-			}
-		}
+		return;
 	}
-	else
+	while (length)
 	{
-		// reset our timeout
-		last_avail_time = 0;
+		uint32_t n = tud_cdc_n_write(SIGROK_CDC, p, length);
+		if (n)
+		{
+			p += n;
+			length -= n;
+			last_avail_time = time_us_64();
+			continue;
+		}
+		tud_cdc_n_write_flush(SIGROK_CDC);
+		if (!tud_cdc_n_connected(SIGROK_CDC) || (time_us_64() > last_avail_time + SIGROK_TX_TIMEOUT_US))
+		{
+			break;
+		}
 	}
 }
 
+// trace data, counted for the end of capture byte count
+static void sigrok_tx(const uint8_t *buf, uint32_t length)
+{
+	sigrok_cdc_write(buf, length);
+	ccnt += length;
+}
+
+// Fold the differences between neighbouring D4 samples into change flags, bit 4*n is set
+// when sample n differs from sample n-1.
+static inline uint32_t d4_changes(uint32_t diff)
+{
+	diff |= diff >> 2;
+	diff |= diff >> 1;
+	return diff & 0x11111111;
+}
+
+// Index (0-7) of the first flagged sample.  The M0+ has no CLZ/CTZ instruction, so the lowest flag
+// is isolated and a multiply moves its index into the top 3 bits: flag n selects bits 31-4n..29-4n
+// of the constant, which hold n.
+static inline uint32_t d4_first_change(uint32_t chng)
+{
+	return ((chng & -chng) * 0x02468ACEu) >> 29;
+}
+
 // This is an optimized transmit of trace data for configurations with 4 or fewer digital channels
 // and no analog.  Run length encoding (RLE) is used to send counts of repeated values to efficiently utilize
 // USB CDC link bandwidth.  This is the only mode where a given serial byte can have both sample information
@@ -124,10 +151,11 @@ void my_stdio_usb_out_chars(const char *buf, int length)
 // For longer runs, an RLE only encoding uses decimal values 48 to 127 (0x30 to 0x7F)
 // as x8 run length values of 8..640.
 // All other ascii values (except from the abort and the end of run byte_cnt) are reserved.
-uint32_t send_slices_D4(sr_device_t *d, uint8_t *dbuf)
+static void send_slices_D4(sr_device_t *d, uint8_t *dbuf)
 {
 	uint8_t nibcurr, niblast;
-	uint32_t cword, lword; // current and last word
+	uint32_t cword; // current word
+	uint32_t chng;  // per sample change flags of the current word
 	uint32_t *cptr;
 	txbufidx = 0;
 	// Don't optimize the first word (eight samples) perfectly, just send them to make the for loop easier,
@@ -137,7 +165,6 @@ uint32_t send_slices_D4(sr_device_t *d, uint8_t *dbuf)
 #ifdef D4_DBG
 	//printf("Dbuf %p cptr %p data 0x%X\n\r", (void *)&(dbuf[0]), (void *)cptr, cword);
 #endif
-	lword = cword;
 	for (int j = 0; j < 8; j++)
 	{
 		nibcurr = cword & 0xF;
@@ -152,9 +179,9 @@ uint32_t send_slices_D4(sr_device_t *d, uint8_t *dbuf)
 
 	if (d->samples_per_half <= 8)
 	{
-		my_stdio_usb_out_chars(txbuf, txbufidx);
+		sigrok_tx(txbuf, txbufidx);
 		d->scnt += d->samples_per_half;
-		return txbufidx;
+		return;
 	}
 	// chngcnt=8;
 	// The total number of 4 bit samples remaining to process from this half.
@@ -172,14 +199,13 @@ uint32_t send_slices_D4(sr_device_t *d, uint8_t *dbuf)
 		d->scnt += d->samples_per_half;
 	}
 	// Process one  word (8 samples) at a time.
-	for (int i = 0; i < (samp_remain >> 3); i++)
+	// Each sample is compared to the one before it across the whole word, so an idle word is
+	// one compare and only the samples that change are visited.
+	for (uint32_t i = 0; i < (samp_remain >> 3); i++)
 	{
 		cptr = (uint32_t *)&(dbuf[rxbufdidx]);
 		cword = *cptr;
 		rxbufdidx += 4;
-#ifdef D4_DBG2
-		//printf("dbuf0 %p dbufr %p cptr %p \n\r", dbuf, &(dbuf[rxbufdidx]), cptr);
-#endif
 		// Send maximal RLE counts in this outer section to the txbuf, and if we accumulate a few of them
 		// push to the device so that we don't accumulate large numbers
 		// of unsent RLEs.  That allows the host to process them gradually rather than in a flood
@@ -190,64 +216,65 @@ uint32_t send_slices_D4(sr_device_t *d, uint8_t *dbuf)
 			rlecnt -= 640;
 			if (txbufidx > 3)
 			{
-				my_stdio_usb_out_chars(txbuf, txbufidx);
-				ccnt += txbufidx;
+				sigrok_tx(txbuf, txbufidx);
 				txbufidx = 0;
 			}
 		}
-		// Coarse rle looks across the full word and allows a faster compare in cases with low activity factors
-		// We must make sure cword==lword and that all nibbles of cword are the same
-		if ((cword == lword) && ((cword >> 4) == (cword & 0x0FFFFFFF)))
+		chng = cword ^ ((cword << 4) | niblast);
+		if (chng == 0)
 		{
 			rlecnt += 8;
-#ifdef D4_DBG2
-			//printf("coarse word 0x%X\n\r", cword);
-#endif
 		}
 		else
-		{ // if coarse rle didn't match
-#ifdef D4_DBG2
-			//printf("cword 0x%X nibcurr 0x%X i %d rx idx %u  rlecnt %u \n\r", cword, nibcurr, i, rxbufdidx, rlecnt);
-#endif
-			lword = cword;
-			for (int j = 0; j < 8; j++)
-			{ // process all 8 nibbles
-				nibcurr = cword & 0xF;
-				if (nibcurr == niblast)
+		{
+			chng = d4_changes(chng);
+			// The first change ends the run carried in from earlier words,
+			// so we must push all remaing rles to the txbuf
+			uint32_t n = d4_first_change(chng);
+			rlecnt += n;
+			// Send intermediate 8..632 RLEs
+			if (rlecnt > 7)
+			{
+				txbuf[txbufidx++] = ((rlecnt & 0x3F8) >> 3) + 47;
+			}
+			// And finally the 0..7 rle along with the new value
+			txbuf[txbufidx++] = 0x80 | ((cword >> (n << 2)) & 0xF) | (rlecnt & 0x7) << 4;
+			uint32_t pos = n + 1; // first sample of the word not yet counted
+			chng &= chng - 1;
+			if (chng == 0x11111110)
+			{
+				// every sample changed, the other seven go out without a run
+				txbuf[txbufidx] = 0x80 | ((cword >> 4) & 0xF);
+				txbuf[txbufidx + 1] = 0x80 | ((cword >> 8) & 0xF);
+				txbuf[txbufidx + 2] = 0x80 | ((cword >> 12) & 0xF);
+				txbuf[txbufidx + 3] = 0x80 | ((cword >> 16) & 0xF);
+				txbuf[txbufidx + 4] = 0x80 | ((cword >> 20) & 0xF);
+				txbuf[txbufidx + 5] = 0x80 | ((cword >> 24) & 0xF);
+				txbuf[txbufidx + 6] = 0x80 | (cword >> 28);
+				txbufidx += 7;
+				pos = 8;
+			}
+			else
+			{
+				// later changes in the same word are always less than 8 samples apart
+				while (chng)
 				{
-					rlecnt++;
+					n = d4_first_change(chng);
+					txbuf[txbufidx++] = 0x80 | ((cword >> (n << 2)) & 0xF) | (n - pos) << 4;
+					pos = n + 1;
+					chng &= chng - 1;
 				}
-				else
-				{
-					// If the value changes we must push all remaing rles to the txbuf
-					// chngcnt++;
-					// Send intermediate 8..632 RLEs
-					if (rlecnt > 7)
-					{
-						int rlemid = rlecnt & 0x3F8;
-						txbuf[txbufidx++] = (rlemid >> 3) + 47;
-					}
-					// And finally the 0..7 rle along with the new value
-					rlecnt &= 0x7;
-#ifdef D4_DBG2 // print when sample value changes
-					//printf("VChang val 0x%X rlecnt %d i%d j%d \n\r", nibcurr, rlecnt, i, j);
-#endif
-					txbuf[txbufidx++] = 0x80 | nibcurr | rlecnt << 4;
-					rlecnt = 0;
-				} // nibcurr!=last
-				cword >>= 4;
-				niblast = nibcurr;
-			} // for j
-		}	  // else (not a coarse rle )
+			}
+			rlecnt = 8 - pos;
+		}
+		niblast = cword >> 28;
 #ifdef D4_DBG2
-		//printf("i %d rx idx %u  rlecnt %u \n\r", i, rxbufdidx, rlecnt);
 		//printf("i %u tx idx %d bufs 0x%X 0x%X 0x%X\n\r", i, txbufidx, txbuf[txbufidx - 3], txbuf[txbufidx - 2], txbuf[txbufidx - 1]);
 #endif
 		// Emperically found that transmitting groups of around 32B gives optimum bandwidth
 		if (txbufidx >= 64)
 		{
-			my_stdio_usb_out_chars(txbuf, txbufidx);
-			ccnt += txbufidx;
+			sigrok_tx(txbuf, txbufidx);
 			txbufidx = 0;
 		}
 	} // for i in samp_send>>3
@@ -275,21 +302,20 @@ uint32_t send_slices_D4(sr_device_t *d, uint8_t *dbuf)
 	{
 		rlecnt &= 0x7;
 		rlecnt--;
-		txbuf[txbufidx++] = 0x80 | nibcurr | rlecnt << 4;
+		txbuf[txbufidx++] = 0x80 | niblast | rlecnt << 4;
 		rlecnt = 0;
 	}
 	
 	if (txbufidx)
 	{
-		my_stdio_usb_out_chars(txbuf, txbufidx);
-		ccnt += txbufidx;
+		sigrok_tx(txbuf, txbufidx);
 		txbufidx = 0;
 	}
 
 } // send_slices_D4
 
 // Send a digital sample of multiple bytes with the 7 bit encoding
-void inline tx_d_samp(sr_device_t *d, uint32_t cval)
+static inline void tx_d_samp(sr_device_t *d, uint32_t cval)
 {
 	for (char b = 0; b < d->d_tx_bps; b++)
 	{
@@ -303,7 +329,7 @@ void inline tx_d_samp(sr_device_t *d, uint32_t cval)
 // the compiled code is substantially slower to the point that digital only transfers
 // can't keep up with USB rate.  Thus it is only used by the send_slices_analog which is already
 // limited to 500khz, and in the starting send_slice_init.
-uint32_t get_cval(uint8_t *dbuf)
+static uint32_t get_cval(uint8_t *dbuf)
 {
 	uint32_t cval;
 
@@ -336,7 +362,7 @@ forward txbuf bytes to USB to prevent txbufidx from overflowing the size
 of txbuf. We do not always push to USB to reduce its impact
 on performance.
  */
-void inline check_rle()
+static inline void check_rle(void)
 {
 
 	while (rlecnt >= 1568)
@@ -360,18 +386,17 @@ void inline check_rle()
 }
 
 // Send txbuf to usb based on an input threshold
-void check_tx_buf(uint16_t cnt)
+static void check_tx_buf(uint16_t cnt)
 {
 	if (txbufidx >= cnt)
 	{
-		my_stdio_usb_out_chars(txbuf, txbufidx);
-		ccnt += txbufidx;
+		sigrok_tx(txbuf, txbufidx);
 		txbufidx = 0;
 	}
 }
 
 // Common init for send_slices_1B/2B/4B, but not D4 or analog
-void send_slice_init(sr_device_t *d, uint8_t *dbuf)
+static void send_slice_init(sr_device_t *d, uint8_t *dbuf)
 {
 	rxbufdidx = 0;
 	// Adjust the number of samples to send if there are more in the dma buffer
@@ -405,30 +430,88 @@ void send_slice_init(sr_device_t *d, uint8_t *dbuf)
 // We can just always read a 4B value because the core doesn't support non-aligned accesses.
 // These must be marked noinline to ensure they remain separate functions for good performance
 // 1B is 5-8 channels
-void __attribute__((noinline)) send_slices_1B(sr_device_t *d, uint8_t *dbuf)
+// Samples are read a word (4 samples) at a time once the read index is aligned, a word that
+// repeats the last sample is only counted and only the changed samples are visited
+static inline void send_sample_1B(sr_device_t *d)
+{
+	if (cval == lval)
+	{
+		rlecnt++;
+	}
+	else
+	{
+		check_rle();
+		tx_d_samp(d, cval);
+		check_tx_buf(TX_BUF_THRESH);
+	} // if cval!=lval
+	lval = cval;
+}
+
+static void __attribute__((noinline)) send_slices_1B(sr_device_t *d, uint8_t *dbuf)
 {
 	send_slice_init(d, dbuf);
-	for (int s = 0; s < samp_remain; s++)
+	uint32_t s = samp_remain;
+	// send_slice_init consumed the first sample, go byte by byte up to a word boundary
+	while (s && (rxbufdidx & 3))
 	{
 		cval = dbuf[rxbufdidx++];
-		if (cval == lval)
+		send_sample_1B(d);
+		s--;
+	}
+	for (; s >= 4; s -= 4)
+	{
+		uint32_t word = *((uint32_t *)(dbuf + rxbufdidx));
+		rxbufdidx += 4;
+		// non zero bytes mark samples that differ from the sample before them
+		uint32_t chng = word ^ ((word << 8) | lval);
+		if (chng == 0)
 		{
-			rlecnt++;
+			rlecnt += 4;
+			continue;
 		}
-		else
+		uint32_t pos = 0; // first sample of the word not yet counted
+		chng |= chng >> 4;
+		chng |= chng >> 2;
+		chng |= chng >> 1;
+		chng &= 0x01010101; // bit 8*n is set when sample n changed
+		if (chng == 0x01010101)
 		{
+			// every sample changed, there are no runs to count between them
 			check_rle();
-			tx_d_samp(d, cval);
-			check_tx_buf(TX_BUF_THRESH);
-		} // if cval!=lval
-		lval = cval;
-	} // for s
+			tx_d_samp(d, word & 0xFF);
+			tx_d_samp(d, (word >> 8) & 0xFF);
+			tx_d_samp(d, (word >> 16) & 0xFF);
+			tx_d_samp(d, word >> 24);
+		}
+		else
+		{
+			do
+			{
+				// same multiply as d4_first_change, flag n selects bits 31-8n..30-8n which hold n
+				uint32_t n = ((chng & -chng) * 0x004080C0u) >> 30;
+				rlecnt += n - pos;
+				cval = (word >> (n << 3)) & 0xFF;
+				check_rle();
+				tx_d_samp(d, cval);
+				pos = n + 1;
+				chng &= chng - 1;
+			} while (chng);
+			rlecnt += 4 - pos;
+		}
+		lval = word >> 24;
+		check_tx_buf(TX_BUF_THRESH);
+	}
+	while (s--)
+	{
+		cval = dbuf[rxbufdidx++];
+		send_sample_1B(d);
+	}
 	check_rle();
 	check_tx_buf(1);
 } // send_slices_1B
 
 // 2B is 9-16 channels
-void __attribute__((noinline)) send_slices_2B(sr_device_t *d, uint8_t *dbuf)
+static void __attribute__((noinline)) send_slices_2B(sr_device_t *d, uint8_t *dbuf)
 {
 	send_slice_init(d, dbuf);
 	for (int s = 0; s < samp_remain; s++)
@@ -452,7 +535,7 @@ void __attribute__((noinline)) send_slices_2B(sr_device_t *d, uint8_t *dbuf)
 } // send_slices_2B
 
 // 4B is 17-21 channels and is the only one that must mask invalid bits which are captured by DMA
-void __attribute__((noinline)) send_slices_4B(sr_device_t *d, uint8_t *dbuf)
+static void __attribute__((noinline)) send_slices_4B(sr_device_t *d, uint8_t *dbuf)
 {
 	send_slice_init(d, dbuf);
 	for (int s = 0; s < samp_remain; s++)
@@ -482,7 +565,7 @@ void __attribute__((noinline)) send_slices_4B(sr_device_t *d, uint8_t *dbuf)
 // All digital channels for one slice are sent first in 7 bit bytes using values 0x80 to 0xFF
 // Analog channels are sent next, with each channel taking one 7 bit byte using values 0x80 to 0xFF.
 // This does not support run length encoding because it's not clear how to define RLE on analog signals
-uint32_t send_slices_analog(sr_device_t *d, uint8_t *dbuf, uint8_t *abuf)
+static void send_slices_analog(sr_device_t *d, uint8_t *dbuf, uint8_t *abuf)
 {
 	uint32_t rxbufaidx = 0;
 	rxbufdidx = 0;
@@ -521,160 +604,122 @@ uint32_t send_slices_analog(sr_device_t *d, uint8_t *dbuf, uint8_t *abuf)
 	check_tx_buf(1);
 } // send_slices_analog
 
+// point the chain trigger of a channel without starting it
+static void dma_chain_to(uint chan, uint to)
+{
+	hw_write_masked(&dma_hw->ch[chan].al1_ctrl, to << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB, DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS);
+}
+
+// sticky flag, set when the PIO RX FIFO was full and a sample was dropped
+static bool sigrok_pio_rxstall(void)
+{
+	return PIO_LOGIC_ANALYZER_PIO->fdebug & (1u << (PIO_FDEBUG_RXSTALL_LSB + PIO_LOGIC_ANALYZER_SM));
+}
+
 // See if a given half's dma engines are idle and if so process the data, update the write pointer and
 // ensure that when done the other dma is still busy indicating we didn't lose data .
-// int __not_in_flash_func(check_half)(sr_device_t *d,volatile uint32_t *tstsa0,volatile uint32_t *tstsa1,volatile uint32_t *tstsd0,
-int check_half(sr_device_t *d, volatile uint32_t *tstsa0, volatile uint32_t *tstsa1, volatile uint32_t *tstsd0,
-			   volatile uint32_t *tstsd1, volatile uint32_t *t_addra0, volatile uint32_t *t_addrd0,
-			   uint8_t *d_start_addr, uint8_t *a_start_addr, bool mask_xfer_err)
+static int check_half(sr_device_t *d, uint my_achan, uint other_achan, uint my_dchan, uint other_dchan,
+					  uint8_t *d_start_addr, uint8_t *a_start_addr)
 {
-	int a0busy, d0busy;
-	uint64_t stime, etime, dtime;
-	volatile uint32_t *piodbg1, *piodbg2;
-	volatile uint8_t piorxstall1, piorxstall2;
-	stime = time_us_64();
-	a0busy = ((*tstsa0) >> 24) & 1;
-	d0busy = ((*tstsd0) >> 24) & 1;
-
-	if (((a0busy == 0) || (d->a_mask == 0)) && ((d0busy == 0) || (d->d_mask == 0)))
+	bool a0busy = d->a_mask && dma_channel_is_busy(my_achan);
+	bool d0busy = d->d_mask && dma_channel_is_busy(my_dchan);
+
+	if (a0busy || d0busy)
 	{
-		// Use two dma controllers where each writes half of the trace space.
-		// When one half finishes we send it's data while the other dma controller writes to the other half.
-		// We rely on DMA chaining where one completing dma engine triggers the next.
-		// When chaining happens the original target address is not restored so we must rewrite the starting address.
-		// Also when chaining is enabled we can get into an infinite loop where we ping pong between each other.
-		// and it is possible that if the other DMA controller finishes before we have send our half of the data that
-		// our DMA controller will startup and overwrite our data.  That is the DMA overflow condition.
-		// We don't actually overflow the DMA, but instead we fail to establish proper chaining to keep the
-		// ping pong going.
-		// The only way to avoid the overflow condition is to reduce the sampling rate so that the transmit of samples
-		// can keep up, or do a fixed sample that fits into the sample buffer.
-		// When we first enter the loop it is assumed that the other controller is not chained to us so that if we don't
-		// process in time then our DMA controller won't be started by the other.  That assumption is maintained by
-		// always pointing our DMA engine to itself so tht in the next function call it is the "other" controller.
-		// We then process our half's samples and send to USB.
-		// When done we confirm that the other channel is still active, and if so we know we haven't overflowed and thus
-		// can establish the chain from the other channel to us.  If the other channel is not still active, or if the
-		// PIO/ADC FIFOs indicates an RXstall condition which indicates PIO lost samples, then we abort.
-		// Note that in all cases we should never actually send any corrupted data we just send less than what was requested.
-		// Note that we must use the "alias" versions of the DMA CSRs to prevent writes from triggering them.
-		// Since we swap the csr pointers we determine the other half from the address offsets.
-		uint8_t myachan = (((uint32_t)tstsa0) >> 6) & 0xF;
-		uint8_t otherachan = (((uint32_t)tstsa1) >> 6) & 0xF;
-		uint8_t mydchan = (((uint32_t)tstsd0) >> 6) & 0xF;
-		uint8_t otherdchan = (((uint32_t)tstsd1) >> 6) & 0xF;
-		//  //printf("my stts pre a 0x%X d 0x%X\n\r",*tstsa0,*tstsd0);
-		// Set my chain to myself so that I can't chain to the other.
-		volatile uint32_t ttmp;
-		ttmp = ((tstsd0[1]) & 0xFFFF87FF) | mydchan << 11;
-		tstsd0[1] = ttmp;
-		ttmp = ((tstsa0[1]) & 0xFFFF87FF) | myachan << 11;
-		tstsa0[1] = ttmp;
-		(*t_addra0) = (uint32_t)a_start_addr;
-		(*t_addrd0) = (uint32_t)d_start_addr;
-
-		piodbg1 = (volatile uint32_t *)(PIO0_BASE + 0x8); // PIO DBG
-		piorxstall1 = (((*piodbg1) & 0x1) && (d->d_mask != 0));
-
-		if (d->a_mask)
-		{
-			send_slices_analog(d, d_start_addr, a_start_addr);
-		}
-		else if (d_dma_bps == 0)
-		{
-			send_slices_D4(d, d_start_addr);
-		}
-		else if (d_dma_bps == 1)
-		{
-			send_slices_1B(d, d_start_addr);
-		}
-		else if (d_dma_bps == 2)
-		{
-			send_slices_2B(d, d_start_addr);
-		}
-		else
-		{
-			send_slices_4B(d, d_start_addr);
-		}
+		return 0;
+	}
 
-		if ((d->cont == false) && (d->scnt >= d->num_samples))
-		{
-			d->sending = false;
-		}
+	// Use two dma controllers where each writes half of the trace space.
+	// When one half finishes we send it's data while the other dma controller writes to the other half.
+	// We rely on DMA chaining where one completing dma engine triggers the next.
+	// When chaining happens the original target address is not restored so we must rewrite the starting address.
+	// Also when chaining is enabled we can get into an infinite loop where we ping pong between each other.
+	// and it is possible that if the other DMA controller finishes before we have send our half of the data that
+	// our DMA controller will startup and overwrite our data.  That is the DMA overflow condition.
+	// We don't actually overflow the DMA, but instead we fail to establish proper chaining to keep the
+	// ping pong going.
+	// The only way to avoid the overflow condition is to reduce the sampling rate so that the transmit of samples
+	// can keep up, or do a fixed sample that fits into the sample buffer.
+	// When we first enter the loop it is assumed that the other controller is not chained to us so that if we don't
+	// process in time then our DMA controller won't be started by the other.  That assumption is maintained by
+	// always pointing our DMA engine to itself so tht in the next function call it is the "other" controller.
+	// We then process our half's samples and send to USB.
+	// When done we confirm that the other channel is still active, and if so we know we haven't overflowed and thus
+	// can establish the chain from the other channel to us.  If the other channel is not still active, or if the
+	// PIO/ADC FIFOs indicates an RXstall condition which indicates PIO lost samples, then we abort.
+	// Note that in all cases we should never actually send any corrupted data we just send less than what was requested.
+	// The al1 (non triggering) alias of the control register is used so the writes don't start a channel.
+	dma_chain_to(my_dchan, my_dchan);
+	dma_chain_to(my_achan, my_achan);
+	dma_channel_set_write_addr(my_achan, a_start_addr, false);
+	dma_channel_set_write_addr(my_dchan, d_start_addr, false);
+
+	bool piorxstall1 = d->d_mask && sigrok_pio_rxstall();
+
+	if (d->a_mask)
+	{
+		send_slices_analog(d, d_start_addr, a_start_addr);
+	}
+	else if (d_dma_bps == 0)
+	{
+		send_slices_D4(d, d_start_addr);
+	}
+	else if (d_dma_bps == 1)
+	{
+		send_slices_1B(d, d_start_addr);
+	}
+	else if (d_dma_bps == 2)
+	{
+		send_slices_2B(d, d_start_addr);
+	}
+	else
+	{
+		send_slices_4B(d, d_start_addr);
+	}
 
-		// Set my other chain to me
-		// use aliases here as well to prevent triggers
-		ttmp = ((tstsd1[1]) & 0xFFFF87FF) | mydchan << 11;
-		tstsd1[1] = ttmp;
-		ttmp = ((tstsa1[1]) & 0xFFFF87FF) | myachan << 11;
-		tstsa1[1] = ttmp;
-		num_halves++;
-		piodbg2 = (volatile uint32_t *)(PIO0_BASE + 0x8); // PIO DBG
-		piorxstall2 = ((*piodbg2) & 0x1) && (d->d_mask != 0);
-		volatile uint32_t *adcfcs;
-		uint8_t adcfail;
-		adcfcs = (volatile uint32_t *)(ADC_BASE + 0x8); // ADC FCS
-		adcfail = (((*adcfcs) & 0xC00) && (d->a_mask)) ? 1 : 0;
-		// if(adcfail){//printf("adcfcs 0x%X %p\n\r",*adcfcs,(void *) adcfcs);}
-		// Ensure other dma is still busy, if not that means we have samples from PIO/ADC that could be lost.
-		// It's only an error if we haven't already gotten the samples we need, or if we are processing the first
-		// half and all the remaining samples we need are in the 2nd half.
-		// Note that in continuous mode num_samples isn't defined.
-		uint8_t proc_fail;
-		proc_fail = (~(((((*tstsa1) >> 24) & 1) || (d->a_mask == 0)) && ((((*tstsd1) >> 24) & 1) || (d->d_mask == 0))) & 1);
-		// //printf("pf 0x%X 0x%X %d\n\r",*tstsa1,*tstsd1,proc_fail);
-		//        if(mask_xfer_err
-		//      || ((piorxstall1==0)
-		//       &&((((*tstsa1)>>24)&1)||(d->a_mask==0))
-		//		  &&((((*tstsd1)>>24)&1)||(d->d_mask==0)))){
-		if (mask_xfer_err || ((piorxstall1 == 0) && (adcfail == 0) && (piorxstall2 == 0) && (proc_fail == 0)))
-		{
-			//           //printf("h\n\r");
-			return 1;
-		}
-		else
-		{
+	if ((d->cont == false) && (d->scnt >= d->num_samples))
+	{
+		d->sending = false;
+	}
 
-			if (piorxstall1 || piorxstall2)
-			{
-				//printf("***Abort PIO RXSTALL*** %d %d half %d\n\r", piorxstall1, piorxstall2, num_halves);
-			}
-			if (proc_fail)
-			{
-				//printf("***Abort DMA ovrflow*** half %d \n\r", num_halves);
-			}
-			if (adcfail)
-			{
-				//printf("***Abort ADC ovrflow*** half %d \n\r", num_halves);
-			}
-			d->aborted = true;
-			// Issue end of trace markers to host
-			// The main loop also sends these periodically until the host is done..
-			my_stdio_usb_out_chars("!!!", 3);
-			// //printf("scnt %u \n\r",d->scnt);
-			// //printf("a st %u msk %u\n\r",(*tstsa1),d->a_mask);
-			// //printf("d st %u msk %u\n\r",(*tstsd1),d->d_mask);
-			return -1;
-		}
-	} // if not busy
-	return 0;
+	// Set my other chain to me
+	dma_chain_to(other_dchan, my_dchan);
+	dma_chain_to(other_achan, my_achan);
+	num_halves++;
+
+	bool piorxstall2 = d->d_mask && sigrok_pio_rxstall();
+	bool adcfail = d->a_mask && (adc_hw->fcs & (ADC_FCS_OVER_BITS | ADC_FCS_UNDER_BITS));
+	// Ensure other dma is still busy, if not that means we have samples from PIO/ADC that could be lost.
+	// It's only an error if we haven't already gotten the samples we need, or if we are processing the first
+	// half and all the remaining samples we need are in the 2nd half.
+	// Note that in continuous mode num_samples isn't defined.
+	bool proc_fail = !((dma_channel_is_busy(other_achan) || (d->a_mask == 0)) &&
+					   (dma_channel_is_busy(other_dchan) || (d->d_mask == 0)));
+
+	if (mask_xfer_err || (!piorxstall1 && !adcfail && !piorxstall2 && !proc_fail))
+	{
+		return 1;
+	}
+
+	d->aborted = true;
+	// Issue end of trace markers to host
+	// The main loop also sends these periodically until the host is done..
+	sigrok_cdc_write("!!!", 3);
+	tud_cdc_n_write_flush(SIGROK_CDC);
+	abort_time = time_us_64() + SIGROK_ABORT_INTERVAL_US;
+	return -1;
 } // check_half
 
-// Check if dma activity is complete.  This was split out to allow core1 to do the monitoring
-// and slice processing and leave usb interrupt handling to core 0, but doing so did not improve
-// streaming performance, so it's left in core0.
-void dma_check(sr_device_t *d)
+// Check if dma activity is complete and send the finished half buffer
+static void dma_check(sr_device_t *d)
 {
 	if (d->sending && d->started && ((d->scnt < d->num_samples) || d->cont))
 	{
-		uint32_t a, b;
 		int ret;
-		c0cnt++;
 		if (lowerhalf)
 		{
-			ret = check_half(&dev, tstsa0, tstsa1, tstsd0, tstsd1, taddra0, taddrd0,
-							 &(capture_buf[d->dbuf0_start]), &(capture_buf[d->abuf0_start]), mask_xfer_err);
-
+			ret = check_half(d, admachan0, admachan1, pdmachan0, pdmachan1,
+							 &(capture_buf[d->dbuf0_start]), &(capture_buf[d->abuf0_start]));
 			if (ret == 1)
 			{
 				lowerhalf = 0;
@@ -686,8 +731,8 @@ void dma_check(sr_device_t *d)
 		}
 		if (lowerhalf == 0)
 		{
-			ret = check_half(&dev, tstsa1, tstsa0, tstsd1, tstsd0, taddra1, taddrd1,
-							 &(capture_buf[d->dbuf1_start]), &(capture_buf[d->abuf1_start]), mask_xfer_err);
+			ret = check_half(d, admachan1, admachan0, pdmachan1, pdmachan0,
+							 &(capture_buf[d->dbuf1_start]), &(capture_buf[d->abuf1_start]));
 			if (ret == 1)
 			{
 				lowerhalf = 1;
@@ -697,137 +742,312 @@ void dma_check(sr_device_t *d)
 				d->sending = false;
 			}
 		}
-	} // if sending and started and under numsamples
+		// end of the half, push out the partial packet
+		tud_cdc_n_write_flush(SIGROK_CDC);
+	}
 }
 
-// This is a simple maintenance loop to monitor serial activity so that core0 can be dedicated
-// to monitoring DMA activity and sending trace data.
-// Most of the time this loop is stalled with wfes (wait for events).
-void pico_sdk_sigrok_no_usb(void)
+// size the buffers, program the ADC, PIO and DMA and start sampling
+static void sigrok_start(void)
 {
-	uint32_t testinc = 0x0;
-	char intin;
-	uint8_t uartch;
-	uint32_t ctime;
-	uint32_t cval;
-	volatile uint32_t *usbctrl;
-	usbctrl = (volatile uint32_t *)(USBCTRL_BASE);
-	uint32_t usb_last = 1, usb_curr;
-	while (true)
+	PIO pio = PIO_LOGIC_ANALYZER_PIO;
+	uint piosm = PIO_LOGIC_ANALYZER_SM;
+
+	lowerhalf = 1;
+
+	// Sample rate must always be even.  Pulseview code enforces this
+	// because a frequency step of 2 is required to get a pulldown to specify
+	// the sample rate, but sigrok cli can still pass it.
+	dev.sample_rate >>= 1;
+	dev.sample_rate <<= 1;
+
+	// Adjust up and align to 4 to avoid rounding errors etc
+	if (dev.num_samples < 16)
+	{
+		dev.num_samples = 16;
+	}
+
+	dev.num_samples = (dev.num_samples + 3) & 0xFFFFFFFC;
+
+	// Divide capture buf evenly based on channel enables
+	// d_size is aligned to 4 bytes because pio operates on words
+	// These are the sizes for each half buffer in bytes
+	// Calculate relative size in terms of nibbles which is the smallest unit, thus a_chan_cnt is multiplied by 2
+	// Nibble size storage is only allow for D4 mode with no analog channels enabled
+	// For instance a D0..D5 with A0 would give 1/2 the storage to digital and 1/2 to analog
+	uint32_t d_nibbles, a_nibbles, t_nibbles; // digital, analog and total nibbles
+	d_nibbles = dev.d_nps;					  // digital is in grous of 4 bits
+	a_nibbles = dev.a_chan_cnt * 2;			  // 1 byte per sample
+	t_nibbles = d_nibbles + a_nibbles;
+
+	// total buf size must be a multiple of a_nibbles*2, d_nibbles*8, and t_nibbles so that division is always
+	// in whole samples
+	// Also set a multiple of 32  because the dma buffer is split in half, and
+	// the PIO does writes on 4B boundaries, and then a 4x factor for any other size/alignment issues
+	uint32_t chunk_size = t_nibbles * 32;
+	if (a_nibbles)
+		chunk_size *= a_nibbles;
+	if (d_nibbles)
+		chunk_size *= d_nibbles;
+	uint32_t dig_bytes_per_chunk = chunk_size * d_nibbles / t_nibbles;
+	uint32_t dig_samples_per_chunk = (d_nibbles) ? dig_bytes_per_chunk * 2 / d_nibbles : 0;
+	uint32_t chunk_samples = d_nibbles ? dig_samples_per_chunk : (chunk_size * 2) / (a_nibbles);
+	// total chunks in entire buffer-round to 2 since we split it in half
+	uint32_t buff_chunks = (DMA_BUF_SIZE / chunk_size) & 0xFFFFFFFE;
+	// round up and force power of two since we cut it in half
+	uint32_t chunks_needed = ((dev.num_samples / chunk_samples) + 2) & 0xFFFFFFFE;
+	// If all of the samples we need fit in two half buffers or less then we can mask the error
+	// logic that is looking for cases where we didn't send one half buffer to the host before
+	// the 2nd buffer ended because we only use each half buffer once.
+	mask_xfer_err = false;
+	// If requested samples are smaller than the buffer, reduce the size so that the
+	// transfer completes sooner.
+	// Also, mask the sending of aborts if the requested number of samples fit into RAM
+	// Don't do this in continuous mode as the final size is unknown
+	if (dev.cont == false)
 	{
-		// The wait for event (wfe) puts core1 in an idle state
-		// Each core instruction takes a memory cycle, as does each core memory or IO register read.
-		// The memory fabric supports up to 4 reads per cycle if there are no bank conflicts
-		// The DMA engine needs a read of the PIO and ADC and a write of memory
-		// and thus chances of conflicts are high.  Thus once we are in sampling mode slow down C1 to allow
-		// C0 to loop faster and process faster.
-		// Without wfes C1 typically completes 10x the number of outer loops as C0, but with the wfes
-		// C0 completes more loops and C1 activity drops to 1% .
-		// Much of the C0 code has built in sev (Send Event) but we also add an explicit one in the main while loop
-
-		if (dev.started)
+		if (buff_chunks > chunks_needed)
 		{
-			c1cnt++;
-			__wfe();
-			__wfe();
-			__wfe();
-			__wfe();
-			__wfe();
-			__wfe();
-			__wfe();
-			__wfe();
-			__wfe();
-			__wfe();
+			mask_xfer_err = true;
+			buff_chunks = chunks_needed;
 		}
-		if (dev.started == false)
+	}
+
+	// Give dig and analog equal fractions
+	// This is the size of each half buffer in bytes
+	dev.d_size = (buff_chunks * chunk_size * d_nibbles) / (t_nibbles * 2);
+	dev.a_size = (buff_chunks * chunk_size * a_nibbles) / (t_nibbles * 2);
+	dev.samples_per_half = chunk_samples * buff_chunks / 2;
+
+	// Clear any previous ADC over/underflow
+	hw_set_bits(&adc_hw->fcs, ADC_FCS_OVER_BITS | ADC_FCS_UNDER_BITS);
+
+	// Ensure any previous dma is done
+	// The cleanup loop also does this but it doesn't hurt to do it twice
+	dma_channel_abort(admachan0);
+	dma_channel_abort(admachan1);
+	dma_channel_abort(pdmachan0);
+	dma_channel_abort(pdmachan1);
+
+	// Enable the initial chaing from the first half to 2nd, further chains are enabled based
+	// on whether we can parse each half in time.
+	channel_config_set_chain_to(&acfg0, admachan1);
+	channel_config_set_chain_to(&pcfg0, pdmachan1);
+	channel_config_set_chain_to(&acfg1, admachan1);
+	channel_config_set_chain_to(&pcfg1, pdmachan1);
+
+	num_halves = 0;
+	dev.dbuf0_start = 0;
+	ccnt = 0;
+	dev.dbuf1_start = dev.d_size;
+	dev.abuf0_start = dev.dbuf1_start + dev.d_size;
+	dev.abuf1_start = dev.abuf0_start + dev.a_size;
+
+	if (dev.a_chan_cnt)
+	{
+		uint32_t adcdivint = 48000000ULL / (dev.sample_rate * dev.a_chan_cnt);
+		// The AMUX can't be switched by the ADC round robin, A0 is one fixed pin.
+		// Select it before claiming the analog subsystem, amux_select_bio() refuses afterwards
+		adc_run(false);
+		amux_select_bio(SIGROK_ANALOG_BIO);
+		scope_running = 1;
+		adc_select_input(AMUX_OUT_ADC);
+		adc_set_round_robin(0);
+		//             en, dreq_en,dreq_thresh,err_in_fifo,byte_shift to 8 bit
+		adc_fifo_setup(false, true, 1, false, true);
+		adc_fifo_drain();
+
+		// This sdk function doesn't support support the fractional divisor
+		//  adc_set_clkdiv((float)(adcdivint-1));
+		// The ADC divisor has some not well documented limitations.
+		//-A value of 0 actually creates a 500khz sample clock.
+		//-Values below 96 don't work well (the SDK has comments about it
+		// in the adc_set_clkdiv document)
+		// It is also import to subtract one from the desired divisor
+		// because the period of ADC clock is 1+INT+FRAC/256
+		// For the case of a requested 500khz clock, we would normally write
+		// a divisor of 95, but doesn't give the desired result, so we use
+		// the 0 value instead.
+		// Fractional divisors should generally be avoided because it creates
+		// skew with digital samples.
+		uint8_t adc_frac_int;
+		adc_frac_int = (uint8_t)(((48000000ULL % dev.sample_rate) * 256ULL) / dev.sample_rate);
+		if (adcdivint <= 96)
 		{
-			// always drain all defined uarts as if that is not done it can
-			// effect the usb serial CDC stability
-			// these are generally rare events caused by noise/reset events
-			// and thus not checked when dev.started
-			/*while (uart_is_readable_within_us(uart0, 0))
-			{
-				uartch = uart_getc(uart0);
-			}*/
+			adc_hw->div = 0;
 		}
-		// look for commands on usb cdc
-		//getchar_timeout_us(0);
-		//tud_task();
-		//tx_fifo_service(); //bus pirate printf
-		bool has_data=bin_rx_fifo_try_get(&intin);
-		// The '+' is the only character we track during normal sampling because it can end
-		// a continuous trace.  A reset '*' should only be seen after we have completed normally
-		// or hit an error condition.
-		if (has_data && intin == '+')
+		else
 		{
-			dev.sending = false;
-			dev.aborted = false; // clear the abort so we stop sending !!
+			adc_hw->div = ((adcdivint - 1) << 8) | adc_frac_int;
 		}
-		// send_resp is used to eliminate all prints from core1 to prevent collisions with
-		// prints in core0
-		else if (has_data && intin >= 0)
+
+		//             en, dreq_en,dreq_thresh,err_in_fifo,byte_shift to 8 bit
+		adc_fifo_setup(true, true, 1, false, true);
+
+		// set chan0 to immediate trigger (but without adc_run it shouldn't start), chan1 is chained to it.
+		//  channel, config, write_addr,read_addr,transfer_count,trigger)
+		dma_channel_configure(admachan0, &acfg0, &(capture_buf[dev.abuf0_start]), &adc_hw->fifo, dev.a_size, true);
+		dma_channel_configure(admachan1, &acfg1, &(capture_buf[dev.abuf1_start]), &adc_hw->fifo, dev.a_size, false);
+		adc_fifo_drain();
+	} // any analog enabled
+
+	if (dev.d_mask)
+	{
+		/* pin count is restricted to 4,8,16 or 32, and pin count of 4 is only used
+	   Pin count is kept to a powers of 2 so that we always read a sample with a single byte/word/dword read
+	   for faster parsing.
+			if analog is disabled and we are in D4 mode
+			   bits d_dma_bps   d_tx_bps
+			   0-4    0          1        No analog channels
+			   0-4    1          1        1 or more analog channels
+			   5-7    1          1
+			   8      1          2
+	   */
+		dev.pin_count = 0;
+		if (dev.d_mask & 0x0000000F) dev.pin_count += 4;
+		if (dev.d_mask & 0x000000F0) dev.pin_count += 4;
+		if (dev.d_mask & 0x0000FF00) dev.pin_count += 8;
+		if (dev.d_mask & 0x0FFF0000) dev.pin_count += 16;
+
+		// If 4 or less channels are enabled but ADC is also enabled, set a minimum size of 1B of PIO storage
+		if ((dev.pin_count == 4) && (dev.a_chan_cnt))
 		{
-			if (process_char(&dev, (char)intin))
-			{
-				send_resp = true;
-			}
+			dev.pin_count = 8;
 		}
-	} // while true
+
+		d_dma_bps = dev.pin_count >> 3;
+		capture_prog_instr = pio_encode_in(pio_pins, dev.pin_count);
+		capture_prog_offset = pio_add_program(pio, &capture_prog);
+		capture_prog_loaded = true;
+		// Configure state machine to loop over this `in` instruction forever,
+		// with autopush enabled.
+		pio_sm_config c = pio_get_default_sm_config();
+		// D0-D7 are BIO0-BIO7, contiguous GPIOs starting at bio2bufiopin[BIO0]
+		sm_config_set_in_pins(&c, bio2bufiopin[BIO0]);
+		sm_config_set_wrap(&c, capture_prog_offset, capture_prog_offset);
+
+		uint32_t clk_sys = clock_get_hz(clk_sys);
+		uint16_t div_int;
+		uint8_t frac_int;
+		div_int = clk_sys / dev.sample_rate;
+		if (div_int < 1)
+			div_int = 1;
+		frac_int = (uint8_t)(((clk_sys % dev.sample_rate) * 256ULL) / dev.sample_rate);
+		// Unlike the ADC, the PIO int divisor does not have to subtract 1.
+		// Frequency=sysclkfreq/(CLKDIV_INT+CLKDIV_FRAC/256)
+		sm_config_set_clkdiv_int_frac(&c, div_int, frac_int);
+
+		// Since we enable digital channels in groups of 4, we always get 32 bit words
+		sm_config_set_in_shift(&c, true, true, 32);
+		sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+		pio_sm_init(pio, piosm, capture_prog_offset, &c);
+		pio_sm_set_enabled(pio, piosm, false);
+		pio_sm_clear_fifos(pio, piosm);
+		pio_sm_restart(pio, piosm);
+		// clear a stale RX stall flag, check_half() treats it as lost samples
+		pio->fdebug = 1u << (PIO_FDEBUG_RXSTALL_LSB + piosm);
+
+		channel_config_set_dreq(&pcfg0, pio_get_dreq(pio, piosm, false));
+		channel_config_set_dreq(&pcfg1, pio_get_dreq(pio, piosm, false));
+
+		//                       number    config   buffer target                  piosm          xfer size  trigger
+		dma_channel_configure(pdmachan0, &pcfg0, &(capture_buf[dev.dbuf0_start]), &pio->rxf[piosm], dev.d_size >> 2, true);
+		dma_channel_configure(pdmachan1, &pcfg1, &(capture_buf[dev.dbuf1_start]), &pio->rxf[piosm], dev.d_size >> 2, false);
+	} // dev.d_mask
+
+	// Enable logic and analog close together for best possible alignment
+	// warning - do not put printfs or similar things here...
+	if (dev.a_chan_cnt)
+	{
+		adc_run(true); // enable free run sample mode
+	}
+	pio_sm_set_enabled(pio, piosm, true);
+	dev.started = true;
+	init_done = true;
+}
+
+// capture finished or aborted: report the byte count and stop the hardware
+static void sigrok_stop(void)
+{
+	PIO pio = PIO_LOGIC_ANALYZER_PIO;
+	uint piosm = PIO_LOGIC_ANALYZER_SM;
+
+	// The end of sequence byte_cnt uses a "$<byte_cnt>+" format.
+	// Send the byte_cnt to ensure no bytes were lost
+	if (dev.aborted == false)
+	{
+		char brsp[16];
+		// Give the host time to finish processing samples so that the bytecnt
+		// isn't dropped on the wire
+		busy_wait_ms(100);
+		snprintf(brsp, sizeof(brsp), "$%u+", ccnt);
+		sigrok_cdc_write(brsp, strlen(brsp));
+		tud_cdc_n_write_flush(SIGROK_CDC);
+	}
+
+	if (dev.a_chan_cnt)
+	{
+		adc_run(false);
+		adc_fifo_setup(false, false, 0, false, false);
+		adc_fifo_drain();
+		adc_hw->div = 0;
+		scope_running = 0;
+	}
+	pio_sm_set_enabled(pio, piosm, false);
+	pio_sm_clear_fifos(pio, piosm);
+	if (capture_prog_loaded)
+	{
+		pio_remove_program(pio, &capture_prog, capture_prog_offset);
+		capture_prog_loaded = false;
+	}
+
+	dma_channel_abort(admachan0);
+	dma_channel_abort(admachan1);
+	dma_channel_abort(pdmachan0);
+	dma_channel_abort(pdmachan1);
+	init_done = false;
 }
 
-void pico_sdk_sigrok_usb(void)
+void sigrok_setup(void)
 {
-	char cmdstr[20];
-	int cmdstrptr = 0;
-	char charin, tmpchar;
-	long int i, j;
-	uint16_t len;
-	uint32_t tmpint, tmpint2;
-
-	dma_channel_config acfg0, acfg1, pcfg0, pcfg1;
-	uint admachan0, admachan1, pdmachan0, pdmachan1;
-	PIO pio = pio0;
-	uint piosm = 0;
-	float ddiv;
-	int res;
-	bool init_done = false;
-	uint64_t starttime, endtime;
-
-	//set_sys_clock_khz(SYS_CLK_BASE, true);
-	//stdio_usb_init();
-	//uart_set_format(uart0, 8, 1, 1);
-	//uart_init(uart0, 921600);
-	//gpio_set_function(0, GPIO_FUNC_UART);
-	//gpio_set_function(1, GPIO_FUNC_UART);
-	//sleep_us(100000);
-	//printf("\n\rHello from PICO sigrok device \n\r");
-
-	uint f_pll_sys = frequency_count_khz(CLOCKS_FC0_SRC_VALUE_PLL_SYS_CLKSRC_PRIMARY);
-	//printf("pll_sys = %dkHz\n\r", f_pll_sys);
-	uint f_clk_sys = frequency_count_khz(CLOCKS_FC0_SRC_VALUE_CLK_SYS);
-	//printf("clk_sys = %dkHz\n\r", f_clk_sys);
-
-	// Set GPIO23 (TP4) to control switched mode power supply noise
-	//gpio_init_mask(1 << 23);
-	//gpio_set_dir_masked(1 << 23, 1 << 23);
-	//gpio_put_masked(1 << 23, 1 << 23);
-
-	// Early CDC IO code had lots of sleep statements, but the TUD code seems to have sufficient
-	// checks that this isn't needed, but it doesn't hurt...
-	sleep_us(100000);
-
-	// GPIOs 26 through 28 (the ADC ports) are on the PICO, GPIO29 is not a pin on the PICO
-	//adc_gpio_init(26);
-	//adc_gpio_init(27);
-	//adc_gpio_init(28);
-	//adc_init();
-
-	//multicore_launch_core1(core1_code);
-
-	admachan0 = dma_claim_unused_channel(true);
-	admachan1 = dma_claim_unused_channel(true);
-	pdmachan0 = dma_claim_unused_channel(true);
-	pdmachan1 = dma_claim_unused_channel(true);
+	// commands come through the binmode RX queue, trace data bypasses the TX queue
+	system_config.binmode_usb_rx_queue_enable = true;
+	system_config.binmode_usb_tx_queue_enable = false;
+
+	init(&dev);
+	init_done = false;
+	capture_prog_loaded = false;
+	dma_missing = false;
+
+	// Since RP2040 is 32 bit this should always be 4B aligned, and it must be because the PIO
+	// does DMA on a per byte basis
+	capture_buf = mem_alloc(DMA_BUF_SIZE, BP_BIG_BUFFER_LA);
+	if (!capture_buf)
+	{
+		return;
+	}
+
+	// Don't panic when another mode holds DMA channels, give back what we got and stay idle
+	int chan[4];
+	for (uint8_t i = 0; i < count_of(chan); i++)
+	{
+		chan[i] = dma_claim_unused_channel(false);
+		if (chan[i] < 0)
+		{
+			while (i--)
+			{
+				dma_channel_unclaim(chan[i]);
+			}
+			dma_missing = true;
+			mem_free(capture_buf);
+			capture_buf = NULL;
+			return;
+		}
+	}
+	admachan0 = chan[0];
+	admachan1 = chan[1];
+	pdmachan0 = chan[2];
+	pdmachan1 = chan[3];
 	acfg0 = dma_channel_get_default_config(admachan0);
 	acfg1 = dma_channel_get_default_config(admachan1);
 	pcfg0 = dma_channel_get_default_config(pdmachan0);
@@ -845,543 +1065,112 @@ void pico_sdk_sigrok_usb(void)
 	channel_config_set_write_increment(&acfg1, true);
 	channel_config_set_write_increment(&pcfg0, true);
 	channel_config_set_write_increment(&pcfg1, true);
-
 	// Pace transfers based on availability of ADC samples
 	channel_config_set_dreq(&acfg0, DREQ_ADC);
 	channel_config_set_dreq(&acfg1, DREQ_ADC);
-	volatile uint32_t *tcounta0, *tcounta1, *tcountd0, *tcountd1;
-	tcounta0 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan0 + 0x8); // DMA_TRANS_COUNT offset
-	tcounta1 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan1 + 0x8); // DMA_TRANS_COUNT offset
-	tcountd0 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan0 + 0x8); // DMA_TRANS_COUNT offset
-	tcountd1 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan1 + 0x8); // DMA_TRANS_COUNT offset
-
-	// Use the debug version of the count registers because the count of the DMA_TRANS_COUNT is not
-	// visible if it is not active
-	volatile uint32_t *tcountdbga0, *tcountdbga1, *tcountdbgd0, *tcountdbgd1;
-	tcountdbga0 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan0 + 0x804); // DMA_TRANS_COUNT DBGoffset
-	tcountdbga1 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan1 + 0x804); // DMA_TRANS_COUNT DBGoffset
-	tcountdbgd0 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan0 + 0x804); // DMA_TRANS_COUNT DBGoffset
-	tcountdbgd1 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan1 + 0x804); // DMA_TRANS_COUNT DBGoffset
-
-	taddra0 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan0 + 0x4); // DMA_WRITE_addr offset
-	taddra1 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan1 + 0x4); // DMA_WRITE_addr offset
-	taddrd0 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan0 + 0x4); // DMA_WRITE_addr offset
-	taddrd1 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan1 + 0x4); // DMA_WRITE_addr offset
-
-	tstsa0 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan0 + 0xc); // DMA_WRITE_sts offset
-	tstsa1 = (volatile uint32_t *)(DMA_BASE + 0x40 * admachan1 + 0xc); // DMA_WRITE_sts offset
-	tstsd0 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan0 + 0xc); // DMA_WRITE_sts offset
-	tstsd1 = (volatile uint32_t *)(DMA_BASE + 0x40 * pdmachan1 + 0xc); // DMA_WRITE_sts offset
-	
-	// PIO status
-	volatile uint32_t *pioctrl, *piofstts, *piodbg, *pioflvl;
-	pioctrl = (volatile uint32_t *)(PIO0_BASE);		   // PIO CTRL
-	piofstts = (volatile uint32_t *)(PIO0_BASE + 0x4); // PIO FSTAT
-	piodbg = (volatile uint32_t *)(PIO0_BASE + 0x8);   // PIO DBG
-	pioflvl = (volatile uint32_t *)(PIO0_BASE + 0x10); // PIO FLVL
-
-	volatile uint32_t *pio0sm0clkdiv;
-	pio0sm0clkdiv = (volatile uint32_t *)(PIO0_BASE + 0xc8);
-	
+
 	// Give High priority to DMA to ensure we don't overflow the PIO or DMA fifos
 	// The DMA controller must read across the common bus to read the PIO fifo so enabled both reads and write
+	bus_priority = bus_ctrl_hw->priority;
 	bus_ctrl_hw->priority = BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS;
 
-	init(&dev);
-	
-	// Since RP2040 is 32 bit this should always be 4B aligned, and it must be because the PIO
-	// does DMA on a per byte basis
-	// If either malloc fails the code will just hang
-	//printf("Malloc\n\r");
-	capture_buf = malloc(DMA_BUF_SIZE);
-	//printf("DMA start %p\n\r", (void *)capture_buf);
-	
-	// Ensure we leave 10k or more left for any dynamic allocations that need it
-	/*uint8_t *tptr;
-	tptr = malloc(10000);
-	//printf("10K free start %p\n\r", (void *)tptr);
-	free(tptr);*/
-
-	// This testmode forces the device into a capture state without needing
-	// sigrok cli/pulseview to initiate it
-	// All of the needed fields may not be up to date...
-	/*
-		 dev.started=false;
-		 dev.cont=false;
-		 dev.sending=true;
-		 dev.a_chan_cnt=0; //count of enabled analog channels
-		 dev.a_mask=0x0;
-		 dev.d_mask=0xF;
-		 dev.d_nps=1; //digital nibbles per slice
-		 dev.sample_rate=1000;
-		 dev.num_samples=5000;
-		 dev.scnt=0; //number of samples sent
-		 ccnt=0;
-
-	*/
-
-	//gpio_init_mask(GPIO_D_MASK);		 // set as GPIO_FUNC_SIO and clear output enable
-	//gpio_set_dir_masked(GPIO_D_MASK, 0); // Set all to input
-	bio_init();
-
-	while (1)
+	for (uint8_t i = 0; i < count_of(pin_labels); i++)
 	{
-		//__sev(); // send event to wake core1
-		
-		tud_task();
-		tx_fifo_service();
-		//printf("Hello");
-		
-		if (send_resp)
-		{
-			int mylen = strlen(dev.rspstr);
-			// Don't mix printf with direct to usb commands
-			// //printf("%s",dev.rspstr);
-			my_stdio_usb_out_chars(dev.rspstr, mylen);
-			send_resp = false;
-		}
-		// //printf("ss %d %d",dev.sending,dev.started);
-		if (dev.sending && (dev.started == false))
-		{
-			// Only boost frequency during a sample so that average device power is less.
-			// It's not clear that this is needed because rp2040 is pretty low power, but it can't hurt...
-#ifdef SYS_CLK_BOOST_EN
-			// This is not enabled if any analog channels are enabled because due to
-			// ADC frequency limits the processing rate is never the limiter to performance.
-			// And maybe it might help avoid an overfrequency issue with ADC...or not...
-			if (dev.a_chan_cnt == 0)
-			{
-				//printf("Boost up\n\r");
-				set_sys_clock_khz(SYS_CLK_BOOST_FREQ, true);
-				// UART is based on sys_clk so must be reprogrammed
-				uart_init(uart0, UART_BAUD);
-			}
-#endif
-			lowerhalf = 1;
-			
-			// Sample rate must always be even.  Pulseview code enforces this
-			// because a frequency step of 2 is required to get a pulldown to specify
-			// the sample rate, but sigrok cli can still pass it.
-			dev.sample_rate >>= 1;
-			dev.sample_rate <<= 1;
-			
-			// Adjust up and align to 4 to avoid rounding errors etc
-			if (dev.num_samples < 16)
-			{
-				dev.num_samples = 16;
-			}
-			
-			dev.num_samples = (dev.num_samples + 3) & 0xFFFFFFFC;
-			
-			// Divide capture buf evenly based on channel enables
-			// d_size is aligned to 4 bytes because pio operates on words
-			// These are the sizes for each half buffer in bytes
-			// Calculate relative size in terms of nibbles which is the smallest unit, thus a_chan_cnt is multiplied by 2
-			// Nibble size storage is only allow for D4 mode with no analog channels enabled
-			// For instance a D0..D5 with A0 would give 1/2 the storage to digital and 1/2 to analog
-			uint32_t d_nibbles, a_nibbles, t_nibbles; // digital, analog and total nibbles
-			d_nibbles = dev.d_nps;					  // digital is in grous of 4 bits
-			a_nibbles = dev.a_chan_cnt * 2;			  // 1 byte per sample
-			t_nibbles = d_nibbles + a_nibbles;
-
-			// total buf size must be a multiple of a_nibbles*2, d_nibbles*8, and t_nibbles so that division is always
-			// in whole samples
-			// Also set a multiple of 32  because the dma buffer is split in half, and
-			// the PIO does writes on 4B boundaries, and then a 4x factor for any other size/alignment issues
-			uint32_t chunk_size = t_nibbles * 32;
-			if (a_nibbles)
-				chunk_size *= a_nibbles;
-			if (d_nibbles)
-				chunk_size *= d_nibbles;
-			uint32_t dig_bytes_per_chunk = chunk_size * d_nibbles / t_nibbles;
-			uint32_t dig_samples_per_chunk = (d_nibbles) ? dig_bytes_per_chunk * 2 / d_nibbles : 0;
-			uint32_t chunk_samples = d_nibbles ? dig_samples_per_chunk : (chunk_size * 2) / (a_nibbles);
-			// total chunks in entire buffer-round to 2 since we split it in half
-			uint32_t buff_chunks = (DMA_BUF_SIZE / chunk_size) & 0xFFFFFFFE;
-			// round up and force power of two since we cut it in half
-			uint32_t chunks_needed = ((dev.num_samples / chunk_samples) + 2) & 0xFFFFFFFE;
-			//printf("Initial buf calcs nibbles d %d a %d t %d \n\r", d_nibbles, a_nibbles, t_nibbles);
-			//printf("chunk size %d samples %d buff %d needed %d\n\r", chunk_size, chunk_samples, buff_chunks, chunks_needed);
-			//printf("dbytes per chunk %d dig samples per chunk %d\n\r", dig_bytes_per_chunk, dig_samples_per_chunk);
-			// If all of the samples we need fit in two half buffers or less then we can mask the error
-			// logic that is looking for cases where we didn't send one half buffer to the host before
-			// the 2nd buffer ended because we only use each half buffer once.
-			mask_xfer_err = false;
-			// If requested samples are smaller than the buffer, reduce the size so that the
-			// transfer completes sooner.
-			// Also, mask the sending of aborts if the requested number of samples fit into RAM
-			// Don't do this in continuous mode as the final size is unknown
-			if (dev.cont == false)
-			{
-				if (buff_chunks > chunks_needed)
-				{
-					mask_xfer_err = true;
-					buff_chunks = chunks_needed;
-					// //printf("Reduce buf chunks to %d\n\r",buff_chunks);
-				}
-			}
-			
-			// Give dig and analog equal fractions
-			// This is the size of each half buffer in bytes
-			dev.d_size = (buff_chunks * chunk_size * d_nibbles) / (t_nibbles * 2);
-			dev.a_size = (buff_chunks * chunk_size * a_nibbles) / (t_nibbles * 2);
-			dev.samples_per_half = chunk_samples * buff_chunks / 2;
-			// //printf("Final sizes d %d a %d mask err %d samples per half %d\n\r"
-			//,dev.d_size,dev.a_size,mask_xfer_err,dev.samples_per_half);
-
-			// Clear any previous ADC over/underflow
-			volatile uint32_t *adcfcs;
-			adcfcs = (volatile uint32_t *)(ADC_BASE + 0x8); // ADC FCS
-			*adcfcs |= 0xC00;
-
-			// Ensure any previous dma is done
-			// The cleanup loop also does this but it doesn't hurt to do it twice
-			dma_channel_abort(admachan0);
-			dma_channel_abort(admachan1);
-			dma_channel_abort(pdmachan0);
-			dma_channel_abort(pdmachan1);
-			
-			// Enable the initial chaing from the first half to 2nd, further chains are enabled based
-			// on whether we can parse each half in time.
-			channel_config_set_chain_to(&acfg0, admachan1);
-			channel_config_set_chain_to(&pcfg0, pdmachan1);
-
-			num_halves = 0;
-			dev.dbuf0_start = 0;
-			ccnt = 0;
-			dev.dbuf1_start = dev.d_size;
-			dev.abuf0_start = dev.dbuf1_start + dev.d_size;
-			dev.abuf1_start = dev.abuf0_start + dev.a_size;
-
-			volatile uint32_t *adcdiv;
-			adcdiv = (volatile uint32_t *)(ADC_BASE + 0x10); // ADC DIV
-
-			//   //printf("adcdiv start %u\n\r",*adcdiv);
-			//	  //printf("starting d_nps %u a_chan_cnt %u d_size %u a_size %u a_mask %X\n\r"
-			//         ,dev.d_nps,dev.a_chan_cnt,dev.d_size,dev.a_size,dev.a_mask);
-			// //printf("start offsets d0 0x%X d1 0x%X a0 0x%X a1 0x%X samperhalf %u\n\r"
-			//    ,dev.dbuf0_start,dev.dbuf1_start,dev.abuf0_start,dev.abuf1_start,dev.samples_per_half);
-			// //printf("starting data buf values 0x%X 0x%X\n\r",capture_buf[dev.dbuf0_start],capture_buf[dev.dbuf1_start]);
-			uint32_t adcdivint = 48000000ULL / (dev.sample_rate * dev.a_chan_cnt);
-			
-			if (dev.a_chan_cnt)
-			{
-				adc_run(false);
-				//             en, dreq_en,dreq_thresh,err_in_fifo,byte_shift to 8 bit
-				adc_fifo_setup(false, true, 1, false, true);
-				adc_fifo_drain();
-				// //printf("astart cnt %u div %f\n\r",dev.a_chan_cnt,(float)adcdivint);
-
-				// This sdk function doesn't support support the fractional divisor
-				//  adc_set_clkdiv((float)(adcdivint-1));
-				// The ADC divisor has some not well documented limitations.
-				//-A value of 0 actually creates a 500khz sample clock.
-				//-Values below 96 don't work well (the SDK has comments about it
-				// in the adc_set_clkdiv document)
-				// It is also import to subtract one from the desired divisor
-				// because the period of ADC clock is 1+INT+FRAC/256
-				// For the case of a requested 500khz clock, we would normally write
-				// a divisor of 95, but doesn't give the desired result, so we use
-				// the 0 value instead.
-				// Fractional divisors should generally be avoided because it creates
-				// skew with digital samples.
-				uint8_t adc_frac_int;
-				adc_frac_int = (uint8_t)(((48000000ULL % dev.sample_rate) * 256ULL) / dev.sample_rate);
-				if (adcdivint <= 96)
-				{
-					*adcdiv = 0;
-				}
-				else
-				{
-					*adcdiv = ((adcdivint - 1) << 8) | adc_frac_int;
-				}
-				// //printf("adcdiv %u frac %d\n\r",*adcdiv,adc_frac_int);
-
-				// This is needed to clear the AINSEL so that when the round robin arbiter starts we start sampling on channel 0
-				adc_select_input(0);
-				adc_set_round_robin(dev.a_mask & 0x7);
-				//             en, dreq_en,dreq_thresh,err_in_fifo,byte_shift to 8 bit
-				adc_fifo_setup(true, true, 1, false, true);
-
-				// set chan0 to immediate trigger (but without adc_run it shouldn't start), chan1 is chained to it.
-				//  channel, config, write_addr,read_addr,transfer_count,trigger)
-				dma_channel_configure(admachan0, &acfg0, &(capture_buf[dev.abuf0_start]), &adc_hw->fifo, dev.a_size, true);
-				dma_channel_configure(admachan1, &acfg1, &(capture_buf[dev.abuf1_start]), &adc_hw->fifo, dev.a_size, false);
-				adc_fifo_drain();
-			} // any analog enabled
-			
-			if (dev.d_mask)
-			{
-				// analyzer_init from pico-examples
-				// Due to how PIO shifts in bits, if any digital channel within a group of 8 is set,
-				// then all groups below it must also be set. We further restrict it in the tx_init function
-				// by saying digital channel usage must be continous.
-				/* pin count is restricted to 4,8,16 or 32, and pin count of 4 is only used
-			   Pin count is kept to a powers of 2 so that we always read a sample with a single byte/word/dword read
-			   for faster parsing.
-					if analog is disabled and we are in D4 mode
-					   bits d_dma_bps   d_tx_bps
-					   0-4    0          1        No analog channels
-					   0-4    1          1        1 or more analog channels
-					   5-7    1          1
-					   8      1          2
-					   9-12   2          2
-					   13-14  2          2
-					   15-16  2          3
-					   17-21  4          3
-			   */
-				dev.pin_count = 0;
-				if (dev.d_mask & 0x0000000F) dev.pin_count += 4;
-				if (dev.d_mask & 0x000000F0) dev.pin_count += 4;
-				if (dev.d_mask & 0x0000FF00) dev.pin_count += 8;
-				if (dev.d_mask & 0x0FFF0000) dev.pin_count += 16;
-				
-				// If 4 or less channels are enabled but ADC is also enabled, set a minimum size of 1B of PIO storage
-				if ((dev.pin_count == 4) && (dev.a_chan_cnt))
-				{
-					dev.pin_count = 8;
-				}
+		bio_input(i);
+		system_bio_update_purpose_and_label(true, i, BP_PIN_MODE, pin_labels[i]);
+	}
+}
 
-				d_dma_bps = dev.pin_count >> 3;
-				// //printf("pin_count %d\n\r",dev.pin_count);
-				uint16_t capture_prog_instr;
-				capture_prog_instr = pio_encode_in(pio_pins, dev.pin_count);
-				// //printf("capture_prog_instr 0x%X\n\r",capture_prog_instr);
-				struct pio_program capture_prog = {
-					.instructions = &capture_prog_instr,
-					.length = 1,
-					.origin = -1};
-				uint offset = pio_add_program(pio, &capture_prog);
-				// Configure state machine to loop over this `in` instruction forever,
-				// with autopush enabled.
-				pio_sm_config c = pio_get_default_sm_config();
-				// start at GPIO2 (keep 0 and 1 for uart)
-				sm_config_set_in_pins(&c, 2);
-				sm_config_set_wrap(&c, offset, offset);
-
-				uint16_t div_int;
-				uint8_t frac_int;
-				div_int = frequency_count_khz(CLOCKS_FC0_SRC_VALUE_CLK_SYS) * 1000 / dev.sample_rate;
-				if(div_int < 1) div_int = 1;
-				frac_int = (uint8_t)(((frequency_count_khz(CLOCKS_FC0_SRC_VALUE_CLK_SYS) * 1000 % dev.sample_rate) * 256ULL) / dev.sample_rate);
-				//             //printf("PIO sample clk %u divint %d divfrac %d \n\r",dev.sample_rate,div_int,frac_int);
-				// Unlike the ADC, the PIO int divisor does not have to subtract 1.
-				// Frequency=sysclkfreq/(CLKDIV_INT+CLKDIV_FRAC/256)
-				sm_config_set_clkdiv_int_frac(&c, div_int, frac_int);
-
-				// Since we enable digital channels in groups of 4, we always get 32 bit words
-				sm_config_set_in_shift(&c, true, true, 32);
-				sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
-				pio_sm_init(pio, piosm, offset, &c);
-				// Analyzer arm from pico examples
-				pio_sm_set_enabled(pio, piosm, false); // clear the enabled bit
-				// XOR the shiftctrl field with PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS
-				// Do it twice to restore the value
-				pio_sm_clear_fifos(pio, piosm);
-				// write the restart bit of PIO_CTRL
-				pio_sm_restart(pio, piosm);
-
-#ifndef NODMA
-				channel_config_set_dreq(&pcfg0, pio_get_dreq(pio, piosm, false));
-				channel_config_set_dreq(&pcfg1, pio_get_dreq(pio, piosm, false));
-
-				//                       number    config   buffer target                  piosm          xfer size  trigger
-				dma_channel_configure(pdmachan0, &pcfg0, &(capture_buf[dev.dbuf0_start]), &pio->rxf[piosm], dev.d_size >> 2, true);
-				dma_channel_configure(pdmachan1, &pcfg1, &(capture_buf[dev.dbuf1_start]), &pio->rxf[piosm], dev.d_size >> 2, false);
-#endif
+void sigrok_setup_message(void)
+{
+	if (dma_missing)
+	{
+		printf("%sError: no DMA channels for the sigrok capture%s\r\n", ui_term_color_error(), ui_term_color_reset());
+		return;
+	}
+	if (!capture_buf)
+	{
+		printf("%sThe sample buffer is in use, exit the logic analyzer or scope and try again%s\r\n",
+			   ui_term_color_error(), ui_term_color_reset());
+		return;
+	}
+	printf("%sUse PulseView or sigrok-cli with the raspberrypi-pico driver on the binary COM port%s\r\n",
+		   ui_term_color_info(), ui_term_color_reset());
+	printf("%sD0-D7: IO0-IO7, A0: IO%d (AMUX, 0-6.6V)%s\r\n",
+		   ui_term_color_info(), SIGROK_ANALOG_BIO, ui_term_color_reset());
+}
 
-				// This is done later so that we start everything as close in time as possible
-				//              pio_sm_set_enabled(pio, piosm, true);
-			} // dev.d_mask
+void sigrok_cleanup(void)
+{
+	if (!capture_buf)
+	{
+		return;
+	}
+	if (init_done)
+	{
+		dev.aborted = true; // no byte count, the host is gone
+		sigrok_stop();
+	}
+	dma_channel_unclaim(admachan0);
+	dma_channel_unclaim(admachan1);
+	dma_channel_unclaim(pdmachan0);
+	dma_channel_unclaim(pdmachan1);
+	bus_ctrl_hw->priority = bus_priority;
+	for (uint8_t i = 0; i < count_of(pin_labels); i++)
+	{
+		system_bio_update_purpose_and_label(false, i, BP_PIN_MODE, 0);
+	}
+	mem_free(capture_buf);
+	capture_buf = NULL;
+	system_config.binmode_usb_rx_queue_enable = true;
+	system_config.binmode_usb_tx_queue_enable = true;
+}
 
-			// These must be at their initial value,(or zero for the 2ndhalf) otherwise it indicates they have started to countdown
-			// //printf("Tcount start d %u %u a %u %u\n\r",*tcountd0,*tcountd1,*tcounta0,*tcounta1);
-			// These must be the initial value for both
-			// //printf("Tcount dbg start d 0x%X 0x%X a 0x%X 0x%X\n\r",*tcountdbgd0,*tcountdbgd1,*tcountdbga0,*tcountdbga1);
-			// These catch cases in DMA coding where DMA engines have started too soon..
+// cooperative: handles commands, starts a capture and sends finished half buffers, then returns
+void sigrok_service(void)
+{
+	char c;
 
-			if ((*tcountd0) != (*tcountdbgd0) && (dev.d_mask))
-			{
-				//printf("\n\r\n\rERROR: DMAD0 changing\n\r\n\r");
-			}
-			if ((*tcounta0) != (*tcountdbga0) && (dev.a_mask))
-			{
-				//printf("\n\r\n\rERROR: DMAA0 changing\n\r\n\r");
-			}
-			if ((*tcountd1) != 0)
-			{
-				//printf("\n\r\n\rERROR: DMAD1 should start with 0 tcount\n\r\n\r");
-			}
-			if ((*tcounta1) != 0)
-			{
-				//printf("\n\r\n\rERROR: DMAA1 should start with 0 tcount\n\r\n\r");
-			}
+	if (!capture_buf)
+	{
+		return;
+	}
 
-			// //printf("LVL0mask 0x%X\n\r",dev.lvl0mask);
-			// //printf("LVL1mask 0x%X\n\r",dev.lvl1mask);
-			// //printf("risemask 0x%X\n\r",dev.risemask);
-			// //printf("fallmask 0x%X\n\r",dev.fallmask);
-			// //printf("edgemask 0x%X\n\r",dev.chgmask);
-
-			// //printf("dma addr start d 0x%X 0x%X a 0x%X 0x%X\n\r",*taddrd0,*taddrd1,*taddra0,*taddra1);
-			// //printf("capture_buf base %p \n\r",capture_buf);
-			// //printf("capture_buf dig %p %p \n\r",&(capture_buf[dev.dbuf0_start]),&(capture_buf[dev.dbuf1_start]));
-			// //printf("capture_buf analog %p %p\n\r",&(capture_buf[dev.abuf0_start]),&(capture_buf[dev.abuf1_start]));
-			// //printf("PIOSMCLKDIV 0x%X\n\r",*pio0sm0clkdiv);
-
-			// //printf("PIO ctrl 0x%X fstts 0x%X dbg 0x%X lvl 0x%X\n\r",*pioctrl,*piofstts,*piodbg,*pioflvl);
-			// //printf("DMA channel assignments a %d %d d %d %d\n\r",admachan0,admachan1,pdmachan0,pdmachan1);
-			// //printf("DMA ctr reg addrs a %p %p d %p %p\n\r",(void *) tstsa0,(void *)tstsa1,(void *)tstsd0,(void *)tstsd1);
-			// //printf("DMA ctrl reg a 0x%X 0x%X d 0x%X 0x%X\n\r",*tstsa0,*tstsa1,*tstsd0,*tstsd1);
-			// Enable logic and analog close together for best possible alignment
-			// warning - do not put printfs or similar things here...
-			tstart = time_us_32();
-			adc_run(true); // enable free run sample mode
-			pio_sm_set_enabled(pio, piosm, true);
-			dev.started = true;
-			init_done = true;
-
-		} // if dev.sending and not started
-
-		dma_check(&dev);
-
-		// In high verbosity modes the host can miss the "!" so send these until it sends a "+"
-		if (dev.aborted == true)
+	while (bin_rx_fifo_try_get(&c))
+	{
+		// The '+' is the only character we track during normal sampling because it can end
+		// a continuous trace.  A reset '*' should only be seen after we have completed normally
+		// or hit an error condition.
+		if (c == '+')
 		{
-			//printf("sending abort !\n\r");
-			my_stdio_usb_out_chars("!!!", 3);
-			sleep_us(200000);
+			dev.sending = false;
+			dev.aborted = false; // clear the abort so we stop sending !!
 		}
-
-		// if we abort or normally finish a run sending gets dropped
-		if ((dev.sending == false) && (init_done == true))
+		else if (process_char(&dev, c))
 		{
-			// //printf("Ending PIO ctrl 0x%X fstts 0x%X dbg 0x%X lvl 0x%X\n\r",*pioctrl,*piofstts,*piodbg,*pioflvl);
-			// The end of sequence byte_cnt uses a "$<byte_cnt>+" format.
-			// Send the byte_cnt to ensure no bytes were lost
-			if (dev.aborted == false)
-			{
-				char brsp[16];
-				// Give the host time to finish processing samples so that the bytecnt
-				// isn't dropped on the wire
-				sleep_us(100000);
-				//printf("Cleanup bytecnt %d\n\r", ccnt);
-				sprintf(brsp, "$%d%c", ccnt, '+');
-				//puts_raw(brsp);
-				uint8_t len=strlen(brsp);
-				my_stdio_usb_out_chars(brsp, len);
-			}
+			sigrok_cdc_write(dev.rspstr, strlen(dev.rspstr));
+			tud_cdc_n_write_flush(SIGROK_CDC);
+		}
+	}
 
-#ifdef NODMA
-			// if dma is disabled and sample sizes are small this can be used
-			// to pull the raw sample data from the pio fifos.
-			uint lvl;
-			lvl = pio_sm_get_rx_fifo_level(pio, piosm);
-			//printf("FIFOlvl 0x%X\n\r", lvl);
-			uint32_t fval;
-			for (int x = 0; x < lvl; x++)
-			{
-				//printf("RX FIFO x %d:0x%X\n\r", x, pio_sm_get_blocking(pio, piosm));
-			}
+	if (dev.sending && (dev.started == false))
+	{
+		sigrok_start();
+	}
 
-#endif
-			adc_run(false);
-			adc_fifo_drain();
-			pio_sm_restart(pio, piosm);
-			pio_sm_set_enabled(pio, piosm, false);
-			pio_sm_clear_fifos(pio, piosm);
-			pio_clear_instruction_memory(pio);
-
-			dma_channel_abort(admachan0);
-			dma_channel_abort(admachan1);
-			dma_channel_abort(pdmachan0);
-			dma_channel_abort(pdmachan1);
-			init_done = false;
-
-			// Print USB Endpoint controls in the DPSRAM, which is at the base of USBCTRL
-			// 0x0 is setup packet,
-			// 0x8-0xfc - EP in/out buffer control
-			// 0x100 - EP0 buffer 0 (in and out)
-			// 0x140 - EPO buffer 1
-			// 0x180 - data buffers
-			/*
-						volatile uint32_t *usbctrl;
-						usbctrl=(volatile uint32_t *)(USBCTRL_BASE);
-						for(i=0;i<256;i+=4){ //It's a 4k space, but everything above this is zero
-							//printf("0x%03X %8X %8X %8X %8X \n\r",i*4,usbctrl[i],usbctrl[i+1],usbctrl[i+2],usbctrl[i+3]);
-			}
-			*/
-
-			// Print out debug information after completing, rather than before so that it doesn't
-			// delay the start of a capture
-			//printf("Complete: SRate %d NSmp %d\n\r", dev.sample_rate, dev.num_samples);
-			//printf("Cont %d bcnt %d\n\r", dev.cont, ccnt);
-			//printf("DMsk 0x%X AMsk 0x%X\n\r", dev.d_mask, dev.a_mask);
-			//printf("Half buffers %d sampperhalf %d\n\r", num_halves, dev.samples_per_half);
-
-			// Report the number of main loops for each core to ensure
-			// C0 runs more loops
-			//printf("loop counts C0 %d C1 %d\n\r", c0cnt, c1cnt);
-			c0cnt = 0;
-			c1cnt = 0;
-#ifdef SYS_CLK_BOOST_EN
-			// Drop down to base to reduce power when not sampling
-			set_sys_clock_khz(SYS_CLK_BASE, true);
-			uart_init(uart0, UART_BAUD);
-			//printf("Boost down\n\r");
-#endif
-		} // i sending==false
-	}	  // while(1)
-
-} // main
-
-// Depracated trigger logic
-// This HW based trigger which should be part of send slices was tested enough to confirm the
-// trigger value worked, however it
-// was not fully implemented because the RP2040 wasn't able to perform the trigger detection and
-// memory buffer management to support sample rates that were substantially higher than the
-// stream rates across USB.  Thus there wasn't a compelling reason to have it.
-// It's left as an example as to how the masks could be used.
-//   To fully support a HW based triggering, a precapture ring buffer of both digital and analog samples
-// would need to be created an managed to store and send pretrigger values.
-// The ring buffer would need to support RLEs and would need to ensure it was sent before sending
-// other samples capture by the DMA after the trigger event.
-/*
-//   uint32_t tlval; Trigger last val
-//   tlval=d->tlval;
-//   uint32_t all_mask=d->lvl0mask | d->lvl1mask| d->risemask | d->fallmask | d->chgmask;
-
-
-			 if(d->triggered==false) {
-				 uint32_t matches=0;
-				 matches|=(~cval & d->lvl0mask);
-				 matches|=(cval & d->lvl1mask);
-				 if(d->notfirst){
-					 matches|=(cval & ~tlval & d->risemask);
-					 matches|=(~cval & tlval & d->fallmask);
-					 matches|=(~cval & tlval & d->chgmask);
-				 }
-				 if(matches==all_mask){
-		 ////printf("Triggered c 0x%X l 0x%X \n\r",cval,tlval);
-					 d->triggered=true;
-					 //This sends the last val on a trigger because SW based trigger on the host needs to see its
-					 //value so that rising/falling/edge triggeers will fire there too.
-					 lbyte=0;
-					 for(char b=0;b < d->d_tx_bps;b++){
-							cbyte=tlval&0xFF;
-							txbuf[txbufidx]=(cbyte<<b)|lbyte|0x80;
-							lbyte=cbyte>>(7-b);
-							tlval>>=8;
-				txbufidx++;
-					 } //for b
-				 }//matches==all_mask
-				 d->notfirst=true;
-			 }
-			 if(d->triggered){
-						 //Transmit samples if we have already triggered.
-				}
+	dma_check(&dev);
+
+	// In high verbosity modes the host can miss the "!" so send these until it sends a "+"
+	if (dev.aborted && (time_us_64() > abort_time))
+	{
+		sigrok_cdc_write("!!!", 3);
+		tud_cdc_n_write_flush(SIGROK_CDC);
+		abort_time = time_us_64() + SIGROK_ABORT_INTERVAL_US;
+	}
 
-//save trigger last value to support rising/falling/change values
-//      tlval=lval;
-End of depracated trigger logic
-*/
+	// if we abort or normally finish a run sending gets dropped
+	if ((dev.sending == false) && init_done)
+	{
+		sigrok_stop();
+	}
+}
@@ -1,2 +1,10 @@
-void pico_sdk_sigrok_no_usb(void);
-void pico_sdk_sigrok_usb(void);
\ No newline at end of file
+#ifndef PICO_SDK_SIGROK_H
+#define PICO_SDK_SIGROK_H
+
+extern const char sigrok_name[];
+void sigrok_setup(void);
+void sigrok_setup_message(void);
+void sigrok_service(void);
+void sigrok_cleanup(void);
+
+#endif // PICO_SDK_SIGROK_H
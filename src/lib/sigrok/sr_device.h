@@ -102,7 +102,7 @@ typedef struct sr_device
 } sr_device_t;
 
 // reset as part of init, or on a completed send
-void reset(sr_device_t *d)
+static void reset(sr_device_t *d)
 {
    d->sending = 0;
    d->cont = 0;
@@ -122,7 +122,7 @@ void reset(sr_device_t *d)
 };
 
 // initial post reset state
-void init(sr_device_t *d)
+static void init(sr_device_t *d)
 {
    reset(d);
    d->a_mask = 0;
@@ -134,7 +134,7 @@ void init(sr_device_t *d)
    d->cmdstrptr = 0;
 }
 
-void tx_init(sr_device_t *d)
+static void tx_init(sr_device_t *d)
 {
    // A reset should have already been called to restart the device.
    // An additional one here would clear trigger and other state that had been updated
@@ -179,7 +179,7 @@ void tx_init(sr_device_t *d)
 // Process incoming character stream
 // Return 1 if the device rspstr has a response to send to host
 // Be sure that rspstr does not have \n  or \r.
-int process_char(sr_device_t *d, char charin)
+static int process_char(sr_device_t *d, char charin)
 {
    int tmpint, tmpint2, ret;
    // set default rspstr for all commands that have a dataless ack
@@ -189,7 +189,6 @@ int process_char(sr_device_t *d, char charin)
    if (charin == '*')
    {
       reset(d);
-      printf("RST* %d\n\r", d->sending);
       return 0;
    }
    else if ((charin == '\r') || (charin == '\n'))
@@ -199,8 +198,7 @@ int process_char(sr_device_t *d, char charin)
       {
       case 'i':
          // SREGEN,AxxyDzz,00 - num analog, analog size, num digital,version
-         sprintf(d->rspstr, "SRPICO,A%02d1D%02d,02", NUM_A_CHAN, NUM_D_CHAN);
-         printf("ID rsp %s\n\r", d->rspstr);
+         snprintf(d->rspstr, sizeof(d->rspstr), "SRPICO,A%02d1D%02d,02", NUM_A_CHAN, NUM_D_CHAN);
          ret = 1;
          break;
       case 'R':
@@ -238,7 +236,7 @@ int process_char(sr_device_t *d, char charin)
          {
             // scale and offset are both in integer uVolts
             // separated by x
-            sprintf(d->rspstr, "25700x0"); // 3.3/(2^7) and 0V offset
+            snprintf(d->rspstr, sizeof(d->rspstr), "51562x0"); // 6.6/(2^7) through the AMUX 1/2 divider, 0V offset
             // //printf("ASCL%d\n\r",tmpint);
             ret = 1;
          }
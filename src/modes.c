@@ -542,7 +542,7 @@ struct _mode modes[] = {
 #endif
 #ifdef BP_USE_BINLOOPBACK
     {
-        .protocol_name = "BIN"                                   // friendly name (promptname)
+        .protocol_name = "BIN",                                  // friendly name (promptname)
         .protocol_start = binloopback_open, // start
         .protocol_start_alt = binloopback_open_read,             // start with read
         .protocol_stop = binloopback_close,                      // stop
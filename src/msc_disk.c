@@ -386,6 +386,9 @@ void eject_usbmsdrive(void) {
 void insert_usbmsdrive(void) {
     insert_or_eject_usbmsdrive(true);
 }
+bool usbmsdrive_is_ejected(void) {
+    return is_ejected();
+}
 
 // eject and insert the usbms drive to force the host to sync its contents
 void refresh_usbmsdrive(void) {
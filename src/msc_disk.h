@@ -23,6 +23,8 @@
  *
  */
 
+#include <stdbool.h>
+
 // remove and insert the usbms drive to force the host to sync its contents
 void refresh_usbmsdrive(void);
 
@@ -37,3 +39,6 @@ void make_usbmsdrive_writable(void);
 
 // remove before jump to bootloader
 void eject_usbmsdrive(void);
+
+// true if the usbms drive is not presented to the host
+bool usbmsdrive_is_ejected(void);
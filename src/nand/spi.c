@@ -8,12 +8,74 @@
 #include "pico/stdlib.h"
 #include "pirate.h"
 #include "hardware/spi.h"
+#include "hardware/dma.h"
 #include "pirate/bio.h"
 #include "system_config.h"
 #include "ui/ui_term.h"
 #include "spi.h"
 #include "nand/sys_time.h"
 
+// page data is moved by a DMA channel pair, command and address bytes stay polled
+#define NAND_SPI_DMA_MIN 16
+
+static const uint8_t nand_spi_dma_zero = 0x00;
+static uint8_t nand_spi_dma_discard;
+
+// clock len bytes with DMA: tx NULL sends zeros, rx NULL discards what comes in.
+// returns false without touching the bus if two channels are not free.
+// the RX channel finishes last, when it is done the bus is idle and the RX FIFO empty
+static bool nand_spi_dma(
+    const uint8_t* tx, uint8_t* rx, size_t len, uint32_t start_time, uint32_t timeout_ms, int* ret) {
+    int tx_chan = dma_claim_unused_channel(false);
+    if (tx_chan < 0) {
+        return false;
+    }
+    int rx_chan = dma_claim_unused_channel(false);
+    if (rx_chan < 0) {
+        dma_channel_unclaim(tx_chan);
+        return false;
+    }
+
+    // anything left in the RX FIFO would shift the read data
+    while (spi_is_readable(BP_SPI_PORT)) {
+        (void)spi_get_hw(BP_SPI_PORT)->dr;
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(rx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, rx != NULL);
+    channel_config_set_dreq(&c, spi_get_dreq(BP_SPI_PORT, false));
+    dma_channel_configure(
+        rx_chan, &c, rx ? rx : &nand_spi_dma_discard, &spi_get_hw(BP_SPI_PORT)->dr, len, false);
+
+    c = dma_channel_get_default_config(tx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, tx != NULL);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(BP_SPI_PORT, true));
+    dma_channel_configure(
+        tx_chan, &c, &spi_get_hw(BP_SPI_PORT)->dr, tx ? tx : &nand_spi_dma_zero, len, false);
+
+    dma_start_channel_mask((1u << tx_chan) | (1u << rx_chan));
+
+    *ret = SPI_RET_OK;
+    while (dma_channel_is_busy(rx_chan)) {
+        if (sys_time_is_elapsed(start_time, timeout_ms)) {
+            dma_channel_abort(tx_chan);
+            dma_channel_abort(rx_chan);
+            // let what is in flight finish so the next transfer starts clean
+            spi_dma_finish();
+            *ret = SPI_RET_TIMEOUT;
+            break;
+        }
+    }
+
+    dma_channel_unclaim(tx_chan);
+    dma_channel_unclaim(rx_chan);
+    return true;
+}
+
 // public function definitions
 /*
 void nand_spi_init(void)
@@ -57,6 +119,10 @@ int nand_spi_write(const uint8_t* write_buff, size_t write_len, uint32_t timeout
 
     // perform transfer
     uint32_t start_time = sys_time_get_ms();
+    int ret;
+    if (write_len >= NAND_SPI_DMA_MIN && nand_spi_dma(write_buff, NULL, write_len, start_time, timeout_ms, &ret)) {
+        return ret;
+    }
     for (int i = 0; i < write_len; i++) {
         // block until tx empty or timeout
         while (!spi_is_writable(BP_SPI_PORT)) {
@@ -105,6 +171,10 @@ int nand_spi_read(uint8_t* read_buff, size_t read_len, uint32_t timeout_ms) {
 
     // perform transfer
     uint32_t start_time = sys_time_get_ms();
+    int ret;
+    if (read_len >= NAND_SPI_DMA_MIN && nand_spi_dma(NULL, read_buff, read_len, start_time, timeout_ms, &ret)) {
+        return ret;
+    }
     for (int i = 0; i < read_len; i++) {
         // block until tx empty or timeout
         while (!spi_is_writable(BP_SPI_PORT)) {
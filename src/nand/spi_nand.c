@@ -272,6 +272,10 @@ int spi_nand_init(struct dhara_nand* dhara_parameters_out) {
     return ret;
 }
 
+bool spi_nand_ready(void) {
+    return g_Actual_Nand_Device != NULL;
+}
+
 int spi_nand_page_read(row_address_t row, column_address_t column, void* data_out, size_t read_len) {
     // input validation
     if (!validate_row_address(row) || !validate_column_address(column)) {
@@ -327,6 +331,19 @@ int spi_nand_page_program(row_address_t row, column_address_t column, const void
     return program_execute(row, timeout);
 }
 
+int spi_nand_page_load(row_address_t row, column_address_t column, const void* data_in, size_t write_len) {
+    // input validation
+    if (!validate_row_address(row) || !validate_column_address(column)) {
+        return SPI_NAND_RET_BAD_ADDRESS;
+    }
+    uint16_t max_write_len = (SPI_NAND_PAGE_SIZE + SPI_NAND_OOB_SIZE()) - column;
+    if (write_len > max_write_len) {
+        return SPI_NAND_RET_INVALID_LEN;
+    }
+
+    return program_load(row, column, data_in, write_len, OP_TIMEOUT);
+}
+
 int spi_nand_page_copy(row_address_t src, row_address_t dest) {
     // input validation
     if (!validate_row_address(src) || !validate_row_address(src)) {
@@ -54,12 +54,19 @@ typedef uint16_t column_address_t;
 /// @brief Initializes the spi nand driver
 int spi_nand_init(struct dhara_nand* dhara_parameters_out);
 
+/// @brief True once spi_nand_init() has found a supported chip
+bool spi_nand_ready(void);
+
 /// @brief Performs a read page operation
 int spi_nand_page_read(row_address_t row, column_address_t column, void* data_out, size_t read_len);
 
 /// @brief Performs a page program operation
 int spi_nand_page_program(row_address_t row, column_address_t column, const void* data_in, size_t write_len);
 
+/// @brief Loads data into the nand's internal cache without programming it
+/// @note For bus benchmarks, the next read or load replaces the cache contents
+int spi_nand_page_load(row_address_t row, column_address_t column, const void* data_in, size_t write_len);
+
 /// @brief Copies the source page to the destination page using nand's internal cache
 int spi_nand_page_copy(row_address_t src, row_address_t dest);
 
@@ -38,6 +38,7 @@
 #include "modes.h"
 #include "displays.h"
 #include "system_monitor.h"
+#include "system_perf.h"
 #include "ui/ui_statusbar.h"
 #include "tusb.h"
 #include "hardware/sync.h"
@@ -410,12 +411,11 @@ static void main_system_initialization(void) {
     BP_DEBUG_PRINT(BP_DEBUG_LEVEL_VERBOSE, BP_DEBUG_CAT_EARLY_BOOT,
         "Init: showing splash\n"
         );
-    lcd_write_background(splash_data);
+    lcd_write_background(splash_data); // sent by DMA while the pins are made safe
     /*monitor(system_config.psu);
     if (displays[system_config.display].display_lcd_update){
         displays[system_config.display].display_lcd_update(UI_UPDATE_ALL);
     }*/
-    lcd_backlight_enable(true);
 #endif
 
     // turn everything off
@@ -426,6 +426,8 @@ static void main_system_initialization(void) {
     psucmd_disable(); // disable psu and reset pin label, clear any errors
 
 #ifdef BP_SPLASH_ENABLED
+    lcd_transfer_wait();
+    lcd_backlight_enable(true);
     busy_wait_ms(1000);
     // draw background after showing splash screen
     lcd_backlight_enable(false);
@@ -489,6 +491,7 @@ static void core0_infinite_loop(void) {
         // core 2 handles USB and other sensitive stuff, so it's not critical to co-op multitask
         // but the terminal will not be responsive if the service is blocking
         binmode_service();
+        lcd_transfer_service();
 
         if (tud_cdc_n_connected(0)) {
             if (!has_been_connected) {
@@ -784,6 +787,8 @@ static void core1_infinite_loop(void) {
 
         // service the terminal TX queue
         tx_fifo_service();
+        // release the SPI bus once queued LCD transfers finish
+        lcd_transfer_service();
         // optionally service the binmode TX queue if requested
         if (system_config.binmode_usb_tx_queue_enable) {
             bin_tx_fifo_service();
@@ -826,7 +831,9 @@ static void core1_infinite_loop(void) {
 
                 // BUGBUG -- comments describing intent here would be helpful
                 if (displays[system_config.display].display_lcd_update) {
+                    uint32_t start = time_us_32();
                     displays[system_config.display].display_lcd_update(update_flags);
+                    perf_counter_add(&perf_lcd.lcd_update, time_us_32() - start);
                 }
             }
 
@@ -846,6 +853,7 @@ static void core1_infinite_loop(void) {
             freq_measure_period_irq(); // update frequency periodically
             monitor_reset();
             lcd_update_request = false;
+            perf_lcd.lcd_requests_done++;
         }
 
         // service any requests with priority
@@ -900,6 +908,10 @@ void core1_entry(void) {
 struct repeating_timer lcd_timer;
 
 bool lcd_timer_callback(struct repeating_timer* t) {
+    perf_lcd.lcd_timer_fired++;
+    if (lcd_update_request) {
+        perf_lcd.lcd_timer_skipped++;
+    }
     lcd_update_request = true;
     return true;
 }
@@ -923,11 +935,28 @@ void spi_busy_wait_internal(bool enable, const char *file, int line) {
     if (!enable) {
 
         BP_ASSERT(lock_get_caller_owner_id() == spi_mutex.owner);
+        perf_spi_release();
         mutex_exit(&spi_mutex);
 
     } else {
 
+        // a running LCD queue on this core holds the bus, finish it first
+        lcd_transfer_wait();
+        uint32_t wait_start = time_us_32();
         mutex_enter_blocking(&spi_mutex);
+        perf_spi_acquired(file, wait_start);
         BP_ASSERT(lock_get_caller_owner_id() == spi_mutex.owner);
     }
 }
+
+// after a DMA write that only fed the TX FIFO, finish the way spi_write_blocking does:
+// wait for the last bits, drop what was clocked in and clear the overrun
+void spi_dma_finish(void) {
+    while (spi_is_busy(BP_SPI_PORT)) {
+        tight_loop_contents();
+    }
+    while (spi_is_readable(BP_SPI_PORT)) {
+        (void)spi_get_hw(BP_SPI_PORT)->dr;
+    }
+    spi_get_hw(BP_SPI_PORT)->icr = SPI_SSPICR_RORIC_BITS;
+}
@@ -128,6 +128,7 @@ void lcd_irq_disable(void);
 
 #define spi_busy_wait(ENABLE) spi_busy_wait_internal(ENABLE, __FILE__, __LINE__)
 void spi_busy_wait_internal(bool enable, const char *file, int line);
+void spi_dma_finish(void);
 
 //#define BP_PIO_SHOW_ASSIGNMENT
 
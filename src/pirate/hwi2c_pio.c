@@ -272,5 +272,34 @@ hwi2c_status_t pio_i2c_transaction_array_timeout(uint8_t addr, uint8_t* txbuf, u
     return HWI2C_OK;
 }
 
+// write then read with a repeated start in between, the bus isn't released until the final stop
+// (pio_i2c_transaction_array_timeout stops after the write, some devices then forget the register address)
+hwi2c_status_t pio_i2c_write_read_array_timeout(uint8_t addr, uint8_t* txbuf, uint txlen, uint8_t* rxbuf, uint rxlen, uint32_t timeout) {
+    if (pio_i2c_start_timeout(timeout)) return HWI2C_TIMEOUT;
+    hwi2c_status_t i2c_result = pio_i2c_write_timeout(addr, timeout);
+    if(i2c_result != HWI2C_OK) return i2c_result;
+
+    while (txlen) {
+        --txlen;
+        i2c_result = pio_i2c_write_timeout(*txbuf++, timeout);
+        if(i2c_result != HWI2C_OK) return i2c_result;
+    }
+
+    if (pio_i2c_restart_timeout(timeout)) return HWI2C_TIMEOUT;
+    i2c_result = pio_i2c_write_timeout(addr|1u, timeout);
+    if(i2c_result != HWI2C_OK) return i2c_result;
+
+    while (rxlen) {
+        --rxlen;
+        // NACK the final byte
+        i2c_result = pio_i2c_read_timeout(rxbuf++, rxlen!=0, timeout);
+        if(i2c_result != HWI2C_OK) return i2c_result;
+    }
+
+    if (pio_i2c_stop_timeout(timeout)) return HWI2C_TIMEOUT;
+    if (pio_i2c_wait_idle_timeout(timeout)) return HWI2C_TIMEOUT;
+    return HWI2C_OK;
+}
+
 
 
@@ -28,6 +28,8 @@ hwi2c_status_t pio_i2c_read_array_timeout(uint8_t addr, uint8_t* rxbuf, uint len
 hwi2c_status_t pio_i2c_write_array_timeout(uint8_t addr, uint8_t* txbuf, uint len, uint32_t timeout);
 hwi2c_status_t pio_i2c_transaction_array_timeout(
     uint8_t addr, uint8_t* txbuf, uint txlen, uint8_t* rxbuf, uint rxlen, uint32_t timeout);
+hwi2c_status_t pio_i2c_write_read_array_timeout(
+    uint8_t addr, uint8_t* txbuf, uint txlen, uint8_t* rxbuf, uint rxlen, uint32_t timeout);
 
 // ----------------------------------------------------------------------------
 // Low-level functions
@@ -2,6 +2,7 @@
 #include "pico/stdlib.h"
 #include <stdint.h>
 #include "hardware/spi.h"
+#include "hardware/dma.h"
 #include "pirate.h"
 #include "pirate/bio.h"
 #include "pirate/hwspi.h"
@@ -109,3 +110,99 @@ void hwspi_read_n(uint8_t* data, uint32_t count) {
         data[i] = hwspi_write_read(0xff);
     }
 }
+
+// DMA full duplex transfers for bulk binary modes
+// two channels are claimed once by the user of the bulk path and kept until unclaim
+static int hwspi_dma_tx = -1;
+static int hwspi_dma_rx = -1;
+static const uint8_t hwspi_dma_zero = 0x00;
+static uint8_t hwspi_dma_discard;
+
+bool hwspi_dma_claim(void) {
+    if (hwspi_dma_tx >= 0) {
+        return true;
+    }
+    hwspi_dma_tx = dma_claim_unused_channel(false);
+    hwspi_dma_rx = dma_claim_unused_channel(false);
+    if (hwspi_dma_tx < 0 || hwspi_dma_rx < 0) {
+        hwspi_dma_unclaim();
+        return false;
+    }
+    return true;
+}
+
+void hwspi_dma_unclaim(void) {
+    if (hwspi_dma_tx >= 0) {
+        dma_channel_unclaim(hwspi_dma_tx);
+    }
+    if (hwspi_dma_rx >= 0) {
+        dma_channel_unclaim(hwspi_dma_rx);
+    }
+    hwspi_dma_tx = -1;
+    hwspi_dma_rx = -1;
+}
+
+bool hwspi_dma_available(void) {
+    return hwspi_dma_tx >= 0;
+}
+
+// start clocking count bytes, tx NULL sends 0x00, rx NULL discards the input
+// returns immediately, call hwspi_dma_wait() before touching the buffers
+void hwspi_dma_start(const uint8_t* tx, uint8_t* rx, uint32_t count) {
+    // stale bytes would shift the received data
+    while (spi_is_readable(M_SPI_PORT)) {
+        (void)spi_get_hw(M_SPI_PORT)->dr;
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(hwspi_dma_rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(M_SPI_PORT, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, rx != NULL);
+    dma_channel_configure(hwspi_dma_rx,
+                          &c,
+                          rx ? rx : &hwspi_dma_discard,
+                          &spi_get_hw(M_SPI_PORT)->dr,
+                          count,
+                          false);
+
+    c = dma_channel_get_default_config(hwspi_dma_tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(M_SPI_PORT, true));
+    channel_config_set_read_increment(&c, tx != NULL);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(hwspi_dma_tx,
+                          &c,
+                          &spi_get_hw(M_SPI_PORT)->dr,
+                          tx ? tx : &hwspi_dma_zero,
+                          count,
+                          false);
+
+    // start both together so the RX FIFO can't overflow
+    dma_start_channel_mask((1u << hwspi_dma_tx) | (1u << hwspi_dma_rx));
+}
+
+// the last byte is in memory when the RX channel finishes
+void hwspi_dma_wait(void) {
+    dma_channel_wait_for_finish_blocking(hwspi_dma_rx);
+    while (spi_is_busy(M_SPI_PORT))
+        ; // wait for idle
+}
+
+// blocking full duplex transfer, falls back to polled IO without DMA channels
+void hwspi_write_read_dma(const uint8_t* tx, uint8_t* rx, uint32_t count) {
+    if (!count) {
+        return;
+    }
+    if (!hwspi_dma_available()) {
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t c = (uint8_t)hwspi_write_read(tx ? tx[i] : 0x00);
+            if (rx) {
+                rx[i] = c;
+            }
+        }
+        return;
+    }
+    hwspi_dma_start(tx, rx, count);
+    hwspi_dma_wait();
+}
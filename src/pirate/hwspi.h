@@ -8,3 +8,9 @@ void hwspi_write_32(const uint32_t data, uint8_t count);
 uint32_t hwspi_read(void);
 void hwspi_read_n(uint8_t* data, uint32_t count);
 uint32_t hwspi_write_read(uint8_t data);
+bool hwspi_dma_claim(void);
+void hwspi_dma_unclaim(void);
+bool hwspi_dma_available(void);
+void hwspi_dma_start(const uint8_t* tx, uint8_t* rx, uint32_t count);
+void hwspi_dma_wait(void);
+void hwspi_write_read_dma(const uint8_t* tx, uint8_t* rx, uint32_t count);
@@ -148,7 +148,7 @@ void irio_pio_tx_frame_write(float mod_freq, uint16_t pairs, uint32_t *buffer){
     irio_pio_tx_set_mod_freq(mod_freq);
 
     //push the data to the FIFO, in pairs to prevent the transmitter from sticking 'on'
-    for(uint8_t i=0; i<pairs; i++){
+    for(uint16_t i=0; i<pairs; i++){
         pio_sm_put_blocking(pio_config_tx.pio, pio_config_tx.sm, buffer[i]);
     }    
     //wait for end of transmission
@@ -363,6 +363,138 @@ ir_rx_status_t irio_pio_rx_frame_printf(uint32_t *rx_frame) {
     return IR_RX_FRAME_OK;
 }
 
+// DMA capture of the MARK and SPACE counters into two rings.
+// The counter state machines push into 4 deep FIFOs (noblock, extra counts are dropped), so
+// polling them only works while the reader never falls behind. With DMA every count lands in
+// RAM and irio_pio_rx_ring_read() pairs them up later, frames of any length can be streamed
+// while core0 is busy for up to IRIO_RX_RING_BYTES/4 edges.
+enum {
+    IRIO_RING_MARK = 0, // ring filled by the low (MARK) counter
+    IRIO_RING_SPACE,    // ring filled by the high (SPACE) counter
+};
+
+static int irio_ring_chan[2] = { -1, -1 };
+static uint32_t* irio_ring[2];
+static uint32_t irio_ring_rptr[2];
+static uint8_t irio_ring_state;
+static bool irio_ring_skip; // stale SPACE counts after a frame timeout still to be dropped
+
+static void irio_ring_dma_start(uint8_t r, PIO pio, uint sm) {
+    dma_channel_config c = dma_channel_get_default_config(irio_ring_chan[r]);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, IRIO_RX_RING_BITS); // wrap the write address
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    // 0xffffffff is endless mode on RP2350 and 4G transfers on RP2040
+    dma_channel_configure(irio_ring_chan[r], &c, irio_ring[r], &pio->rxf[sm], 0xffffffff, true);
+    irio_ring_rptr[r] = 0;
+}
+
+// buf holds both rings: 2*IRIO_RX_RING_BYTES, aligned to IRIO_RX_RING_BYTES
+// call after irio_pio_rx_init()
+bool irio_pio_rx_ring_start(uint32_t* buf) {
+    irio_ring_chan[IRIO_RING_MARK] = dma_claim_unused_channel(false);
+    irio_ring_chan[IRIO_RING_SPACE] = dma_claim_unused_channel(false);
+    if (irio_ring_chan[IRIO_RING_MARK] < 0 || irio_ring_chan[IRIO_RING_SPACE] < 0) {
+        irio_pio_rx_ring_stop();
+        return false;
+    }
+    irio_ring[IRIO_RING_MARK] = buf;
+    irio_ring[IRIO_RING_SPACE] = buf + (IRIO_RX_RING_BYTES / sizeof(uint32_t));
+    irio_ring_state = 0;
+    irio_ring_skip = false;
+    irio_pio_rxtx_drain_fifo();
+    irio_ring_dma_start(IRIO_RING_MARK, pio_config_rx_mark.pio, pio_config_rx_mark.sm);
+    irio_ring_dma_start(IRIO_RING_SPACE, pio_config_rx_space.pio, pio_config_rx_space.sm);
+    irio_pio_rx_reset_mod_freq();
+    return true;
+}
+
+// call before irio_pio_rx_deinit()
+void irio_pio_rx_ring_stop(void) {
+    for (uint8_t r = 0; r < count_of(irio_ring_chan); r++) {
+        if (irio_ring_chan[r] >= 0) {
+            dma_channel_abort(irio_ring_chan[r]);
+            dma_channel_unclaim(irio_ring_chan[r]);
+            irio_ring_chan[r] = -1;
+        }
+    }
+}
+
+static bool irio_ring_pop(uint8_t r, uint16_t* count) {
+    if (irio_ring_chan[r] < 0) { // not started or no channels
+        return false;
+    }
+    uint32_t mask = (IRIO_RX_RING_BYTES / sizeof(uint32_t)) - 1;
+    uint32_t wptr = ((dma_hw->ch[irio_ring_chan[r]].write_addr - (uintptr_t)irio_ring[r]) / sizeof(uint32_t)) & mask;
+    if (irio_ring_rptr[r] == wptr) {
+        return false;
+    }
+    *count = (uint16_t)irio_ring[r][irio_ring_rptr[r]];
+    irio_ring_rptr[r] = (irio_ring_rptr[r] + 1) & mask;
+    return true;
+}
+
+// counts run down from 0xffff, a timeout is left as 0xffff
+static uint16_t irio_ring_us(uint16_t count) {
+    return (count == IRIO_RX_TIMEOUT) ? count : (uint16_t)(0xffff - count);
+}
+
+// next MARK or SPACE of the captured frames in order, us is IRIO_RX_TIMEOUT on the final SPACE
+// (or a stuck MARK) of a frame
+// The MARKs and SPACEs are in separate rings, they are paired up the same way irio_pio_rx_frame_buf()
+// does but strictly in turn, so a reader that falls behind never mistakes the next SPACE for the end of frame
+uint8_t irio_pio_rx_ring_read(uint16_t* us) {
+    enum {
+        RING_IDLE,  // waiting for the first MARK of a frame
+        RING_SPACE, // waiting for the SPACE after a MARK
+        RING_MARK   // waiting for the next MARK
+    };
+    uint16_t count;
+
+    switch (irio_ring_state) {
+        case RING_IDLE:
+            // after a frame ends the SPACE counter keeps timing out until the next MARK starts,
+            // then pushes the partial idle count: drop the timeouts and that one count
+            while (irio_ring_skip && irio_ring_pop(IRIO_RING_SPACE, &count)) {
+                if (count != IRIO_RX_TIMEOUT) {
+                    irio_ring_skip = false;
+                }
+            }
+            if (irio_ring_skip || !irio_ring_pop(IRIO_RING_MARK, &count)) {
+                return IRIO_RX_NONE;
+            }
+            if (count == IRIO_RX_TIMEOUT) {
+                return IRIO_RX_NONE; // receiver stuck low, no frame
+            }
+            *us = irio_ring_us(count);
+            irio_ring_state = RING_SPACE;
+            return IRIO_RX_MARK;
+        case RING_SPACE:
+            if (!irio_ring_pop(IRIO_RING_SPACE, &count)) {
+                return IRIO_RX_NONE;
+            }
+            *us = irio_ring_us(count);
+            if (count == IRIO_RX_TIMEOUT) {
+                irio_ring_skip = true;
+                irio_ring_state = RING_IDLE;
+            } else {
+                irio_ring_state = RING_MARK;
+            }
+            return IRIO_RX_SPACE;
+        case RING_MARK:
+        default:
+            if (!irio_ring_pop(IRIO_RING_MARK, &count)) {
+                return IRIO_RX_NONE;
+            }
+            *us = irio_ring_us(count);
+            // a MARK timeout does not start the SPACE counter, end the frame here
+            irio_ring_state = (count == IRIO_RX_TIMEOUT) ? RING_IDLE : RING_SPACE;
+            return IRIO_RX_MARK;
+    }
+}
+
 #if 0
 //debug function for developing the RX modulation frequency measurement
 void irio_pio_rx_mod_freq_get_debug(float *mod_freq){
@@ -15,3 +15,17 @@ void irio_pio_tx_frame_write(float mod_freq, uint16_t pairs, uint32_t *buffer);
 bool irio_pio_rx_frame_buf(float *mod_freq, uint16_t *us, uint16_t *pairs, uint32_t *buffer);
 
 void irio_pio_rx_reset_mod_freq(void);
+bool irio_pio_get_freq_mod(float *mod_freq, uint16_t *us);
+
+// DMA ring capture, see irio_pio_rx_ring_read()
+#define IRIO_RX_RING_BITS 12 // 4096 bytes, 1024 counts per ring
+#define IRIO_RX_RING_BYTES (1u << IRIO_RX_RING_BITS)
+#define IRIO_RX_TIMEOUT 0xffff
+enum {
+    IRIO_RX_NONE = 0,
+    IRIO_RX_MARK,
+    IRIO_RX_SPACE,
+};
+bool irio_pio_rx_ring_start(uint32_t *buf);
+void irio_pio_rx_ring_stop(void);
+uint8_t irio_pio_rx_ring_read(uint16_t *us);
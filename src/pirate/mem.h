@@ -25,6 +25,8 @@ enum big_buffer_owners {
     BP_BIG_BUFFER_SCOPE,
     BP_BIG_BUFFER_LA,
     BP_BIG_BUFFER_DISKFORMAT,
+    BP_BIG_BUFFER_NANDBENCH,
+    BP_BIG_BUFFER_IRTOY_AIR,
 };
 
 /// @brief Attempts to allocate a nand page buffer.
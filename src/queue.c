@@ -126,6 +126,28 @@ void queue2_add_blocking(queue_t* q, const char* data) {
     queue_add_internal(q, data, true);
 }
 
+// copy as much as fits under one lock, then wait for the reader to make room
+void queue2_add_buf_blocking(queue_t* q, const char* data, uint32_t count) {
+    while (count) {
+        uint32_t save = spin_lock_blocking(q->core.spin_lock);
+        uint16_t mask = q->element_count - 1;
+        uint32_t space = (q->rptr - q->wptr - 1) & mask;
+        if (!space) {
+            lock_internal_spin_unlock_with_wait(&q->core, save);
+            continue;
+        }
+        if (space > count) {
+            space = count;
+        }
+        count -= space;
+        while (space--) {
+            q->data[q->wptr] = *data++;
+            q->wptr = (q->wptr + 1) & mask;
+        }
+        lock_internal_spin_unlock_with_notify(&q->core, save);
+    }
+}
+
 void queue2_remove_blocking(queue_t* q, char* data) {
     queue_remove_internal(q, data, true);
 }
@@ -160,6 +160,18 @@ bool queue2_try_peek(queue_t* q, char* data);
  */
 void queue2_add_blocking(queue_t* q, const char* data);
 
+/*! \brief Blocking add of a block of values to queue
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param data Pointer to the values to be copied into the queue
+ * \param count Number of values to copy
+ *
+ * Takes the lock once for each run of free space instead of once per value.
+ * If the queue is full this function will block, until a removal happens on the queue
+ */
+void queue2_add_buf_blocking(queue_t* q, const char* data, uint32_t count);
+
 /*! \brief Blocking remove entry from queue
  *  \ingroup queue
  *
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "system_perf.h"
+
+#define PERF_SPI_FILES 8 // call site files remembered by perf_spi_user()
+
+perf_lcd_t perf_lcd;
+
+static uint8_t spi_user;
+static uint32_t spi_hold_start_us;
+
+void perf_counter_add(perf_counter_t* c, uint32_t us) {
+    c->count++;
+    c->total_us += us;
+    if (us > c->max_us) {
+        c->max_us = us;
+    }
+}
+
+void perf_lcd_clear(void) {
+    memset(&perf_lcd, 0, sizeof(perf_lcd));
+    perf_lcd.start_us = time_us_64();
+}
+
+// sort the bus users by the __FILE__ spi_busy_wait() was called from,
+// the string is only searched the first time a call site file is seen
+static uint8_t perf_spi_user(const char* file) {
+    static const char* files[PERF_SPI_FILES];
+    static uint8_t users[PERF_SPI_FILES];
+    static uint8_t next;
+
+    for (uint8_t i = 0; i < PERF_SPI_FILES; i++) {
+        if (files[i] == file) {
+            return users[i];
+        }
+    }
+
+    uint8_t user = PERF_SPI_OTHER;
+    if (strstr(file, "ui_lcd") || strstr(file, "display/")) {
+        user = PERF_SPI_LCD;
+    } else if (strstr(file, "nand/") || strstr(file, "fatfs/")) {
+        user = PERF_SPI_STORAGE;
+    }
+    files[next] = file;
+    users[next] = user;
+    next = (next + 1) % PERF_SPI_FILES;
+    return user;
+}
+
+void perf_spi_acquired(const char* file, uint32_t wait_start_us) {
+    spi_hold_start_us = time_us_32();
+    spi_user = perf_spi_user(file);
+    perf_counter_add(&perf_lcd.spi_wait[spi_user], spi_hold_start_us - wait_start_us);
+}
+
+void perf_spi_release(void) {
+    perf_counter_add(&perf_lcd.spi_hold[spi_user], time_us_32() - spi_hold_start_us);
+}
@@ -0,0 +1,38 @@
+#ifndef SYSTEM_PERF_H
+#define SYSTEM_PERF_H
+
+// Always on performance counters, printed by the perf command.
+// Durations come from the 1us system timer, reading it is a single register load.
+// Counters updated from both cores may lose the odd count, they are for profiling only.
+typedef struct {
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+} perf_counter_t;
+
+enum perf_spi_user {
+    PERF_SPI_LCD,
+    PERF_SPI_STORAGE, // NAND flash or TF card
+    PERF_SPI_OTHER,   // shift registers
+    PERF_SPI_USERS,
+};
+
+typedef struct {
+    uint64_t start_us;                       // when the counters were cleared, boot until then
+    perf_counter_t lcd_update;               // displays[].display_lcd_update() calls from the core1 loop
+    uint32_t lcd_timer_fired;                // refresh timer callbacks
+    uint32_t lcd_timer_skipped;              // callbacks with the last request still pending
+    uint32_t lcd_requests_done;              // update requests completed by core1
+    perf_counter_t spi_hold[PERF_SPI_USERS]; // SPI bus mutex held
+    perf_counter_t spi_wait[PERF_SPI_USERS]; // waiting for the mutex
+} perf_lcd_t;
+
+extern perf_lcd_t perf_lcd;
+
+void perf_counter_add(perf_counter_t* c, uint32_t us);
+void perf_lcd_clear(void);
+// called from spi_busy_wait() with the bus mutex held
+void perf_spi_acquired(const char* file, uint32_t wait_start_us);
+void perf_spi_release(void);
+
+#endif
@@ -23,6 +23,7 @@
 #include "pirate/intercore_helpers.h"
 #include "binmode/logicanalyzer.h"
 #include "binmode/fala.h"
+#include "decode/la_decode.h"
 
 // 80 characters wide box outline
 // box top and corners
@@ -30,13 +31,40 @@
 #define LOGIC_BAR_HEIGHT 10
 #define LOGIC_BAR_VERTICAL_LABELS 2 // width of each vertical label
 #define LOGIC_BAR_GRAPH_WIDTH LOGIC_BAR_WIDTH - (LOGIC_BAR_VERTICAL_LABELS * 2)
+#define LOGIC_BAR_CHANNELS 8
+#define LOGIC_BAR_CURSOR_COST 8     // bytes to reposition the cursor (\e[rr;ccH), rewrite shorter gaps instead
+#define LOGIC_BAR_SHIFT_MIN_REUSE 24 // columns that must survive a pan before shifting the terminal cells pays off
+#define LOGIC_BAR_DECODE_CHECKPOINTS 8 // saved decoder states per capture, a pan back restarts from the nearest
 
 uint32_t la_freq = 1000, la_samples = 1000;
 uint32_t la_trigger_pin = 0, la_trigger_level = 0;
 char logic_graph_low_character = '_';
 char logic_graph_high_character = '#';
+static const la_decoder_t* logic_bar_decoder = NULL; // when set, decoded frames replace the timeline
+static void graph_decode_invalidate(void);
+
+void logic_bar_set_decoder(const la_decoder_t* decoder) {
+    logic_bar_decoder = decoder;
+    graph_decode_invalidate();
+}
+
+// glyphs currently on the terminal, a redraw only sends the cells that changed
+static char graph_cells[LOGIC_BAR_CHANNELS][LOGIC_BAR_GRAPH_WIDTH];
+static bool graph_cells_valid = false;
+static uint32_t graph_cells_start;  // sample position of column 0 in graph_cells
+static uint32_t graph_redraw_bytes; // terminal bytes sent by the last graph update
+
+// force a full redraw, call whenever the terminal area was cleared or redrawn
+static void graph_cells_invalidate(void) {
+    graph_cells_valid = false;
+}
+
+uint32_t logic_bar_get_redraw_bytes(void) {
+    return graph_redraw_bytes;
+}
 
 void logic_bar_config(char low, char high) {
+    graph_cells_invalidate();
     if (low != 0) {
         logic_graph_low_character = low;
     }
@@ -77,6 +105,123 @@ void graph_timeline(uint16_t position, uint32_t start_pos) {
            start_pos + 6 + (16 * 4));
 }
 
+// decoder state kept between redraws of the same capture
+// running is where the last window ended, panning forward feeds it only the new samples.
+// checkpoints[i] is the state at sample i * interval, panning back restarts from one of them
+static struct {
+    la_decoder_t checkpoints[LOGIC_BAR_DECODE_CHECKPOINTS];
+    uint8_t checkpoint_count; // 0 when nothing is decoded
+    uint32_t interval;
+    uint32_t total_samples; // capture the state belongs to
+    la_decoder_t running;
+    // frames that start inside the last window, in decode order
+    uint32_t first_sample;
+    bool frames_valid; // false if the last window had more frames than fit
+    uint8_t frame_count;
+    la_decode_frame_t frames[LOGIC_BAR_GRAPH_WIDTH];
+    char cells[(LOGIC_BAR_GRAPH_WIDTH) + 1];
+} graph_decode;
+
+// call when the capture or the decoder configuration changes
+static void graph_decode_invalidate(void) {
+    graph_decode.checkpoint_count = 0;
+    graph_decode.frames_valid = false;
+}
+
+static void graph_decode_label(const la_decode_frame_t* frame) {
+    uint32_t col = frame->start - graph_decode.first_sample;
+    la_decode_frame_label(frame, &graph_decode.cells[col], (LOGIC_BAR_GRAPH_WIDTH) - col);
+}
+
+static void graph_decode_frame(const la_decoder_t* d, const la_decode_frame_t* frame) {
+    (void)d;
+    if (frame->start < graph_decode.first_sample ||
+        frame->start >= graph_decode.first_sample + (LOGIC_BAR_GRAPH_WIDTH)) {
+        return;
+    }
+    graph_decode_label(frame);
+    if (graph_decode.frame_count < count_of(graph_decode.frames)) {
+        graph_decode.frames[graph_decode.frame_count++] = *frame;
+    } else {
+        graph_decode.frames_valid = false;
+    }
+}
+
+// decode up to the end of the window and label the frames that start in it
+void graph_decode_line(uint16_t position, uint32_t start_pos, uint32_t total_samples) {
+    memset(graph_decode.cells, ' ', sizeof(graph_decode.cells) - 1);
+    graph_decode.cells[sizeof(graph_decode.cells) - 1] = 0x00;
+
+    uint32_t end = start_pos + (LOGIC_BAR_GRAPH_WIDTH);
+    if (end > total_samples) {
+        end = total_samples;
+    }
+
+    if (total_samples != graph_decode.total_samples) {
+        graph_decode_invalidate();
+    }
+    if (!graph_decode.checkpoint_count) {
+        // work on a copy, the active decoder keeps its own output and state
+        graph_decode.checkpoints[0] = *logic_bar_decoder;
+        la_decode_reset(&graph_decode.checkpoints[0]);
+        graph_decode.checkpoint_count = 1;
+        graph_decode.interval = total_samples / LOGIC_BAR_DECODE_CHECKPOINTS + 1;
+        graph_decode.total_samples = total_samples;
+    }
+
+    la_decoder_t decoder;
+    if (graph_decode.frames_valid && start_pos >= graph_decode.first_sample && graph_decode.running.index <= end) {
+        // frames decoded before the new samples are kept, label the ones still in the window
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < graph_decode.frame_count; i++) {
+            if (graph_decode.frames[i].start >= start_pos) {
+                graph_decode.frames[count++] = graph_decode.frames[i];
+            }
+        }
+        graph_decode.frame_count = count;
+        graph_decode.first_sample = start_pos;
+        for (uint8_t i = 0; i < count; i++) {
+            graph_decode_label(&graph_decode.frames[i]);
+        }
+        decoder = graph_decode.running;
+    } else {
+        uint32_t i = start_pos / graph_decode.interval;
+        if (i >= graph_decode.checkpoint_count) {
+            i = graph_decode.checkpoint_count - 1;
+        }
+        graph_decode.frame_count = 0;
+        graph_decode.frames_valid = true;
+        graph_decode.first_sample = start_pos;
+        decoder = graph_decode.checkpoints[i];
+    }
+    decoder.emit = &graph_decode_frame;
+    decoder.ctx = NULL;
+
+    // feed the samples up to the end of the window, saving checkpoints on the way
+    uint32_t start_ptr = logic_analyzer_get_start_ptr(total_samples);
+    while (decoder.index < end) {
+        uint32_t next = graph_decode.checkpoint_count * graph_decode.interval;
+        bool save = graph_decode.checkpoint_count < LOGIC_BAR_DECODE_CHECKPOINTS && next >= decoder.index &&
+                    next <= end;
+        uint32_t stop = save ? next : end;
+        la_decode_run(&decoder, &logic_analyzer_get_span, start_ptr + decoder.index, stop - decoder.index);
+        if (decoder.index != stop) {
+            break;
+        }
+        if (save) {
+            graph_decode.checkpoints[graph_decode.checkpoint_count++] = decoder;
+        }
+    }
+    graph_decode.running = decoder;
+
+    printf("%s\e[%d;0H\e[K\e[%d;%dH%s",
+           ui_term_color_reset(),
+           position,
+           position,
+           LOGIC_BAR_VERTICAL_LABELS + 1,
+           graph_decode.cells);
+}
+
 // less memory access, but more terminal cursor movement
 void graph_logic_lines_1(uint16_t position, uint32_t sample_ptr) {
     // draw the logic bars
@@ -123,6 +268,91 @@ void graph_logic_lines_2(uint16_t position, uint32_t sample_ptr) {
     }
 }
 
+// pan the cached graph by shift columns using delete/insert character (VT102 DCH/ICH).
+// the right hand labels are pushed back into place by the insert
+static uint32_t graph_cells_shift(char* out, uint32_t max_len, uint8_t channel, uint16_t row, int32_t shift) {
+    char* cells = graph_cells[channel];
+    uint32_t n = (shift < 0) ? -shift : shift;
+    uint32_t keep = (LOGIC_BAR_GRAPH_WIDTH) - n;
+    uint16_t left = LOGIC_BAR_VERTICAL_LABELS + 1;
+    uint16_t right = left + keep;
+    if (shift > 0) { // content moves left
+        memmove(cells, &cells[n], keep);
+        memset(&cells[keep], ' ', n);
+        return snprintf(out, max_len, "\e[%d;%dH\e[%dP\e[%d;%dH\e[%d@", row, left, n, row, right, n);
+    }
+    // content moves right
+    memmove(&cells[n], cells, keep);
+    memset(cells, ' ', n);
+    return snprintf(out, max_len, "\e[%d;%dH\e[%dP\e[%d;%dH\e[%d@", row, right, n, row, left, n);
+}
+
+// build the glyphs for the window, then send only the cells that differ from the cache
+void graph_logic_lines_cached(uint16_t position, uint32_t sample_ptr, uint32_t start_pos) {
+    char next[LOGIC_BAR_CHANNELS][LOGIC_BAR_GRAPH_WIDTH];
+    for (int i = 0; i < (LOGIC_BAR_GRAPH_WIDTH); i++) {
+        uint8_t sample = logic_analyzer_read_ptr(sample_ptr);
+        sample_ptr++;
+        sample_ptr &= 0x1ffff;
+        for (int pins = 0; pins < LOGIC_BAR_CHANNELS; pins++) {
+            next[pins][i] = (sample & (0b1 << pins)) ? logic_graph_high_character : logic_graph_low_character;
+        }
+    }
+
+    // nothing on screen we can trust, every cell differs
+    if (!graph_cells_valid) {
+        memset(graph_cells, 0x00, sizeof(graph_cells));
+        graph_cells_start = start_pos;
+        graph_cells_valid = true;
+    }
+
+    int32_t shift = (int32_t)(start_pos - graph_cells_start);
+    bool do_shift = (shift != 0 && (shift < 0 ? -shift : shift) <= (LOGIC_BAR_GRAPH_WIDTH) - LOGIC_BAR_SHIFT_MIN_REUSE);
+    graph_cells_start = start_pos;
+
+    graph_redraw_bytes = printf("%s", ui_term_color_error());
+    for (int pins = 0; pins < LOGIC_BAR_CHANNELS; pins++) {
+        // worst case: shift escapes plus every other cell changed
+        char out[((LOGIC_BAR_GRAPH_WIDTH) * (LOGIC_BAR_CURSOR_COST + 1)) / 2 + 48];
+        uint32_t len = 0;
+        uint16_t row = position + pins;
+        char* cells = graph_cells[pins];
+
+        if (do_shift) {
+            len += graph_cells_shift(&out[len], sizeof(out) - len, pins, row, shift);
+        }
+
+        int cursor = -1; // column after the last cell written, -1 if unknown
+        for (int i = 0; i < (LOGIC_BAR_GRAPH_WIDTH); i++) {
+            if (next[pins][i] == cells[i]) {
+                continue;
+            }
+            if (cursor < 0 || (i - cursor) > LOGIC_BAR_CURSOR_COST) {
+                len += snprintf(&out[len], sizeof(out) - len, "\e[%d;%dH", row, LOGIC_BAR_VERTICAL_LABELS + 1 + i);
+            } else {
+                // short gap of unchanged cells, cheaper to write them again
+                memcpy(&out[len], &next[pins][cursor], i - cursor);
+                len += i - cursor;
+            }
+            out[len++] = next[pins][i];
+            cells[i] = next[pins][i];
+            cursor = i + 1;
+        }
+        // after a long pan most cells differ, then the whole row is cheaper than the shift and runs
+        uint32_t whole = snprintf(NULL, 0, "\e[%d;%dH", row, LOGIC_BAR_VERTICAL_LABELS + 1) + (LOGIC_BAR_GRAPH_WIDTH);
+        if (len > whole) {
+            len = snprintf(out, sizeof(out), "\e[%d;%dH", row, LOGIC_BAR_VERTICAL_LABELS + 1);
+            memcpy(&out[len], next[pins], LOGIC_BAR_GRAPH_WIDTH);
+            len += LOGIC_BAR_GRAPH_WIDTH;
+            memcpy(cells, next[pins], LOGIC_BAR_GRAPH_WIDTH);
+        }
+        if (len) {
+            out[len] = 0x00;
+            graph_redraw_bytes += printf("%s", out);
+        }
+    }
+}
+
 // TODO: either an exposed struct, or a function to access all the la variables
 void logic_bar_redraw(uint32_t start_pos, uint32_t total_samples) {
 
@@ -147,11 +377,16 @@ void logic_bar_redraw(uint32_t start_pos, uint32_t total_samples) {
 
     // draw timing marks
     uint16_t position = draw_get_position_index(LOGIC_BAR_HEIGHT);
-    graph_timeline(position + 2, start_pos);
+    if (logic_bar_decoder) {
+        graph_decode_line(position + 2, start_pos, total_samples);
+    } else {
+        graph_timeline(position + 2, start_pos);
+    }
 
     // draw the logic bars
     // graph_logic_lines_1(position+3, sample_ptr);
-    graph_logic_lines_2(position + 3, sample_ptr);
+    // graph_logic_lines_2(position + 3, sample_ptr);
+    graph_logic_lines_cached(position + 3, sample_ptr, start_pos);
 
     // restore cursor
     printf("\e8");
@@ -193,6 +428,7 @@ void frame_vertical_labels(uint16_t position) {
 }
 
 void logic_bar_draw_frame(void) {
+    graph_cells_invalidate();
     // height of the logic bar, plus height of the status bar if active
     // todo: allocate position index from central toolbar logic
     uint16_t toolbar_position_index = draw_get_position_index(LOGIC_BAR_HEIGHT);
@@ -223,6 +459,7 @@ void logic_bar_draw_frame(void) {
 
 // detach/release/stop/end the logic bar frame
 void logic_bar_detach(void) {
+    graph_cells_invalidate();
     //  freeze terminal updates
     draw_prepare();
 
@@ -251,6 +488,7 @@ void logic_bar_update(void) {
         return;
     }
     uint32_t total_samples = logic_analyzer_get_end_ptr(); // TODO: REMOVE HACK
+    graph_decode_invalidate(); // a new capture
     logic_bar_redraw(0, total_samples);
 }
 
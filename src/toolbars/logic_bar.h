@@ -1,6 +1,8 @@
 #ifndef LOGIC_BAR_H
 #define LOGIC_BAR_H
 
+struct la_decoder;
+
 // Function declarations
 void la_draw_frame(void);
 void logic_bar_redraw(uint32_t start_pos, uint32_t total_samples);
@@ -12,5 +14,7 @@ void logic_bar_show(void);
 void logic_bar_navigate(void);
 void logic_bar_update(void);
 void logic_bar_config(char low, char high);
+uint32_t logic_bar_get_redraw_bytes(void);
+void logic_bar_set_decoder(const struct la_decoder* decoder);
 
 #endif // LOGIC_BAR_H
\ No newline at end of file
@@ -519,6 +519,7 @@ enum T_translations{
     T_HELP_LOGIC_HIDE,
     T_HELP_LOGIC_SHOW,
     T_HELP_LOGIC_NAV,
+    T_HELP_LOGIC_DECODE,
     T_HELP_LOGIC_INFO,
     T_HELP_LOGIC_FREQUENCY,
     T_HELP_LOGIC_OVERSAMPLE,
@@ -528,6 +529,8 @@ enum T_translations{
     T_HELP_LOGIC_TRIGGER_LEVEL,
     T_HELP_LOGIC_LOW_CHAR,
     T_HELP_LOGIC_HIGH_CHAR,
+    T_HELP_LOGIC_WRITE,
+    T_HELP_LOGIC_FILTER,
     T_HELP_CMD_CLS,
     T_HELP_SECTION_TOOLS,
     T_HELP_CMD_LOGIC,
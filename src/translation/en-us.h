@@ -515,6 +515,7 @@ static char const * const en_us[]={
 	[T_HELP_LOGIC_HIDE]="hide logic graph",
 	[T_HELP_LOGIC_SHOW]="show logic graph",
 	[T_HELP_LOGIC_NAV]="navigate logic graph with arrow keys, x to exit",
+	[T_HELP_LOGIC_DECODE]="decode the capture: i2c, spi, uart, 1wire, off. -p channels, -s save to file, -r UART baud, -c SPI CPOL, -e SPI CPHA",
 	[T_HELP_LOGIC_INFO]="show configuration info",
 	[T_HELP_LOGIC_FREQUENCY]="set sample frequency in Hz",
 	[T_HELP_LOGIC_OVERSAMPLE]="set oversample rate, multiplies the sample frequency",
@@ -524,6 +525,8 @@ static char const * const en_us[]={
 	[T_HELP_LOGIC_TRIGGER_LEVEL]="set trigger level, 0-1",
 	[T_HELP_LOGIC_LOW_CHAR]="set character used for low in graph (ex:_)",
 	[T_HELP_LOGIC_HIGH_CHAR]="set character used for high in graph (ex:*)",
+	[T_HELP_LOGIC_WRITE]="save each capture to storage: vcd, sr (sigrok), off",
+	[T_HELP_LOGIC_FILTER]="reduce oversampled captures to the sample frequency: glitch (keep), majority (reject), off",
 	[T_HELP_CMD_CLS]="Clear and reset the terminal",
 	[T_HELP_SECTION_TOOLS]="tools and utilities",
 	[T_HELP_CMD_LOGIC]="Logic analyzer",
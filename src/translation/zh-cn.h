@@ -503,6 +503,7 @@ static char const * const zh_cn[T_LAST_ITEM_ALWAYS_AT_THE_END]={
     [ T_HELP_LOGIC_HIDE                ] = NULL,
     [ T_HELP_LOGIC_SHOW                ] = NULL,
     [ T_HELP_LOGIC_NAV                 ] = NULL,
+    [ T_HELP_LOGIC_DECODE              ] = NULL,
     [ T_HELP_LOGIC_INFO                ] = NULL,
     [ T_HELP_LOGIC_FREQUENCY           ] = NULL,
     [ T_HELP_LOGIC_OVERSAMPLE          ] = NULL,
@@ -512,6 +513,8 @@ static char const * const zh_cn[T_LAST_ITEM_ALWAYS_AT_THE_END]={
     [ T_HELP_LOGIC_TRIGGER_LEVEL       ] = NULL,
     [ T_HELP_LOGIC_LOW_CHAR            ] = NULL,
     [ T_HELP_LOGIC_HIGH_CHAR           ] = NULL,
+    [ T_HELP_LOGIC_WRITE               ] = NULL,
+    [ T_HELP_LOGIC_FILTER              ] = NULL,
     [ T_HELP_CMD_CLS                   ] = NULL,
     [ T_HELP_SECTION_TOOLS             ] = NULL,
     [ T_HELP_CMD_LOGIC                 ] = NULL,
@@ -87,6 +87,20 @@ bool cmdln_try_discard(uint32_t i) {
     return true;
 }
 
+// copy the current command (as isolated by cmdln_find_next_command) into str
+// returns the number of characters copied, str is always zero terminated
+uint32_t cmdln_get_current_command(uint32_t max_len, char* str) {
+    uint32_t i = 0;
+    char c;
+    while (i < (max_len - 1) && command_info.endptr >= command_info.startptr + i &&
+           cmdln_try_peek(command_info.startptr + i, &c)) {
+        str[i] = c;
+        i++;
+    }
+    str[i] = 0x00;
+    return i;
+}
+
 bool cmdln_next_buf_pos(void) {
     cmdln.rptr = cmdln.wptr;
     cmdln.cursptr = cmdln.wptr;
@@ -36,6 +36,7 @@ bool cmdln_args_float_by_position(uint32_t pos, float* value);
 bool cmdln_args_uint32_by_position(uint32_t pos, uint32_t* value);
 bool cmdln_args_string_by_position(uint32_t pos, uint32_t max_len, char* str);
 bool cmdln_find_next_command(struct _command_info_t* cp);
+uint32_t cmdln_get_current_command(uint32_t max_len, char* str);
 bool cmdln_info(void);
 bool cmdln_info_uint32(void);
 
@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "hardware/dma.h"
 #include "pirate.h"
 #include "system_config.h"
 #include "font/font.h"
@@ -31,6 +33,176 @@ static inline void lcd_write_stop(void) {
     spi_busy_wait(false);
 }
 
+// LCD transfer queue
+// Large pixel blocks are sent by DMA while the caller carries on. The queue holds the SPI bus
+// from the first transfer until it drains, other SPI users wait in spi_busy_wait() as they
+// would for any LCD write. DMA completion is polled by lcd_transfer_service() from both core
+// loops, the bus mutex has to be released by the core that took it.
+// Text and label repaints stay on spi_write_blocking(): they stream into a window the caller
+// opened with lcd_set_bounding_box(), a glyph or two at a time from a glyph cache slot or a
+// stack buffer that is reused before a queued transfer would run, and at around 1KB each
+// the DMA setup would cost about as much as it saves.
+#define LCD_QUEUE_DEPTH 4
+
+typedef struct {
+    uint16_t xs, xe, ys, ye;
+    const uint8_t* pixels; // NULL for a fill with color
+    uint16_t color;        // fill color in LCD byte order, DMA reads it in place
+    uint32_t length;       // bytes to send
+    lcd_transfer_done_t done;
+    void* context;
+} lcd_transfer_t;
+
+static lcd_transfer_t lcd_queue[LCD_QUEUE_DEPTH];
+static uint8_t lcd_queue_head; // running transfer
+static uint8_t lcd_queue_count;
+static volatile int8_t lcd_queue_core = -1; // core holding the bus for the queue, -1 when idle
+static int lcd_queue_chan = -1;
+
+// set the write window with the bus already held
+static void lcd_window(uint16_t xs, uint16_t xe, uint16_t ys, uint16_t ye) {
+    uint8_t column[4] = { ys >> 8, ys & 0xff, ye >> 8, ye & 0xff };
+    uint8_t row[4] = { xs >> 8, xs & 0xff, xe >> 8, xe & 0xff };
+    const uint8_t command[3] = { 0x2A, 0x2B, 0x2C }; // column set, row set, memory write
+    const uint8_t* data[2] = { column, row };
+
+    for (uint8_t i = 0; i < 3; i++) {
+        gpio_put(DISPLAY_DP, 0);
+        gpio_put(DISPLAY_CS, 0);
+        spi_write_blocking(BP_SPI_PORT, &command[i], 1);
+        gpio_put(DISPLAY_CS, 1);
+        if (i < 2) {
+            gpio_put(DISPLAY_DP, 1);
+            gpio_put(DISPLAY_CS, 0);
+            spi_write_blocking(BP_SPI_PORT, data[i], 4);
+            gpio_put(DISPLAY_CS, 1);
+        }
+    }
+}
+
+static void lcd_transfer_start(lcd_transfer_t* t) {
+    lcd_window(t->xs, t->xe, t->ys, t->ye);
+    gpio_put(DISPLAY_DP, 1);
+    gpio_put(DISPLAY_CS, 0);
+    const uint8_t* src = t->pixels ? t->pixels : (const uint8_t*)&t->color;
+
+    if (lcd_queue_chan < 0) {
+        if (t->pixels) {
+            spi_write_blocking(BP_SPI_PORT, src, t->length);
+        } else {
+            for (uint32_t i = 0; i < t->length; i += 2) {
+                spi_write_blocking(BP_SPI_PORT, src, 2);
+            }
+        }
+        return;
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(lcd_queue_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    if (!t->pixels) {
+        channel_config_set_ring(&c, false, 1); // read wraps on the two color bytes
+    }
+    channel_config_set_dreq(&c, spi_get_dreq(BP_SPI_PORT, true));
+    dma_channel_configure(lcd_queue_chan, &c, &spi_get_hw(BP_SPI_PORT)->dr, src, t->length, true);
+}
+
+// called on the owning core with the bus held, returns false once the queue is empty and the bus released
+static bool lcd_transfer_next(void) {
+    lcd_transfer_t* t = &lcd_queue[lcd_queue_head];
+    if (lcd_queue_chan >= 0) {
+        if (dma_channel_is_busy(lcd_queue_chan)) {
+            return true;
+        }
+        spi_dma_finish();
+    }
+    gpio_put(DISPLAY_CS, 1);
+    lcd_queue_head = (lcd_queue_head + 1) % LCD_QUEUE_DEPTH;
+    lcd_queue_count--;
+    if (t->done) {
+        t->done(t->context);
+    }
+
+    if (lcd_queue_count) {
+        lcd_transfer_start(&lcd_queue[lcd_queue_head]);
+        return true;
+    }
+    if (lcd_queue_chan >= 0) {
+        dma_channel_unclaim(lcd_queue_chan);
+        lcd_queue_chan = -1;
+    }
+    lcd_queue_core = -1;
+    spi_busy_wait(false);
+    return false;
+}
+
+void lcd_transfer_service(void) {
+    if (lcd_queue_core == (int8_t)get_core_num()) {
+        lcd_transfer_next();
+    }
+}
+
+// finish the transfers this core queued, other cores wait for the bus in spi_busy_wait()
+void lcd_transfer_wait(void) {
+    while (lcd_queue_core == (int8_t)get_core_num() && lcd_transfer_next()) {
+        tight_loop_contents();
+    }
+}
+
+static void lcd_transfer_queue(const lcd_transfer_t* t) {
+    if (lcd_queue_core == (int8_t)get_core_num()) {
+        // queue is ours and running, wait for a free slot
+        while (lcd_queue_count == LCD_QUEUE_DEPTH && lcd_transfer_next()) {
+            tight_loop_contents();
+        }
+    }
+    if (lcd_queue_core == (int8_t)get_core_num()) {
+        lcd_queue[(lcd_queue_head + lcd_queue_count) % LCD_QUEUE_DEPTH] = *t;
+        lcd_queue_count++;
+        return;
+    }
+
+    spi_busy_wait(true);
+    lcd_queue_core = get_core_num();
+    lcd_queue_chan = dma_claim_unused_channel(false); // polled writes if none is free
+    lcd_queue_head = 0;
+    lcd_queue_count = 1;
+    lcd_queue[0] = *t;
+    lcd_transfer_start(&lcd_queue[0]);
+    // without DMA the transfer is already done
+    if (lcd_queue_chan < 0) {
+        lcd_transfer_next();
+    }
+}
+
+// send a block of pixels in LCD byte order, they must stay untouched until done is called
+void lcd_transfer_pixels(uint16_t xs,
+                         uint16_t xe,
+                         uint16_t ys,
+                         uint16_t ye,
+                         const uint8_t* pixels,
+                         uint32_t length,
+                         lcd_transfer_done_t done,
+                         void* context) {
+    lcd_transfer_t t = { xs, xe, ys, ye, pixels, 0, length, done, context };
+    lcd_transfer_queue(&t);
+}
+
+// fill a window with count pixels of one color
+void lcd_transfer_fill(uint16_t xs,
+                       uint16_t xe,
+                       uint16_t ys,
+                       uint16_t ye,
+                       const uint8_t* color,
+                       uint32_t count,
+                       lcd_transfer_done_t done,
+                       void* context) {
+    lcd_transfer_t t = { xs, xe, ys, ye, NULL, 0, count * 2, done, context };
+    memcpy(&t.color, color, 2);
+    lcd_transfer_queue(&t);
+}
+
 void lcd_write_string(
     const FONT_INFO* font, const uint8_t* back_color, const uint8_t* text_color, const char* c, uint16_t fill_length);
 void lcd_write_labels(uint16_t left_margin,
@@ -115,60 +287,143 @@ const struct display_layout layout = {
     LCD_RED               // enum lcd_colors io_value_color;
 };
 
+// returns with the image queued, the next SPI user waits for it
 void lcd_write_background(const unsigned char* image) {
-    lcd_set_bounding_box(0, 240, 0, 320);
-
-    lcd_write_start();
-
     // Update October 2024: new image headers in pre-sorted pixel format for speed
     //  see image.py in the display folder to create new headers
-    // TODO: DMA it.
-    spi_write_blocking(BP_SPI_PORT, image, (320 * 240 * 2));
+    lcd_transfer_pixels(0, 240, 0, 320, image, (320 * 240 * 2), NULL, NULL);
+}
 
-    lcd_write_stop();
+// Glyphs are expanded once into the RGB565 pixel stream the LCD wants (columns of rows,
+// then the right padding) and sent with a single SPI write. The most recently used
+// glyphs are kept, keyed on font, character and the fg/bg color pair.
+#define LCD_GLYPH_CACHE_SLOTS 8
+#define LCD_GLYPH_MAX_PIXELS (24 * (24 + 2)) // largest status screen glyph, 23pt with its right padding
+#define LCD_FILL_PIXELS 64                   // background pixels per write when clearing old characters
+
+typedef struct {
+    const FONT_INFO* font; // NULL if the slot is empty
+    uint8_t c;             // character, less the font start_char
+    uint16_t back_color;
+    uint16_t text_color;
+    uint16_t length; // bytes in pixels
+    uint32_t used;   // last use, the oldest slot is replaced
+    uint8_t pixels[LCD_GLYPH_MAX_PIXELS * 2];
+} lcd_glyph_t;
+
+static lcd_glyph_t lcd_glyph_cache[LCD_GLYPH_CACHE_SLOTS];
+static uint32_t lcd_glyph_clock;
+
+static void lcd_glyph_expand(lcd_glyph_t* g, const uint8_t* back_color, const uint8_t* text_color) {
+    const FONT_INFO* font = g->font;
+    const FONT_CHAR_INFO* info = &(*font).lookup[g->c];
+    uint8_t* p = g->pixels;
+
+    // some bits may be discarded because of poor packing by The Dot Factory
+    uint16_t rows = (info->height < (*font).height_bytes * 8) ? info->height : (*font).height_bytes * 8;
+    for (uint16_t col = 0; col < info->width; col++) {
+        const uint8_t* bitmap = &(*font).bitmaps[info->offset + (col * (*font).height_bytes)];
+        for (uint16_t row = 0; row < rows; row++) {
+            const uint8_t* color = (bitmap[row / 8] & (0b10000000 >> (row % 8))) ? text_color : back_color;
+            *p++ = color[0];
+            *p++ = color[1];
+        }
+    }
+    // depending on how the font fits in the bitmap,
+    // there may or may not be enough right hand padding between characters
+    // this adds a configurable amount of space
+    for (uint16_t pad = 0; pad < info->height * (*font).right_padding; pad++) {
+        *p++ = back_color[0];
+        *p++ = back_color[1];
+    }
+    g->length = p - g->pixels;
+}
+
+// find the glyph in the cache or expand it into the oldest slot, NULL if it is too big for a slot
+static const lcd_glyph_t* lcd_glyph_get(const FONT_INFO* font,
+                                        uint8_t adjusted_c,
+                                        const uint8_t* back_color,
+                                        const uint8_t* text_color) {
+    const FONT_CHAR_INFO* info = &(*font).lookup[adjusted_c];
+    if (info->height * (info->width + (*font).right_padding) > LCD_GLYPH_MAX_PIXELS) {
+        return NULL;
+    }
+
+    uint16_t back = (back_color[0] << 8) | back_color[1];
+    uint16_t text = (text_color[0] << 8) | text_color[1];
+    lcd_glyph_t* oldest = &lcd_glyph_cache[0];
+    lcd_glyph_clock++;
+    for (uint8_t i = 0; i < LCD_GLYPH_CACHE_SLOTS; i++) {
+        lcd_glyph_t* g = &lcd_glyph_cache[i];
+        if (g->font == font && g->c == adjusted_c && g->back_color == back && g->text_color == text) {
+            g->used = lcd_glyph_clock;
+            return g;
+        }
+        if (g->font == NULL || (oldest->font != NULL && g->used < oldest->used)) {
+            oldest = g;
+        }
+    }
+
+    oldest->font = font;
+    oldest->c = adjusted_c;
+    oldest->back_color = back;
+    oldest->text_color = text;
+    oldest->used = lcd_glyph_clock;
+    lcd_glyph_expand(oldest, back_color, text_color);
+    return oldest;
+}
+
+// pixel at a time, for glyphs too big to cache
+static void lcd_write_glyph_pixels(const FONT_INFO* font,
+                                   uint8_t adjusted_c,
+                                   const uint8_t* back_color,
+                                   const uint8_t* text_color) {
+    uint16_t row;
+    for (uint16_t col = 0; col < (*font).lookup[adjusted_c].width; col++) {
+        row = 0;
+        uint16_t rows = (*font).lookup[adjusted_c].height;
+        uint16_t offset = (*font).lookup[adjusted_c].offset;
+
+        for (uint16_t page = 0; page < (*font).height_bytes; page++) {
+
+            uint8_t bitmap_char = (*font).bitmaps[offset + (col * (*font).height_bytes) + page];
+
+            for (uint8_t i = 0; i < 8; i++) {
+                if (bitmap_char & (0b10000000 >> i)) {
+                    spi_write_blocking(BP_SPI_PORT, text_color, 2);
+                } else {
+                    spi_write_blocking(BP_SPI_PORT, back_color, 2);
+                }
+
+                row++;
+                // break out of loop when we have all the rows
+                // some bits may be discarded because of poor packing by The Dot Factory
+                if (row == rows) {
+                    break;
+                }
+            }
+        }
+    }
+    uint16_t needed_padding = (*font).lookup[adjusted_c].height * (*font).right_padding;
+    for (uint16_t pad = 0; pad < needed_padding; pad++) {
+        spi_write_blocking(BP_SPI_PORT, back_color, 2);
+    }
 }
 
 // Write a string to the LCD
 // TODO: in LCD write string, automaticall toupper/lower depending on the contents of the font and the string
 void lcd_write_string(
     const FONT_INFO* font, const uint8_t* back_color, const uint8_t* text_color, const char* c, uint16_t fill_length) {
-    uint16_t row;
     uint16_t length = 0;
-    uint8_t adjusted_c;
+    uint8_t adjusted_c = 0;
 
     while (*c > 0) {
         adjusted_c = (*c) - (*font).start_char;
-        for (uint16_t col = 0; col < (*font).lookup[adjusted_c].width; col++) {
-            row = 0;
-            uint16_t rows = (*font).lookup[adjusted_c].height;
-            uint16_t offset = (*font).lookup[adjusted_c].offset;
-
-            for (uint16_t page = 0; page < (*font).height_bytes; page++) {
-
-                uint8_t bitmap_char = (*font).bitmaps[offset + (col * (*font).height_bytes) + page];
-
-                for (uint8_t i = 0; i < 8; i++) {
-                    if (bitmap_char & (0b10000000 >> i)) {
-                        spi_write_blocking(BP_SPI_PORT, text_color, 2);
-                    } else {
-                        spi_write_blocking(BP_SPI_PORT, back_color, 2);
-                    }
-
-                    row++;
-                    // break out of loop when we have all the rows
-                    // some bits may be discarded because of poor packing by The Dot Factory
-                    if (row == rows) {
-                        break;
-                    }
-                }
-            }
-        }
-        // depending on how the font fits in the bitmap,
-        // there may or may not be enough right hand padding between characters
-        // this adds a configurable amount of space
-        uint16_t needed_padding = (*font).lookup[adjusted_c].height * (*font).right_padding;
-        for (uint16_t pad = 0; pad < needed_padding; pad++) {
-            spi_write_blocking(BP_SPI_PORT, back_color, 2);
+        const lcd_glyph_t* g = lcd_glyph_get(font, adjusted_c, back_color, text_color);
+        if (g) {
+            spi_write_blocking(BP_SPI_PORT, g->pixels, g->length);
+        } else {
+            lcd_write_glyph_pixels(font, adjusted_c, back_color, text_color);
         }
         (c)++;
         length++; // how many characters have we written
@@ -178,8 +433,15 @@ void lcd_write_string(
     if (length < fill_length) {
         uint32_t fill = (fill_length - length) * ((*font).lookup[adjusted_c].height *
                                                   ((*font).right_padding + (*font).lookup[adjusted_c].width));
-        for (uint32_t i = 0; i < fill; i++) {
-            spi_write_blocking(BP_SPI_PORT, back_color, 2);
+        uint8_t run[LCD_FILL_PIXELS * 2];
+        for (uint32_t i = 0; i < LCD_FILL_PIXELS; i++) {
+            run[i * 2] = back_color[0];
+            run[i * 2 + 1] = back_color[1];
+        }
+        while (fill) {
+            uint32_t n = (fill < LCD_FILL_PIXELS) ? fill : LCD_FILL_PIXELS;
+            spi_write_blocking(BP_SPI_PORT, run, n * 2);
+            fill -= n;
         }
     }
 }
@@ -341,36 +603,18 @@ void lcd_write_labels(uint16_t left_margin,
     lcd_write_stop();
 }
 
+// also called from the screensaver alarm, wait so the bus is not left held
 void lcd_clear(void) {
-    uint16_t x, y;
-
-    lcd_set_bounding_box(0, 240, 0, 320);
-
-    lcd_write_start();
-    for (x = 0; x < 240; x++) {
-        for (y = 0; y < 320; y++) {
-            spi_write_blocking(BP_SPI_PORT, colors_pallet[LCD_BLACK], 2);
-        }
-    }
-    lcd_write_stop();
+    lcd_transfer_fill(0, 240, 0, 320, colors_pallet[LCD_BLACK], 240 * 320, NULL, NULL);
+    lcd_transfer_wait();
 }
 
 void lcd_set_bounding_box(uint16_t xs, uint16_t xe, uint16_t ys, uint16_t ye) {
     // setup write area
     // start must always be =< end
-    lcd_write_command(0x2A); // column start and end set
-    lcd_write_data(ys >> 8);
-    lcd_write_data(ys & 0xff); // 0
-    lcd_write_data(ye >> 8);
-    lcd_write_data(ye & 0xff); // 320
-
-    lcd_write_command(0x2B); // row start and end set
-
-    lcd_write_data(xs >> 8);
-    lcd_write_data(xs & 0xff); // 0
-    lcd_write_data(xe >> 8);
-    lcd_write_data(xe & 0xff); // LCD_W (240)
-    lcd_write_command(0x2C);   // Memory Write
+    spi_busy_wait(true);
+    lcd_window(xs, xe, ys, ye);
+    spi_busy_wait(false);
 }
 
 void lcd_write_command(uint8_t command) {
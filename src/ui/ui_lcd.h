@@ -12,6 +12,28 @@ void lcd_disable(void);
 void menu_update(uint8_t current, uint8_t next);
 void lcd_screensaver_alarm_reset(void);
 
+// LCD transfer queue, done is called from lcd_transfer_service() with the SPI bus still held:
+// it may queue more transfers but must not take the bus
+typedef void (*lcd_transfer_done_t)(void* context);
+void lcd_transfer_pixels(uint16_t xs,
+                         uint16_t xe,
+                         uint16_t ys,
+                         uint16_t ye,
+                         const uint8_t* pixels,
+                         uint32_t length,
+                         lcd_transfer_done_t done,
+                         void* context);
+void lcd_transfer_fill(uint16_t xs,
+                       uint16_t xe,
+                       uint16_t ys,
+                       uint16_t ye,
+                       const uint8_t* color,
+                       uint32_t count,
+                       lcd_transfer_done_t done,
+                       void* context);
+void lcd_transfer_service(void);
+void lcd_transfer_wait(void);
+
 extern const uint8_t colors_pallet[][2];
 // Setup the text and background pixel colors
 enum lcd_colors {
@@ -90,6 +90,9 @@ bool ui_process_commands(void) {
             return false;
         }
 
+        // follow along logic analyzer hook, remember the command for capture metadata
+        fala_command_hook();
+
         switch (cp.command[0]) {
             case '[':
             case '>':
@@ -164,6 +164,11 @@ void bin_tx_fifo_put(const char c) {
     queue2_add_blocking(&bin_tx_fifo, &c);
 }
 
+void bin_tx_fifo_put_buf(const char* buf, uint32_t len) {
+    BP_ASSERT_CORE0(); // tx fifo shoudl only be added to from core 0 (deadlock risk)
+    queue2_add_buf_blocking(&bin_tx_fifo, buf, len);
+}
+
 bool bin_tx_fifo_try_get(char* c) {
     BP_ASSERT_CORE1(); // tx fifo is drained from core1 only
     return queue2_try_remove(&bin_tx_fifo, c);
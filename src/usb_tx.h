@@ -4,6 +4,7 @@ void tx_fifo_put(char* c);
 void tx_fifo_try_put(char* c);
 void tx_sb_start(uint32_t valid_characters_in_status_bar);
 void bin_tx_fifo_put(const char c);
+void bin_tx_fifo_put_buf(const char* buf, uint32_t len);
 void bin_tx_fifo_service(void);
 bool bin_tx_not_empty(void);
 bool bin_tx_fifo_try_get(char* c);